@@ -0,0 +1,268 @@
+#ifndef AUDIO_DEVICES_H
+#define AUDIO_DEVICES_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include "system_probe.h"
+
+// The sound devices of the machine, found without running arecord, aplay
+// or pactl. The ALSA enumeration lives in alsa_devices.cpp; the parsers of
+// /proc/asound below are its fallback and need no ALSA library.
+
+// One direction of a PCM: a device that both plays and captures is listed
+// twice. Rates and channels are zero when the device was not opened to
+// probe them, e.g. because it is busy or is a plugin like "pulse".
+struct AudioDeviceInfo {
+    std::string name;        // What to pass to --input-device, e.g. "hw:1,0" or "default"
+    std::string card_id;     // ALSA card id, e.g. "Device"; empty for plugins
+    std::string description; // e.g. "USB Audio Device: USB Audio"
+    int card = -1;
+    int device = -1;
+    bool capture = false;    // Otherwise playback
+    bool probed = false;
+    bool s16 = false;        // Takes 16-bit little-endian samples
+    unsigned int min_rate = 0;
+    unsigned int max_rate = 0;
+    unsigned int min_channels = 0;
+    unsigned int max_channels = 0;
+};
+
+struct AsoundCard {
+    int index = -1;
+    std::string id;   // e.g. "PCH"
+    std::string name; // e.g. "HDA Intel PCH"
+};
+
+// Cards from /proc/asound/cards text, whose lines look like
+// " 0 [PCH            ]: HDA-Intel - HDA Intel PCH"
+inline std::vector<AsoundCard> parse_asound_cards(const std::string& text) {
+    std::vector<AsoundCard> cards;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t open = line.find('[');
+        size_t close = line.find("]:");
+        if (open == std::string::npos || close == std::string::npos || close < open) {
+            continue; // The second line of each card is its long name
+        }
+        char* end = nullptr;
+        long index = std::strtol(line.c_str(), &end, 10);
+        if (end == line.c_str() || index < 0) {
+            continue;
+        }
+        
+        AsoundCard card;
+        card.index = static_cast<int>(index);
+        card.id = trim_probe_value(line.substr(open + 1, close - open - 1));
+        std::string rest = line.substr(close + 2);
+        size_t dash = rest.find(" - ");
+        card.name = trim_probe_value(dash == std::string::npos ? rest : rest.substr(dash + 3));
+        cards.push_back(card);
+    }
+    return cards;
+}
+
+// Hardware PCMs from /proc/asound/pcm text, whose lines look like
+// "00-00: ALC887-VD Analog : ALC887-VD Analog : playback 1 : capture 1"
+inline std::vector<AudioDeviceInfo> parse_asound_pcm(const std::string& text, const std::vector<AsoundCard>& cards) {
+    std::vector<AudioDeviceInfo> devices;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        char* end = nullptr;
+        const int card = static_cast<int>(std::strtol(line.c_str(), &end, 10));
+        if (end == line.c_str() || *end != '-') {
+            continue;
+        }
+        const char* device_start = end + 1;
+        const int device = static_cast<int>(std::strtol(device_start, &end, 10));
+        if (end == device_start || *end != ':') {
+            continue;
+        }
+        
+        std::vector<std::string> fields;
+        std::istringstream rest(line.substr(end + 1 - line.c_str()));
+        std::string field;
+        while (std::getline(rest, field, ':')) {
+            fields.push_back(trim_probe_value(field));
+        }
+        
+        AudioDeviceInfo info;
+        info.name = "hw:" + std::to_string(card) + "," + std::to_string(device);
+        info.card = card;
+        info.device = device;
+        std::string card_name;
+        for (const auto& c : cards) {
+            if (c.index == card) {
+                info.card_id = c.id;
+                card_name = c.name;
+            }
+        }
+        const std::string pcm_name = fields.empty() ? "" : fields[0];
+        info.description = card_name.empty() ? pcm_name : pcm_name.empty() ? card_name : card_name + ": " + pcm_name;
+        
+        for (size_t i = 1; i < fields.size(); i++) {
+            if (fields[i].compare(0, 7, "capture") == 0) {
+                info.capture = true;
+                devices.push_back(info);
+            } else if (fields[i].compare(0, 8, "playback") == 0) {
+                info.capture = false;
+                devices.push_back(info);
+            }
+        }
+    }
+    return devices;
+}
+
+// The hardware PCMs listed in /proc/asound, which is readable even without
+// access to the sound devices themselves
+inline std::vector<AudioDeviceInfo> list_proc_audio_devices() {
+    return parse_asound_pcm(read_text_file("/proc/asound/pcm"), parse_asound_cards(read_text_file("/proc/asound/cards")));
+}
+
+// Split a hardware PCM name like "hw:1,0", "plughw:1", "hw:CARD=Device,DEV=0"
+// or "hw:Device,0" into its card (a number or an id) and device. Returns
+// false for other names, such as "default" or "pulse".
+inline bool parse_hw_device_name(const std::string& name, std::string& card, int& device, bool* plugin = nullptr) {
+    size_t colon = name.find(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    const std::string kind = name.substr(0, colon);
+    if (kind != "hw" && kind != "plughw") {
+        return false;
+    }
+    if (plugin) {
+        *plugin = kind == "plughw";
+    }
+    
+    std::string rest = name.substr(colon + 1);
+    size_t comma = rest.find(',');
+    card = rest.substr(0, comma);
+    std::string dev = comma == std::string::npos ? "0" : rest.substr(comma + 1);
+    if (card.compare(0, 5, "CARD=") == 0) {
+        card = card.substr(5);
+    }
+    if (dev.compare(0, 4, "DEV=") == 0) {
+        dev = dev.substr(4);
+    }
+    char* end = nullptr;
+    long number = std::strtol(dev.c_str(), &end, 10);
+    if (card.empty() || dev.empty() || *end != '\0' || number < 0) {
+        return false;
+    }
+    device = static_cast<int>(number);
+    return true;
+}
+
+// The entry for name in the given direction, or nullptr if there is none.
+// Hardware PCMs are found by card number or id, whatever the prefix.
+inline const AudioDeviceInfo* find_audio_device(const std::vector<AudioDeviceInfo>& devices, const std::string& name, bool capture) {
+    std::string card;
+    int device = 0;
+    if (!parse_hw_device_name(name, card, device)) {
+        for (const auto& info : devices) {
+            if (info.name == name && info.capture == capture) {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+    
+    char* end = nullptr;
+    long card_number = std::strtol(card.c_str(), &end, 10);
+    const bool by_number = *end == '\0';
+    for (const auto& info : devices) {
+        if (info.card < 0 || info.capture != capture || info.device != device) {
+            continue;
+        }
+        if (by_number ? info.card == card_number : info.card_id == card) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+// "1-2 channels, 44100-48000 Hz", or "" if the device was not probed
+inline std::string describe_audio_capabilities(const AudioDeviceInfo& info) {
+    if (!info.probed) {
+        return "";
+    }
+    auto range = [](unsigned int low, unsigned int high) {
+        return low == high ? std::to_string(low) : std::to_string(low) + "-" + std::to_string(high);
+    };
+    std::string text = range(info.min_channels, info.max_channels) + (info.max_channels == 1 ? " channel" : " channels") +
+                       ", " + range(info.min_rate, info.max_rate) + " Hz";
+    if (!info.s16) {
+        text += ", no 16-bit format";
+    }
+    return text;
+}
+
+// Why the capture or playback device in name may not work, or "" if the
+// probe has nothing against it. Only hardware PCMs can be checked; hw:
+// devices are opened without conversion, so they must take 16-bit mono
+// (for capture) as they are.
+inline std::string audio_device_warning(const std::vector<AudioDeviceInfo>& devices, const std::string& name, bool capture) {
+    std::string card;
+    int device = 0;
+    bool plugin = false;
+    if (!parse_hw_device_name(name, card, device, &plugin)) {
+        return "";
+    }
+    
+    const AudioDeviceInfo* info = find_audio_device(devices, name, capture);
+    if (!info) {
+        return "No " + std::string(capture ? "capture" : "playback") + " device " + name + " (see --list-devices)";
+    }
+    if (plugin || !info->probed) {
+        return "";
+    }
+    if (!info->s16) {
+        return name + " does not take 16-bit samples; try plughw:" + name.substr(name.find(':') + 1);
+    }
+    if (capture && info->min_channels > 1) {
+        return name + " cannot capture mono; try plughw:" + name.substr(name.find(':') + 1);
+    }
+    return "";
+}
+
+// Print the devices in one direction, one per line, as --list-devices shows them
+inline void print_audio_devices(const std::vector<AudioDeviceInfo>& devices, bool capture, std::ostream& out = std::cout) {
+    bool any = false;
+    for (const auto& info : devices) {
+        if (info.capture != capture) {
+            continue;
+        }
+        out << "  " << info.name;
+        if (!info.description.empty()) {
+            out << "  " << info.description;
+        }
+        std::string capabilities = describe_audio_capabilities(info);
+        if (!capabilities.empty()) {
+            out << " (" << capabilities << ")";
+        }
+        out << std::endl;
+        any = true;
+    }
+    if (!any) {
+        out << "  (none found)" << std::endl;
+    }
+}
+
+// Every ALSA PCM worth offering: the hardware devices of each card, opened
+// to read what they support, and plugins such as "default" or "pulse".
+// Falls back to /proc/asound if the ALSA enumeration finds no card.
+std::vector<AudioDeviceInfo> enumerate_alsa_devices();
+
+// enumerate_alsa_devices(), run once and kept, so listing, diagnostics and
+// the startup checks share one probe
+const std::vector<AudioDeviceInfo>& probe_audio_devices();
+
+// Version of the ALSA library the program runs with, e.g. "1.2.8"
+std::string alsa_library_version();
+
+#endif // AUDIO_DEVICES_H
@@ -10,6 +10,7 @@
 #include <atomic>
 #include <csignal>
 #include "config.h"
+#include "audio_devices.h"
 
 // Reference to the global running flag from main.cpp
 extern volatile sig_atomic_t g_running;
@@ -20,15 +21,10 @@ private:
     bool continuous_mode;
     bool debug_enabled = false;
     
-    // List available audio devices
+    // List the capture devices of the sound cards, as /proc/asound has them
     void list_devices() {
         std::cout << "Available audio input devices:" << std::endl;
-        
-        // Try ALSA devices
-        std::system("arecord -l 2>/dev/null");
-        
-        // Try PulseAudio devices
-        std::system("pactl list sources 2>/dev/null | grep -E 'Name:|Description:' | grep -v monitor");
+        print_audio_devices(list_proc_audio_devices(), true);
     }
     
 public:
@@ -0,0 +1,335 @@
+#ifndef AUDIO_KERNELS_H
+#define AUDIO_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+// Vectorised inner loops for the per-buffer audio work (PCM conversion, gain
+// and the statistics used by the VAD). The implementation is picked at compile
+// time from the target instruction set: AVX2, SSE2 (always available on
+// x86-64), NEON on AArch64, or a portable scalar fallback. Build with
+// -DENABLE_NATIVE_ARCH=ON to let the compiler use everything the build machine
+// supports.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define AUDIO_KERNELS_AVX2 1
+#define AUDIO_KERNELS_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AUDIO_KERNELS_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_KERNELS_NEON 1
+#endif
+
+namespace audio_kernels {
+
+// Name of the instruction set the kernels were compiled for
+inline const char* backend_name() {
+#if defined(AUDIO_KERNELS_AVX2)
+    return "avx2";
+#elif defined(AUDIO_KERNELS_SSE2)
+    return "sse2";
+#elif defined(AUDIO_KERNELS_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+#if defined(AUDIO_KERNELS_SSE2)
+inline float horizontal_sum(__m128 v) {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+
+inline float horizontal_max(__m128 v) {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 maxes = _mm_max_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, maxes);
+    return _mm_cvtss_f32(_mm_max_ss(maxes, shuffled));
+}
+
+inline size_t horizontal_count(__m128i v) {
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<size_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+inline __m128 abs_ps(__m128 v) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+#endif
+
+#if defined(AUDIO_KERNELS_AVX2)
+inline __m128 fold(__m256 v) {
+    return _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+}
+
+inline __m128 fold_max(__m256 v) {
+    return _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+}
+
+inline __m128i fold_count(__m256i v) {
+    return _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+#endif
+
+// Convert 16-bit PCM to float normalised to [-1, 1)
+inline void convert_s16_to_f32(const int16_t* in, float* out, size_t count) {
+    const float scale = 1.0f / 32768.0f;
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 vscale = _mm256_set1_ps(scale);
+    for (; i + 8 <= count; i += 8) {
+        __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m256 samples = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(pcm));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(samples, vscale));
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 8 <= count; i += 8) {
+        __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // Sign-extend by placing each sample in the top half and shifting down
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), vscale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), vscale));
+    }
+#elif defined(AUDIO_KERNELS_NEON)
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t pcm = vld1q_s16(in + i);
+        float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(pcm)));
+        float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(pcm)));
+        vst1q_f32(out + i, vmulq_f32(low, vscale));
+        vst1q_f32(out + i + 4, vmulq_f32(high, vscale));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = static_cast<float>(in[i]) * scale;
+    }
+}
+
+// out[i] = in[i] * gain; in and out may be the same buffer
+inline void scale(const float* in, float* out, size_t count, float gain) {
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 vgain = _mm256_set1_ps(gain);
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), vgain));
+    }
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 vgain = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), vgain));
+    }
+#elif defined(AUDIO_KERNELS_NEON)
+    const float32x4_t vgain = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(in + i), vgain));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = in[i] * gain;
+    }
+}
+
+// Sum of x^2 over the buffer
+inline float sum_of_squares(const float* in, size_t count) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(in + i);
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(x, x));
+    }
+    sum = horizontal_sum(fold(acc));
+#elif defined(AUDIO_KERNELS_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(x, x));
+    }
+    sum = horizontal_sum(acc);
+#elif defined(AUDIO_KERNELS_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(in + i);
+        acc = vmlaq_f32(acc, x, x);
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < count; i++) {
+        sum += in[i] * in[i];
+    }
+    return sum;
+}
+
+// Sum of a[i] * b[i], the inner loop of FIR filtering
+inline float dot(const float* a, const float* b, size_t count) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    sum = horizontal_sum(fold(acc));
+#elif defined(AUDIO_KERNELS_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    sum = horizontal_sum(acc);
+#elif defined(AUDIO_KERNELS_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Sum of |x| over the buffer
+inline float abs_sum(const float* in, size_t count) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_ps(acc, abs_ps(_mm_loadu_ps(in + i)));
+    }
+    sum = horizontal_sum(acc);
+#elif defined(AUDIO_KERNELS_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        acc = vaddq_f32(acc, vabsq_f32(vld1q_f32(in + i)));
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < count; i++) {
+        sum += std::fabs(in[i]);
+    }
+    return sum;
+}
+
+// Largest |x| in the buffer, 0 if it is empty
+inline float abs_max(const float* in, size_t count) {
+    float peak = 0.0f;
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        acc = _mm256_max_ps(acc, _mm256_andnot_ps(sign, _mm256_loadu_ps(in + i)));
+    }
+    peak = horizontal_max(fold_max(acc));
+#elif defined(AUDIO_KERNELS_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_max_ps(acc, abs_ps(_mm_loadu_ps(in + i)));
+    }
+    peak = horizontal_max(acc);
+#elif defined(AUDIO_KERNELS_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        acc = vmaxq_f32(acc, vabsq_f32(vld1q_f32(in + i)));
+    }
+    peak = vmaxvq_f32(acc);
+#endif
+    for (; i < count; i++) {
+        float abs_sample = std::fabs(in[i]);
+        if (abs_sample > peak) peak = abs_sample;
+    }
+    return peak;
+}
+
+// Number of sign changes between consecutive samples, treating 0 as positive
+// (the same rule as is_zero_crossing in vad.h)
+inline size_t count_zero_crossings(const float* in, size_t count) {
+    size_t crossings = 0;
+    size_t i = 1;
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 zero = _mm256_setzero_ps();
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        __m256 previous = _mm256_cmp_ps(_mm256_loadu_ps(in + i - 1), zero, _CMP_LT_OQ);
+        __m256 current = _mm256_cmp_ps(_mm256_loadu_ps(in + i), zero, _CMP_LT_OQ);
+        // Each differing lane is all ones, i.e. -1, so subtracting counts it
+        acc = _mm256_sub_epi32(acc, _mm256_castps_si256(_mm256_xor_ps(previous, current)));
+    }
+    crossings = horizontal_count(fold_count(acc));
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128 previous = _mm_cmplt_ps(_mm_loadu_ps(in + i - 1), zero);
+        __m128 current = _mm_cmplt_ps(_mm_loadu_ps(in + i), zero);
+        acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_xor_ps(previous, current)));
+    }
+    crossings = horizontal_count(acc);
+#elif defined(AUDIO_KERNELS_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t previous = vcltq_f32(vld1q_f32(in + i - 1), zero);
+        uint32x4_t current = vcltq_f32(vld1q_f32(in + i), zero);
+        acc = vsubq_u32(acc, veorq_u32(previous, current));
+    }
+    crossings = vaddvq_u32(acc);
+#endif
+    for (; i < count; i++) {
+        if ((in[i - 1] < 0) != (in[i] < 0)) crossings++;
+    }
+    return crossings;
+}
+
+// Number of samples whose energy x^2 exceeds threshold
+inline size_t count_energy_above(const float* in, size_t count, float threshold) {
+    size_t active = 0;
+    size_t i = 0;
+#if defined(AUDIO_KERNELS_AVX2)
+    const __m256 vthreshold = _mm256_set1_ps(threshold);
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(in + i);
+        __m256 above = _mm256_cmp_ps(_mm256_mul_ps(x, x), vthreshold, _CMP_GT_OQ);
+        acc = _mm256_sub_epi32(acc, _mm256_castps_si256(above));
+    }
+    active = horizontal_count(fold_count(acc));
+#elif defined(AUDIO_KERNELS_SSE2)
+    const __m128 vthreshold = _mm_set1_ps(threshold);
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        __m128 above = _mm_cmpgt_ps(_mm_mul_ps(x, x), vthreshold);
+        acc = _mm_sub_epi32(acc, _mm_castps_si128(above));
+    }
+    active = horizontal_count(acc);
+#elif defined(AUDIO_KERNELS_NEON)
+    const float32x4_t vthreshold = vdupq_n_f32(threshold);
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(in + i);
+        acc = vsubq_u32(acc, vcgtq_f32(vmulq_f32(x, x), vthreshold));
+    }
+    active = vaddvq_u32(acc);
+#endif
+    for (; i < count; i++) {
+        if (in[i] * in[i] > threshold) active++;
+    }
+    return active;
+}
+
+} // namespace audio_kernels
+
+#endif // AUDIO_KERNELS_H
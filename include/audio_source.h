@@ -0,0 +1,439 @@
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "config.h"
+#include "wav_file.h"
+
+// Where the capture thread gets its audio from. Sources deliver 16-bit mono
+// PCM; StreamingAudioInput resamples it to the configured rate and runs the
+// VAD and segmentation on it, whatever the source.
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+    
+    // Get ready to deliver audio, asking for sample_rate. Called every time
+    // capture starts. Sources that are not devices carry on where they were
+    // when capture last stopped.
+    virtual bool open(int sample_rate) = 0;
+    
+    // Release the device; called every time capture stops
+    virtual void close() = 0;
+    
+    // Rate of the audio read() returns, valid after open()
+    virtual int sample_rate() const = 0;
+    
+    // Read up to frames samples. Returns the number read, 0 if none arrived
+    // within about 100 ms, or a negative value once the stream has ended or
+    // failed (after printing why).
+    virtual long read(int16_t* buffer, size_t frames) = 0;
+    
+    // Description for log messages
+    virtual std::string name() const = 0;
+    
+    // How many times audio was lost because it was not read in time. Safe
+    // to call from any thread.
+    virtual uint64_t overrun_count() const { return 0; }
+};
+
+// What audio.device (or --input-device) asks for
+struct AudioSourceSpec {
+    enum class Kind {
+        Alsa,  // An ALSA capture device, e.g. "default" or "hw:1,0"
+        File,  // "file:PATH", or a path ending in .wav, .raw or .pcm
+        Stdin, // "-" or "stdin": raw PCM piped in
+        Tcp,   // "tcp://[HOST]:PORT": listen for a client streaming raw PCM
+        Udp    // "udp://[HOST]:PORT": raw PCM datagrams
+    };
+    Kind kind = Kind::Alsa;
+    std::string path; // Device name or file path
+    std::string host; // Address to listen on, empty for all
+    int port = 0;
+};
+
+// Work out which source a device string asks for. Returns false and prints
+// an error if it is malformed.
+inline bool parse_audio_source(const std::string& device, AudioSourceSpec& spec) {
+    spec = AudioSourceSpec();
+    auto ends_with = [&device](const char* suffix) {
+        size_t length = std::strlen(suffix);
+        return device.size() > length && device.compare(device.size() - length, length, suffix) == 0;
+    };
+    
+    if (device == "-" || device == "stdin") {
+        spec.kind = AudioSourceSpec::Kind::Stdin;
+    } else if (device.compare(0, 5, "file:") == 0) {
+        spec.kind = AudioSourceSpec::Kind::File;
+        spec.path = device.substr(5);
+    } else if (ends_with(".wav") || ends_with(".raw") || ends_with(".pcm")) {
+        spec.kind = AudioSourceSpec::Kind::File;
+        spec.path = device;
+    } else if (device.compare(0, 6, "tcp://") == 0 || device.compare(0, 6, "udp://") == 0) {
+        spec.kind = device[0] == 't' ? AudioSourceSpec::Kind::Tcp : AudioSourceSpec::Kind::Udp;
+        const std::string address = device.substr(6);
+        const size_t colon = address.rfind(':');
+        char* end = nullptr;
+        long port = colon == std::string::npos ? 0 : std::strtol(address.c_str() + colon + 1, &end, 10);
+        if (port <= 0 || port > 65535 || *end != '\0') {
+            std::cerr << "Error: " << device << " needs a port, e.g. " << device.substr(0, 6) << ":5000" << std::endl;
+            return false;
+        }
+        spec.host = address.substr(0, colon);
+        spec.port = static_cast<int>(port);
+    } else {
+        spec.kind = AudioSourceSpec::Kind::Alsa;
+        spec.path = device;
+    }
+    
+    if (spec.kind == AudioSourceSpec::Kind::File && spec.path.empty()) {
+        std::cerr << "Error: " << device << " does not name a file" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Plays back a recording held in memory: a WAV file at its own rate, raw
+// little-endian 16-bit PCM at the requested rate, or samples handed over
+// directly. With realtime set, read() keeps pace with the clock like a
+// microphone would; otherwise it returns audio as fast as it is asked for.
+class PcmFileSource : public AudioSource {
+private:
+    std::string path;
+    bool realtime;
+    bool loaded = false;
+    std::vector<int16_t> samples;
+    int rate = 0;
+    size_t position = 0;
+    
+    // Pacing: when the sample at paced_from was due
+    std::chrono::steady_clock::time_point paced_start;
+    size_t paced_from = 0;
+    
+    bool load(int requested_rate) {
+        bool is_wav = path.size() > 4 && path.compare(path.size() - 4, 4, ".wav") == 0;
+        if (is_wav) {
+            std::vector<float> audio;
+            if (!wav_file::read(path, audio, rate)) {
+                return false;
+            }
+            samples.resize(audio.size());
+            for (size_t i = 0; i < audio.size(); i++) {
+                float clipped = std::max(-1.0f, std::min(1.0f, audio[i]));
+                samples[i] = static_cast<int16_t>(clipped * 32767.0f);
+            }
+            return true;
+        }
+        
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open audio file " << path << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        samples.resize(data.size() / 2);
+        for (size_t i = 0; i < samples.size(); i++) {
+            samples[i] = static_cast<int16_t>(wav_file::read_le16(data.data() + 2 * i));
+        }
+        rate = requested_rate;
+        return true;
+    }
+
+public:
+    explicit PcmFileSource(const std::string& file_path, bool paced = true)
+        : path(file_path), realtime(paced) {}
+    
+    PcmFileSource(std::vector<int16_t> pcm, int sample_rate, bool paced = false)
+        : path("memory"), realtime(paced), loaded(true), samples(std::move(pcm)), rate(sample_rate) {}
+    
+    bool open(int sample_rate) override {
+        if (!loaded) {
+            if (!load(sample_rate)) {
+                return false;
+            }
+            loaded = true;
+        }
+        paced_start = std::chrono::steady_clock::now();
+        paced_from = position;
+        return true;
+    }
+    
+    void close() override {}
+    
+    int sample_rate() const override { return rate; }
+    
+    long read(int16_t* buffer, size_t frames) override {
+        if (position >= samples.size()) {
+            return -1;
+        }
+        const size_t count = std::min(frames, samples.size() - position);
+        if (realtime) {
+            // Release the chunk once its last sample would have been recorded
+            auto due = paced_start + std::chrono::microseconds(
+                static_cast<int64_t>((position + count - paced_from) * 1000000ULL / rate));
+            std::this_thread::sleep_until(due);
+        }
+        std::memcpy(buffer, samples.data() + position, count * sizeof(int16_t));
+        position += count;
+        return static_cast<long>(count);
+    }
+    
+    std::string name() const override { return path; }
+};
+
+// Reads raw little-endian 16-bit PCM from a file descriptor, e.g. a pipe,
+// at the requested rate, waiting at most 100 ms per read
+class FdPcmSource : public AudioSource {
+protected:
+    int fd = -1;
+    int rate = 0;
+    unsigned char carry[1];     // Odd byte left over from the last read
+    bool has_carry = false;
+    
+    // Wait up to timeout_ms for fd to become readable
+    static bool wait_readable(int descriptor, int timeout_ms) {
+        pollfd entry{descriptor, POLLIN, 0};
+        return poll(&entry, 1, timeout_ms) > 0;
+    }
+    
+    // Read whatever is available into buffer as samples. Returns the number
+    // read, 0 if none arrived in time, -1 once fd is at its end.
+    long read_fd(int descriptor, int16_t* buffer, size_t frames) {
+        if (frames == 0 || !wait_readable(descriptor, 100)) {
+            return 0;
+        }
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(buffer);
+        size_t offset = 0;
+        if (has_carry) {
+            bytes[0] = carry[0];
+            offset = 1;
+        }
+        ssize_t n = ::read(descriptor, bytes + offset, frames * 2 - offset);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            return 0;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        
+        // Keep an odd trailing byte for the next read
+        size_t total = offset + static_cast<size_t>(n);
+        has_carry = (total & 1) != 0;
+        if (has_carry) {
+            carry[0] = bytes[total - 1];
+        }
+        const size_t count = total / 2;
+        for (size_t i = 0; i < count; i++) {
+            buffer[i] = static_cast<int16_t>(wav_file::read_le16(bytes + 2 * i));
+        }
+        return static_cast<long>(count);
+    }
+
+public:
+    explicit FdPcmSource(int descriptor = -1) : fd(descriptor) {}
+    
+    bool open(int sample_rate) override {
+        rate = sample_rate;
+        return fd >= 0;
+    }
+    
+    void close() override {}
+    
+    int sample_rate() const override { return rate; }
+    
+    long read(int16_t* buffer, size_t frames) override {
+        long count = read_fd(fd, buffer, frames);
+        if (count < 0) {
+            std::cout << "Info: End of audio input on " << name() << std::endl;
+        }
+        return count;
+    }
+    
+    std::string name() const override { return fd == STDIN_FILENO ? "stdin" : "fd " + std::to_string(fd); }
+};
+
+// Binds a socket for the network sources. Returns -1 after printing an error.
+inline int bind_audio_socket(int type, const std::string& host, int port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = type;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    const std::string service = std::to_string(port);
+    int err = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &addresses);
+    if (err != 0) {
+        std::cerr << "Error: Cannot resolve " << host << ": " << gai_strerror(err) << std::endl;
+        return -1;
+    }
+    
+    int sock = -1;
+    for (addrinfo* address = addresses; address && sock < 0; address = address->ai_next) {
+        sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(sock, address->ai_addr, address->ai_addrlen) != 0 ||
+            (type == SOCK_STREAM && listen(sock, 1) != 0)) {
+            ::close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    
+    if (sock < 0) {
+        std::cerr << "Error: Cannot listen on port " << port << ": " << std::strerror(errno) << std::endl;
+    }
+    return sock;
+}
+
+// Listens on a TCP port for a client that streams raw PCM, e.g. a thin
+// device sending its microphone to a shared inference host. One client is
+// served at a time; when it disconnects the next one is accepted.
+class TcpPcmSource : public FdPcmSource {
+private:
+    std::string host;
+    int port;
+    int listener = -1;
+    
+    void drop_client() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        has_carry = false;
+    }
+
+public:
+    TcpPcmSource(const std::string& listen_host, int listen_port) : host(listen_host), port(listen_port) {}
+    
+    ~TcpPcmSource() override {
+        drop_client();
+        if (listener >= 0) {
+            ::close(listener);
+        }
+    }
+    
+    // The port stays open between captures, so clients can stay connected
+    bool open(int sample_rate) override {
+        rate = sample_rate;
+        if (listener < 0) {
+            listener = bind_audio_socket(SOCK_STREAM, host, port);
+            if (listener >= 0) {
+                std::cout << "Info: Waiting for PCM audio on tcp port " << port << std::endl;
+            }
+        }
+        return listener >= 0;
+    }
+    
+    long read(int16_t* buffer, size_t frames) override {
+        if (fd < 0) {
+            if (!wait_readable(listener, 100)) {
+                return 0;
+            }
+            fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                return 0;
+            }
+            std::cout << "Info: Audio client connected on tcp port " << port << std::endl;
+        }
+        
+        long count = read_fd(fd, buffer, frames);
+        if (count < 0) {
+            std::cout << "Info: Audio client on tcp port " << port << " disconnected" << std::endl;
+            drop_client();
+            return 0;
+        }
+        return count;
+    }
+    
+    std::string name() const override { return "tcp port " + std::to_string(port); }
+};
+
+// Receives raw PCM datagrams on a UDP port. Lost datagrams are simply gaps
+// in the audio, which suits clients on a local network.
+class UdpPcmSource : public AudioSource {
+private:
+    std::string host;
+    int port;
+    int sock = -1;
+    int rate = 0;
+    
+    // A datagram can be longer than the caller's buffer; the rest waits here
+    std::vector<unsigned char> datagram;
+    size_t datagram_pos = 0;
+    size_t datagram_len = 0;
+
+public:
+    UdpPcmSource(const std::string& listen_host, int listen_port)
+        : host(listen_host), port(listen_port), datagram(65536) {}
+    
+    ~UdpPcmSource() override {
+        if (sock >= 0) {
+            ::close(sock);
+        }
+    }
+    
+    bool open(int sample_rate) override {
+        rate = sample_rate;
+        if (sock < 0) {
+            sock = bind_audio_socket(SOCK_DGRAM, host, port);
+            if (sock >= 0) {
+                std::cout << "Info: Waiting for PCM audio on udp port " << port << std::endl;
+            }
+        }
+        return sock >= 0;
+    }
+    
+    void close() override {}
+    
+    int sample_rate() const override { return rate; }
+    
+    long read(int16_t* buffer, size_t frames) override {
+        if (datagram_pos >= datagram_len) {
+            pollfd entry{sock, POLLIN, 0};
+            if (poll(&entry, 1, 100) <= 0) {
+                return 0;
+            }
+            ssize_t n = recv(sock, datagram.data(), datagram.size(), 0);
+            if (n <= 0) {
+                return 0;
+            }
+            datagram_pos = 0;
+            datagram_len = static_cast<size_t>(n) & ~static_cast<size_t>(1);
+        }
+        
+        const size_t count = std::min(frames, (datagram_len - datagram_pos) / 2);
+        for (size_t i = 0; i < count; i++) {
+            buffer[i] = static_cast<int16_t>(wav_file::read_le16(datagram.data() + datagram_pos + 2 * i));
+        }
+        datagram_pos += count * 2;
+        return static_cast<long>(count);
+    }
+    
+    std::string name() const override { return "udp port " + std::to_string(port); }
+};
+
+// Capture from an ALSA device, opened on every open() and closed again on close()
+std::unique_ptr<AudioSource> create_alsa_audio_source(const std::string& device);
+
+// The source audio.device names; see AudioSourceSpec. Returns nullptr if
+// the device string is malformed.
+std::unique_ptr<AudioSource> create_audio_source(const AudioConfig& config);
+
+#endif // AUDIO_SOURCE_H
@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <nlohmann/json.hpp>
 
@@ -17,6 +18,20 @@ struct WhisperConfig {
     std::string model = "base.en";
     std::string executable = "./whisper.cpp/main";
     std::string params = "-l en";
+    bool incremental = false;     // Transcribe while the user is still speaking
+    int partial_step_ms = 500;    // How often to decode the utterance so far
+    int partial_length_ms = 3000; // Longest uncommitted window before text is committed anyway
+    int partial_keep_ms = 500;    // Newest audio whose text always stays tentative
+    int tail_padding_ms = 300;    // Silence appended after an utterance so whisper sees it end
+    int pool_size = 1;            // Decoding states sharing one copy of the model
+    int threads = 0;              // Thread budget for all states together, 0 to pick from the hardware
+    int reserved_cores = -1;      // Cores left for capture and TTS when picking threads, -1 for automatic
+    bool use_gpu = true;          // Use a GPU backend if whisper was built with one
+    bool flash_attn = false;      // Flash attention (GPU only)
+    int gpu_device = 0;
+    bool calibrate = false;       // Time a few thread counts at startup and keep the fastest
+    bool mmap = true;             // Read the model through a memory mapping of the file
+    bool share_weights = false;   // Let the kernel merge identical weight pages across processes (KSM)
 };
 
 // Ollama configuration
@@ -24,6 +39,12 @@ struct OllamaConfig {
     std::string model = "llama3";
     std::string system_prompt = "You are a helpful voice assistant. Provide concise responses.";
     std::string host = "http://localhost:11434";
+    bool stream = false; // Stream replies and speak them sentence by sentence
+    std::string keep_alive = ""; // How long the server keeps the model loaded, e.g. "30m" or "-1"
+    std::string api = "generate"; // "generate", or "chat" to send history as messages
+    int history_turns = 16;       // Turns of the conversation kept for context
+    int history_tokens = 1024;    // Rough token budget for those turns
+    bool history_summary = false; // Summarize turns that drop out instead of forgetting them
 };
 
 // TTS configuration
@@ -32,6 +53,13 @@ struct TTSConfig {
     std::string voice = "en";
     int speed = 150;
     std::string output_device = "default";
+    bool native = true; // Synthesize espeak voices in-process via libespeak-ng when available
+    std::vector<std::string> cached_phrases = {  // Synthesized at startup so they play instantly
+        "Goodbye. Exiting voice assistant.",
+        "Sorry, I'm having trouble connecting to my thinking module.",
+        "Sorry, I encountered an error while processing your request."
+    };
+    std::string phrase_cache_file = "phrase_cache.bin"; // Relative to the config file, "" to keep in memory only
 };
 
 // Personality configuration
@@ -207,6 +235,67 @@ struct StreamingConfig {
     int min_speech_ms = 300;
     int max_silence_ms = 1000;
     int padding_ms = 500;
+    int buffer_history_ms = 5000;
+    int max_speech_ms = 30000;
+    int vad_window_ms = 500;
+    int vad_hop_ms = 100;
+    bool persistent_capture = false; // Keep the microphone open while the assistant replies
+    int echo_tail_ms = 300;          // Audio ignored after a reply, for room echo and device latency
+    bool barge_in = false;           // Let the user interrupt a reply by talking over it
+    float barge_in_threshold = 0.01f; // Speech energy needed to interrupt, above the assistant's echo
+    int barge_in_min_ms = 200;       // How long the user must talk before the reply stops
+    std::string vad_model = "";      // whisper.cpp Silero VAD model; empty for the energy VAD only
+    float vad_speech_threshold = 0.5f; // Speech probability the VAD model needs
+    bool speculative_reply = false;  // Start the reply once the partial transcript stops changing
+    int speculative_stable_ms = 400; // How long the partial transcript must stay the same
+};
+
+// Latency measurement of each conversation turn
+struct MetricsConfig {
+    bool enabled = false;             // Time each turn and print a summary on exit
+    std::string jsonl_file = "";      // Append one JSON line per turn, if set
+    std::string prometheus_file = ""; // Keep histograms here in the Prometheus text format, if set
+};
+
+// Conversation log, written when logging is enabled on the command line
+struct LoggingConfig {
+    std::string format = "text";  // "text", or "jsonl" for one JSON object per line
+    int flush_interval_ms = 1000; // How often the log is synced to disk
+    int rotate_kb = 0;            // Start a new file past this size; 0 never does
+    int rotate_hours = 0;         // Start a new file after this long; 0 never does
+    int keep_files = 5;           // Rotated files kept as log.1, log.2, ...
+};
+
+// Replies given without asking the language model
+struct ResponseCacheConfig {
+    bool enabled = false;       // Reuse the reply to a question asked again
+    int max_entries = 64;       // Replies kept, least recently used dropped first
+    int ttl_s = 3600;           // How long a reply stays valid
+    bool quick_intents = true;  // Answer time, date and system questions directly
+    bool keep_audio = true;     // Keep the speech of cached replies, with native TTS
+};
+
+// Scheduling of the threads that keep up with the sound card
+struct SchedulingConfig {
+    bool realtime = false;          // Run capture and playback with SCHED_FIFO
+    int capture_priority = 70;      // SCHED_FIFO priorities, 1-99
+    int playback_priority = 60;
+    std::string capture_cpus = "";  // Cores for the capture thread, e.g. "3"
+    std::string playback_cpus = ""; // Cores for the thread playing streamed replies
+    std::string worker_cpus = "";   // Cores for everything else; empty for those the two above leave
+};
+
+// One room or client of the serving mode
+struct SessionConfig {
+    std::string name;                      // Shown in messages and added to per-session file names
+    std::string input_device = "default";  // Anything audio.device takes, e.g. "hw:1,0" or "tcp://:5001"
+    std::string output_device = "default";
+};
+
+// Several conversations served by one process with --serve
+struct ServingConfig {
+    std::vector<SessionConfig> sessions;
+    int llm_slots = 2; // Replies generated at the same time across all sessions; 0 for no limit
 };
 
 // Main configuration
@@ -218,6 +307,11 @@ public:
     TTSConfig tts;
     SystemInfo system_info;
     StreamingConfig streaming;
+    MetricsConfig metrics;
+    ResponseCacheConfig response_cache;
+    LoggingConfig logging;
+    SchedulingConfig scheduling;
+    ServingConfig serving;
     
     // Static instances of available options
     static AvailableModels available_models;
@@ -246,6 +340,20 @@ public:
             if (j["whisper"].contains("model")) whisper.model = j["whisper"]["model"];
             if (j["whisper"].contains("executable")) whisper.executable = j["whisper"]["executable"];
             if (j["whisper"].contains("params")) whisper.params = j["whisper"]["params"];
+            if (j["whisper"].contains("incremental")) whisper.incremental = j["whisper"]["incremental"];
+            if (j["whisper"].contains("partial_step_ms")) whisper.partial_step_ms = j["whisper"]["partial_step_ms"];
+            if (j["whisper"].contains("partial_length_ms")) whisper.partial_length_ms = j["whisper"]["partial_length_ms"];
+            if (j["whisper"].contains("partial_keep_ms")) whisper.partial_keep_ms = j["whisper"]["partial_keep_ms"];
+            if (j["whisper"].contains("tail_padding_ms")) whisper.tail_padding_ms = j["whisper"]["tail_padding_ms"];
+            if (j["whisper"].contains("pool_size")) whisper.pool_size = j["whisper"]["pool_size"];
+            if (j["whisper"].contains("threads")) whisper.threads = j["whisper"]["threads"];
+            if (j["whisper"].contains("reserved_cores")) whisper.reserved_cores = j["whisper"]["reserved_cores"];
+            if (j["whisper"].contains("use_gpu")) whisper.use_gpu = j["whisper"]["use_gpu"];
+            if (j["whisper"].contains("flash_attn")) whisper.flash_attn = j["whisper"]["flash_attn"];
+            if (j["whisper"].contains("gpu_device")) whisper.gpu_device = j["whisper"]["gpu_device"];
+            if (j["whisper"].contains("calibrate")) whisper.calibrate = j["whisper"]["calibrate"];
+            if (j["whisper"].contains("mmap")) whisper.mmap = j["whisper"]["mmap"];
+            if (j["whisper"].contains("share_weights")) whisper.share_weights = j["whisper"]["share_weights"];
         }
         
         // Parse ollama config
@@ -253,6 +361,16 @@ public:
             if (j["ollama"].contains("model")) ollama.model = j["ollama"]["model"];
             if (j["ollama"].contains("system_prompt")) ollama.system_prompt = j["ollama"]["system_prompt"];
             if (j["ollama"].contains("host")) ollama.host = j["ollama"]["host"];
+            if (j["ollama"].contains("stream")) ollama.stream = j["ollama"]["stream"];
+            if (j["ollama"].contains("api")) ollama.api = j["ollama"]["api"];
+            if (j["ollama"].contains("history_turns")) ollama.history_turns = j["ollama"]["history_turns"];
+            if (j["ollama"].contains("history_tokens")) ollama.history_tokens = j["ollama"]["history_tokens"];
+            if (j["ollama"].contains("history_summary")) ollama.history_summary = j["ollama"]["history_summary"];
+            if (j["ollama"].contains("keep_alive")) {
+                // Accept both "30m" and a number of seconds
+                const auto& keep_alive = j["ollama"]["keep_alive"];
+                ollama.keep_alive = keep_alive.is_string() ? keep_alive.get<std::string>() : keep_alive.dump();
+            }
         }
         
         // Parse TTS config
@@ -261,6 +379,9 @@ public:
             if (j["tts"].contains("voice")) tts.voice = j["tts"]["voice"];
             if (j["tts"].contains("speed")) tts.speed = j["tts"]["speed"];
             if (j["tts"].contains("output_device")) tts.output_device = j["tts"]["output_device"];
+            if (j["tts"].contains("native")) tts.native = j["tts"]["native"];
+            if (j["tts"].contains("cached_phrases")) tts.cached_phrases = j["tts"]["cached_phrases"].get<std::vector<std::string>>();
+            if (j["tts"].contains("phrase_cache_file")) tts.phrase_cache_file = j["tts"]["phrase_cache_file"];
         }
         
         // Parse streaming config
@@ -271,6 +392,70 @@ public:
             if (j["streaming"].contains("min_speech_ms")) streaming.min_speech_ms = j["streaming"]["min_speech_ms"];
             if (j["streaming"].contains("max_silence_ms")) streaming.max_silence_ms = j["streaming"]["max_silence_ms"];
             if (j["streaming"].contains("padding_ms")) streaming.padding_ms = j["streaming"]["padding_ms"];
+            if (j["streaming"].contains("buffer_history_ms")) streaming.buffer_history_ms = j["streaming"]["buffer_history_ms"];
+            if (j["streaming"].contains("max_speech_ms")) streaming.max_speech_ms = j["streaming"]["max_speech_ms"];
+            if (j["streaming"].contains("vad_window_ms")) streaming.vad_window_ms = j["streaming"]["vad_window_ms"];
+            if (j["streaming"].contains("vad_hop_ms")) streaming.vad_hop_ms = j["streaming"]["vad_hop_ms"];
+            if (j["streaming"].contains("persistent_capture")) streaming.persistent_capture = j["streaming"]["persistent_capture"];
+            if (j["streaming"].contains("echo_tail_ms")) streaming.echo_tail_ms = j["streaming"]["echo_tail_ms"];
+            if (j["streaming"].contains("barge_in")) streaming.barge_in = j["streaming"]["barge_in"];
+            if (j["streaming"].contains("barge_in_threshold")) streaming.barge_in_threshold = j["streaming"]["barge_in_threshold"];
+            if (j["streaming"].contains("barge_in_min_ms")) streaming.barge_in_min_ms = j["streaming"]["barge_in_min_ms"];
+            if (j["streaming"].contains("vad_model")) streaming.vad_model = j["streaming"]["vad_model"];
+            if (j["streaming"].contains("vad_speech_threshold")) streaming.vad_speech_threshold = j["streaming"]["vad_speech_threshold"];
+            if (j["streaming"].contains("speculative_reply")) streaming.speculative_reply = j["streaming"]["speculative_reply"];
+            if (j["streaming"].contains("speculative_stable_ms")) streaming.speculative_stable_ms = j["streaming"]["speculative_stable_ms"];
+        }
+        
+        // Parse metrics config
+        if (j.contains("metrics")) {
+            if (j["metrics"].contains("enabled")) metrics.enabled = j["metrics"]["enabled"];
+            if (j["metrics"].contains("jsonl_file")) metrics.jsonl_file = j["metrics"]["jsonl_file"];
+            if (j["metrics"].contains("prometheus_file")) metrics.prometheus_file = j["metrics"]["prometheus_file"];
+        }
+        
+        // Parse response cache config
+        if (j.contains("response_cache")) {
+            if (j["response_cache"].contains("enabled")) response_cache.enabled = j["response_cache"]["enabled"];
+            if (j["response_cache"].contains("max_entries")) response_cache.max_entries = j["response_cache"]["max_entries"];
+            if (j["response_cache"].contains("ttl_s")) response_cache.ttl_s = j["response_cache"]["ttl_s"];
+            if (j["response_cache"].contains("quick_intents")) response_cache.quick_intents = j["response_cache"]["quick_intents"];
+            if (j["response_cache"].contains("keep_audio")) response_cache.keep_audio = j["response_cache"]["keep_audio"];
+        }
+        
+        // Parse logging config
+        if (j.contains("logging")) {
+            if (j["logging"].contains("format")) logging.format = j["logging"]["format"];
+            if (j["logging"].contains("flush_interval_ms")) logging.flush_interval_ms = j["logging"]["flush_interval_ms"];
+            if (j["logging"].contains("rotate_kb")) logging.rotate_kb = j["logging"]["rotate_kb"];
+            if (j["logging"].contains("rotate_hours")) logging.rotate_hours = j["logging"]["rotate_hours"];
+            if (j["logging"].contains("keep_files")) logging.keep_files = j["logging"]["keep_files"];
+        }
+        
+        // Parse scheduling config
+        if (j.contains("scheduling")) {
+            if (j["scheduling"].contains("realtime")) scheduling.realtime = j["scheduling"]["realtime"];
+            if (j["scheduling"].contains("capture_priority")) scheduling.capture_priority = j["scheduling"]["capture_priority"];
+            if (j["scheduling"].contains("playback_priority")) scheduling.playback_priority = j["scheduling"]["playback_priority"];
+            if (j["scheduling"].contains("capture_cpus")) scheduling.capture_cpus = j["scheduling"]["capture_cpus"];
+            if (j["scheduling"].contains("playback_cpus")) scheduling.playback_cpus = j["scheduling"]["playback_cpus"];
+            if (j["scheduling"].contains("worker_cpus")) scheduling.worker_cpus = j["scheduling"]["worker_cpus"];
+        }
+        
+        // Parse serving config
+        if (j.contains("serving")) {
+            if (j["serving"].contains("llm_slots")) serving.llm_slots = j["serving"]["llm_slots"];
+            if (j["serving"].contains("sessions")) {
+                serving.sessions.clear();
+                for (const auto& item : j["serving"]["sessions"]) {
+                    SessionConfig session;
+                    if (item.contains("name")) session.name = item["name"];
+                    if (item.contains("input_device")) session.input_device = item["input_device"];
+                    if (item.contains("output_device")) session.output_device = item["output_device"];
+                    if (session.name.empty()) session.name = "session" + std::to_string(serving.sessions.size() + 1);
+                    serving.sessions.push_back(session);
+                }
+            }
         }
     }
     
@@ -291,15 +476,38 @@ public:
         j["whisper"]["model"] = whisper.model;
         j["whisper"]["executable"] = whisper.executable;
         j["whisper"]["params"] = whisper.params;
+        j["whisper"]["incremental"] = whisper.incremental;
+        j["whisper"]["partial_step_ms"] = whisper.partial_step_ms;
+        j["whisper"]["partial_length_ms"] = whisper.partial_length_ms;
+        j["whisper"]["partial_keep_ms"] = whisper.partial_keep_ms;
+        j["whisper"]["tail_padding_ms"] = whisper.tail_padding_ms;
+        j["whisper"]["pool_size"] = whisper.pool_size;
+        j["whisper"]["threads"] = whisper.threads;
+        j["whisper"]["reserved_cores"] = whisper.reserved_cores;
+        j["whisper"]["use_gpu"] = whisper.use_gpu;
+        j["whisper"]["flash_attn"] = whisper.flash_attn;
+        j["whisper"]["gpu_device"] = whisper.gpu_device;
+        j["whisper"]["calibrate"] = whisper.calibrate;
+        j["whisper"]["mmap"] = whisper.mmap;
+        j["whisper"]["share_weights"] = whisper.share_weights;
         
         j["ollama"]["model"] = ollama.model;
         j["ollama"]["system_prompt"] = ollama.system_prompt;
         j["ollama"]["host"] = ollama.host;
+        j["ollama"]["stream"] = ollama.stream;
+        j["ollama"]["keep_alive"] = ollama.keep_alive;
+        j["ollama"]["api"] = ollama.api;
+        j["ollama"]["history_turns"] = ollama.history_turns;
+        j["ollama"]["history_tokens"] = ollama.history_tokens;
+        j["ollama"]["history_summary"] = ollama.history_summary;
         
         j["tts"]["engine"] = tts.engine;
         j["tts"]["voice"] = tts.voice;
         j["tts"]["speed"] = tts.speed;
         j["tts"]["output_device"] = tts.output_device;
+        j["tts"]["native"] = tts.native;
+        j["tts"]["cached_phrases"] = tts.cached_phrases;
+        j["tts"]["phrase_cache_file"] = tts.phrase_cache_file;
         
         j["streaming"]["enabled"] = streaming.enabled;
         j["streaming"]["vad_threshold"] = streaming.vad_threshold;
@@ -307,6 +515,52 @@ public:
         j["streaming"]["min_speech_ms"] = streaming.min_speech_ms;
         j["streaming"]["max_silence_ms"] = streaming.max_silence_ms;
         j["streaming"]["padding_ms"] = streaming.padding_ms;
+        j["streaming"]["buffer_history_ms"] = streaming.buffer_history_ms;
+        j["streaming"]["max_speech_ms"] = streaming.max_speech_ms;
+        j["streaming"]["vad_window_ms"] = streaming.vad_window_ms;
+        j["streaming"]["vad_hop_ms"] = streaming.vad_hop_ms;
+        j["streaming"]["persistent_capture"] = streaming.persistent_capture;
+        j["streaming"]["echo_tail_ms"] = streaming.echo_tail_ms;
+        j["streaming"]["barge_in"] = streaming.barge_in;
+        j["streaming"]["barge_in_threshold"] = streaming.barge_in_threshold;
+        j["streaming"]["barge_in_min_ms"] = streaming.barge_in_min_ms;
+        j["streaming"]["vad_model"] = streaming.vad_model;
+        j["streaming"]["vad_speech_threshold"] = streaming.vad_speech_threshold;
+        j["streaming"]["speculative_reply"] = streaming.speculative_reply;
+        j["streaming"]["speculative_stable_ms"] = streaming.speculative_stable_ms;
+        
+        j["metrics"]["enabled"] = metrics.enabled;
+        j["metrics"]["jsonl_file"] = metrics.jsonl_file;
+        j["metrics"]["prometheus_file"] = metrics.prometheus_file;
+        
+        j["response_cache"]["enabled"] = response_cache.enabled;
+        j["response_cache"]["max_entries"] = response_cache.max_entries;
+        j["response_cache"]["ttl_s"] = response_cache.ttl_s;
+        j["response_cache"]["quick_intents"] = response_cache.quick_intents;
+        j["response_cache"]["keep_audio"] = response_cache.keep_audio;
+        
+        j["logging"]["format"] = logging.format;
+        j["logging"]["flush_interval_ms"] = logging.flush_interval_ms;
+        j["logging"]["rotate_kb"] = logging.rotate_kb;
+        j["logging"]["rotate_hours"] = logging.rotate_hours;
+        j["logging"]["keep_files"] = logging.keep_files;
+        
+        j["scheduling"]["realtime"] = scheduling.realtime;
+        j["scheduling"]["capture_priority"] = scheduling.capture_priority;
+        j["scheduling"]["playback_priority"] = scheduling.playback_priority;
+        j["scheduling"]["capture_cpus"] = scheduling.capture_cpus;
+        j["scheduling"]["playback_cpus"] = scheduling.playback_cpus;
+        j["scheduling"]["worker_cpus"] = scheduling.worker_cpus;
+        
+        j["serving"]["llm_slots"] = serving.llm_slots;
+        j["serving"]["sessions"] = nlohmann::json::array();
+        for (const auto& session : serving.sessions) {
+            j["serving"]["sessions"].push_back({
+                {"name", session.name},
+                {"input_device", session.input_device},
+                {"output_device", session.output_device}
+            });
+        }
         
         // Write to file
         std::ofstream file(filename);
@@ -0,0 +1,185 @@
+#ifndef CONVERSATION_HISTORY_H
+#define CONVERSATION_HISTORY_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// The recent turns of the conversation, kept in a fixed number of slots
+// and limited to a token budget. Space is made in batches, so the oldest
+// turns in the prompt (and the server's cached prefill for them) only
+// change every few turns. Turns that are dropped can be kept aside to be
+// folded into a running summary, whenever the owner has time for that.
+class ConversationHistory {
+public:
+    struct Turn {
+        std::string user;
+        std::string assistant;
+        size_t tokens = 0;
+        uint64_t id = 0; // Given by push(), never reused
+    };
+
+private:
+    std::vector<Turn> slots; // Reused, so their strings keep their capacity
+    size_t first = 0;        // Slot of the oldest turn
+    size_t count = 0;
+    size_t tokens = 0;
+    uint64_t last_id = 0;
+    size_t token_budget;
+    std::string summary;
+    bool keep_dropped = false;
+    std::string dropped;     // Turns dropped since take_dropped(), formatted as in the prompt
+    
+    Turn& slot(size_t index) {
+        return slots[(first + index) % slots.size()];
+    }
+    
+    const Turn& slot(size_t index) const {
+        return slots[(first + index) % slots.size()];
+    }
+    
+    // Drop the oldest turns until at most keep_turns are left and they fit
+    // in keep_tokens, keeping them aside for the summary if asked to
+    void trim(size_t keep_turns, size_t keep_tokens) {
+        while (count > 0 && (count > keep_turns || tokens > keep_tokens)) {
+            Turn& oldest = slots[first];
+            if (keep_dropped) {
+                append_turn(dropped, oldest);
+            }
+            tokens -= oldest.tokens;
+            first = (first + 1) % slots.size();
+            count--;
+        }
+    }
+
+public:
+    explicit ConversationHistory(size_t max_turns = 16, size_t max_tokens = 1024)
+        : slots(max_turns > 0 ? max_turns : 1), token_budget(max_tokens) {}
+    
+    // Rough token count, about four characters per token for English text.
+    // Good enough to bound the prompt without the model's tokenizer.
+    static size_t estimate_tokens(const std::string& text) {
+        return (text.size() + 3) / 4;
+    }
+    
+    static void append_turn(std::string& out, const Turn& turn) {
+        out += "User: ";
+        out += turn.user;
+        out += "\nAssistant: ";
+        out += turn.assistant;
+        out += "\n\n";
+    }
+    
+    // Keep the turns that are dropped, for take_dropped()
+    void set_keep_dropped(bool keep) {
+        keep_dropped = keep;
+    }
+    
+    // The turns dropped since the last call, to be summarized, or ""
+    std::string take_dropped() {
+        std::string turns;
+        turns.swap(dropped);
+        return turns;
+    }
+    
+    bool has_dropped() const { return !dropped.empty(); }
+    
+    // Replace the summary of the turns dropped so far
+    void set_summary(const std::string& text) {
+        summary = text;
+    }
+    
+    // Add the newest turn, dropping old ones first if there is no room. A
+    // turn over the whole budget is still kept, on its own. Returns the id
+    // of the turn, for forget().
+    uint64_t push(const std::string& user, const std::string& assistant) {
+        const size_t turn_tokens = estimate_tokens(user) + estimate_tokens(assistant);
+        
+        // Free a quarter of the slots or the budget at a time
+        if (count == slots.size()) {
+            trim(slots.size() - std::max<size_t>(1, slots.size() / 4), static_cast<size_t>(-1));
+        }
+        if (token_budget > 0 && tokens + turn_tokens > token_budget) {
+            const size_t target = token_budget * 3 / 4;
+            trim(count, target > turn_tokens ? target - turn_tokens : 0);
+        }
+        
+        Turn& turn = slot(count);
+        turn.user.assign(user);
+        turn.assistant.assign(assistant);
+        turn.tokens = turn_tokens;
+        turn.id = ++last_id;
+        count++;
+        tokens += turn_tokens;
+        return turn.id;
+    }
+    
+    // Drop the newest turn. The summary is left alone.
+    void pop_back() {
+        if (count > 0) {
+            tokens -= slot(count - 1).tokens;
+            count--;
+        }
+    }
+    
+    // Drop the turn with id if it is still the newest, e.g. a reply that was
+    // generated ahead of time and not used. The size cannot tell, since the
+    // push may have dropped older turns. Returns false if it is not there.
+    bool forget(uint64_t id) {
+        if (count == 0 || id == 0 || slot(count - 1).id != id) {
+            return false;
+        }
+        pop_back();
+        return true;
+    }
+    
+    void clear() {
+        first = 0;
+        count = 0;
+        tokens = 0;
+        summary.clear();
+        dropped.clear();
+    }
+    
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t token_count() const { return tokens; }
+    size_t capacity() const { return slots.size(); }
+    const std::string& get_summary() const { return summary; }
+    
+    // Turns from the oldest (0) to the newest
+    const Turn& operator[](size_t index) const {
+        return slot(index);
+    }
+    
+    // The history as it goes into the system prompt, or "" if there is none
+    std::string format() const {
+        if (count == 0 && summary.empty()) {
+            return "";
+        }
+        
+        static const char header[] = "\n\nConversation history:\n";
+        static const char summary_label[] = "Summary of the earlier conversation: ";
+        size_t size = sizeof(header) + sizeof(summary_label) + summary.size() + 2;
+        for (size_t i = 0; i < count; i++) {
+            size += slot(i).user.size() + slot(i).assistant.size() + 22;
+        }
+        
+        std::string history;
+        history.reserve(size);
+        history += header;
+        if (!summary.empty()) {
+            history += summary_label;
+            history += summary;
+            history += "\n\n";
+        }
+        for (size_t i = 0; i < count; i++) {
+            append_turn(history, slot(i));
+        }
+        return history;
+    }
+};
+
+#endif // CONVERSATION_HISTORY_H
@@ -0,0 +1,274 @@
+#ifndef CONVERSATION_LOGGER_H
+#define CONVERSATION_LOGGER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "config.h"
+#include "latency_metrics.h"
+
+// Writes the conversation log on a background thread, so a slow disk (an SD
+// card, say) never holds up a turn. Callers only queue a record; every
+// flush_interval_ms the writer appends whatever has piled up in one write,
+// syncs the file and rotates it by size or age. Plain text lines or JSON
+// lines, which can also carry the latency of each turn.
+class ConversationLogger {
+public:
+    using Clock = std::chrono::system_clock;
+
+private:
+    struct Record {
+        Clock::time_point time;
+        std::string speaker;   // Empty for events
+        std::string text;
+        LatencyMetrics::Turn timings;
+        bool has_timings = false;
+    };
+    
+    std::string path;
+    LoggingConfig config;
+    
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Record> pending;
+    bool stopping = false;
+    std::thread writer;
+    
+    // Only used by the writer thread
+    int fd = -1;
+    size_t file_size = 0;
+    Clock::time_point opened_at;
+    std::string buffer;
+    bool unsynced = false;
+    bool reported_error = false;
+    
+    bool json_lines() const {
+        return config.format == "jsonl";
+    }
+    
+    static std::string local_time(Clock::time_point time, const char* format) {
+        std::time_t t = Clock::to_time_t(time);
+        std::tm local{};
+        localtime_r(&t, &local);
+        char text[64];
+        std::strftime(text, sizeof(text), format, &local);
+        return text;
+    }
+    
+    std::string format_record(const Record& record) const {
+        if (json_lines()) {
+            nlohmann::json line;
+            line["time"] = local_time(record.time, "%Y-%m-%dT%H:%M:%S");
+            if (record.has_timings) {
+                for (const auto& interval : LatencyMetrics::intervals()) {
+                    double ms = record.timings.elapsed_ms(interval.from, interval.to);
+                    if (ms >= 0.0) {
+                        line["latency_ms"][interval.name] = static_cast<int64_t>(ms + 0.5);
+                    }
+                }
+            } else if (record.speaker.empty()) {
+                line["event"] = record.text;
+            } else {
+                line["speaker"] = record.speaker;
+                line["text"] = record.text;
+            }
+            return line.dump() + "\n";
+        }
+        
+        if (record.has_timings) {
+            return "[" + local_time(record.time, "%H:%M:%S") + "] Latency: " + LatencyMetrics::describe(record.timings) + "\n";
+        }
+        if (record.speaker.empty()) {
+            // ctime() style, as the log has always had
+            return "=== " + record.text + " at " + local_time(record.time, "%a %b %e %H:%M:%S %Y") + "\n===\n";
+        }
+        return "[" + local_time(record.time, "%H:%M:%S") + "] " + record.speaker + ": " + record.text + "\n";
+    }
+    
+    bool open_file() {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        off_t end = lseek(fd, 0, SEEK_END);
+        file_size = end > 0 ? static_cast<size_t>(end) : 0;
+        opened_at = Clock::now();
+        return true;
+    }
+    
+    void write_buffer() {
+        size_t offset = 0;
+        while (fd >= 0 && offset < buffer.size()) {
+            ssize_t written = ::write(fd, buffer.data() + offset, buffer.size() - offset);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                if (!reported_error) {
+                    std::cerr << "Error: Failed to write log file " << path << ": " << std::strerror(errno) << std::endl;
+                    reported_error = true;
+                }
+                break;
+            }
+            offset += static_cast<size_t>(written);
+        }
+        file_size += offset;
+        unsynced = unsynced || offset > 0;
+        buffer.clear();
+    }
+    
+    void sync() {
+        if (fd >= 0 && unsynced) {
+            fdatasync(fd);
+            unsynced = false;
+        }
+    }
+    
+    // Move the current file to path.1, path.1 to path.2 and so on, keeping
+    // keep_files old files, and start a new one
+    void rotate() {
+        write_buffer();
+        sync();
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        
+        const int keep = config.keep_files > 0 ? config.keep_files : 1;
+        std::remove((path + "." + std::to_string(keep)).c_str());
+        for (int i = keep - 1; i >= 1; i--) {
+            std::rename((path + "." + std::to_string(i)).c_str(), (path + "." + std::to_string(i + 1)).c_str());
+        }
+        std::rename(path.c_str(), (path + ".1").c_str());
+        
+        if (!open_file() && !reported_error) {
+            std::cerr << "Error: Failed to open log file: " << path << std::endl;
+            reported_error = true;
+        }
+    }
+    
+    bool needs_rotation(size_t next_record) const {
+        size_t size = file_size + buffer.size();
+        if (size == 0) {
+            return false;
+        }
+        if (config.rotate_kb > 0 && size + next_record > static_cast<size_t>(config.rotate_kb) * 1024) {
+            return true;
+        }
+        return config.rotate_hours > 0 && Clock::now() - opened_at >= std::chrono::hours(config.rotate_hours);
+    }
+    
+    void run() {
+        std::vector<Record> batch;
+        const auto interval = std::chrono::milliseconds(config.flush_interval_ms > 0 ? config.flush_interval_ms : 1000);
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            // Records are collected for a whole interval, so the disk sees one
+            // write and one sync per interval at most
+            wake.wait_for(lock, interval, [this] { return stopping; });
+            batch.swap(pending);
+            const bool stop = stopping;
+            lock.unlock();
+            
+            for (const Record& record : batch) {
+                std::string line = format_record(record);
+                if (needs_rotation(line.size())) {
+                    rotate();
+                }
+                buffer += line;
+            }
+            batch.clear();
+            write_buffer();
+            sync();
+            
+            lock.lock();
+            if (stop && pending.empty()) {
+                break;
+            }
+        }
+    }
+    
+    void enqueue(Record record) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            pending.push_back(std::move(record));
+        }
+    }
+
+public:
+    ConversationLogger(const std::string& log_path, const LoggingConfig& cfg)
+        : path(log_path), config(cfg) {}
+    
+    ~ConversationLogger() {
+        close();
+    }
+    
+    ConversationLogger(const ConversationLogger&) = delete;
+    ConversationLogger& operator=(const ConversationLogger&) = delete;
+    
+    // Open the log file and start the writer. Returns false if the file
+    // cannot be opened for appending.
+    bool open() {
+        if (writer.joinable()) {
+            return true;
+        }
+        if (!open_file()) {
+            return false;
+        }
+        stopping = false;
+        writer = std::thread(&ConversationLogger::run, this);
+        return true;
+    }
+    
+    // Write everything queued, sync the file and stop the writer
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (writer.joinable()) {
+            writer.join();
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    
+    const std::string& get_path() const {
+        return path;
+    }
+    
+    // Queue a message said by speaker ("User" or "Vibe")
+    void log(const std::string& speaker, const std::string& message) {
+        enqueue({Clock::now(), speaker, message, LatencyMetrics::Turn(), false});
+    }
+    
+    // Queue an event such as "Conversation started"
+    void log_event(const std::string& event) {
+        enqueue({Clock::now(), "", event, LatencyMetrics::Turn(), false});
+    }
+    
+    // Queue the latency of a finished turn, if anything was measured
+    void log_timings(const LatencyMetrics::Turn& turn) {
+        if (LatencyMetrics::describe(turn).empty()) {
+            return;
+        }
+        enqueue({Clock::now(), "", "", turn, true});
+    }
+};
+
+#endif // CONVERSATION_LOGGER_H
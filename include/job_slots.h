@@ -0,0 +1,136 @@
+#ifndef JOB_SLOTS_H
+#define JOB_SLOTS_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+// A fixed number of slots for work that several sessions compete for, such
+// as requests to the language model. Callers waiting for a slot are served
+// in arrival order, as the states of a WhisperContextPool are, so a busy
+// session cannot starve the others and the load on the server stays bounded.
+//
+// The slots must outlive every lease taken from them.
+class JobSlots {
+public:
+    // A held slot, handed back when destroyed
+    class Lease {
+    private:
+        JobSlots* slots = nullptr;
+        
+        friend class JobSlots;
+        explicit Lease(JobSlots* owner) : slots(owner) {}
+    
+    public:
+        Lease() = default;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        
+        Lease(Lease&& other) noexcept : slots(other.slots) {
+            other.slots = nullptr;
+        }
+        
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                slots = other.slots;
+                other.slots = nullptr;
+            }
+            return *this;
+        }
+        
+        ~Lease() {
+            release();
+        }
+        
+        explicit operator bool() const { return slots != nullptr; }
+        
+        // Hand the slot back early
+        void release() {
+            if (slots) {
+                slots->give_back();
+                slots = nullptr;
+            }
+        }
+    };
+
+private:
+    // A caller waiting for a slot; give_back() hands the slot over directly
+    struct Waiter {
+        bool granted = false;
+    };
+    
+    const int total;
+    int free_slots;
+    std::deque<Waiter*> waiting;
+    uint64_t waits = 0; // Acquires that found every slot taken
+    std::mutex mutex;
+    std::condition_variable cv;
+    
+    void give_back() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (waiting.empty()) {
+            free_slots++;
+            return;
+        }
+        waiting.front()->granted = true;
+        waiting.pop_front();
+        cv.notify_all();
+    }
+
+public:
+    explicit JobSlots(int slots) : total(std::max(slots, 1)), free_slots(total) {}
+    
+    JobSlots(const JobSlots&) = delete;
+    JobSlots& operator=(const JobSlots&) = delete;
+    
+    // Wait for a free slot. Gives up with an empty lease once cancelled
+    // returns true, which is checked on entry and every few milliseconds,
+    // so a request cancelled before it got here does not take a slot.
+    Lease acquire(const std::function<bool()>& cancelled = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (cancelled && cancelled()) {
+            return Lease();
+        }
+        if (free_slots > 0 && waiting.empty()) {
+            free_slots--;
+            return Lease(this);
+        }
+        
+        Waiter waiter;
+        waiting.push_back(&waiter);
+        waits++;
+        while (!waiter.granted) {
+            if (cancelled && cancelled()) {
+                waiting.erase(std::find(waiting.begin(), waiting.end(), &waiter));
+                return Lease();
+            }
+            if (cancelled) {
+                cv.wait_for(lock, std::chrono::milliseconds(20));
+            } else {
+                cv.wait(lock);
+            }
+        }
+        return Lease(this);
+    }
+    
+    int size() const { return total; }
+    
+    int in_use() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total - free_slots;
+    }
+    
+    // How many callers have had to wait for a slot
+    uint64_t wait_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return waits;
+    }
+};
+
+#endif // JOB_SLOTS_H
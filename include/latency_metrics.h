@@ -0,0 +1,329 @@
+#ifndef LATENCY_METRICS_H
+#define LATENCY_METRICS_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdint>
+
+// Points in a conversation turn, in the order they normally happen
+enum class TurnEvent {
+    SpeechEnd,    // The capture thread decided the user stopped speaking
+    SttStart,     // Whisper was handed the utterance
+    SttEnd,       // The transcript is ready
+    LlmFirstByte, // First reply data arrived from Ollama
+    LlmLastByte,  // The whole reply has arrived
+    TtsStart,     // The first sentence was passed to the TTS engine
+    FirstAudio,   // The first synthesized audio was written to the output
+    Count
+};
+
+// Per-turn timestamps and latency histograms. Events can be marked from any
+// thread (the TTS queue and the capture thread run on their own); only the
+// first mark of each event in a turn counts. Finished turns can be appended
+// to a JSON-lines file and the histograms written in the Prometheus text
+// format, e.g. for node_exporter's textfile collector.
+class LatencyMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    // A measured span between two events
+    struct Interval {
+        const char* name;
+        TurnEvent from;
+        TurnEvent to;
+    };
+    
+    static const std::array<Interval, 6>& intervals() {
+        static const std::array<Interval, 6> list = {{
+            {"capture_to_stt", TurnEvent::SpeechEnd, TurnEvent::SttStart},
+            {"stt", TurnEvent::SttStart, TurnEvent::SttEnd},
+            {"llm_first_byte", TurnEvent::SttEnd, TurnEvent::LlmFirstByte},
+            {"llm_total", TurnEvent::SttEnd, TurnEvent::LlmLastByte},
+            {"tts_first_audio", TurnEvent::TtsStart, TurnEvent::FirstAudio},
+            {"end_to_end", TurnEvent::SpeechEnd, TurnEvent::FirstAudio},
+        }};
+        return list;
+    }
+    
+    // Histogram bucket upper bounds in milliseconds, plus an implicit +Inf
+    static const std::vector<double>& bucket_bounds_ms() {
+        static const std::vector<double> bounds = {25, 50, 100, 200, 300, 500, 750, 1000, 1500, 2000, 3000, 5000, 10000};
+        return bounds;
+    }
+    
+    struct Histogram {
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(bucket_bounds_ms().size() + 1, 0); // Not cumulative
+        uint64_t count = 0;
+        double sum_ms = 0.0;
+        
+        void add(double ms) {
+            const std::vector<double>& bounds = bucket_bounds_ms();
+            size_t i = 0;
+            while (i < bounds.size() && ms > bounds[i]) i++;
+            buckets[i]++;
+            count++;
+            sum_ms += ms;
+        }
+        
+        // Estimate the q-th quantile (0 to 1) as the upper bound of its bucket
+        double quantile_ms(double q) const {
+            if (count == 0) return 0.0;
+            const std::vector<double>& bounds = bucket_bounds_ms();
+            uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets.size(); i++) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return i < bounds.size() ? bounds[i] : bounds.back();
+                }
+            }
+            return bounds.back();
+        }
+    };
+    
+    // Timestamps of one turn
+    struct Turn {
+        std::array<Clock::time_point, static_cast<size_t>(TurnEvent::Count)> times{};
+        std::array<bool, static_cast<size_t>(TurnEvent::Count)> marked{};
+        
+        bool has(TurnEvent event) const { return marked[static_cast<size_t>(event)]; }
+        
+        // Milliseconds between two marked events, or -1 if either is missing
+        double elapsed_ms(TurnEvent from, TurnEvent to) const {
+            if (!has(from) || !has(to)) return -1.0;
+            return std::chrono::duration<double, std::milli>(times[static_cast<size_t>(to)] - times[static_cast<size_t>(from)]).count();
+        }
+    };
+
+private:
+    mutable std::mutex mutex;
+    bool enabled = false;
+    bool in_turn = false;
+    Turn current;
+    uint64_t turns = 0;
+    uint64_t rejected_turns = 0; // Utterances whose transcript was empty or a silence marker
+    std::array<Histogram, 6> histograms;
+    std::vector<std::pair<std::string, std::function<uint64_t()>>> counters;
+    std::string jsonl_path;
+    std::string prometheus_path;
+    uint64_t exports = 0;
+    
+    // Files are written outside mutex, so marks from the TTS and capture
+    // threads never wait on the disk. export_mutex keeps the writes in order.
+    std::mutex export_mutex;
+    uint64_t last_prometheus_export = 0;
+    
+    std::string jsonl_line_locked(const Turn& turn, bool rejected) const {
+        std::ostringstream out;
+        auto wall = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        out << std::fixed << std::setprecision(3) << "{\"time\":" << wall << ",\"turn\":" << turns
+            << ",\"rejected\":" << (rejected ? "true" : "false");
+        for (const Interval& interval : intervals()) {
+            double ms = turn.elapsed_ms(interval.from, interval.to);
+            if (ms >= 0.0) {
+                out << ",\"" << interval.name << "_ms\":" << ms;
+            }
+        }
+        out << "}\n";
+        return out.str();
+    }
+    
+    std::string prometheus_text_locked() const {
+        std::ostringstream out;
+        const std::vector<double>& bounds = bucket_bounds_ms();
+        for (size_t h = 0; h < histograms.size(); h++) {
+            const Histogram& histogram = histograms[h];
+            std::string name = std::string("voice_assistant_") + intervals()[h].name + "_seconds";
+            out << "# TYPE " << name << " histogram\n";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < histogram.buckets.size(); i++) {
+                cumulative += histogram.buckets[i];
+                out << name << "_bucket{le=\"";
+                if (i < bounds.size()) {
+                    out << bounds[i] / 1000.0;
+                } else {
+                    out << "+Inf";
+                }
+                out << "\"} " << cumulative << "\n";
+            }
+            out << name << "_sum " << histogram.sum_ms / 1000.0 << "\n";
+            out << name << "_count " << histogram.count << "\n";
+        }
+        out << "# TYPE voice_assistant_turns_total counter\n";
+        out << "voice_assistant_turns_total " << turns << "\n";
+        out << "# TYPE voice_assistant_rejected_utterances_total counter\n";
+        out << "voice_assistant_rejected_utterances_total " << rejected_turns << "\n";
+        for (const auto& counter : counters) {
+            std::string name = "voice_assistant_" + counter.first + "_total";
+            out << "# TYPE " << name << " counter\n";
+            out << name << " " << counter.second() << "\n";
+        }
+        return out.str();
+    }
+    
+    static void append_file(const std::string& path, const std::string& text) {
+        std::ofstream file(path, std::ios::app);
+        if (file.is_open()) {
+            file << text;
+        }
+    }
+    
+    // Replace the file in one step so a scraper never reads half of it
+    static void replace_file(const std::string& path, const std::string& text) {
+        std::string temp_path = path + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::trunc);
+            if (!file.is_open()) {
+                return;
+            }
+            file << text;
+        }
+        std::rename(temp_path.c_str(), path.c_str());
+    }
+
+public:
+    // Start recording. Either path may be empty to skip that export.
+    void enable(const std::string& jsonl_file = "", const std::string& prometheus_file = "") {
+        std::lock_guard<std::mutex> lock(mutex);
+        enabled = true;
+        jsonl_path = jsonl_file;
+        prometheus_path = prometheus_file;
+    }
+    
+    bool is_enabled() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return enabled;
+    }
+    
+    // Export a count kept elsewhere, e.g. capture overruns, as
+    // voice_assistant_<name>_total. read is called from whichever thread
+    // exports, so it should only load an atomic.
+    void add_counter(const std::string& name, std::function<uint64_t()> read) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.emplace_back(name, std::move(read));
+    }
+    
+    // Start a turn whose speech ended at speech_end
+    void begin_turn(Clock::time_point speech_end = Clock::now()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!enabled) return;
+        current = Turn();
+        in_turn = true;
+        current.times[static_cast<size_t>(TurnEvent::SpeechEnd)] = speech_end;
+        current.marked[static_cast<size_t>(TurnEvent::SpeechEnd)] = true;
+    }
+    
+    // Record an event of the current turn, unless it was already recorded
+    void mark(TurnEvent event) {
+        mark(event, Clock::now());
+    }
+    
+    // Record an event that happened at a given time, e.g. on a pipeline stage
+    // that ran before the turn was started
+    void mark(TurnEvent event, Clock::time_point at) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t index = static_cast<size_t>(event);
+        if (!enabled || !in_turn || current.marked[index]) return;
+        current.times[index] = at;
+        current.marked[index] = true;
+    }
+    
+    // Finish the current turn: add its intervals to the histograms and export
+    // them. rejected marks an utterance that turned out not to be speech.
+    // Returns the finished turn.
+    Turn end_turn(bool rejected = false) {
+        Turn finished;
+        std::string jsonl_file, jsonl_line, prometheus_file, prometheus;
+        uint64_t export_id;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!enabled || !in_turn) return Turn();
+            in_turn = false;
+            turns++;
+            if (rejected) rejected_turns++;
+            
+            for (size_t h = 0; h < histograms.size(); h++) {
+                double ms = current.elapsed_ms(intervals()[h].from, intervals()[h].to);
+                if (ms >= 0.0) {
+                    histograms[h].add(ms);
+                }
+            }
+            
+            finished = current;
+            export_id = ++exports;
+            jsonl_file = jsonl_path;
+            prometheus_file = prometheus_path;
+            if (!jsonl_file.empty()) jsonl_line = jsonl_line_locked(current, rejected);
+            if (!prometheus_file.empty()) prometheus = prometheus_text_locked();
+        }
+        
+        std::lock_guard<std::mutex> lock(export_mutex);
+        if (!jsonl_file.empty()) append_file(jsonl_file, jsonl_line);
+        // A turn that ended later may have written its newer totals already
+        if (!prometheus_file.empty() && export_id > last_prometheus_export) {
+            replace_file(prometheus_file, prometheus);
+            last_prometheus_export = export_id;
+        }
+        return finished;
+    }
+    
+    // Turns finished so far, not counting utterances that were rejected
+    uint64_t turn_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return turns - rejected_turns;
+    }
+    
+    // Describe a finished turn, e.g. "end_to_end 812 ms, stt 230 ms, ..."
+    static std::string describe(const Turn& turn) {
+        std::ostringstream out;
+        for (const Interval& interval : intervals()) {
+            double ms = turn.elapsed_ms(interval.from, interval.to);
+            if (ms < 0.0) continue;
+            if (out.tellp() > 0) out << ", ";
+            out << interval.name << " " << static_cast<int>(ms) << " ms";
+        }
+        return out.str();
+    }
+    
+    // All histograms and counters in the Prometheus text format
+    std::string prometheus_text() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return prometheus_text_locked();
+    }
+    
+    // One line per interval with its count and approximate median and p90
+    std::string summary() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream out;
+        out << "Latency over " << turns << " turn(s), " << rejected_turns << " rejected:\n";
+        for (size_t h = 0; h < histograms.size(); h++) {
+            const Histogram& histogram = histograms[h];
+            if (histogram.count == 0) continue;
+            out << "  " << std::left << std::setw(16) << intervals()[h].name << std::right
+                << " n=" << histogram.count
+                << " mean=" << static_cast<int>(histogram.sum_ms / histogram.count) << "ms"
+                << " p50<=" << histogram.quantile_ms(0.5) << "ms"
+                << " p90<=" << histogram.quantile_ms(0.9) << "ms\n";
+        }
+        for (const auto& counter : counters) {
+            out << "  " << std::left << std::setw(16) << counter.first << std::right << " " << counter.second() << "\n";
+        }
+        return out.str();
+    }
+    
+    // A copy of one interval's histogram, in the order of intervals()
+    Histogram histogram(size_t index) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return histograms[index];
+    }
+};
+
+#endif // LATENCY_METRICS_H
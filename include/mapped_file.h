@@ -0,0 +1,96 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// A whole file mapped read-only and read front to back like a stream. The
+// pages come straight from the page cache, so a file several processes
+// read (such as a model) is only held in memory once while they read it,
+// and a second process reading it does not touch the disk.
+class MappedFile {
+private:
+    const unsigned char* base = nullptr;
+    size_t length = 0;
+    size_t offset = 0;
+
+public:
+    MappedFile() = default;
+    
+    ~MappedFile() {
+        close();
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    // Map path for reading from the start. Returns false if it cannot be
+    // opened or is empty.
+    bool open(const std::string& path) {
+        close();
+        
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        
+        size_t size = static_cast<size_t>(st.st_size);
+        void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping stays valid after the descriptor is closed
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        
+        // Read ahead aggressively, since the file is read once in order
+        madvise(data, size, MADV_SEQUENTIAL);
+        madvise(data, size, MADV_WILLNEED);
+        
+        base = static_cast<const unsigned char*>(data);
+        length = size;
+        offset = 0;
+        return true;
+    }
+    
+    void close() {
+        if (base) {
+            munmap(const_cast<unsigned char*>(base), length);
+            base = nullptr;
+        }
+        length = 0;
+        offset = 0;
+    }
+    
+    // Copy up to count bytes from the current position and move past them.
+    // Returns how many were copied, fewer only at the end of the file.
+    size_t read(void* output, size_t count) {
+        if (!base) {
+            return 0;
+        }
+        size_t available = length - offset;
+        if (count > available) {
+            count = available;
+        }
+        std::memcpy(output, base + offset, count);
+        offset += count;
+        return count;
+    }
+    
+    bool is_open() const { return base != nullptr; }
+    bool eof() const { return offset >= length; }
+    size_t size() const { return length; }
+    size_t position() const { return offset; }
+    const unsigned char* data() const { return base; }
+};
+
+#endif // MAPPED_FILE_H
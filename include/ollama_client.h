@@ -4,9 +4,22 @@
 #include <string>
 #include <sstream>
 #include <cstdlib>
-#include <regex>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <curl/curl.h>
 #include "config.h"
+#include "job_slots.h"
+#include "tts_normalizer.h"
+#include "latency_metrics.h"
+#include "conversation_history.h"
 
 // Callback for CURL to write response data
 static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
@@ -14,215 +27,362 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* use
     return size * nmemb;
 }
 
-class OllamaClient {
+// Splits streamed LLM output into complete sentences so each one can be
+// spoken while the rest of the reply is still being generated
+class SentenceSplitter {
 private:
-    OllamaConfig config;
-    std::string system_info;
-    std::vector<std::pair<std::string, std::string>> conversation_history; // Pairs of (user, assistant) messages
+    std::string pending; // Text received but not yet emitted as a sentence
     
-    // Process text to make it more TTS-friendly
-    std::string process_text_for_tts(const std::string& text) {
-        std::string result = text;
-        
-        // Replace markdown formatting
-        auto replace_all = [](std::string& str, const std::string& from, const std::string& to) {
-            size_t start_pos = 0;
-            while((start_pos = str.find(from, start_pos)) != std::string::npos) {
-                str.replace(start_pos, from.length(), to);
-                start_pos += to.length();
-            }
+    // Check if the word ending at period_pos is an abbreviation rather than a sentence end
+    static bool is_abbreviation(const std::string& text, size_t period_pos) {
+        static const std::vector<std::string> abbreviations = {
+            "e.g", "i.e", "etc", "vs", "approx", "mr", "mrs", "ms", "dr", "st"
         };
         
-        // Remove code blocks
-        std::regex code_block_regex("```[\\s\\S]*?```");
-        result = std::regex_replace(result, code_block_regex, "I've prepared some code for you, but I won't read it aloud.");
-        
-        // Remove inline code
-        std::regex inline_code_regex("`([^`]+)`");
-        result = std::regex_replace(result, inline_code_regex, "$1");
-        
-        // Convert bullet points to complete sentences
-        std::regex bulletPointLine("^\\s*[\\*\\-•]\\s*(.+?)$");
-        std::string bulletReplacement = "Point: $1. ";
-        result = std::regex_replace(result, bulletPointLine, bulletReplacement);
-        
-        // Replace remaining bullet characters
-        replace_all(result, "* ", "Point: ");
-        replace_all(result, "- ", "Point: ");
-        replace_all(result, "• ", "Point: ");
-        
-        // Replace URLs with more speech-friendly text
-        std::regex url_regex("https?://\\S+");
-        result = std::regex_replace(result, url_regex, "website link");
-        
-        // Remove markdown links but keep text
-        std::regex link_regex("\\[([^\\]]+)\\]\\([^\\)]+\\)");
-        result = std::regex_replace(result, link_regex, "$1");
-        
-        // Replace heading formatting with spoken phrases
-        std::regex h1_regex("# ([^\n]+)");
-        result = std::regex_replace(result, h1_regex, "Main topic: $1. ");
-        
-        std::regex h2_regex("## ([^\n]+)");
-        result = std::regex_replace(result, h2_regex, "Subtopic: $1. ");
-        
-        std::regex h3_regex("### ([^\n]+)");
-        result = std::regex_replace(result, h3_regex, "Section: $1. ");
-        
-        // Remove bold and italic formatting
-        replace_all(result, "**", "");
-        replace_all(result, "__", "");
-        replace_all(result, "*", "");
-        replace_all(result, "_", "");
-        
-        // Replace colons in text with spoken language
-        std::regex colonPattern("([^:]):([^:]|$)");
-        result = std::regex_replace(result, colonPattern, "$1 is $2");
-        
-        // Replace newlines with spaces for better flow in speech
-        replace_all(result, "\n\n", ". ");
-        replace_all(result, "\n", " ");
-        
-        // Remove multiple spaces
-        std::regex multi_spaces("\\s+");
-        result = std::regex_replace(result, multi_spaces, " ");
-        
-        // Remove multiple periods
-        replace_all(result, ".. ", ". ");
-        replace_all(result, "... ", ". ");
-        
-        // Add pauses after sentences for better speech rhythm
-        std::regex sentence_end("\\. ");
-        result = std::regex_replace(result, sentence_end, ". ");
-        
-        // Expand common abbreviations
-        replace_all(result, " e.g. ", " for example ");
-        replace_all(result, " i.e. ", " that is ");
-        replace_all(result, " etc. ", " etcetera ");
-        replace_all(result, " vs. ", " versus ");
-        replace_all(result, " approx. ", " approximately ");
-        
-        // Make numbers more speech-friendly
-        replace_all(result, "1st", "first");
-        replace_all(result, "2nd", "second");
-        replace_all(result, "3rd", "third");
-        replace_all(result, "4th", "fourth");
-        replace_all(result, "5th", "fifth");
-        
-        // Read special characters in a more natural way
-        replace_all(result, "&", " and ");
-        replace_all(result, "%", " percent ");
-        replace_all(result, "$", " dollars ");
-        replace_all(result, "=", " equals ");
-        replace_all(result, "+", " plus ");
-        replace_all(result, "-", " minus ");
-        replace_all(result, "/", " divided by ");
-        replace_all(result, ">", " greater than ");
-        replace_all(result, "<", " less than ");
-        
-        // Replace common emojis with spoken descriptions
-        replace_all(result, "😊", " smiling face ");
-        replace_all(result, "👍", " thumbs up ");
-        replace_all(result, "👎", " thumbs down ");
-        replace_all(result, "❤️", " heart ");
-        replace_all(result, "👋", " waving hand ");
-        replace_all(result, "🙂", " slightly smiling face ");
-        replace_all(result, "😀", " grinning face ");
-        replace_all(result, "🤖", " robot face ");
-        replace_all(result, "✅", " check mark ");
-        replace_all(result, "⚠️", " warning ");
-        replace_all(result, "⭐", " star ");
-        replace_all(result, "🚀", " rocket ");
-        
-        return result;
+        size_t word_start = period_pos;
+        while (word_start > 0 && !std::isspace(static_cast<unsigned char>(text[word_start - 1]))) {
+            word_start--;
+        }
+        
+        std::string word = text.substr(word_start, period_pos - word_start);
+        for (char& c : word) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        
+        for (const auto& abbreviation : abbreviations) {
+            if (word == abbreviation) {
+                return true;
+            }
+        }
+        return false;
     }
     
-    // Format conversation history for the prompt
-    std::string format_conversation_history() const {
-        if (conversation_history.empty()) {
-            return "";
+    // Trim a sentence and pass it on if it has any content
+    static void emit_sentence(const std::string& sentence, const std::function<void(const std::string&)>& emit) {
+        size_t first = sentence.find_first_not_of(" \t\n\r");
+        if (first == std::string::npos) {
+            return;
         }
+        size_t last = sentence.find_last_not_of(" \t\n\r");
+        emit(sentence.substr(first, last - first + 1));
+    }
+    
+public:
+    // Add a chunk of streamed text; every sentence it completes is passed to emit
+    void feed(const std::string& chunk, const std::function<void(const std::string&)>& emit) {
+        pending += chunk;
         
-        std::stringstream history;
-        history << "\n\nConversation history:\n";
-        
-        // Get the last 5 turns at most (or fewer if there aren't that many)
-        size_t start_idx = conversation_history.size() > 5 ? conversation_history.size() - 5 : 0;
+        size_t sentence_start = 0;
+        bool in_code_block = false; // Never split inside ``` fences so they stay intact
+        size_t i = 0;
         
-        for (size_t i = start_idx; i < conversation_history.size(); ++i) {
-            const auto& turn = conversation_history[i];
-            history << "User: " << turn.first << "\n";
-            history << "Assistant: " << turn.second << "\n\n";
+        while (i < pending.size()) {
+            char c = pending[i];
+            
+            if (c == '`') {
+                // Need all three characters to recognise a fence
+                if (i + 3 > pending.size()) {
+                    break;
+                }
+                if (pending.compare(i, 3, "```") == 0) {
+                    in_code_block = !in_code_block;
+                    i += 3;
+                    continue;
+                }
+            }
+            
+            if (in_code_block) {
+                i++;
+                continue;
+            }
+            
+            if (c == '\n') {
+                emit_sentence(pending.substr(sentence_start, i + 1 - sentence_start), emit);
+                sentence_start = i + 1;
+            } else if (c == '.' || c == '!' || c == '?') {
+                // Absorb runs of terminal punctuation and closing quotes ("Really?!")
+                size_t end = i + 1;
+                while (end < pending.size() && std::strchr(".!?\"')", pending[end]) != nullptr) {
+                    end++;
+                }
+                
+                // Wait for the next character to know whether this ends a sentence
+                if (end >= pending.size()) {
+                    break;
+                }
+                
+                if (std::isspace(static_cast<unsigned char>(pending[end])) &&
+                    !(c == '.' && is_abbreviation(pending, i))) {
+                    emit_sentence(pending.substr(sentence_start, end - sentence_start), emit);
+                    sentence_start = end;
+                }
+                i = end;
+                continue;
+            }
+            
+            i++;
         }
         
-        return history.str();
+        pending.erase(0, sentence_start);
+    }
+    
+    // Emit whatever text is left once the stream has finished
+    void flush(const std::function<void(const std::string&)>& emit) {
+        emit_sentence(pending, emit);
+        pending.clear();
+    }
+    
+    // Discard any buffered text
+    void reset() {
+        pending.clear();
+    }
+};
+
+// Connections, DNS lookups and TLS sessions shared by the clients of
+// several sessions, so they reuse one pool of connections to the server
+class CurlShare {
+private:
+    CURLSH* share = nullptr;
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+    
+    static void lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+        static_cast<CurlShare*>(userptr)->locks[data].lock();
     }
     
+    static void unlock(CURL*, curl_lock_data data, void* userptr) {
+        static_cast<CurlShare*>(userptr)->locks[data].unlock();
+    }
+
 public:
-    OllamaClient(const OllamaConfig& cfg, const std::string& sysinfo = "") 
-        : config(cfg), system_info(sysinfo), conversation_history() {
-        // Initialize CURL globally (should be done once)
+    CurlShare() {
         curl_global_init(CURL_GLOBAL_ALL);
+        share = curl_share_init();
+        if (!share) {
+            std::cerr << "Warning: Failed to create a CURL share, sessions use connections of their own" << std::endl;
+            return;
+        }
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
     }
     
-    // Set system information
-    void set_system_info(const std::string& sysinfo) {
-        system_info = sysinfo;
+    ~CurlShare() {
+        if (share) {
+            curl_share_cleanup(share);
+        }
+        curl_global_cleanup();
     }
     
-    // Clear conversation history
-    void clear_history() {
-        conversation_history.clear();
+    CurlShare(const CurlShare&) = delete;
+    CurlShare& operator=(const CurlShare&) = delete;
+    
+    CURLSH* handle() const { return share; }
+};
+
+class OllamaClient {
+private:
+    OllamaConfig config;
+    std::string system_info;
+    ConversationHistory conversation_history;
+    std::atomic<uint64_t> issued_tokens{0};     // Last token handed out by request_token()
+    std::atomic<uint64_t> cancelled_through{0}; // Requests with this token or an older one are cancelled
+    std::atomic<uint64_t> active_token{0};      // Token of the request in flight, or the last one
+    std::atomic<bool> last_complete{false};    // Whether the last request produced a complete reply
+    std::atomic<uint64_t> last_turn{0};        // History id of the turn the last request added, or 0
+    LatencyMetrics* metrics = nullptr;         // Receives LlmFirstByte for streamed replies, if set
+    
+    // Long-lived CURL handle, so the connection to the server is kept alive
+    // and reused between turns
+    CURL* curl = nullptr;
+    struct curl_slist* headers = nullptr;
+    
+    // Shared with the clients of other sessions, if set
+    std::shared_ptr<CurlShare> connection_share;
+    std::shared_ptr<JobSlots> request_slots;
+    
+    // Summaries of the dropped turns are made on a thread of their own, so
+    // no reply waits for them, and taken into the history by the next request
+    std::thread summary_worker;
+    std::atomic<bool> summary_running{false};
+    std::atomic<bool> closing{false}; // Aborts the summary in progress
+    std::mutex summary_mutex;         // Guards the fields below
+    std::string ready_summary;
+    bool summary_ready = false;
+    uint64_t summary_epoch = 0;       // Bumped by clear_history(), so old summaries are dropped
+    
+    // Check if the request in flight has been cancelled
+    bool is_cancelled() const {
+        const uint64_t token = active_token.load();
+        return token != 0 && token <= cancelled_through.load();
     }
     
-    // Get the number of conversation turns
-    size_t history_size() const {
-        return conversation_history.size();
+    // Process text to make it more TTS-friendly
+    std::string process_text_for_tts(const std::string& text) {
+        return TTSNormalizer::normalize(text);
     }
     
-    ~OllamaClient() {
-        // Cleanup CURL globally
-        curl_global_cleanup();
+    // Format conversation history for the prompt
+    std::string format_conversation_history() const {
+        return conversation_history.format();
     }
     
-    // Process text with ollama
-    std::string process(const std::string& text) {
-        // Safety check - do not process empty text
-        if (text.empty()) {
-            std::cerr << "Error: Attempted to process empty text" << std::endl;
-            return ""; // Return empty response for empty input
+    // Fold turns dropped from the history into the summary with a separate
+    // request, so older context is kept in a few sentences. Returns "" if
+    // the server could not be asked.
+    std::string summarize_history(const std::string& summary, const std::string& dropped) const {
+        std::string prompt = "Summarize this conversation between a user and a voice assistant in at most three "
+                             "short sentences, keeping names, facts and anything the user asked to remember.\n\n";
+        if (!summary.empty()) {
+            prompt += "Earlier summary: " + summary + "\n\n";
         }
+        prompt += dropped;
         
-        CURL* curl;
-        CURLcode res;
-        std::string readBuffer;
+        nlohmann::json request_json;
+        request_json["model"] = config.model;
+        request_json["prompt"] = prompt;
+        request_json["stream"] = false;
+        add_keep_alive(request_json);
         
-        // Create CURL handle
-        curl = curl_easy_init();
-        if (!curl) {
-            std::cerr << "Failed to initialize CURL" << std::endl;
-            return "Sorry, I'm having trouble connecting to my thinking module.";
+        std::string response;
+        if (send_oneshot("/api/generate", request_json.dump(), 60L, response, &closing) != 200) {
+            std::cerr << "Warning: Could not summarize the conversation history" << std::endl;
+            return "";
+        }
+        try {
+            std::string text;
+            if (extract_reply(nlohmann::json::parse(response), text)) {
+                return text;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error parsing JSON response: " << e.what() << std::endl;
+        }
+        return "";
+    }
+    
+    // State shared with the CURL write callback while a streamed reply arrives
+    struct StreamState {
+        OllamaClient* client = nullptr;
+        std::string line_buffer;    // Partial NDJSON line waiting for its newline
+        std::string response_text;  // Raw reply text received so far
+        std::string error;          // Error reported by the server, if any
+        TTSNormalizer normalizer;   // Normalizes the reply for TTS as it streams in
+        SentenceSplitter splitter;  // Splits the normalized text into sentences
+        std::function<void(const std::string&)> on_sentence;
+        
+        // Hand a finished sentence to the caller
+        void speak(const std::string& sentence) {
+            if (sentence.find_first_not_of(" \t\n\r") != std::string::npos) {
+                on_sentence(sentence);
+            }
         }
         
-        // Set URL
-        std::string url = config.host + "/api/generate";
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        // Normalize a streamed piece of the reply and speak every sentence it completes
+        void feed(const std::string& piece) {
+            std::string normalized;
+            normalizer.feed(piece, normalized);
+            splitter.feed(normalized, [this](const std::string& sentence) { speak(sentence); });
+        }
         
-        // Set timeout (5 seconds)
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+        // Speak whatever is left once the reply has finished
+        void finish() {
+            std::string normalized;
+            normalizer.flush(normalized);
+            splitter.feed(normalized, [this](const std::string& sentence) { speak(sentence); });
+            splitter.flush([this](const std::string& sentence) { speak(sentence); });
+        }
+    };
+    
+    // Handle one NDJSON line from a streamed /api/generate or /api/chat response
+    static void handle_stream_line(StreamState& state, const std::string& line) {
+        if (line.find_first_not_of(" \t\r\n") == std::string::npos) {
+            return;
+        }
         
-        // Set headers
-        struct curl_slist* headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        try {
+            nlohmann::json chunk = nlohmann::json::parse(line);
+            
+            if (chunk.contains("error")) {
+                state.error = chunk["error"].get<std::string>();
+            }
+            
+            std::string piece;
+            if (extract_reply(chunk, piece)) {
+                state.response_text += piece;
+                state.feed(piece);
+            }
+            
+            if (chunk.value("done", false)) {
+                state.finish();
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error parsing streamed JSON chunk: " << e.what() << std::endl;
+            std::cerr << "Raw chunk: " << line << std::endl;
+        }
+    }
+    
+    // Callback for CURL to split streamed data into NDJSON lines
+    static size_t StreamWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+        StreamState* state = static_cast<StreamState*>(userp);
         
-        // Create a proper JSON object with the nlohmann/json library
-        nlohmann::json request_json;
-        request_json["model"] = config.model;
-        request_json["prompt"] = text;
+        // Returning less than was received makes CURL abort the transfer
+        if (state->client->is_cancelled()) {
+            return 0;
+        }
+        if (state->client->metrics) {
+            state->client->metrics->mark(TurnEvent::LlmFirstByte);
+        }
+        
+        state->line_buffer.append(static_cast<char*>(contents), size * nmemb);
+        
+        size_t newline_pos;
+        while ((newline_pos = state->line_buffer.find('\n')) != std::string::npos) {
+            std::string line = state->line_buffer.substr(0, newline_pos);
+            state->line_buffer.erase(0, newline_pos + 1);
+            handle_stream_line(*state, line);
+        }
         
-        // Add system information and conversation history to the system prompt
+        return size * nmemb;
+    }
+    
+    // Callback for CURL progress; a non-zero return aborts the transfer
+    static int ProgressCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return static_cast<OllamaClient*>(clientp)->is_cancelled() ? 1 : 0;
+    }
+    
+    // The same for send_oneshot(), given the flag that aborts it
+    static int AbortCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return static_cast<const std::atomic<bool>*>(clientp)->load() ? 1 : 0;
+    }
+    
+    // Put a summary finished in the background into the history
+    void take_ready_summary() {
+        std::lock_guard<std::mutex> lock(summary_mutex);
+        if (summary_ready) {
+            conversation_history.set_summary(ready_summary);
+            summary_ready = false;
+        }
+    }
+    
+    // Build the system prompt with system information and conversation history
+    std::string build_system_prompt() const {
+        std::string enhanced_system_prompt = build_base_system_prompt();
+        
+        // Add conversation history if available
+        std::string history = format_conversation_history();
+        if (!history.empty()) {
+            enhanced_system_prompt += history + 
+                                    "\nPlease respond to the user's latest message, taking into account the conversation history above.";
+        }
+        
+        return enhanced_system_prompt;
+    }
+    
+    // Build the system prompt with system information only. It stays the same
+    // from turn to turn, so the server can reuse its prompt cache in chat mode.
+    std::string build_base_system_prompt() const {
         std::string enhanced_system_prompt = config.system_prompt;
         
         // Add system information if available
@@ -246,74 +406,483 @@ public:
                                     "When describing your hardware capabilities, be conversational and avoid overly technical information.";
         }
         
-        // Add conversation history if available
-        std::string history = format_conversation_history();
-        if (!history.empty()) {
-            enhanced_system_prompt += history + 
-                                    "\nPlease respond to the user's latest message, taking into account the conversation history above.";
+        return enhanced_system_prompt;
+    }
+    
+    // Check if requests go to /api/chat rather than /api/generate
+    bool is_chat() const {
+        return config.api == "chat";
+    }
+    
+    std::string endpoint() const {
+        return is_chat() ? "/api/chat" : "/api/generate";
+    }
+    
+    // Create the /api/chat message list: a stable system message, the
+    // summary of earlier turns, the past turns, then the new user message.
+    // The history drops old turns in batches, so the message prefix (and
+    // the server's cached prefill for it) stays the same for most turns.
+    nlohmann::json build_chat_messages(const std::string& text) const {
+        nlohmann::json messages = nlohmann::json::array();
+        messages.push_back({{"role", "system"}, {"content", build_base_system_prompt()}});
+        
+        const std::string& summary = conversation_history.get_summary();
+        if (!summary.empty()) {
+            messages.push_back({{"role", "system"}, {"content", "Summary of the earlier conversation: " + summary}});
+        }
+        for (size_t i = 0; i < conversation_history.size(); ++i) {
+            messages.push_back({{"role", "user"}, {"content", conversation_history[i].user}});
+            messages.push_back({{"role", "assistant"}, {"content", conversation_history[i].assistant}});
         }
         
-        request_json["system"] = enhanced_system_prompt;
-        request_json["stream"] = false;
+        messages.push_back({{"role", "user"}, {"content", text}});
+        return messages;
+    }
+    
+    // Pull the reply text out of a /api/generate or /api/chat response object
+    static bool extract_reply(const nlohmann::json& response, std::string& reply) {
+        if (response.contains("response") && response["response"].is_string()) {
+            reply = response["response"];
+            return true;
+        }
+        if (response.contains("message") && response["message"].contains("content")) {
+            reply = response["message"]["content"];
+            return true;
+        }
+        return false;
+    }
+    
+    // Create the long-lived CURL handle and set the options shared by every request
+    bool init_handle() {
+        if (curl) {
+            return true;
+        }
         
-        // Convert to string
-        std::string json_data = request_json.dump();
+        curl = curl_easy_init();
+        if (!curl) {
+            std::cerr << "Failed to initialize CURL" << std::endl;
+            return false;
+        }
         
-        // Set data to send
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
+        // Set headers
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
         
-        // Set callback function for received data
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+        // Keep the connection alive between turns
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
         
-        // Perform the request
-        res = curl_easy_perform(curl);
+        // No SIGALRM for DNS timeouts, which is not thread-safe and other
+        // clients and the summary thread run requests at the same time
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
         
-        // Check for errors
-        if (res != CURLE_OK) {
-            std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
-            
-            // Provide more specific error messages based on error code
-            if (res == CURLE_COULDNT_CONNECT) {
-                std::cerr << "Could not connect to Ollama server. Is it running?" << std::endl;
-                std::cerr << "Start it with: ollama serve" << std::endl;
-                curl_easy_cleanup(curl);
-                curl_slist_free_all(headers);
-                return "I can't reach my thinking module. Please make sure Ollama is running with 'ollama serve'.";
-            } else if (res == CURLE_OPERATION_TIMEDOUT) {
-                std::cerr << "Connection to Ollama server timed out" << std::endl;
-                curl_easy_cleanup(curl);
-                curl_slist_free_all(headers);
-                return "It's taking too long to get a response. Is the model loaded? Try 'ollama pull " + config.model + "'.";
+        // Let cancel() abort the request while waiting for the reply
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+        
+        if (connection_share && connection_share->handle()) {
+            curl_easy_setopt(curl, CURLOPT_SHARE, connection_share->handle());
+        }
+        return true;
+    }
+    
+    // Set the per-request options for a POST to an Ollama endpoint
+    void setup_request(const std::string& endpoint, const std::string& json_data, bool stream) {
+        // Set URL
+        std::string url = config.host + endpoint;
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        
+        if (stream) {
+            // A streamed reply can legitimately take longer than the fixed timeout,
+            // so only give up if the server stops sending data for 30 seconds
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 30L);
+        } else {
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 0L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 0L);
+        }
+        
+        // Set data to send (CURLOPT_COPYPOSTFIELDS so the caller's string may go away)
+        curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, json_data.c_str());
+    }
+    
+    // Ask the server to keep the model loaded for config.keep_alive. Ollama
+    // takes either a duration such as "30m" or a number of seconds (-1 = forever).
+    void add_keep_alive(nlohmann::json& request_json) const {
+        if (config.keep_alive.empty()) {
+            return;
+        }
+        
+        char* end = nullptr;
+        long seconds = std::strtol(config.keep_alive.c_str(), &end, 10);
+        if (end && *end == '\0') {
+            request_json["keep_alive"] = seconds;
+        } else {
+            request_json["keep_alive"] = config.keep_alive;
+        }
+    }
+    
+    // Create the JSON request body for a prompt
+    nlohmann::json build_request_json(const std::string& text, bool stream) const {
+        nlohmann::json request_json;
+        request_json["model"] = config.model;
+        if (is_chat()) {
+            request_json["messages"] = build_chat_messages(text);
+        } else {
+            request_json["prompt"] = text;
+            request_json["system"] = build_system_prompt();
+        }
+        request_json["stream"] = stream;
+        add_keep_alive(request_json);
+        return request_json;
+    }
+    
+    // Map a CURL transport error to a spoken error message
+    std::string curl_error_message(CURLcode res) const {
+        std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
+        
+        // Provide more specific error messages based on error code
+        if (res == CURLE_COULDNT_CONNECT) {
+            std::cerr << "Could not connect to Ollama server. Is it running?" << std::endl;
+            std::cerr << "Start it with: ollama serve" << std::endl;
+            return "I can't reach my thinking module. Please make sure Ollama is running with 'ollama serve'.";
+        } else if (res == CURLE_OPERATION_TIMEDOUT) {
+            std::cerr << "Connection to Ollama server timed out" << std::endl;
+            return "It's taking too long to get a response. Is the model loaded? Try 'ollama pull " + config.model + "'.";
+        }
+        
+        return "Sorry, I encountered an error while processing your request.";
+    }
+    
+    // Map an unsuccessful HTTP response to a spoken error message
+    std::string http_error_message(long http_code, const std::string& body) const {
+        if (http_code == 404) {
+            std::cerr << "Model not found: " << config.model << std::endl;
+            return "I can't find the model '" + config.model + "'. Please run 'ollama pull " + config.model + "' first.";
+        } else if (http_code == 500) {
+            std::cerr << "Ollama server error: " << body << std::endl;
+            return "The Ollama server encountered an error processing your request.";
+        } else if (http_code != 200) {
+            std::cerr << "Unexpected HTTP code: " << http_code << std::endl;
+            std::cerr << "Response: " << body << std::endl;
+        }
+        
+        return "Sorry, I couldn't process your request properly.";
+    }
+    
+    // Send a request on a handle of its own, so it can run on another thread
+    // while the shared handle is in use. A GET if body is empty. Returns the
+    // HTTP code, or 0 if the server could not be reached or abort was set.
+    long send_oneshot(const std::string& path, const std::string& body, long timeout_seconds, std::string& response,
+                      const std::atomic<bool>* abort = nullptr) const {
+        CURL* handle = curl_easy_init();
+        if (!handle) {
+            return 0;
+        }
+        
+        std::string url = config.host + path;
+        curl_slist* request_headers = curl_slist_append(nullptr, "Content-Type: application/json");
+        curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request_headers);
+        curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, 5L);
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT, timeout_seconds);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+        if (!body.empty()) {
+            curl_easy_setopt(handle, CURLOPT_COPYPOSTFIELDS, body.c_str());
+        }
+        if (abort) {
+            curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, AbortCallback);
+            curl_easy_setopt(handle, CURLOPT_XFERINFODATA, abort);
+        }
+        
+        long http_code = 0;
+        if (curl_easy_perform(handle) == CURLE_OK) {
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_code);
+        }
+        curl_slist_free_all(request_headers);
+        curl_easy_cleanup(handle);
+        return http_code;
+    }
+
+
+public:
+    OllamaClient(const OllamaConfig& cfg, const std::string& sysinfo = "") 
+        : config(cfg), system_info(sysinfo),
+          conversation_history(cfg.history_turns > 0 ? static_cast<size_t>(cfg.history_turns) : 1,
+                               cfg.history_tokens > 0 ? static_cast<size_t>(cfg.history_tokens) : 0) {
+        // Initialize CURL globally (should be done once)
+        curl_global_init(CURL_GLOBAL_ALL);
+        
+        conversation_history.set_keep_dropped(config.history_summary);
+    }
+    
+    // Set system information
+    void set_system_info(const std::string& sysinfo) {
+        system_info = sysinfo;
+    }
+    
+    // Clear conversation history
+    void clear_history() {
+        {
+            std::lock_guard<std::mutex> lock(summary_mutex);
+            summary_epoch++;
+            summary_ready = false;
+        }
+        conversation_history.clear();
+    }
+    
+    // Fold the turns that have dropped out of the history into its summary,
+    // on a background thread. Call when idle, e.g. once a reply has been
+    // spoken, and not for a reply that may still be thrown away. Does
+    // nothing if history_summary is off or a summary is still being made.
+    void update_summary() {
+        take_ready_summary();
+        if (summary_running.load() || !conversation_history.has_dropped()) {
+            return;
+        }
+        if (summary_worker.joinable()) {
+            summary_worker.join();
+        }
+        
+        std::string summary = conversation_history.get_summary();
+        std::string dropped = conversation_history.take_dropped();
+        uint64_t epoch;
+        {
+            std::lock_guard<std::mutex> lock(summary_mutex);
+            epoch = summary_epoch;
+        }
+        summary_running.store(true);
+        summary_worker = std::thread([this, summary, dropped, epoch] {
+            std::string updated = summarize_history(summary, dropped);
+            {
+                std::lock_guard<std::mutex> lock(summary_mutex);
+                if (!updated.empty() && epoch == summary_epoch) {
+                    ready_summary = std::move(updated);
+                    summary_ready = true;
+                }
             }
-            
+            summary_running.store(false);
+        });
+    }
+    
+    // Wait for a summary being made in the background, e.g. in tests
+    void wait_for_summary() {
+        if (summary_worker.joinable()) {
+            summary_worker.join();
+        }
+        take_ready_summary();
+    }
+    
+    // Drop the turn with id from last_turn_id(), e.g. a reply generated
+    // ahead of time and not used, if no turn has been added since
+    bool forget_turn(uint64_t id) {
+        return conversation_history.forget(id);
+    }
+    
+    // Add a turn answered without the model, so later replies know about it
+    void add_turn(const std::string& user, const std::string& assistant) {
+        if (!user.empty() && !assistant.empty()) {
+            conversation_history.push(user, assistant);
+        }
+    }
+    
+    // Check if the last request got a complete reply, rather than an error
+    // message or a cancelled one
+    bool last_reply_complete() const {
+        return last_complete.load();
+    }
+    
+    // History id of the turn the last request added, or 0 if it added none
+    uint64_t last_turn_id() const {
+        return last_turn.load();
+    }
+    
+    // Get the number of conversation turns
+    size_t history_size() const {
+        return conversation_history.size();
+    }
+    
+    // Summary of the turns dropped from the history so far, or ""
+    const std::string& get_history_summary() const {
+        return conversation_history.get_summary();
+    }
+    
+    ~OllamaClient() {
+        closing.store(true);
+        if (summary_worker.joinable()) {
+            summary_worker.join();
+        }
+        if (curl) {
             curl_easy_cleanup(curl);
-            curl_slist_free_all(headers);
-            return "Sorry, I encountered an error while processing your request.";
         }
+        curl_slist_free_all(headers);
+        
+        // Cleanup CURL globally
+        curl_global_cleanup();
+    }
+    
+    OllamaClient(const OllamaClient&) = delete;
+    OllamaClient& operator=(const OllamaClient&) = delete;
+    
+    // Check if replies should be streamed sentence by sentence
+    bool is_streaming() const {
+        return config.stream;
+    }
+    
+    // Abort the request in flight and every one whose token has been taken,
+    // e.g. when the user interrupts the reply. Safe to call from any thread;
+    // requests asked for later are not affected.
+    void cancel() {
+        cancel(issued_tokens.load());
+    }
+    
+    // Abort only the request made with token, and older ones
+    void cancel(uint64_t token) {
+        uint64_t through = cancelled_through.load();
+        while (through < token && !cancelled_through.compare_exchange_weak(through, token)) {
+        }
+    }
+    
+    // Take on the thread that asks for a reply and pass to process() or
+    // process_streaming(), so a cancel() from then on stops that request
+    // even if it has not started yet
+    uint64_t request_token() {
+        return ++issued_tokens;
+    }
+    
+    // Record when the first data of each streamed reply arrives
+    void set_metrics(LatencyMetrics* latency_metrics) {
+        metrics = latency_metrics;
+    }
+    
+    // Draw connections from a pool shared with other clients. Set before
+    // the first request.
+    void set_connection_share(std::shared_ptr<CurlShare> share) {
+        connection_share = std::move(share);
+    }
+    
+    // Wait for one of slots before each reply, so the sessions sharing them
+    // take turns at the server. cancel() also ends the wait.
+    void set_request_slots(std::shared_ptr<JobSlots> slots) {
+        request_slots = std::move(slots);
+    }
+    
+    // Check if the last request was aborted by cancel()
+    bool was_cancelled() const {
+        return is_cancelled();
+    }
+    
+    // Load the model into memory without generating anything (a generate
+    // request with no prompt), so the first reply does not pay for the load.
+    // Uses its own connection; safe to run on a startup thread.
+    bool warm_up() const {
+        nlohmann::json request_json;
+        request_json["model"] = config.model;
+        add_keep_alive(request_json);
+        
+        std::string response;
+        long http_code = send_oneshot("/api/generate", request_json.dump(), 300L, response);
+        if (http_code != 200) {
+            std::cerr << "Warning: Could not preload the Ollama model " << config.model;
+            if (http_code == 0) {
+                std::cerr << " (server not reachable)";
+            } else {
+                std::cerr << " (HTTP " << http_code << ")";
+            }
+            std::cerr << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Version reported by the server, e.g. "ollama 0.5.7", or "" if unknown
+    std::string server_version() const {
+        std::string response;
+        if (send_oneshot("/api/version", "", 5L, response) != 200) {
+            return "";
+        }
+        try {
+            auto version = nlohmann::json::parse(response).value("version", std::string());
+            return version.empty() ? "" : "ollama " + version;
+        } catch (const nlohmann::json::exception&) {
+            return "";
+        }
+    }
+    
+    
+    // Process text with ollama
+    std::string process(const std::string& text) {
+        return process(text, request_token());
+    }
+    
+    // Same, for a token from request_token()
+    std::string process(const std::string& text, uint64_t token) {
+        // Safety check - do not process empty text
+        if (text.empty()) {
+            std::cerr << "Error: Attempted to process empty text" << std::endl;
+            return ""; // Return empty response for empty input
+        }
+        
+        std::string readBuffer;
+        active_token.store(token);
+        last_complete.store(false);
+        last_turn.store(0);
+        take_ready_summary();
+        if (is_cancelled()) {
+            return "";
+        }
+        
+        JobSlots::Lease slot;
+        if (request_slots && !(slot = request_slots->acquire([this] { return is_cancelled(); }))) {
+            return "";
+        }
+        
+        // Reuse the CURL handle and its connection
+        if (!init_handle()) {
+            return "Sorry, I'm having trouble connecting to my thinking module.";
+        }
+        
+        setup_request(endpoint(), build_request_json(text, false).dump(), false);
+        
+        // Set callback function for received data
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+        
+        // Perform the request
+        CURLcode res = curl_easy_perform(curl);
         
         // Get HTTP response code
         long http_code = 0;
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
         
-        // Clean up
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+        // Check for errors
+        if (res != CURLE_OK && is_cancelled()) {
+            return "";
+        } else if (res != CURLE_OK) {
+            return curl_error_message(res);
+        }
         
         // Process response
         if (http_code == 200 && !readBuffer.empty()) {
             // Parse JSON response
             try {
                 nlohmann::json response = nlohmann::json::parse(readBuffer);
-                if (response.contains("response")) {
-                    std::string resp_text = response["response"];
+                std::string resp_text;
+                if (extract_reply(response, resp_text)) {
                     
                     // Process the response for TTS friendliness
                     std::string processed_text = process_text_for_tts(resp_text);
                     
                     // Only add to conversation history if there was actual speech and a valid response
                     if (!text.empty() && !resp_text.empty()) {
-                        conversation_history.push_back(std::make_pair(text, resp_text));
+                        last_turn.store(conversation_history.push(text, resp_text));
+                        last_complete.store(true);
                     }
                     
                     return processed_text;
@@ -324,18 +893,109 @@ public:
                 std::cerr << "Error parsing JSON response: " << e.what() << std::endl;
                 std::cerr << "Raw response: " << readBuffer << std::endl;
             }
-        } else if (http_code == 404) {
-            std::cerr << "Model not found: " << config.model << std::endl;
-            return "I can't find the model '" + config.model + "'. Please run 'ollama pull " + config.model + "' first.";
-        } else if (http_code == 500) {
-            std::cerr << "Ollama server error: " << readBuffer << std::endl;
-            return "The Ollama server encountered an error processing your request.";
-        } else {
-            std::cerr << "Unexpected HTTP code: " << http_code << std::endl;
-            std::cerr << "Response: " << readBuffer << std::endl;
         }
         
-        return "Sorry, I couldn't process your request properly.";
+        return http_error_message(http_code, readBuffer);
+    }
+    
+    // Process text with ollama, streaming the reply as it is generated.
+    // Each complete sentence is made TTS-friendly and passed to on_sentence
+    // as soon as it arrives. Error messages are passed to on_sentence too, so
+    // callers only need to speak what they are given. Returns the full reply.
+    std::string process_streaming(const std::string& text, const std::function<void(const std::string&)>& on_sentence) {
+        return process_streaming(text, on_sentence, request_token());
+    }
+    
+    // Same, for a token from request_token()
+    std::string process_streaming(const std::string& text, const std::function<void(const std::string&)>& on_sentence,
+                                  uint64_t token) {
+        // Safety check - do not process empty text
+        if (text.empty()) {
+            std::cerr << "Error: Attempted to process empty text" << std::endl;
+            return "";
+        }
+        
+        active_token.store(token);
+        last_complete.store(false);
+        last_turn.store(0);
+        take_ready_summary();
+        if (is_cancelled()) {
+            return "";
+        }
+        
+        JobSlots::Lease slot;
+        if (request_slots && !(slot = request_slots->acquire([this] { return is_cancelled(); }))) {
+            return "";
+        }
+        
+        // Reuse the CURL handle and its connection
+        if (!init_handle()) {
+            std::string message = "Sorry, I'm having trouble connecting to my thinking module.";
+            on_sentence(message);
+            return message;
+        }
+        
+        StreamState state;
+        state.client = this;
+        state.on_sentence = on_sentence;
+        
+        setup_request(endpoint(), build_request_json(text, true).dump(), true);
+        
+        // Handle NDJSON chunks as they arrive
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamWriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &state);
+        
+        // Perform the request
+        CURLcode res = curl_easy_perform(curl);
+        
+        // Get HTTP response code
+        long http_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        
+        // An interrupted reply is returned as far as it got, but not spoken any
+        // further or kept in the history
+        if (is_cancelled()) {
+            return process_text_for_tts(state.response_text);
+        }
+        
+        // Handle a final chunk that was not newline terminated
+        if (!state.line_buffer.empty()) {
+            handle_stream_line(state, state.line_buffer);
+            state.line_buffer.clear();
+        }
+        
+        std::string message;
+        if (res != CURLE_OK) {
+            message = curl_error_message(res);
+        } else if (http_code != 200) {
+            message = http_error_message(http_code, state.error);
+        } else if (!state.error.empty()) {
+            std::cerr << "Ollama server error: " << state.error << std::endl;
+            message = "The Ollama server encountered an error processing your request.";
+        }
+        
+        // If part of the reply was already spoken, keep it rather than replacing it with an error
+        if (!message.empty() && state.response_text.empty()) {
+            on_sentence(message);
+            return message;
+        }
+        
+        // Speak anything left over if the stream ended without a done marker
+        state.finish();
+        
+        if (state.response_text.empty()) {
+            message = http_error_message(http_code, state.error);
+            on_sentence(message);
+            return message;
+        }
+        
+        // Only add complete replies to the conversation history
+        if (message.empty()) {
+            last_turn.store(conversation_history.push(text, state.response_text));
+            last_complete.store(true);
+        }
+        
+        return process_text_for_tts(state.response_text);
     }
 };
 
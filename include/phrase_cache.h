@@ -0,0 +1,216 @@
+#ifndef PHRASE_CACHE_H
+#define PHRASE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Synthesized audio for phrases the assistant says often, keyed by text,
+// voice and speed. Entries can be saved to a file and memory-mapped back on
+// the next start, so cached phrases play without synthesizing at all.
+// Safe to share between threads; entries are only ever added, so one that
+// was found stays valid while the cache exists.
+//
+// File layout, integers in native byte order and every block 8-byte aligned:
+//   header:  "VAPC", uint32 version, uint32 entry count, uint32 reserved
+//   entries: uint32 key size, uint32 sample rate, uint64 sample count,
+//            key bytes, 16-bit mono samples
+class PhraseCache {
+public:
+    struct Entry {
+        std::vector<int16_t> owned;        // Samples synthesized this run
+        const int16_t* mapped = nullptr;   // Or samples in the mapped file
+        size_t count = 0;
+        int sample_rate = 0;
+        
+        const int16_t* samples() const { return mapped ? mapped : owned.data(); }
+    };
+
+private:
+    static constexpr char MAGIC[4] = {'V', 'A', 'P', 'C'};
+    static constexpr uint32_t VERSION = 1;
+    
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    
+    static size_t align8(size_t n) {
+        return (n + 7) & ~static_cast<size_t>(7);
+    }
+    
+    void unmap() {
+        if (mapping) {
+            munmap(mapping, mapping_size);
+            mapping = nullptr;
+            mapping_size = 0;
+        }
+    }
+
+public:
+    PhraseCache() = default;
+    PhraseCache(const PhraseCache&) = delete;
+    PhraseCache& operator=(const PhraseCache&) = delete;
+    
+    ~PhraseCache() {
+        entries.clear();
+        unmap();
+    }
+    
+    // Build the lookup key for a phrase spoken with a given voice and speed
+    static std::string make_key(const std::string& text, const std::string& voice, int speed) {
+        return voice + '\n' + std::to_string(speed) + '\n' + text;
+    }
+    
+    const Entry* find(const std::string& key) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+    
+    // Add the audio for key. An entry already stored is kept, as it may be
+    // playing on another thread.
+    void store(const std::string& key, std::vector<int16_t> samples, int sample_rate) {
+        Entry entry;
+        entry.owned = std::move(samples);
+        entry.count = entry.owned.size();
+        entry.sample_rate = sample_rate;
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.emplace(key, std::move(entry));
+    }
+    
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    
+    // Map a saved cache file and index its entries. Returns false if the file
+    // is missing or not a valid cache, leaving the cache empty. Call before
+    // anything is looked up.
+    bool load(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        unmap();
+        
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < 16) {
+            close(fd);
+            return false;
+        }
+        
+        size_t size = static_cast<size_t>(st.st_size);
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping stays valid after the descriptor is closed
+        if (data == MAP_FAILED) {
+            std::cerr << "Warning: Cannot map phrase cache " << path << std::endl;
+            return false;
+        }
+        mapping = data;
+        mapping_size = size;
+        
+        const char* base = static_cast<const char*>(data);
+        uint32_t version = 0;
+        uint32_t count = 0;
+        std::memcpy(&version, base + 4, sizeof(version));
+        std::memcpy(&count, base + 8, sizeof(count));
+        if (std::memcmp(base, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+            std::cerr << "Warning: Ignoring phrase cache " << path << " with unknown format" << std::endl;
+            unmap();
+            return false;
+        }
+        
+        size_t offset = 16;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t key_size = 0;
+            uint32_t sample_rate = 0;
+            uint64_t sample_count = 0;
+            if (offset + 16 > size) break;
+            std::memcpy(&key_size, base + offset, sizeof(key_size));
+            std::memcpy(&sample_rate, base + offset + 4, sizeof(sample_rate));
+            std::memcpy(&sample_count, base + offset + 8, sizeof(sample_count));
+            offset += 16;
+            
+            size_t samples_offset = offset + align8(key_size);
+            if (samples_offset > size || sample_count > (size - samples_offset) / sizeof(int16_t)) {
+                std::cerr << "Warning: Phrase cache " << path << " is truncated" << std::endl;
+                entries.clear();
+                unmap();
+                return false;
+            }
+            
+            Entry entry;
+            entry.mapped = reinterpret_cast<const int16_t*>(base + samples_offset);
+            entry.count = static_cast<size_t>(sample_count);
+            entry.sample_rate = static_cast<int>(sample_rate);
+            entries[std::string(base + offset, key_size)] = std::move(entry);
+            
+            offset = samples_offset + align8(static_cast<size_t>(sample_count) * sizeof(int16_t));
+        }
+        
+        return true;
+    }
+    
+    // Write every entry to path. The file is replaced atomically, so a
+    // mapping of the previous version stays valid.
+    bool save(const std::string& path) const {
+        std::string temp_path = path + ".tmp";
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Warning: Cannot write phrase cache " << temp_path << std::endl;
+            return false;
+        }
+        
+        static const char padding[8] = {};
+        auto write_padded = [&file](const void* data, size_t size) {
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            file.write(padding, static_cast<std::streamsize>(align8(size) - size));
+        };
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t header[3] = {VERSION, static_cast<uint32_t>(entries.size()), 0};
+        file.write(MAGIC, sizeof(MAGIC));
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        
+        for (const auto& item : entries) {
+            uint32_t key_size = static_cast<uint32_t>(item.first.size());
+            uint32_t sample_rate = static_cast<uint32_t>(item.second.sample_rate);
+            uint64_t sample_count = item.second.count;
+            file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+            file.write(reinterpret_cast<const char*>(&sample_rate), sizeof(sample_rate));
+            file.write(reinterpret_cast<const char*>(&sample_count), sizeof(sample_count));
+            write_padded(item.first.data(), item.first.size());
+            write_padded(item.second.samples(), item.second.count * sizeof(int16_t));
+        }
+        
+        file.close();
+        if (!file) {
+            std::cerr << "Warning: Failed writing phrase cache " << temp_path << std::endl;
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            std::cerr << "Warning: Cannot replace phrase cache " << path << std::endl;
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // PHRASE_CACHE_H
@@ -0,0 +1,159 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include "audio_kernels.h"
+
+// Streaming polyphase resampler for capture devices that only run at rates
+// like 44.1 or 48 kHz. The rate ratio is kept exact as up/down, and a
+// Kaiser-windowed sinc low-pass is split into `up` phases so every output
+// sample is a single dot product over the newest input. Input can arrive in
+// chunks of any size; the filter history is carried across them, so the
+// output does not depend on how the input was split.
+class PolyphaseResampler {
+private:
+    int up = 1;                 // Output rate / input rate, reduced
+    int down = 1;
+    size_t taps = 1;            // Filter taps per phase
+    std::vector<float> coeffs;  // up phases of taps coefficients, each stored oldest-input first
+    std::vector<float> history; // Input still needed by upcoming outputs, oldest first
+    size_t next_input = 0;      // Index in history of the newest input for the next output
+    int phase = 0;              // Filter phase of the next output
+    size_t filter_delay = 0;    // Delay of the filter in upsampled samples
+    
+    // Zeroth-order modified Bessel function, for the Kaiser window
+    static double bessel_i0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 50; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+            if (term < sum * 1e-12) {
+                break;
+            }
+        }
+        return sum;
+    }
+    
+    void design_filter() {
+        // Zero crossings on each side of the sinc, at the lower of the two rates
+        const int zero_crossings = 16;
+        const double beta = 8.6; // About 90 dB stopband attenuation
+        const double rolloff = 0.92; // Passband edge relative to the lower Nyquist frequency
+        
+        // Enough taps per phase to span the sinc, rounded up to a whole number of SIMD vectors
+        taps = static_cast<size_t>(std::ceil(2.0 * zero_crossings * std::max(1.0, static_cast<double>(down) / up)));
+        taps = (taps + 7) & ~static_cast<size_t>(7);
+        
+        // Prototype filter at the upsampled rate. An odd length puts its
+        // centre on a whole sample, so the delay can be skipped exactly; the
+        // last coefficient slot stays zero.
+        const size_t length = taps * up - 1;
+        const double cutoff = rolloff * 0.5 / std::max(up, down); // Cycles per upsampled sample
+        filter_delay = (length - 1) / 2;
+        const double center = static_cast<double>(filter_delay);
+        const double window_norm = bessel_i0(beta);
+        std::vector<double> prototype(length);
+        double total = 0.0;
+        for (size_t n = 0; n < length; n++) {
+            double t = n - center;
+            double sinc = t == 0.0 ? 1.0 : std::sin(2.0 * M_PI * cutoff * t) / (2.0 * M_PI * cutoff * t);
+            double x = length > 1 ? 2.0 * n / (length - 1) - 1.0 : 0.0;
+            double window = bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - x * x))) / window_norm;
+            prototype[n] = 2.0 * cutoff * sinc * window;
+            total += prototype[n];
+        }
+        
+        // Phase p uses prototype taps p, p + up, p + 2 * up, ... where tap j
+        // multiplies the input j samples before the newest, so store them
+        // reversed to make the product a forward dot over the history.
+        // Scaling by up / total keeps unity gain at DC.
+        coeffs.assign(taps * up, 0.0f);
+        for (int p = 0; p < up; p++) {
+            for (size_t j = 0; j < taps && p + j * up < length; j++) {
+                coeffs[p * taps + (taps - 1 - j)] = static_cast<float>(prototype[p + j * up] * up / total);
+            }
+        }
+    }
+
+public:
+    PolyphaseResampler(int input_rate, int output_rate) {
+        int divisor = std::gcd(std::max(1, input_rate), std::max(1, output_rate));
+        up = std::max(1, output_rate) / divisor;
+        down = std::max(1, input_rate) / divisor;
+        if (!is_passthrough()) {
+            design_filter();
+        }
+        reset();
+    }
+    
+    // True if both rates are equal and process() only copies
+    bool is_passthrough() const {
+        return up == down;
+    }
+    
+    // Forget all input seen so far. The first output is centred on the first
+    // input sample, so the filter delay shows up as latency, not as a shift.
+    void reset() {
+        history.assign(taps - 1, 0.0f);
+        next_input = taps - 1 + filter_delay / up;
+        phase = static_cast<int>(filter_delay % up);
+    }
+    
+    // Upper bound on the samples process() produces for count input samples
+    size_t max_output(size_t count) const {
+        return static_cast<size_t>((static_cast<uint64_t>(count) * up) / down) + 1;
+    }
+    
+    // Output samples held back until later input arrives
+    size_t latency() const {
+        return static_cast<size_t>(std::lround(static_cast<double>(filter_delay) / down));
+    }
+    
+    // Resample count input samples, appending the output to out. Once out and
+    // the history have grown to the largest chunk size this does not allocate.
+    void process(const float* in, size_t count, std::vector<float>& out) {
+        if (is_passthrough()) {
+            out.insert(out.end(), in, in + count);
+            return;
+        }
+        
+        history.insert(history.end(), in, in + count);
+        while (next_input < history.size()) {
+            out.push_back(audio_kernels::dot(coeffs.data() + phase * taps, history.data() + next_input - (taps - 1), taps));
+            phase += down;
+            next_input += phase / up;
+            phase %= up;
+        }
+        
+        // Keep only the taps - 1 samples before the next output's newest input
+        size_t consumed = std::min(next_input - (taps - 1), history.size());
+        history.erase(history.begin(), history.begin() + consumed);
+        next_input -= consumed;
+    }
+    
+    // Resample a whole buffer at once, flushing the samples held back at the end
+    static void resample(const float* in, size_t count, int input_rate, int output_rate, std::vector<float>& out) {
+        out.clear();
+        PolyphaseResampler resampler(input_rate, output_rate);
+        if (resampler.is_passthrough()) {
+            out.assign(in, in + count);
+            return;
+        }
+        
+        const size_t expected = static_cast<size_t>((static_cast<uint64_t>(count) * resampler.up) / resampler.down);
+        out.reserve(resampler.max_output(count + resampler.taps));
+        resampler.process(in, count, out);
+        const std::vector<float> silence(resampler.taps, 0.0f);
+        resampler.process(silence.data(), silence.size(), out);
+        
+        out.resize(expected, 0.0f);
+    }
+};
+
+#endif // RESAMPLER_H
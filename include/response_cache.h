@@ -0,0 +1,247 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <chrono>
+#include <ctime>
+#include <cctype>
+#include "config.h"
+
+// Replies to questions already answered, so asking again needs no round
+// trip to the language model. Entries expire after a while and the least
+// recently used are dropped once the cache is full.
+class ResponseCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Entry {
+        std::string key;
+        std::string reply;
+        Clock::time_point stored;
+    };
+    
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t max_entries;
+    Clock::duration ttl;
+    std::mutex mutex;
+
+public:
+    ResponseCache(size_t max_size, std::chrono::seconds time_to_live)
+        : max_entries(max_size), ttl(time_to_live) {}
+    
+    // Reduce a transcript to what identifies the question: lowercase words,
+    // without punctuation, spacing differences or filler words
+    static std::string normalize(const std::string& text) {
+        static const std::unordered_set<std::string> filler = {"please", "hey", "um", "uh", "so", "okay", "ok"};
+        
+        std::string key;
+        std::string word;
+        auto end_word = [&] {
+            if (!word.empty() && !filler.count(word)) {
+                if (!key.empty()) key += ' ';
+                key += word;
+            }
+            word.clear();
+        };
+        for (char c : text) {
+            unsigned char uc = static_cast<unsigned char>(c);
+            if (std::isalnum(uc) || c == '\'') {
+                word += static_cast<char>(std::tolower(uc));
+            } else if (std::isspace(uc) || c == ',' || c == '.' || c == '?' || c == '!') {
+                end_word();
+            }
+        }
+        end_word();
+        return key;
+    }
+    
+    // The same question gets a different answer from another model or
+    // personality, so both are part of the key
+    static std::string make_key(const std::string& transcript, const std::string& model, const std::string& system_prompt) {
+        return model + '\n' + system_prompt + '\n' + normalize(transcript);
+    }
+    
+    // Look up a reply that has not expired yet, marking it recently used
+    bool find(const std::string& key, std::string& reply, Clock::time_point now = Clock::now()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        if (now - it->second->stored >= ttl) {
+            entries.erase(it->second);
+            index.erase(it);
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        reply = it->second->reply;
+        return true;
+    }
+    
+    void store(const std::string& key, const std::string& reply, Clock::time_point now = Clock::now()) {
+        if (max_entries == 0 || reply.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->second->reply = reply;
+            it->second->stored = now;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        
+        entries.push_front({key, reply, now});
+        index[key] = entries.begin();
+        while (entries.size() > max_entries) {
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+    
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+    }
+};
+
+// Questions answered from the clock or the system information instead of
+// the language model, which only knows the time the prompt was built
+enum class QuickIntent {
+    None,
+    Time,
+    Date,
+    System
+};
+
+inline QuickIntent match_quick_intent(const std::string& transcript) {
+    static const std::unordered_set<std::string> time_questions = {
+        "what time is it", "what time is it now", "what's the time", "what is the time",
+        "tell me the time", "what's the time now", "what is the time now",
+        "do you know what time it is", "can you tell me the time", "what time is it right now"
+    };
+    static const std::unordered_set<std::string> date_questions = {
+        "what's the date", "what is the date", "what's today's date", "what is today's date",
+        "what's the date today", "what is the date today", "what day is it", "what day is it today",
+        "what day is today", "tell me the date", "can you tell me the date", "what's today"
+    };
+    static const std::unordered_set<std::string> system_questions = {
+        "what system are you running on", "what are you running on", "what computer are you running on",
+        "what hardware are you running on", "what machine are you running on"
+    };
+    
+    const std::string key = ResponseCache::normalize(transcript);
+    if (time_questions.count(key)) return QuickIntent::Time;
+    if (date_questions.count(key)) return QuickIntent::Date;
+    if (system_questions.count(key)) return QuickIntent::System;
+    return QuickIntent::None;
+}
+
+// Spoken answer to a quick intent, e.g. "It's 3:07 PM." or "Today is
+// Wednesday, October 14, 2026."
+inline std::string answer_quick_intent(QuickIntent intent, const SystemInfo& info, std::time_t now = std::time(nullptr)) {
+    std::tm local{};
+    localtime_r(&now, &local);
+    char buffer[64];
+    
+    switch (intent) {
+        case QuickIntent::Time: {
+            std::strftime(buffer, sizeof(buffer), "%I:%M %p", &local);
+            std::string time = buffer;
+            if (time[0] == '0') {
+                time.erase(0, 1); // "3:07 PM" rather than "03:07 PM"
+            }
+            return "It's " + time + ".";
+        }
+        case QuickIntent::Date: {
+            std::strftime(buffer, sizeof(buffer), "%A, %B ", &local);
+            return "Today is " + std::string(buffer) + std::to_string(local.tm_mday) + ", " +
+                   std::to_string(local.tm_year + 1900) + ".";
+        }
+        case QuickIntent::System: {
+            if (info.os_info.empty()) {
+                return "";
+            }
+            std::string reply = "I'm running on " + info.os_info;
+            if (!info.cpu_info.empty()) {
+                reply += " with " + info.cpu_info;
+            }
+            if (!info.memory_info.empty()) {
+                reply += " and " + info.memory_info;
+            }
+            return reply + ".";
+        }
+        case QuickIntent::None:
+            break;
+    }
+    return "";
+}
+
+// Replies the assistant can give without the language model: quick intents
+// first, then the response cache. Keys include the model and personality
+// the client was configured with.
+class QuickReplies {
+private:
+    ResponseCacheConfig config;
+    std::string model;
+    std::string system_prompt;
+    SystemInfo system_info;
+    ResponseCache cache;
+
+public:
+    QuickReplies(const ResponseCacheConfig& cfg, const OllamaConfig& ollama, const SystemInfo& info)
+        : config(cfg), model(ollama.model), system_prompt(ollama.system_prompt), system_info(info),
+          cache(cfg.max_entries > 0 ? static_cast<size_t>(cfg.max_entries) : 0, std::chrono::seconds(cfg.ttl_s)) {}
+    
+    bool is_enabled() const {
+        return config.enabled || config.quick_intents;
+    }
+    
+    // Find a reply to transcript. from_cache tells whether it is a cached
+    // reply, which is the same every time, rather than an intent's answer.
+    bool find(const std::string& transcript, std::string& reply, bool* from_cache = nullptr) {
+        if (config.quick_intents) {
+            std::string answer = answer_quick_intent(match_quick_intent(transcript), system_info);
+            if (!answer.empty()) {
+                reply = answer;
+                if (from_cache) *from_cache = false;
+                return true;
+            }
+        }
+        if (config.enabled && cache.find(ResponseCache::make_key(transcript, model, system_prompt), reply)) {
+            if (from_cache) *from_cache = true;
+            return true;
+        }
+        return false;
+    }
+    
+    // Cache the language model's complete reply to transcript
+    void remember(const std::string& transcript, const std::string& reply) {
+        if (config.enabled) {
+            cache.store(ResponseCache::make_key(transcript, model, system_prompt), reply);
+        }
+    }
+    
+    // How many cached replies may keep their synthesized speech
+    size_t kept_audio_limit() const {
+        return config.enabled && config.keep_audio && config.max_entries > 0 ? static_cast<size_t>(config.max_entries) : 0;
+    }
+    
+    size_t cached_count() {
+        return cache.size();
+    }
+};
+
+#endif // RESPONSE_CACHE_H
@@ -0,0 +1,188 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// Fixed-capacity single-producer/single-consumer history buffer.
+// The producer appends without ever blocking or allocating, overwriting the
+// oldest samples once the buffer is full. Samples are addressed by their
+// absolute position in the stream, so a reader can remember where an
+// utterance started and copy it out later.
+template <typename T>
+class SpscRingBuffer {
+private:
+    std::vector<T> storage;
+    size_t capacity_ = 0;
+    std::atomic<uint64_t> write_pos{0}; // Total number of samples ever written
+    std::atomic<uint64_t> writing_pos{0}; // End of the write in progress, published before it starts
+
+public:
+    // Up to two contiguous pieces covering a range of the buffer
+    struct Span {
+        const T* first = nullptr;
+        size_t first_size = 0;
+        const T* second = nullptr;
+        size_t second_size = 0;
+
+        size_t size() const { return first_size + second_size; }
+
+        // Copy both pieces into a contiguous destination
+        void copy_to(T* dest) const {
+            std::copy(first, first + first_size, dest);
+            std::copy(second, second + second_size, dest + first_size);
+        }
+    };
+
+    explicit SpscRingBuffer(size_t capacity = 0) {
+        reset(capacity);
+    }
+
+    // Resize and clear the buffer. Not thread-safe: only call while neither
+    // the producer nor the consumer is active.
+    void reset(size_t capacity) {
+        if (capacity != capacity_) {
+            storage.assign(capacity, T());
+            capacity_ = capacity;
+        }
+        writing_pos.store(0, std::memory_order_relaxed);
+        write_pos.store(0, std::memory_order_release);
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // Absolute position one past the newest sample
+    uint64_t write_position() const {
+        return write_pos.load(std::memory_order_acquire);
+    }
+
+    // Absolute position of the oldest sample still held
+    uint64_t oldest_position() const {
+        uint64_t end = write_position();
+        return end > capacity_ ? end - capacity_ : 0;
+    }
+
+    // Number of samples currently held
+    size_t size() const {
+        return static_cast<size_t>(write_position() - oldest_position());
+    }
+
+    // Producer: append samples, overwriting the oldest ones when full
+    void write(const T* data, size_t count) {
+        if (capacity_ == 0 || count == 0) {
+            return;
+        }
+
+        uint64_t pos = write_pos.load(std::memory_order_relaxed);
+
+        // Only the newest capacity_ samples can survive a very large write
+        if (count > capacity_) {
+            data += count - capacity_;
+            pos += count - capacity_;
+            count = capacity_;
+        }
+
+        // Announce the samples about to be overwritten, so a reader that
+        // copies them meanwhile can tell. The fence keeps the marker ahead
+        // of the data.
+        writing_pos.store(pos + count, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        size_t index = static_cast<size_t>(pos % capacity_);
+        size_t first = std::min(count, capacity_ - index);
+        std::copy(data, data + first, storage.begin() + index);
+        std::copy(data + first, data + count, storage.begin());
+
+        write_pos.store(pos + count, std::memory_order_release);
+    }
+
+    // View the samples in [start, end). The range must still be held; the
+    // producer can read its own history this way without copying.
+    Span span(uint64_t start, uint64_t end) const {
+        Span result;
+        if (capacity_ == 0 || end <= start) {
+            return result;
+        }
+
+        size_t count = static_cast<size_t>(end - start);
+        size_t index = static_cast<size_t>(start % capacity_);
+        result.first = storage.data() + index;
+        result.first_size = std::min(count, capacity_ - index);
+        result.second = storage.data();
+        result.second_size = count - result.first_size;
+        return result;
+    }
+
+    // Consumer: copy the samples in [start, end) into out. Returns false if
+    // the producer overwrote part of the range before the copy finished,
+    // including a write that was still in progress.
+    bool copy(uint64_t start, uint64_t end, std::vector<T>& out) const {
+        out.clear();
+        if (end <= start) {
+            return true;
+        }
+        if (start < oldest_position()) {
+            return false;
+        }
+
+        Span view = span(start, end);
+        out.resize(view.size());
+        view.copy_to(out.data());
+
+        // The oldest part of the range may have been overwritten while
+        // copying. Checked against the write in progress, not the finished
+        // ones, since a write that started during the copy may not be done.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return writing_pos.load(std::memory_order_relaxed) - start <= capacity_;
+    }
+};
+
+// Fixed-capacity lock-free single-producer/single-consumer queue.
+// push() fails instead of overwriting when the queue is full.
+template <typename T>
+class SpscQueue {
+private:
+    std::vector<T> slots;
+    std::atomic<size_t> head{0}; // Next slot to read (owned by the consumer)
+    std::atomic<size_t> tail{0}; // Next slot to write (owned by the producer)
+
+public:
+    // One slot is kept free to tell a full queue from an empty one
+    explicit SpscQueue(size_t capacity) : slots(capacity + 1) {}
+
+    bool push(const T& item) {
+        size_t current_tail = tail.load(std::memory_order_relaxed);
+        size_t next_tail = (current_tail + 1) % slots.size();
+        if (next_tail == head.load(std::memory_order_acquire)) {
+            return false; // Full
+        }
+        slots[current_tail] = item;
+        tail.store(next_tail, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t current_head = head.load(std::memory_order_relaxed);
+        if (current_head == tail.load(std::memory_order_acquire)) {
+            return false; // Empty
+        }
+        item = slots[current_head];
+        head.store((current_head + 1) % slots.size(), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    // Drop all items. Not thread-safe: only call while the queue is idle.
+    void clear() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,174 @@
+#ifndef SESSION_MANAGER_H
+#define SESSION_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <csignal>
+#include <cstdint>
+
+// Runs the conversations of several rooms or clients in one process. Each
+// session has a thread of its own that runs one conversation after another:
+// when the user says goodbye the next conversation starts, until the running
+// flag is cleared. One that fails, e.g. because its microphone is unplugged,
+// is retried after a delay that doubles up to max_restart_delay_ms.
+class SessionManager {
+public:
+    enum class Outcome {
+        Ended,  // Over normally, e.g. the user said goodbye; the next one starts right away
+        Failed, // Could not be held, e.g. no audio; retried after a delay
+        Stopped // The session cannot have another, e.g. its recording has been played through
+    };
+    
+    // Runs one conversation and returns when it is over
+    using Conversation = std::function<Outcome()>;
+    
+    // Answered turns so far, for the throughput summary
+    using TurnCounter = std::function<uint64_t()>;
+
+private:
+    struct Session {
+        std::string name;
+        Conversation conversation;
+        TurnCounter turns;
+        std::atomic<uint64_t> conversations{0};
+        std::thread thread;
+    };
+    
+    const volatile sig_atomic_t* running_flag;
+    int restart_delay_ms;
+    int max_restart_delay_ms;
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::chrono::steady_clock::time_point started_at;
+    
+    // Sleep for ms, or less if the running flag is cleared
+    void pause(int ms) const {
+        auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while (*running_flag && std::chrono::steady_clock::now() < until) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(ms, 50)));
+        }
+    }
+    
+    void run(Session& session) const {
+        int delay_ms = restart_delay_ms;
+        while (*running_flag) {
+            const Outcome outcome = session.conversation();
+            session.conversations++;
+            if (outcome == Outcome::Stopped || !*running_flag) {
+                break;
+            }
+            
+            if (outcome == Outcome::Ended) {
+                delay_ms = restart_delay_ms;
+            } else {
+                std::cerr << "Warning: Session " << session.name << " failed, restarting in "
+                          << delay_ms << " ms" << std::endl;
+                pause(delay_ms);
+                delay_ms = std::min(delay_ms * 2, max_restart_delay_ms);
+            }
+        }
+    }
+
+public:
+    explicit SessionManager(const volatile sig_atomic_t* running, int restart_ms = 1000, int max_restart_ms = 30000)
+        : running_flag(running), restart_delay_ms(std::max(restart_ms, 1)),
+          max_restart_delay_ms(std::max(max_restart_ms, restart_delay_ms)) {}
+    
+    ~SessionManager() {
+        join();
+    }
+    
+    SessionManager(const SessionManager&) = delete;
+    SessionManager& operator=(const SessionManager&) = delete;
+    
+    // Add a session; call before start()
+    void add(const std::string& name, Conversation conversation, TurnCounter turns = nullptr) {
+        auto session = std::make_unique<Session>();
+        session->name = name;
+        session->conversation = std::move(conversation);
+        session->turns = std::move(turns);
+        sessions.push_back(std::move(session));
+    }
+    
+    // Start every session on its own thread
+    void start() {
+        started_at = std::chrono::steady_clock::now();
+        for (auto& session : sessions) {
+            if (!session->thread.joinable()) {
+                Session* s = session.get();
+                session->thread = std::thread([this, s] { run(*s); });
+            }
+        }
+    }
+    
+    // Wait until every session has stopped. The running flag has to be
+    // cleared, and whatever a conversation waits on interrupted, for that.
+    void join() {
+        for (auto& session : sessions) {
+            if (session->thread.joinable()) {
+                session->thread.join();
+            }
+        }
+    }
+    
+    size_t size() const {
+        return sessions.size();
+    }
+    
+    // Conversations finished by the session at index
+    uint64_t conversation_count(size_t index) const {
+        return sessions[index]->conversations.load();
+    }
+    
+    uint64_t turn_count() const {
+        uint64_t total = 0;
+        for (const auto& session : sessions) {
+            if (session->turns) total += session->turns();
+        }
+        return total;
+    }
+    
+    // Turns and conversations of each session, and the turns answered per
+    // CPU-hour over all sessions, so a server can be sized by its cores
+    std::string summary(size_t cpus) const {
+        const double hours = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count() / 3600.0;
+        std::ostringstream out;
+        out << "Served " << sessions.size() << " session(s) for " << std::fixed << std::setprecision(2)
+            << hours * 60.0 << " min:\n";
+        for (const auto& session : sessions) {
+            out << "  " << std::left << std::setw(16) << session->name << std::right
+                << " turns=" << (session->turns ? session->turns() : 0)
+                << " conversations=" << session->conversations.load() << "\n";
+        }
+        if (hours > 0.0 && cpus > 0) {
+            out << "  " << std::setprecision(1) << turn_count() / (hours * static_cast<double>(cpus))
+                << " turns per CPU-hour on " << cpus << " CPU(s)\n";
+        }
+        return out.str();
+    }
+};
+
+// path with the session name before its extension, e.g. "metrics.jsonl"
+// becomes "metrics.kitchen.jsonl", so sessions do not write the same file.
+// Empty paths stay empty.
+inline std::string session_file_path(const std::string& path, const std::string& session) {
+    if (path.empty()) {
+        return path;
+    }
+    const size_t slash = path.find_last_of('/');
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot == slash + 1) {
+        return path + "." + session;
+    }
+    return path.substr(0, dot) + "." + session + path.substr(dot);
+}
+
+#endif // SESSION_MANAGER_H
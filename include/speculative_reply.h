@@ -0,0 +1,217 @@
+#ifndef SPECULATIVE_REPLY_H
+#define SPECULATIVE_REPLY_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <cctype>
+#include <cstdint>
+
+// Starts the reply to a partial transcript while the user is still pausing,
+// before the end of the utterance has been detected. The sentences it
+// produces are held back; if the final transcript turns out to be the same,
+// the reply stage adopts them and carries on from there, otherwise the
+// request is cancelled and thrown away.
+class SpeculativeReply {
+public:
+    using SentenceCallback = std::function<void(const std::string&)>;
+    // Generates the reply to a prompt, passing each sentence on as it is
+    // ready, and returns the whole reply (e.g. OllamaClient::process_streaming).
+    // The token comes from RequestToken.
+    using Generate = std::function<std::string(const std::string&, const SentenceCallback&, uint64_t)>;
+    // Taken on the thread that starts a reply, before generate runs, so
+    // cancelling the token stops it even if it has not got going yet
+    // (e.g. OllamaClient::request_token)
+    using RequestToken = std::function<uint64_t()>;
+    // Aborts the generate given the token, from another thread (e.g. OllamaClient::cancel)
+    using Cancel = std::function<void(uint64_t)>;
+
+private:
+    Generate generate;
+    RequestToken request_token;
+    Cancel cancel_request;
+    std::function<void()> forget_reply;   // Undoes a discarded generate, e.g. drops it from the history
+    
+    std::mutex control_mutex;            // Serializes start, adopt and discard
+    std::thread worker;
+    uint64_t token = 0;                  // Of the reply in progress
+    bool paused = false;
+    
+    std::mutex mutex;                    // Shared with the worker
+    std::string prompt;                  // What the reply in progress answers
+    std::vector<std::string> held;       // Sentences nobody has taken yet
+    SentenceCallback sink;               // Receives sentences once adopted
+    std::string result;
+    
+    void run(std::string text, uint64_t request) {
+        std::string reply = generate(text, [this](const std::string& sentence) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (sink) {
+                sink(sentence);
+            } else {
+                held.push_back(sentence);
+            }
+        }, request);
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        result = std::move(reply);
+    }
+    
+    // Clear the state of a joined worker and return its reply
+    std::string take_result() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string reply = std::move(result);
+        prompt.clear();
+        held.clear();
+        sink = nullptr;
+        result.clear();
+        return reply;
+    }
+    
+    // Cancel the worker and wait for it. Needs control_mutex.
+    void discard_locked() {
+        if (!worker.joinable()) {
+            return;
+        }
+        cancel_request(token);
+        worker.join();
+        take_result();
+        forget_reply();
+    }
+
+public:
+    SpeculativeReply(Generate generate_reply, RequestToken take_token, Cancel cancel, std::function<void()> forget)
+        : generate(std::move(generate_reply)), request_token(std::move(take_token)), cancel_request(std::move(cancel)),
+          forget_reply(std::move(forget)) {}
+    
+    ~SpeculativeReply() {
+        discard();
+    }
+    
+    SpeculativeReply(const SpeculativeReply&) = delete;
+    SpeculativeReply& operator=(const SpeculativeReply&) = delete;
+    
+    // Compare transcripts ignoring case, punctuation and spacing, which is
+    // what usually changes between the last partial and the final text
+    static std::string match_key(const std::string& text) {
+        std::string key;
+        bool pending_space = false;
+        for (char c : text) {
+            unsigned char uc = static_cast<unsigned char>(c);
+            if (std::isalnum(uc) || c == '\'') {
+                if (pending_space && !key.empty()) {
+                    key += ' ';
+                }
+                pending_space = false;
+                key += static_cast<char>(std::tolower(uc));
+            } else if (std::isspace(uc)) {
+                pending_space = true;
+            }
+        }
+        return key;
+    }
+    
+    // Start replying to text in the background. A reply to a different
+    // prompt is discarded first. Returns false if paused or already
+    // replying to the same prompt.
+    bool start(const std::string& text) {
+        const std::string key = match_key(text);
+        std::lock_guard<std::mutex> control(control_mutex);
+        if (paused || key.empty()) {
+            return false;
+        }
+        if (worker.joinable()) {
+            std::string current;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current = prompt;
+            }
+            if (match_key(current) == key) {
+                return false;
+            }
+            discard_locked();
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            prompt = text;
+        }
+        token = request_token();
+        worker = std::thread(&SpeculativeReply::run, this, text, token);
+        return true;
+    }
+    
+    // Cancel and forget the reply in progress, if any
+    void discard() {
+        std::lock_guard<std::mutex> control(control_mutex);
+        discard_locked();
+    }
+    
+    // Cancel and forget the reply in progress, unless a turn is being
+    // answered and may still adopt it. For when the partial transcript
+    // changes and the reply no longer fits.
+    void invalidate() {
+        std::lock_guard<std::mutex> control(control_mutex);
+        if (!paused) {
+            discard_locked();
+        }
+    }
+    
+    // Take over the reply if it answers text: the held sentences and those
+    // still to come go to on_sentence, then this waits for the reply and
+    // stores it in reply. Otherwise the reply is discarded and false
+    // returned. Call while paused, so no new reply starts meanwhile.
+    bool adopt(const std::string& text, const SentenceCallback& on_sentence, std::string& reply) {
+        std::thread running;
+        {
+            std::lock_guard<std::mutex> control(control_mutex);
+            if (!worker.joinable()) {
+                return false;
+            }
+            
+            bool matches;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                matches = match_key(prompt) == match_key(text);
+                if (matches) {
+                    for (const auto& sentence : held) {
+                        on_sentence(sentence);
+                    }
+                    held.clear();
+                    sink = on_sentence;
+                }
+            }
+            if (!matches) {
+                discard_locked();
+                return false;
+            }
+            running = std::move(worker);
+        }
+        
+        // Wait without holding the lock, so invalidate() is not held up
+        running.join();
+        reply = take_result();
+        return true;
+    }
+    
+    // Stop new replies from starting, e.g. while a turn is being answered
+    void pause() {
+        std::lock_guard<std::mutex> control(control_mutex);
+        paused = true;
+    }
+    
+    void resume() {
+        std::lock_guard<std::mutex> control(control_mutex);
+        paused = false;
+    }
+    
+    // Check if a reply has been started and not yet adopted or discarded
+    bool is_active() {
+        std::lock_guard<std::mutex> control(control_mutex);
+        return worker.joinable();
+    }
+};
+
+#endif // SPECULATIVE_REPLY_H
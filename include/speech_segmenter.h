@@ -0,0 +1,360 @@
+#ifndef SPEECH_SEGMENTER_H
+#define SPEECH_SEGMENTER_H
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include "vad.h"
+#include "config.h"
+
+// VAD (Voice Activity Detection) parameters
+struct VADParams {
+    float threshold = 0.6f;       // Voice activation threshold (0.0 to 1.0)
+    float freq_threshold = 100.0f; // Frequency threshold for speech detection
+    int min_speech_ms = 300;      // Minimum speech duration in ms to be considered valid
+    int max_silence_ms = 1000;    // Maximum silence duration in ms before stopping capture
+    int padding_ms = 500;         // Padding at the beginning and end of speech segments
+    int buffer_history_ms = 5000; // How much audio history to keep for context (5 seconds)
+    int max_speech_ms = 30000;    // Longest utterance before capture is cut off
+    int window_ms = 500;          // Length of the VAD analysis window
+    int hop_ms = 100;             // How often the VAD makes a decision
+    int echo_tail_ms = 300;       // Audio still ignored after the echo gate opens
+    float barge_in_threshold = 0.01f; // Energy needed to talk over the assistant
+    int barge_in_min_ms = 200;    // Speech needed while the gate is closed to count as barge-in
+    float speech_probability = 0.5f; // Needed from the speech classifier, if one is set
+};
+
+// VAD parameters from the streaming section of the configuration
+inline VADParams make_vad_params(const StreamingConfig& streaming) {
+    VADParams vad_params;
+    vad_params.threshold = streaming.vad_threshold;
+    vad_params.freq_threshold = streaming.vad_freq_threshold;
+    vad_params.min_speech_ms = streaming.min_speech_ms;
+    vad_params.max_silence_ms = streaming.max_silence_ms;
+    vad_params.padding_ms = streaming.padding_ms;
+    vad_params.buffer_history_ms = streaming.buffer_history_ms;
+    vad_params.max_speech_ms = streaming.max_speech_ms;
+    vad_params.window_ms = streaming.vad_window_ms;
+    vad_params.hop_ms = streaming.vad_hop_ms;
+    vad_params.echo_tail_ms = streaming.echo_tail_ms;
+    vad_params.barge_in_threshold = streaming.barge_in_threshold;
+    vad_params.barge_in_min_ms = streaming.barge_in_min_ms;
+    vad_params.speech_probability = streaming.vad_speech_threshold;
+    return vad_params;
+}
+
+// Splits a stream of captured audio into utterances. Samples are addressed by
+// their absolute position in the capture stream (the capture ring's write
+// position), and every VAD hop updates a small state machine that reports
+// where utterances start and end. It has no audio device or threads of its
+// own, so the capture thread and offline tools share the same logic.
+class SpeechSegmenter {
+public:
+    enum class Event {
+        Started, // Speech began; start is where the utterance will begin
+        Ended,   // The utterance [start, end) is complete
+        Split,   // The utterance [start, end) hit max_speech_ms; a new one starts at end
+        Dropped, // The echo gate closed while speaking; the utterance is gone
+        BargeIn  // Speech over the closed echo gate; a new utterance starts at start
+    };
+    
+    // State of the echo gate when a chunk was captured
+    struct EchoGate {
+        bool closed = false;
+        uint64_t release_pos = 0; // Stream position where the gate last opened, 0 if never
+    };
+
+private:
+    VADParams params;
+    int rate;
+    size_t history_capacity;     // Samples of history kept before the newest
+    bool debug_enabled;
+    bool barge_in_enabled = false;
+    VoiceActivityDetector vad;
+    int hop_frames;
+    
+    int padding_frames;
+    int min_speech_frames;
+    int max_silence_frames;
+    int max_speech_frames;
+    size_t buffer_history_frames;
+    uint64_t echo_tail_frames;
+    int barge_in_min_frames;
+    
+    // Detection state
+    bool was_speaking = false;   // Was speaking in previous hop
+    int silence_frames = 0;      // Consecutive silence frames
+    int speech_frames = 0;       // Consecutive speech frames
+    int barge_in_frames = 0;     // Consecutive loud speech frames while gated
+    uint64_t barge_in_start = 0; // Position where that speech began
+    uint64_t segment_start = 0;  // Position where the current utterance starts
+    
+    // Update the state machine with one VAD decision covering hop_frames,
+    // where write_pos is the stream position at the end of that hop
+    template <typename Callback>
+    void handle_decision(bool is_speech, uint64_t write_pos, EchoGate& gate, Callback& on_event) {
+        // While the echo gate is closed, or its window still holds playback audio,
+        // nothing counts as speech
+        const uint64_t gate_end = gate.release_pos > 0 ? gate.release_pos + echo_tail_frames : 0;
+        
+        // Only speech well above the assistant's echo may interrupt it
+        if (gate.closed && barge_in_enabled && is_speech &&
+            vad.get_stats().energy > params.barge_in_threshold) {
+            if (barge_in_frames == 0) {
+                barge_in_start = write_pos - std::min<uint64_t>(write_pos, vad.get_window_size());
+            }
+            barge_in_frames += hop_frames;
+            
+            if (barge_in_frames >= barge_in_min_frames) {
+                if (debug_enabled) {
+                    std::cout << "Info: Barge-in detected, interrupting the reply" << std::endl;
+                }
+                
+                // The user's speech starts a new utterance right away, and the
+                // gate counts as open from here on
+                gate.closed = false;
+                was_speaking = true;
+                speech_frames = barge_in_frames;
+                silence_frames = 0;
+                barge_in_frames = 0;
+                segment_start = std::max(barge_in_start, oldest_position(write_pos));
+                on_event(Event::BargeIn, segment_start, write_pos);
+                return;
+            }
+        } else {
+            barge_in_frames = 0;
+        }
+        
+        if (gate.closed || (gate_end > 0 && write_pos < gate_end + vad.get_window_size())) {
+            if (was_speaking) {
+                // Drop the utterance; it is most likely the assistant's own voice
+                if (debug_enabled) {
+                    std::cout << "Debug: Echo gate closed, dropping speech in progress" << std::endl;
+                }
+                was_speaking = false;
+                on_event(Event::Dropped, segment_start, write_pos);
+            }
+            speech_frames = 0;
+            silence_frames = 0;
+            return;
+        }
+        
+        if (is_speech) {
+            speech_frames += hop_frames;
+            silence_frames = 0;
+            
+            if (!was_speaking && speech_frames >= min_speech_frames) {
+                // Speech start detected
+                if (debug_enabled) {
+                    std::cout << "Info: Speech detected" << std::endl;
+                }
+                was_speaking = true;
+                
+                // When speech starts, include audio from before it with ample padding
+                // Instead of just using padding_frames, use at least 50% of the available history
+                const size_t history_size = std::min<size_t>(
+                    std::min<uint64_t>(write_pos, history_capacity), buffer_history_frames);
+                size_t half_buffer = history_size / 2;
+                size_t padding_frames_size = static_cast<size_t>(padding_frames);
+                size_t extended_padding = std::max(padding_frames_size, half_buffer);
+                
+                // But don't go beyond the start of the history, or back into gated audio
+                extended_padding = std::min(extended_padding, history_size);
+                segment_start = std::max(write_pos - extended_padding, gate_end);
+                
+                // Log how much context we're including
+                if (debug_enabled) {
+                    float context_seconds = static_cast<float>(extended_padding) / rate;
+                    std::cout << "Debug: Including " << context_seconds << " seconds of audio context" << std::endl;
+                }
+                on_event(Event::Started, segment_start, write_pos);
+            } else if (was_speaking && write_pos - segment_start >= static_cast<uint64_t>(max_speech_frames)) {
+                // Utterance is too long for the ring, hand over what we have
+                std::cerr << "Warning: Speech exceeded " << params.max_speech_ms
+                          << " ms, processing it now" << std::endl;
+                on_event(Event::Split, segment_start, write_pos);
+                
+                // Carry on as a new utterance starting here
+                segment_start = write_pos;
+            }
+        } else {
+            // Not speech
+            silence_frames += hop_frames;
+            
+            if (was_speaking) {
+                // Check if silence has been detected for max_silence_ms milliseconds
+                // Or if silence detected after at least 1 second of speech
+                bool long_enough_speech = speech_frames > rate; // At least 1 second of speech
+                bool silence_detected = silence_frames >= max_silence_frames;
+                bool speech_followed_by_short_silence = long_enough_speech && silence_frames >= (max_silence_frames / 3);
+                
+                if (silence_detected || speech_followed_by_short_silence) {
+                    // Speech end detected
+                    if (debug_enabled) {
+                        std::cout << "Info: Speech ended after " << speech_frames * 1000 / rate << " ms "
+                                  << "(silence: " << silence_frames * 1000 / rate << " ms)" << std::endl;
+                        
+                        if (speech_followed_by_short_silence && !silence_detected) {
+                            std::cout << "Info: Detected end of speech due to short silence after long speech" << std::endl;
+                        }
+                        
+                        // The utterance runs up to the newest sample, so the trailing
+                        // silence is included as end padding
+                        float padding_seconds = static_cast<float>(silence_frames) / rate;
+                        std::cout << "Debug: Adding " << padding_seconds << " seconds of end padding" << std::endl;
+                    }
+                    
+                    // Reset state
+                    was_speaking = false;
+                    speech_frames = 0;
+                    on_event(Event::Ended, segment_start, write_pos);
+                }
+            } else {
+                // Reset detection if we've been silent too long
+                speech_frames = 0;
+            }
+        }
+    }
+    
+    uint64_t oldest_position(uint64_t write_pos) const {
+        return write_pos - std::min<uint64_t>(write_pos, history_capacity);
+    }
+
+public:
+    // history_capacity is how many samples before the newest are still
+    // available (the capture ring's capacity); utterances never start earlier
+    SpeechSegmenter(const VADParams& vad_params, int sample_rate, size_t history_capacity, bool debug = false)
+        : params(vad_params), rate(sample_rate), history_capacity(history_capacity), debug_enabled(debug),
+          vad(sample_rate, vad_params.window_ms, vad_params.hop_ms, vad_params.threshold, vad_params.freq_threshold, debug) {
+        hop_frames = static_cast<int>(vad.get_hop_size());
+        padding_frames = params.padding_ms * rate / 1000;
+        min_speech_frames = params.min_speech_ms * rate / 1000;
+        max_silence_frames = params.max_silence_ms * rate / 1000;
+        max_speech_frames = params.max_speech_ms * rate / 1000;
+        buffer_history_frames = (static_cast<size_t>(params.buffer_history_ms) * rate) / 1000;
+        // Once the echo gate opens, wait out the echo tail and a full VAD window of fresh audio
+        echo_tail_frames = static_cast<uint64_t>(params.echo_tail_ms) * rate / 1000;
+        barge_in_min_frames = params.barge_in_min_ms * rate / 1000;
+    }
+    
+    // Use a trained classifier for windows that pass the energy gate
+    void set_classifier(SpeechClassifier* classifier) {
+        vad.set_classifier(classifier, params.speech_probability);
+    }
+    
+    // Report barge-in while the echo gate is closed
+    void set_barge_in_enabled(bool enabled) { barge_in_enabled = enabled; }
+    
+    // Feed count new samples starting at stream position chunk_start.
+    // on_event(Event, start, end) is called for every utterance boundary.
+    template <typename Callback>
+    void process(const float* samples, size_t count, uint64_t chunk_start, EchoGate gate, Callback on_event) {
+        vad.process(samples, count, [&](bool is_speech, size_t offset) {
+            handle_decision(is_speech, chunk_start + offset, gate, on_event);
+        });
+    }
+    
+    // The stream ended at write_pos: an utterance still in progress is
+    // reported as Ended there instead of waiting for trailing silence
+    template <typename Callback>
+    void finish(uint64_t write_pos, Callback on_event) {
+        if (was_speaking) {
+            was_speaking = false;
+            speech_frames = 0;
+            silence_frames = 0;
+            on_event(Event::Ended, segment_start, write_pos);
+        }
+    }
+
+    // Forget the current utterance and all VAD history
+    void reset() {
+        vad.reset();
+        was_speaking = false;
+        silence_frames = 0;
+        speech_frames = 0;
+        barge_in_frames = 0;
+        segment_start = 0;
+    }
+    
+    bool is_speaking() const { return was_speaking; }
+    size_t get_hop_size() const { return vad.get_hop_size(); }
+    size_t get_window_size() const { return vad.get_window_size(); }
+    const VoiceActivityDetector& detector() const { return vad; }
+};
+
+// The echo gate as shared by the thread that plays replies and the capture
+// thread. The capture thread segments each chunk with a snapshot, so by the
+// time it reports barge-in the gate may have been opened; barge_in() checks
+// the live gate, under the same lock as open() and take_barge_in(), so a
+// late barge-in can neither cancel the next reply nor go unnoticed.
+class SharedEchoGate {
+private:
+    std::mutex mutex;
+    std::atomic<bool> closed{false};
+    std::atomic<uint64_t> release_pos{0};
+    bool barged_in = false;
+
+public:
+    // Open, and forget any barge-in. Only while capture is stopped.
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed.store(false);
+        release_pos.store(0);
+        barged_in = false;
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed.store(true);
+    }
+    
+    // Open the gate at stream position. Returns false if it was already
+    // open, e.g. after barge-in, when the user is speaking and the position
+    // is left alone.
+    bool open(uint64_t position) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!closed.load()) {
+            return false;
+        }
+        closed.store(false);
+        release_pos.store(position);
+        return true;
+    }
+    
+    // The state to segment the next chunk with
+    SpeechSegmenter::EchoGate snapshot() const {
+        SpeechSegmenter::EchoGate gate;
+        gate.closed = closed.load();
+        gate.release_pos = release_pos.load();
+        return gate;
+    }
+    
+    // Capture thread, on Event::BargeIn: if the gate is still closed, open
+    // it, call on_barge_in (which must be quick) and return true. Returns
+    // false if the gate was opened meanwhile, so the speech is an ordinary
+    // utterance and the reply that was playing is over.
+    template <typename Callback>
+    bool barge_in(Callback on_barge_in) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!closed.load()) {
+            return false;
+        }
+        closed.store(false);
+        barged_in = true;
+        on_barge_in();
+        return true;
+    }
+    
+    // Check and clear whether barge-in happened since the last call
+    bool take_barge_in() {
+        std::lock_guard<std::mutex> lock(mutex);
+        const bool happened = barged_in;
+        barged_in = false;
+        return happened;
+    }
+};
+
+#endif // SPEECH_SEGMENTER_H
@@ -0,0 +1,208 @@
+#ifndef SPEECH_SYNTHESIZER_H
+#define SPEECH_SYNTHESIZER_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "config.h"
+
+// Destination for synthesized 16-bit mono PCM, e.g. a playback device
+class PcmSink {
+public:
+    virtual ~PcmSink() = default;
+    
+    // Get ready to receive audio at the given sample rate. Called before
+    // every utterance; a long-lived device only reconfigures if the rate changed.
+    virtual bool begin(int sample_rate) = 0;
+    
+    // Queue samples for playback, blocking while the device buffer is full.
+    // Returns false if the samples could not be written.
+    virtual bool write(const int16_t* samples, size_t count) = 0;
+    
+    // Wait for everything written so far to finish playing
+    virtual void drain() = 0;
+    
+    // Throw away any audio that has not been played yet
+    virtual void drop() = 0;
+    
+    // Like drain(), but drops the rest if cancelled becomes true while
+    // waiting. Returns false if playback was cut off.
+    virtual bool wait_played(const std::atomic<bool>& cancelled) {
+        if (cancelled.load()) {
+            drop();
+            return false;
+        }
+        drain();
+        return true;
+    }
+    
+    // How many times playback ran dry and had to be restarted. Safe to
+    // call from any thread.
+    virtual uint64_t underrun_count() const { return 0; }
+};
+
+// Sink that keeps the audio in memory instead of playing it
+class BufferSink : public PcmSink {
+public:
+    std::vector<int16_t> samples;
+    int sample_rate = 0;
+    
+    bool begin(int rate) override {
+        sample_rate = rate;
+        return true;
+    }
+    
+    bool write(const int16_t* data, size_t count) override {
+        samples.insert(samples.end(), data, data + count);
+        return true;
+    }
+    
+    void drain() override {}
+    void drop() override {}
+};
+
+// Passes audio on to another sink and calls on_first_write once the first
+// samples have been written, e.g. to time when speech starts playing
+class FirstWriteSink : public PcmSink {
+private:
+    PcmSink& target;
+    std::function<void()> on_first_write;
+    bool written = false;
+
+public:
+    FirstWriteSink(PcmSink& sink, std::function<void()> callback)
+        : target(sink), on_first_write(std::move(callback)) {}
+    
+    bool begin(int rate) override {
+        return target.begin(rate);
+    }
+    
+    bool write(const int16_t* data, size_t count) override {
+        bool ok = target.write(data, count);
+        if (ok && !written && count > 0) {
+            written = true;
+            if (on_first_write) on_first_write();
+        }
+        return ok;
+    }
+    
+    void drain() override { target.drain(); }
+    void drop() override { target.drop(); }
+    
+    bool wait_played(const std::atomic<bool>& cancelled) override {
+        return target.wait_played(cancelled);
+    }
+};
+
+// Passes audio on to another sink and keeps a copy of what was written,
+// e.g. to cache speech while it plays
+class CopyingSink : public PcmSink {
+private:
+    PcmSink& target;
+
+public:
+    BufferSink copy;
+    
+    explicit CopyingSink(PcmSink& sink) : target(sink) {}
+    
+    bool begin(int rate) override {
+        copy.begin(rate);
+        return target.begin(rate);
+    }
+    
+    bool write(const int16_t* data, size_t count) override {
+        copy.write(data, count);
+        return target.write(data, count);
+    }
+    
+    void drain() override { target.drain(); }
+    void drop() override { target.drop(); }
+    
+    bool wait_played(const std::atomic<bool>& cancelled) override {
+        return target.wait_played(cancelled);
+    }
+};
+
+// Turns text into PCM inside the process, without temporary files or
+// external programs
+class SpeechSynthesizer {
+public:
+    virtual ~SpeechSynthesizer() = default;
+    
+    // Synthesize text, passing the audio to sink as it is produced.
+    // Stops early and returns false once cancelled becomes true.
+    virtual bool synthesize(const std::string& text, PcmSink& sink, const std::atomic<bool>& cancelled) = 0;
+    
+    // Sample rate of the audio passed to the sink
+    virtual int sample_rate() const = 0;
+};
+
+// Lets the TTS engines of several sessions use one synthesizer, for
+// libraries like espeak-ng that keep global state. Each text is synthesized
+// into memory under a lock and played after it is released, so playback in
+// one session never holds up synthesis for another.
+class SharedSynthesizer : public SpeechSynthesizer {
+private:
+    struct Shared {
+        std::unique_ptr<SpeechSynthesizer> synthesizer;
+        std::mutex mutex;
+    };
+    std::shared_ptr<Shared> shared;
+    
+    explicit SharedSynthesizer(std::shared_ptr<Shared> state) : shared(std::move(state)) {}
+
+public:
+    // Wrap synthesizer so share() can hand it to more engines
+    explicit SharedSynthesizer(std::unique_ptr<SpeechSynthesizer> synthesizer) : shared(std::make_shared<Shared>()) {
+        shared->synthesizer = std::move(synthesizer);
+    }
+    
+    // Another handle on the same synthesizer
+    std::unique_ptr<SpeechSynthesizer> share() const {
+        return std::unique_ptr<SpeechSynthesizer>(new SharedSynthesizer(shared));
+    }
+    
+    bool synthesize(const std::string& text, PcmSink& sink, const std::atomic<bool>& cancelled) override {
+        BufferSink buffer;
+        buffer.begin(sample_rate());
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (!shared->synthesizer->synthesize(text, buffer, cancelled)) {
+                return false;
+            }
+        }
+        
+        // Write in blocks of 50 ms so a cancel takes effect quickly
+        const size_t block = static_cast<size_t>(std::max(buffer.sample_rate / 20, 1));
+        for (size_t offset = 0; offset < buffer.samples.size(); offset += block) {
+            if (cancelled.load()) {
+                return false;
+            }
+            size_t count = std::min(block, buffer.samples.size() - offset);
+            if (!sink.write(buffer.samples.data() + offset, count)) {
+                return false;
+            }
+        }
+        return !cancelled.load();
+    }
+    
+    int sample_rate() const override {
+        return shared->synthesizer->sample_rate();
+    }
+};
+
+// Synthesizer backed by libespeak-ng. Returns nullptr if the program was
+// built without espeak-ng or it fails to initialize.
+std::unique_ptr<SpeechSynthesizer> create_espeak_synthesizer(const TTSConfig& config);
+
+// Sink that plays through a long-lived ALSA playback handle. The device is
+// opened on first use and kept open between utterances.
+std::unique_ptr<PcmSink> create_alsa_pcm_sink(const std::string& device);
+
+#endif // SPEECH_SYNTHESIZER_H
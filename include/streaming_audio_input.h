@@ -8,42 +8,58 @@
 #include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <chrono>
+#include <memory>
+#include <algorithm>
 #include <csignal>
+#include <cstdint>
 #include "config.h"
+#include "ring_buffer.h"
+#include "speech_segmenter.h"
+#include "audio_source.h"
+#include "thread_scheduling.h"
 
 // Reference to the global running flag from main.cpp
 extern volatile sig_atomic_t g_running;
 
-// VAD (Voice Activity Detection) parameters
-struct VADParams {
-    float threshold = 0.6f;       // Voice activation threshold (0.0 to 1.0)
-    float freq_threshold = 100.0f; // Frequency threshold for speech detection
-    int min_speech_ms = 300;      // Minimum speech duration in ms to be considered valid
-    int max_silence_ms = 1000;    // Maximum silence duration in ms before stopping capture
-    int padding_ms = 500;         // Padding at the beginning and end of speech segments
-    int buffer_history_ms = 5000; // How much audio history to keep for context (5 seconds)
-};
-
 class StreamingAudioInput {
 private:
     AudioConfig config;
     bool debug_enabled = false;
     VADParams vad_params;
+    std::unique_ptr<SpeechClassifier> speech_classifier; // Optional neural VAD stage
+    std::unique_ptr<AudioSource> source; // Created from config.device on first start() unless set
+    std::atomic<bool> input_ended{false}; // The source has no more audio
 
+    // A completed utterance, as absolute positions in the capture ring
+    struct SpeechSegment {
+        uint64_t start = 0;
+        uint64_t end = 0;
+        std::chrono::steady_clock::time_point detected_at; // When the end of speech was detected
+    };
+    
     // Audio buffers
-    std::vector<float> audio_buffer;     // Main audio buffer for processing
-    std::vector<float> capture_buffer;   // Buffer for ongoing capture
+    SpscRingBuffer<float> capture_ring;  // Audio history written by the capture thread
+    SpscQueue<SpeechSegment> segment_queue{8}; // Utterances waiting for wait_for_speech
+    std::atomic<uint64_t> active_segment_start{NO_ACTIVE_SEGMENT}; // Start of the utterance being spoken
+    size_t output_reserve = 0; // Spare samples wait_for_speech allocates after each utterance
     
     // Threading
     std::thread capture_thread;
+    ThreadPolicy capture_policy; // Applied by the capture thread when it starts
     std::mutex buffer_mutex;
     std::condition_variable cv;
     std::atomic<bool> is_capturing{false};
     std::atomic<bool> speech_detected{false};
+    std::atomic<bool> wait_interrupted{false}; // Set by interrupt_wait()
+    
+    // Echo gate: while closed (e.g. during TTS playback) no speech is detected
+    SharedEchoGate echo_gate;
+    
+    // Barge-in: loud speech while the echo gate is closed interrupts the assistant
+    std::function<void()> barge_in_callback;
     
-    // Audio capture method using ALSA/PulseAudio
-    bool start_audio_capture();
-    void stop_audio_capture();
+    // Reads the audio source, then resamples and segments it
     void capture_thread_func();
     
     // VAD functions
@@ -51,8 +67,14 @@ private:
     
     // List available audio devices
     void list_devices();
+    
+    // Number of samples the capture ring needs at the given rate
+    size_t ring_capacity_for_rate(unsigned int rate) const;
 
 public:
+    // Value of active_segment_start while nobody is speaking
+    static constexpr uint64_t NO_ACTIVE_SEGMENT = UINT64_MAX;
+    
     StreamingAudioInput(const AudioConfig& cfg, bool debug = false);
     ~StreamingAudioInput();
     
@@ -60,12 +82,59 @@ public:
     bool start();
     void stop();
     
-    // Wait for speech and return a buffer of audio containing the speech
-    std::vector<float> wait_for_speech(int timeout_ms = 10000);
+    // Wait for speech and return a buffer of audio containing the speech.
+    // utterance_id, if given, receives the same id get_active_speech reported,
+    // and speech_end the time the capture thread detected the end of speech.
+    std::vector<float> wait_for_speech(int timeout_ms = 10000, uint64_t* utterance_id = nullptr,
+                                       std::chrono::steady_clock::time_point* speech_end = nullptr);
+    
+    // Make the current or next wait_for_speech return right away with no
+    // audio, e.g. when another thread decides the conversation is over
+    void interrupt_wait();
+    
+    // Allocate room for ms of audio after each utterance wait_for_speech
+    // returns, so the consumer can pad it in place without reallocating
+    void set_output_reserve_ms(int ms) { output_reserve = static_cast<size_t>(config.sample_rate) * std::max(0, ms) / 1000; }
+    
+    // Copy the utterance that is still being spoken, if any, into out
+    bool get_active_speech(std::vector<float>& out, uint64_t* utterance_id = nullptr) const;
     
     // Check if speech is currently being detected
     bool is_speech_active() const;
     
+    // Close the echo gate while the assistant is speaking so capture can keep
+    // running without transcribing its own voice; open it again afterwards
+    void set_echo_gate(bool closed);
+    
+    // Called on the capture thread when the user talks over the assistant while
+    // the echo gate is closed; the gate then opens and the speech is captured
+    // as a new utterance. Must be quick. Set before start().
+    void set_barge_in_callback(std::function<void()> callback) { barge_in_callback = std::move(callback); }
+    
+    // Check and clear whether barge-in happened since the last call
+    bool take_barge_in() { return echo_gate.take_barge_in(); }
+    
+    // Use a trained classifier for windows that pass the energy gate, instead
+    // of the frequency and activity heuristics. Set before start().
+    void set_speech_classifier(std::unique_ptr<SpeechClassifier> classifier) { speech_classifier = std::move(classifier); }
+    
+    // Capture from source instead of the one audio.device names, e.g. a
+    // recording for offline runs. Set before start().
+    void set_audio_source(std::unique_ptr<AudioSource> audio_source) {
+        source = std::move(audio_source);
+        input_ended.store(false);
+    }
+    
+    // Check if the source has run out of audio, e.g. at the end of a file.
+    // Utterances already found are still returned by wait_for_speech.
+    bool has_input_ended() const { return input_ended.load(); }
+    
+    // Pin the capture thread and raise its priority. Set before start().
+    void set_thread_policy(const ThreadPolicy& policy) { capture_policy = policy; }
+    
+    // How many times the source lost audio because capture fell behind
+    uint64_t get_overrun_count() const { return source ? source->overrun_count() : 0; }
+    
     // Set VAD parameters
     void set_vad_params(const VADParams& params);
     
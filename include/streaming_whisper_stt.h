@@ -5,29 +5,85 @@
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <mutex>
 #include <csignal>
+#include <cstdint>
 #include "config.h"
+#include "whisper_context_pool.h"
 
-// Forward declaration for whisper context to avoid including the full header
-struct whisper_context;
-
+// One transcription session. Sessions can share a WhisperContextPool, so the
+// model is loaded once and sessions for different inputs run in parallel.
 class StreamingWhisperSTT {
 private:
     WhisperConfig config;
-    whisper_context* ctx = nullptr;
+    std::shared_ptr<WhisperContextPool> pool;
+    WhisperContextPool::Lease lease; // State used by the current whisper run
     bool is_initialized = false;
     std::atomic<bool> is_processing{false};
     bool debug_enabled = false;
     volatile sig_atomic_t* running_flag = nullptr;
     
-    // Initialize whisper context
+    // Serialises this session's partial and final passes
+    std::mutex whisper_mutex;
+    
+    // Transcript of the current or last utterance, returned by get_last_transcript
+    mutable std::mutex transcript_mutex;
+    std::string live_transcript;
+    
+    // Incremental decoding state for the utterance being spoken
+    struct PartialState {
+        uint64_t utterance_id = UINT64_MAX;
+        size_t committed_samples = 0;      // Input samples already turned into committed text
+        std::string committed_text;
+        std::vector<int32_t> prompt_tokens; // Tokens of the committed text, fed back as prompt
+    };
+    PartialState partial;
+    
+    // Load the model into a pool of our own, unless one was shared with us
     bool initialize();
     
-    // Free whisper context
+    // Drop the pool (freeing it if no other session uses it)
     void cleanup();
     
+    // Audio handed to whisper, reused between runs so its capacity is kept.
+    // Guarded by whisper_mutex.
+    std::vector<float> work_buffer;
+    
+    // Resample to 16kHz, boost quiet audio and append padding_ms of silence
+    // (at least up to whisper's one second minimum), into work_buffer
+    const std::vector<float>& prepare_audio(const float* audio, size_t count, int sample_rate, int padding_ms);
+    
+    // Same, taking over audio instead of copying it when it is already 16kHz
+    const std::vector<float>& prepare_audio(std::vector<float>&& audio, int sample_rate, int padding_ms);
+    
+    // Steps shared by both: boost work_buffer in place, pad it, pick the gain
+    const std::vector<float>& finish_prepared_audio(int padding_ms);
+    const std::vector<float>& pad_prepared_audio(size_t speech_samples, int padding_ms);
+    float quiet_gain(const float* audio, size_t count) const;
+    
+    // Run whisper on prepared audio; the caller must hold whisper_mutex.
+    // use_context carries text over from the previous run. The pool state
+    // stays leased for reading the results until release_state(). With
+    // wait false it gives up if no state is free.
+    bool run_whisper(const std::vector<float>& audio, const std::vector<int32_t>& prompt_tokens, bool use_context, bool wait = true);
+    
+    // Hand the pool state of the last run back
+    void release_state() { lease.release(); }
+    
+    // Check the model is loaded and audio_buffer is not empty
+    bool ready_for(const std::vector<float>& audio_buffer);
+    
+    // Transcribe work_buffer as a whole utterance; the caller must hold whisper_mutex
+    std::string transcribe_prepared();
+    
+    // Join the text of segments [first, last) of the last whisper run
+    std::string collect_segments(int first, int last) const;
+    
+    void set_live_transcript(const std::string& text);
+
 public:
-    StreamingWhisperSTT(const WhisperConfig& cfg, bool debug = false);
+    // Pass the pool of another session to share its model
+    StreamingWhisperSTT(const WhisperConfig& cfg, bool debug = false, std::shared_ptr<WhisperContextPool> shared_pool = nullptr);
     ~StreamingWhisperSTT();
     
     // Set running flag pointer
@@ -36,11 +92,33 @@ public:
     // Process an audio buffer containing PCM float samples
     std::string process_audio(const std::vector<float>& audio_buffer, int sample_rate);
     
-    // Get the last transcript from whisper (for partial results)
+    // Same, reusing the buffer instead of copying it (16kHz audio is padded
+    // in place, so spare capacity avoids a reallocation)
+    std::string process_audio(std::vector<float>&& audio_buffer, int sample_rate);
+    
+    // Incremental mode: decode the newest part of an utterance that is still
+    // being spoken. audio holds the utterance so far and utterance_id tells
+    // utterances apart. Returns the live transcript, or the previous one if
+    // whisper is busy.
+    std::string process_partial(const std::vector<float>& audio, int sample_rate, uint64_t utterance_id);
+    
+    // Incremental mode: finish an utterance by decoding only the audio after
+    // the committed prefix. Falls back to process_audio if no partials ran;
+    // move the utterance in to avoid copying it.
+    std::string finalize(std::vector<float> audio, int sample_rate, uint64_t utterance_id);
+    
+    // Get the last transcript from whisper (live partials in incremental mode)
     std::string get_last_transcript() const;
     
+    // Incremental mode settings
+    bool is_incremental() const { return config.incremental; }
+    int get_partial_step_ms() const { return config.partial_step_ms; }
+    
     // Check if whisper is currently processing
     bool is_busy() const { return is_processing.load(); }
+    
+    // The pool behind this session, for creating more sessions on the same model
+    std::shared_ptr<WhisperContextPool> get_pool() const { return pool; }
 };
 
 #endif // STREAMING_WHISPER_STT_H
\ No newline at end of file
@@ -0,0 +1,302 @@
+#ifndef SYSTEM_PROBE_H
+#define SYSTEM_PROBE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+#include <sys/utsname.h>
+#include "config.h"
+
+// Describes the machine for the assistant's system prompt by reading /etc,
+// /proc and /sys directly, so startup does not wait on a chain of shell
+// commands. The describe_* functions take the file contents and can be
+// tested without the files.
+
+// Whole file contents, or an empty string if it cannot be read
+inline std::string read_text_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return "";
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+inline std::string trim_probe_value(const std::string& value) {
+    size_t first = value.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    size_t last = value.find_last_not_of(" \t\r\n");
+    return value.substr(first, last - first + 1);
+}
+
+// Value of KEY=value in os-release text, without its quotes
+inline std::string os_release_value(const std::string& os_release, const std::string& key) {
+    std::istringstream in(os_release);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, key.size() + 1, key + "=") != 0) {
+            continue;
+        }
+        std::string value = trim_probe_value(line.substr(key.size() + 1));
+        if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front()) {
+            value = value.substr(1, value.size() - 2);
+        }
+        return value;
+    }
+    return "";
+}
+
+// "NAME VERSION" from os-release, or the kernel name if there is none
+inline std::string describe_os(const std::string& os_release, const std::string& kernel_name) {
+    std::string name = os_release_value(os_release, "NAME");
+    if (!name.empty()) {
+        std::string version = os_release_value(os_release, "VERSION");
+        return version.empty() ? name : name + " " + version;
+    }
+    if (!kernel_name.empty()) {
+        return kernel_name + " Operating System";
+    }
+    return "Unknown Operating System";
+}
+
+// First value of a key in /proc/cpuinfo text
+inline std::string cpuinfo_value(const std::string& cpuinfo, const std::string& key) {
+    std::istringstream in(cpuinfo);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        if (trim_probe_value(line.substr(0, colon)) == key) {
+            return trim_probe_value(line.substr(colon + 1));
+        }
+    }
+    return "";
+}
+
+// Short CPU description such as "Intel Core i7 running at 2.8 GHz with 8 cores"
+inline std::string describe_cpu(const std::string& cpuinfo, unsigned int cores) {
+    const std::string model = cpuinfo_value(cpuinfo, "model name");
+    
+    std::string simplified_cpu;
+    if (model.find("Intel") != std::string::npos) {
+        simplified_cpu = "Intel";
+    } else if (model.find("AMD") != std::string::npos) {
+        simplified_cpu = "AMD";
+    } else {
+        simplified_cpu = "Generic";
+    }
+    
+    // Try to extract processor type ("Ryzen 7 5800X 8-Core" is a Ryzen)
+    if (model.find("Ryzen") != std::string::npos) {
+        simplified_cpu += " Ryzen processor";
+    } else if (model.find("Core") != std::string::npos) {
+        if (model.find("i7") != std::string::npos)
+            simplified_cpu += " Core i7";
+        else if (model.find("i5") != std::string::npos)
+            simplified_cpu += " Core i5";
+        else if (model.find("i3") != std::string::npos)
+            simplified_cpu += " Core i3";
+        else if (model.find("i9") != std::string::npos)
+            simplified_cpu += " Core i9";
+        else
+            simplified_cpu += " Core processor";
+    } else {
+        simplified_cpu += " processor";
+    }
+    
+    // Clock speed in GHz, when the kernel reports one (many ARM kernels don't)
+    const std::string mhz = cpuinfo_value(cpuinfo, "cpu MHz");
+    char* end = nullptr;
+    double mhz_value = std::strtod(mhz.c_str(), &end);
+    if (!mhz.empty() && end != mhz.c_str() && mhz_value > 0) {
+        std::ostringstream ghz;
+        ghz << std::fixed << std::setprecision(1) << mhz_value / 1000.0;
+        simplified_cpu += " running at " + ghz.str() + " GHz";
+    }
+    
+    if (cores > 0) {
+        simplified_cpu += " with " + std::to_string(cores) + " cores";
+    }
+    return simplified_cpu;
+}
+
+// Size in powers of 1024 the way free -h and df -h print it: "7.6Gi" or
+// "15G", with one decimal below 10
+inline std::string format_size(uint64_t bytes, bool binary_suffix) {
+    static const char* units[] = {"B", "K", "M", "G", "T", "P"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024.0;
+        unit++;
+    }
+    
+    std::ostringstream out;
+    if (unit > 0 && value < 10.0) {
+        out << std::fixed << std::setprecision(1) << value;
+    } else {
+        out << std::llround(value);
+    }
+    out << units[unit];
+    if (binary_suffix && unit > 0) {
+        out << "i";
+    }
+    return out.str();
+}
+
+// Total RAM from /proc/meminfo text, e.g. "15Gi of RAM"
+inline std::string describe_memory(const std::string& meminfo) {
+    const std::string total = cpuinfo_value(meminfo, "MemTotal"); // Same "key: value" layout
+    if (total.empty()) {
+        return "";
+    }
+    uint64_t kilobytes = std::strtoull(total.c_str(), nullptr, 10);
+    return format_size(kilobytes * 1024, true) + " of RAM";
+}
+
+// Space on the filesystem holding path, e.g. "50G total, 20G free (58% used) disk space"
+inline std::string describe_disk(const std::string& path) {
+    struct statvfs stats;
+    if (statvfs(path.c_str(), &stats) != 0 || stats.f_blocks == 0) {
+        return "";
+    }
+    const uint64_t block = stats.f_frsize;
+    const uint64_t total = stats.f_blocks * block;
+    const uint64_t available = stats.f_bavail * block;
+    const uint64_t used = (stats.f_blocks - stats.f_bfree) * block;
+    
+    // Like df, usage is relative to the space available to users, rounded up
+    const uint64_t usable = used + available;
+    const int used_percent = usable > 0 ? static_cast<int>((used * 100 + usable - 1) / usable) : 0;
+    
+    return format_size(total, false) + " total, " + format_size(available, false) + " free (" +
+           std::to_string(used_percent) + "% used) disk space";
+}
+
+// Graphics vendor from the PCI vendor ids of the display controllers found.
+// A discrete card is named over integrated graphics.
+inline std::string describe_gpu(const std::vector<std::string>& vendor_ids) {
+    if (vendor_ids.empty()) {
+        return "";
+    }
+    auto has_vendor = [&vendor_ids](const char* id) {
+        for (const auto& vendor : vendor_ids) {
+            if (vendor == id) {
+                return true;
+            }
+        }
+        return false;
+    };
+    
+    if (has_vendor("0x10de")) return "NVIDIA";
+    if (has_vendor("0x1002")) return "AMD Radeon";
+    if (has_vendor("0x8086")) return "Intel";
+    return "Graphics card";
+}
+
+// PCI vendor ids of the display controllers (class 0x03xxxx) under sysfs
+inline std::vector<std::string> find_display_vendors(const std::string& pci_devices = "/sys/bus/pci/devices") {
+    std::vector<std::string> vendors;
+    DIR* dir = opendir(pci_devices.c_str());
+    if (!dir) {
+        return vendors;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        const std::string device = pci_devices + "/" + entry->d_name;
+        if (trim_probe_value(read_text_file(device + "/class")).compare(0, 4, "0x03") == 0) {
+            vendors.push_back(trim_probe_value(read_text_file(device + "/vendor")));
+        }
+    }
+    closedir(dir);
+    return vendors;
+}
+
+// Check /proc/net/route text for an IPv4 default route that is up
+inline bool has_default_route(const std::string& route_table) {
+    std::istringstream in(route_table);
+    std::string line;
+    std::getline(in, line); // Header
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string iface, destination, gateway, flags;
+        if (!(fields >> iface >> destination >> gateway >> flags)) {
+            continue;
+        }
+        if (destination == "00000000" && (std::strtoul(flags.c_str(), nullptr, 16) & 0x1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Full path of the executable name on a PATH-style list of directories, or
+// "" if none has it; what `which` prints, without running it
+inline std::string find_in_path(const std::string& name, const std::string& path_list) {
+    std::istringstream in(path_list);
+    std::string dir;
+    while (std::getline(in, dir, ':')) {
+        std::string candidate = (dir.empty() ? "." : dir) + "/" + name;
+        if (access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+    }
+    return "";
+}
+
+// "whisper.cpp X.Y.Z" from the project() line of whisper.cpp's CMakeLists.txt
+inline std::string whisper_source_version(const std::string& cmake_lists) {
+    size_t project = cmake_lists.find("project(\"whisper.cpp\"");
+    if (project == std::string::npos) {
+        return "";
+    }
+    size_t end = cmake_lists.find(')', project);
+    size_t version = cmake_lists.find("VERSION", project);
+    if (version == std::string::npos || version > end) {
+        return "";
+    }
+    std::istringstream in(cmake_lists.substr(version + 7, end - version - 7));
+    std::string number;
+    in >> number;
+    return number.empty() ? "" : "whisper.cpp " + number;
+}
+
+// Fill in the hardware and OS fields of info. Only reads local files; the
+// Ollama version is asked from the server during startup instead.
+inline void probe_system_info(SystemInfo& info) {
+    utsname kernel{};
+    const std::string kernel_name = uname(&kernel) == 0 ? kernel.sysname : "";
+    info.os_info = describe_os(read_text_file("/etc/os-release"), kernel_name);
+    
+    info.cpu_info = describe_cpu(read_text_file("/proc/cpuinfo"), std::thread::hardware_concurrency());
+    info.gpu_info = describe_gpu(find_display_vendors());
+    info.memory_info = describe_memory(read_text_file("/proc/meminfo"));
+    info.disk_info = describe_disk("/");
+    
+    // For privacy reasons, only say whether there is a way out, not the address
+    info.network_info = has_default_route(read_text_file("/proc/net/route"))
+                            ? "Connected to a network" : "Not connected to a network";
+    
+    std::string whisper_version = whisper_source_version(read_text_file("./whisper.cpp/CMakeLists.txt"));
+    if (!whisper_version.empty()) {
+        info.whisper_version = whisper_version;
+    }
+}
+
+#endif // SYSTEM_PROBE_H
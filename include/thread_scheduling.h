@@ -0,0 +1,189 @@
+#ifndef THREAD_SCHEDULING_H
+#define THREAD_SCHEDULING_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "config.h"
+
+// Keeps the threads that feed and drain the sound card from being starved
+// by whisper and the language model: they can get cores of their own and
+// SCHED_FIFO, and the other threads are kept off those cores.
+
+// How one thread is scheduled
+struct ThreadPolicy {
+    std::vector<int> cpus; // Cores to run on; empty leaves the affinity alone
+    int priority = 0;      // SCHED_FIFO priority (1-99); 0 keeps normal scheduling
+    
+    bool is_set() const { return !cpus.empty() || priority > 0; }
+};
+
+// CPUs in a list like "3" or "0,2-3", as taskset -c takes them. Returns
+// false if the list is malformed; an empty list is valid.
+inline bool parse_cpu_list(const std::string& text, std::vector<int>& cpus) {
+    cpus.clear();
+    if (!text.empty() && text.back() == ',') {
+        return false;
+    }
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (item.empty()) {
+            return false;
+        }
+        char* end = nullptr;
+        long first = std::strtol(item.c_str(), &end, 10);
+        long last = first;
+        if (end == item.c_str() || first < 0) {
+            return false;
+        }
+        if (*end == '-') {
+            const char* second = end + 1;
+            last = std::strtol(second, &end, 10);
+            if (end == second || last < first) {
+                return false;
+            }
+        }
+        if (*end != '\0' || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (std::find(cpus.begin(), cpus.end(), static_cast<int>(cpu)) == cpus.end()) {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+    }
+    return true;
+}
+
+// The CPUs as a comma-separated list, e.g. "0,2,3"
+inline std::string format_cpu_list(const std::vector<int>& cpus) {
+    std::string text;
+    for (int cpu : cpus) {
+        if (!text.empty()) text += ',';
+        text += std::to_string(cpu);
+    }
+    return text;
+}
+
+// CPUs the calling thread may run on
+inline std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+// The CPUs of all that are not taken
+inline std::vector<int> remaining_cpus(const std::vector<int>& all, const std::vector<int>& taken) {
+    std::vector<int> rest;
+    for (int cpu : all) {
+        if (std::find(taken.begin(), taken.end(), cpu) == taken.end()) {
+            rest.push_back(cpu);
+        }
+    }
+    return rest;
+}
+
+// Apply policy to the calling thread; name is for the messages. Without
+// permission for SCHED_FIFO (CAP_SYS_NICE or an rtprio limit) the thread
+// gets a raised nice level instead, if that is allowed. Returns false if
+// anything asked for could not be applied.
+inline bool apply_thread_policy(const ThreadPolicy& policy, const char* name, bool debug = false) {
+    bool ok = true;
+    
+    if (!policy.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : policy.cpus) {
+            CPU_SET(cpu, &set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            std::cerr << "Warning: Cannot run the " << name << " thread on CPU " << format_cpu_list(policy.cpus)
+                      << ": " << std::strerror(err) << std::endl;
+            ok = false;
+        } else if (debug) {
+            std::cout << "Debug: " << name << " thread runs on CPU " << format_cpu_list(policy.cpus) << std::endl;
+        }
+    }
+    
+    if (policy.priority > 0) {
+        sched_param param{};
+        param.sched_priority = std::min(policy.priority, sched_get_priority_max(SCHED_FIFO));
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0) {
+            if (debug) {
+                std::cout << "Debug: " << name << " thread uses SCHED_FIFO priority " << param.sched_priority << std::endl;
+            }
+        } else if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), -10) == 0) {
+            std::cerr << "Warning: SCHED_FIFO is not allowed for the " << name
+                      << " thread, using nice -10 instead (raise rtprio in /etc/security/limits.conf)" << std::endl;
+        } else {
+            std::cerr << "Warning: Cannot raise the priority of the " << name << " thread: " << std::strerror(err)
+                      << " (raise rtprio in /etc/security/limits.conf or grant CAP_SYS_NICE)" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// The policy for the capture or the playback thread, from the config.
+// Prints a warning and leaves the affinity alone if the CPU list is malformed.
+inline ThreadPolicy audio_thread_policy(const SchedulingConfig& config, bool capture) {
+    ThreadPolicy policy;
+    const std::string& list = capture ? config.capture_cpus : config.playback_cpus;
+    if (!parse_cpu_list(list, policy.cpus)) {
+        std::cerr << "Warning: Ignoring malformed CPU list \"" << list << "\"" << std::endl;
+        policy.cpus.clear();
+    }
+    if (config.realtime) {
+        policy.priority = capture ? config.capture_priority : config.playback_priority;
+    }
+    return policy;
+}
+
+// The CPUs for every other thread: worker_cpus if set, otherwise those the
+// capture and playback threads do not have. Empty to leave them alone.
+inline std::vector<int> worker_cpus(const SchedulingConfig& config, const std::vector<int>& available) {
+    std::vector<int> cpus;
+    if (!config.worker_cpus.empty()) {
+        if (!parse_cpu_list(config.worker_cpus, cpus)) {
+            std::cerr << "Warning: Ignoring malformed CPU list \"" << config.worker_cpus << "\"" << std::endl;
+            cpus.clear();
+        }
+        return cpus;
+    }
+    
+    std::vector<int> taken;
+    std::vector<int> list;
+    if (parse_cpu_list(config.capture_cpus, list)) taken.insert(taken.end(), list.begin(), list.end());
+    if (parse_cpu_list(config.playback_cpus, list)) taken.insert(taken.end(), list.begin(), list.end());
+    if (taken.empty()) {
+        return cpus;
+    }
+    cpus = remaining_cpus(available, taken);
+    if (cpus.empty()) {
+        std::cerr << "Warning: The capture and playback threads take every CPU, leaving the others unpinned" << std::endl;
+    }
+    return cpus;
+}
+
+#endif // THREAD_SCHEDULING_H
@@ -4,24 +4,132 @@
 #include <string>
 #include <sstream>
 #include <cstdlib>
-#include <ctime>
+#include <cstdio>
 #include <fstream>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <unordered_set>
+#include <condition_variable>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "config.h"
+#include "speech_synthesizer.h"
+#include "phrase_cache.h"
+#include "latency_metrics.h"
+#include "audio_devices.h"
+#include "thread_scheduling.h"
+
+extern char** environ;
 
 class TTSEngine {
 private:
     TTSConfig config;
     std::string output_device;
     
-    // List available audio output devices
-    void list_devices() {
-        std::cout << "Available audio output devices:" << std::endl;
+    // The synthesis or playback process currently running, so it can be cancelled
+    std::mutex process_mutex;
+    pid_t current_pid = 0;
+    std::atomic<bool> cancelled{false};
+    
+    // In-process synthesis and playback, used instead of shelling out when set
+    std::unique_ptr<SpeechSynthesizer> synthesizer;
+    std::unique_ptr<PcmSink> sink;
+    
+    // Audio for fixed phrases, synthesized once by warm_phrase_cache().
+    // Engines of several sessions can share one.
+    std::shared_ptr<PhraseCache> phrase_cache = std::make_shared<PhraseCache>();
+    
+    // Texts whose audio goes into the phrase cache the next time they are
+    // synthesized, such as cached replies; at most kept_limit of them
+    std::mutex keep_mutex;
+    std::unordered_set<std::string> keep_requests;
+    size_t kept_count = 0;
+    size_t kept_limit = 0;
+    
+    // Receives TtsStart and FirstAudio for each spoken text, if set
+    LatencyMetrics* metrics = nullptr;
+    
+    // For the thread of a TTSSpeechQueue, which plays streamed replies
+    ThreadPolicy playback_policy;
+    
+    void mark(TurnEvent event) {
+        if (metrics) metrics->mark(event);
+    }
+    
+    // Create an empty temporary file with a unique name, so utterances
+    // synthesized close together never share a file. Returns "" on failure.
+    static std::string make_temp_file(const std::string& prefix, const std::string& suffix) {
+        std::string path = "/tmp/" + prefix + "XXXXXX" + suffix;
+        int fd = mkstemps(&path[0], static_cast<int>(suffix.size()));
+        if (fd < 0) {
+            std::cerr << "Failed to create temporary file" << std::endl;
+            return "";
+        }
+        close(fd);
+        return path;
+    }
+    
+    // Run a shell command like std::system, but in its own process group so
+    // cancel() can stop it and anything it started. Returns the exit status,
+    // or -1 if the command could not be run or was cancelled.
+    int run_command(const std::string& command) {
+        if (cancelled.load()) {
+            return -1;
+        }
+        
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+        
+        const char* argv[] = {"sh", "-c", command.c_str(), nullptr};
+        pid_t pid = 0;
+        int spawn_result;
+        {
+            std::lock_guard<std::mutex> lock(process_mutex);
+            spawn_result = posix_spawn(&pid, "/bin/sh", nullptr, &attr, const_cast<char* const*>(argv), environ);
+            if (spawn_result == 0) {
+                current_pid = pid;
+                // cancel() may have run just before the process existed
+                if (cancelled.load()) {
+                    kill(-pid, SIGTERM);
+                }
+            }
+        }
+        posix_spawnattr_destroy(&attr);
+        
+        if (spawn_result != 0) {
+            std::cerr << "Failed to run command: " << command << std::endl;
+            return -1;
+        }
+        
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
         
-        // Try ALSA devices
-        std::system("aplay -l 2>/dev/null");
+        {
+            std::lock_guard<std::mutex> lock(process_mutex);
+            current_pid = 0;
+        }
         
-        // Try PulseAudio devices
-        std::system("pactl list sinks 2>/dev/null | grep -E 'Name:|Description:'");
+        if (cancelled.load() || !WIFEXITED(status)) {
+            return -1;
+        }
+        return WEXITSTATUS(status);
+    }
+    
+    // List the playback devices of the sound cards, as /proc/asound has them
+    void list_devices() {
+        std::cout << "Available audio output devices:" << std::endl;
+        print_audio_devices(list_proc_audio_devices(), false);
     }
     
 public:
@@ -36,13 +144,144 @@ public:
         }
     }
     
+    // Stop the current synthesis or playback and make speak() return
+    // immediately until reset_cancel() is called. Safe to call from any thread.
+    void cancel() {
+        std::lock_guard<std::mutex> lock(process_mutex);
+        cancelled.store(true);
+        if (current_pid > 0) {
+            kill(-current_pid, SIGTERM);
+        }
+    }
+    
+    // Allow speaking again after cancel()
+    void reset_cancel() {
+        cancelled.store(false);
+    }
+    
+    bool is_cancelled() const {
+        return cancelled.load();
+    }
+    
+    // Synthesize espeak voices in-process and play them through sink, instead
+    // of running espeak and an audio player for every utterance
+    void set_native_backend(std::unique_ptr<SpeechSynthesizer> synth, std::unique_ptr<PcmSink> pcm_sink) {
+        synthesizer = std::move(synth);
+        sink = std::move(pcm_sink);
+    }
+    
+    bool has_native_backend() const {
+        return synthesizer && sink;
+    }
+    
+    // Record when speaking starts and its first audio plays. With the
+    // command-line engines, the first audio is when the player starts.
+    void set_metrics(LatencyMetrics* latency_metrics) {
+        metrics = latency_metrics;
+    }
+    
+    // Pin the thread that speaks queued sentences and raise its priority.
+    // Set before a TTSSpeechQueue is created.
+    void set_playback_policy(const ThreadPolicy& policy) {
+        playback_policy = policy;
+    }
+    
+    const ThreadPolicy& get_playback_policy() const {
+        return playback_policy;
+    }
+    
+    // How many times native playback ran dry
+    uint64_t underrun_count() const {
+        return sink ? sink->underrun_count() : 0;
+    }
+    
+    // Make sure every phrase has cached audio, so it plays without being
+    // synthesized. Audio is loaded from and saved to cache_file when it is
+    // set. Needs the native backend, since the cache holds raw PCM.
+    // Returns the number of phrases synthesized now.
+    size_t warm_phrase_cache(const std::vector<std::string>& phrases, const std::string& cache_file = "") {
+        if (!has_native_backend() || phrases.empty()) {
+            return 0;
+        }
+        
+        if (!cache_file.empty()) {
+            phrase_cache->load(cache_file);
+        }
+        
+        size_t synthesized = 0;
+        std::atomic<bool> never_cancelled{false};
+        for (const auto& phrase : phrases) {
+            std::string key = PhraseCache::make_key(phrase, config.voice, config.speed);
+            if (phrase.empty() || phrase_cache->find(key)) {
+                continue;
+            }
+            
+            BufferSink buffer;
+            buffer.begin(synthesizer->sample_rate());
+            if (synthesizer->synthesize(phrase, buffer, never_cancelled)) {
+                phrase_cache->store(key, std::move(buffer.samples), buffer.sample_rate);
+                synthesized++;
+            }
+        }
+        
+        if (synthesized > 0 && !cache_file.empty()) {
+            phrase_cache->save(cache_file);
+        }
+        return synthesized;
+    }
+    
+    // Keep the audio of text once it has been synthesized, so saying it
+    // again plays from memory. Ignored without the native backend and once
+    // limit texts have been kept.
+    void keep_audio(const std::string& text, size_t limit) {
+        if (!has_native_backend() || text.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(keep_mutex);
+        kept_limit = limit;
+        if (kept_count + keep_requests.size() < kept_limit) {
+            keep_requests.insert(text);
+        }
+    }
+    
+    size_t cached_phrase_count() const {
+        return phrase_cache->size();
+    }
+    
+    // The phrase cache, for sharing with the engines of other sessions
+    std::shared_ptr<PhraseCache> get_phrase_cache() const {
+        return phrase_cache;
+    }
+    
+    // Use a cache warmed by another engine with the same voice and speed
+    void set_phrase_cache(std::shared_ptr<PhraseCache> cache) {
+        if (cache) {
+            phrase_cache = std::move(cache);
+        }
+    }
+    
+    const std::string& get_output_device() const {
+        return output_device;
+    }
+    
+    // Check if a device name refers to ALSA rather than a PulseAudio sink
+    static bool is_alsa_device(const std::string& device) {
+        return device == "default" || device.find("hw:") != std::string::npos;
+    }
+    
     // Convert text to speech and play
     void speak(const std::string& text) {
-        if (text.empty()) {
+        if (text.empty() || cancelled.load()) {
             return; // Nothing to speak
         }
+        mark(TurnEvent::TtsStart);
         
-        if (config.engine == "espeak") {
+        if (config.engine == "espeak" && has_native_backend()) {
+            if (!speak_native(text) && !cancelled.load()) {
+                std::cerr << "In-process speech synthesis failed, falling back to espeak" << std::endl;
+                speak_espeak(text);
+            }
+        } else if (config.engine == "espeak") {
             speak_espeak(text);
         } else if (config.engine == "piper") {
             speak_piper(text);
@@ -54,20 +293,82 @@ public:
     }
     
 private:
+    // Stream synthesized audio straight to the sink. Returns false if it
+    // failed, true if it was played or cancelled.
+    bool speak_native(const std::string& text) {
+        FirstWriteSink output(*sink, [this] { mark(TurnEvent::FirstAudio); });
+        
+        // Cached phrases play straight from memory; entries are only ever
+        // added, so the one found stays valid
+        const PhraseCache::Entry* cached = phrase_cache->find(PhraseCache::make_key(text, config.voice, config.speed));
+        if (cached) {
+            if (!output.begin(cached->sample_rate)) {
+                return false;
+            }
+            
+            // Write in blocks so a cancel takes effect quickly
+            const size_t block = static_cast<size_t>(cached->sample_rate) / 20;
+            for (size_t offset = 0; offset < cached->count && !cancelled.load(); offset += block) {
+                size_t count = std::min(block, cached->count - offset);
+                if (!output.write(cached->samples() + offset, count)) {
+                    output.drop();
+                    return false;
+                }
+            }
+            output.wait_played(cancelled);
+            return true;
+        }
+        
+        if (!output.begin(synthesizer->sample_rate())) {
+            return false;
+        }
+        
+        bool keep;
+        {
+            std::lock_guard<std::mutex> lock(keep_mutex);
+            keep = keep_requests.erase(text) > 0;
+        }
+        if (keep) {
+            // Copy the audio on its way to the device. Only a complete
+            // utterance is kept, so a cancelled one is tried again next time.
+            CopyingSink copying(output);
+            copying.copy.begin(synthesizer->sample_rate());
+            if (!synthesizer->synthesize(text, copying, cancelled)) {
+                output.drop();
+                return cancelled.load();
+            }
+            if (!cancelled.load()) {
+                std::lock_guard<std::mutex> lock(keep_mutex);
+                phrase_cache->store(PhraseCache::make_key(text, config.voice, config.speed),
+                                    std::move(copying.copy.samples), copying.copy.sample_rate);
+                kept_count++;
+            }
+            output.wait_played(cancelled);
+            return true;
+        }
+        
+        if (!synthesizer->synthesize(text, output, cancelled)) {
+            output.drop();
+            return cancelled.load();
+        }
+        
+        output.wait_played(cancelled);
+        return true;
+    }
+    
     // Use espeak for TTS
     void speak_espeak(const std::string& text) {
         // Create temporary file for text
-        std::stringstream ss;
-        ss << "/tmp/tts_text_" << std::time(nullptr) << ".txt";
-        std::string text_file = ss.str();
-        
-        // Audio output file
-        std::string audio_file = "/tmp/tts_output_" + std::to_string(std::time(nullptr)) + ".wav";
+        std::string text_file = make_temp_file("tts_text_", ".txt");
+        if (text_file.empty()) {
+            return;
+        }
         
         // Write text to file
         std::ofstream file(text_file);
         if (!file.is_open()) {
             std::cerr << "Failed to create temporary text file" << std::endl;
+            std::remove(text_file.c_str());
             return;
         }
         
@@ -85,14 +386,22 @@ private:
         
         // If we should generate a file instead of direct playback
         if (output_device != "default") {
+            std::string audio_file = make_temp_file("tts_output_", ".wav");
+            if (audio_file.empty()) {
+                std::remove(text_file.c_str());
+                return;
+            }
             cmd << " -w " << audio_file;
             
             // Execute command to generate audio file
-            int result = std::system(cmd.str().c_str());
+            int result = run_command(cmd.str());
             
             if (result != 0) {
-                std::cerr << "Error running espeak" << std::endl;
+                if (!cancelled.load()) {
+                    std::cerr << "Error running espeak" << std::endl;
+                }
                 std::remove(text_file.c_str());
+                std::remove(audio_file.c_str());
                 return;
             }
             
@@ -103,9 +412,10 @@ private:
             std::remove(audio_file.c_str());
         } else {
             // Direct playback using system default
-            int result = std::system(cmd.str().c_str());
+            mark(TurnEvent::FirstAudio);
+            int result = run_command(cmd.str());
             
-            if (result != 0) {
+            if (result != 0 && !cancelled.load()) {
                 std::cerr << "Error running espeak" << std::endl;
             }
         }
@@ -116,18 +426,21 @@ private:
     
     // Use piper TTS (if available)
     void speak_piper(const std::string& text) {
-        // Create temporary file for text
-        std::stringstream ss;
-        ss << "/tmp/tts_text_" << std::time(nullptr) << ".txt";
-        std::string text_file = ss.str();
-        
-        // Audio output file
-        std::string audio_file = "/tmp/tts_output_" + std::to_string(std::time(nullptr)) + ".wav";
+        // Create temporary files for the text and the audio
+        std::string text_file = make_temp_file("tts_text_", ".txt");
+        std::string audio_file = make_temp_file("tts_output_", ".wav");
+        if (text_file.empty() || audio_file.empty()) {
+            std::remove(text_file.c_str());
+            std::remove(audio_file.c_str());
+            return;
+        }
         
         // Write text to file
         std::ofstream file(text_file);
         if (!file.is_open()) {
             std::cerr << "Failed to create temporary text file" << std::endl;
+            std::remove(text_file.c_str());
+            std::remove(audio_file.c_str());
             return;
         }
         
@@ -142,12 +455,17 @@ private:
             << " --text_file " << text_file;
             
         // Execute command
-        int result = std::system(cmd.str().c_str());
+        int result = run_command(cmd.str());
         
-        if (result != 0) {
+        if (result != 0 && cancelled.load()) {
+            std::remove(text_file.c_str());
+            std::remove(audio_file.c_str());
+            return;
+        } else if (result != 0) {
             std::cerr << "Error running piper, falling back to espeak" << std::endl;
-            speak_espeak(text);
             std::remove(text_file.c_str());
+            std::remove(audio_file.c_str());
+            speak_espeak(text);
             return;
         }
         
@@ -165,7 +483,7 @@ private:
         bool using_pulse = false;
         
         // Check if we should use PulseAudio for playback
-        if (output_device != "default" && output_device.find("hw:") == std::string::npos) {
+        if (!is_alsa_device(output_device)) {
             // Attempt to use PulseAudio
             cmd << "paplay"
                 << " --device=" << output_device
@@ -183,9 +501,10 @@ private:
         }
         
         // Execute command
-        int result = std::system(cmd.str().c_str());
+        mark(TurnEvent::FirstAudio);
+        int result = run_command(cmd.str());
         
-        if (result != 0) {
+        if (result != 0 && !cancelled.load()) {
             // If first attempt fails, try alternative approach
             cmd.str("");
             
@@ -197,16 +516,16 @@ private:
                 cmd << "paplay --device=@DEFAULT_SINK@ " << audio_file;
             }
             
-            result = std::system(cmd.str().c_str());
+            result = run_command(cmd.str());
             
-            if (result != 0) {
+            if (result != 0 && !cancelled.load()) {
                 // Last resort: try SoX
                 cmd.str("");
                 cmd << "play -q " << audio_file;
                 
-                result = std::system(cmd.str().c_str());
+                result = run_command(cmd.str());
                 
-                if (result != 0) {
+                if (result != 0 && !cancelled.load()) {
                     std::cerr << "No suitable audio player found" << std::endl;
                 }
             }
@@ -214,4 +533,93 @@ private:
     }
 };
 
+// Speaks queued sentences on a background thread, so that synthesis of one
+// sentence overlaps with generation of the next
+class TTSSpeechQueue {
+private:
+    TTSEngine& engine;
+    std::deque<std::string> sentences;
+    std::thread worker;
+    std::mutex queue_mutex;
+    std::condition_variable cv;
+    bool speaking = false;
+    bool stopping = false;
+    
+    void worker_func() {
+        // Synthesis runs here as well, feeding the sink as it goes
+        if (engine.get_playback_policy().is_set()) {
+            apply_thread_policy(engine.get_playback_policy(), "playback");
+        }
+        
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true) {
+            cv.wait(lock, [this] { return stopping || !sentences.empty(); });
+            if (sentences.empty()) {
+                break; // Stopping and nothing left to say
+            }
+            
+            std::string sentence = std::move(sentences.front());
+            sentences.pop_front();
+            speaking = true;
+            
+            lock.unlock();
+            engine.speak(sentence);
+            lock.lock();
+            
+            speaking = false;
+            cv.notify_all();
+        }
+    }
+    
+public:
+    explicit TTSSpeechQueue(TTSEngine& tts) : engine(tts) {
+        worker = std::thread(&TTSSpeechQueue::worker_func, this);
+    }
+    
+    ~TTSSpeechQueue() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    
+    // Queue a sentence to be spoken after any already queued
+    void enqueue(const std::string& sentence) {
+        if (sentence.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            sentences.push_back(sentence);
+        }
+        cv.notify_all();
+    }
+    
+    // Block until every queued sentence has been spoken
+    void wait_until_done() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        cv.wait(lock, [this] { return sentences.empty() && !speaking; });
+    }
+    
+    // Drop queued sentences and stop the one playing. Returns once the engine
+    // is idle and ready to speak again.
+    void cancel() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        sentences.clear();
+        engine.cancel();
+        cv.wait(lock, [this] { return !speaking; });
+        engine.reset_cancel();
+    }
+    
+    // Check if anything is queued or being spoken
+    bool is_active() {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        return speaking || !sentences.empty();
+    }
+};
+
 #endif // TTS_ENGINE_H
\ No newline at end of file
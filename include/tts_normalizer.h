@@ -0,0 +1,475 @@
+#ifndef TTS_NORMALIZER_H
+#define TTS_NORMALIZER_H
+
+#include <string>
+#include <cctype>
+#include <cstring>
+
+// Turns markdown-flavoured LLM output into text that reads well aloud, in a
+// single pass without regular expressions. Text can be fed in arbitrary
+// chunks as it streams in: anything that might still turn out to be part of
+// a longer construct (a code fence, link, URL, ordinal, emoji...) is held
+// back until enough of it has arrived to decide.
+class TTSNormalizer {
+private:
+    std::string pending;               // Input not yet converted
+    bool in_code_block = false;        // Inside a ``` fence
+    bool at_line_start = true;         // Only whitespace seen since the last newline
+    bool line_needs_period = false;    // Bullet or heading line, ends as a sentence
+    bool space_pending = false;        // Whitespace to emit before the next word
+    bool soft_space = false;           // The pending space only follows a spoken replacement
+    bool sentence_end_pending = false; // Sentence break to emit before the next word
+    int newline_run = 0;               // Consecutive newlines, two make a sentence break
+    char prev_in = '\0';               // Last input byte consumed
+    char last_out = '\0';              // Last byte emitted
+    bool emitted_any = false;          // Whether anything has been emitted yet
+    
+    // Longest construct held back before giving up and treating it literally
+    static constexpr size_t MAX_LOOKAHEAD = 256;
+    
+    struct Replacement {
+        const char* from;
+        const char* to;
+    };
+    
+    static const Replacement* abbreviations(size_t& count) {
+        static const Replacement table[] = {
+            {"e.g.", "for example"},
+            {"i.e.", "that is"},
+            {"etc.", "etcetera"},
+            {"vs.", "versus"},
+            {"approx.", "approximately"},
+        };
+        count = sizeof(table) / sizeof(table[0]);
+        return table;
+    }
+    
+    static const Replacement* emojis(size_t& count) {
+        static const Replacement table[] = {
+            {"😊", "smiling face"},
+            {"👍", "thumbs up"},
+            {"👎", "thumbs down"},
+            {"❤️", "heart"},
+            {"❤", "heart"},
+            {"👋", "waving hand"},
+            {"🙂", "slightly smiling face"},
+            {"😀", "grinning face"},
+            {"🤖", "robot face"},
+            {"✅", "check mark"},
+            {"⚠️", "warning"},
+            {"⚠", "warning"},
+            {"⭐", "star"},
+            {"🚀", "rocket"},
+        };
+        count = sizeof(table) / sizeof(table[0]);
+        return table;
+    }
+    
+    static bool is_word_char(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) != 0;
+    }
+    
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+    
+    static bool is_sentence_punct(char c) {
+        return c == '.' || c == '!' || c == '?' || c == ':' || c == ';' || c == ',';
+    }
+    
+    // Emit the whitespace or sentence break owed before the next word
+    void flush_separators(std::string& out) {
+        if (sentence_end_pending) {
+            if (emitted_any && !is_sentence_punct(last_out)) {
+                out += '.';
+            }
+            if (emitted_any) {
+                out += ' ';
+                last_out = ' ';
+            }
+        } else if (space_pending && emitted_any && last_out != ' ') {
+            out += ' ';
+            last_out = ' ';
+        }
+        sentence_end_pending = false;
+        space_pending = false;
+        soft_space = false;
+    }
+    
+    void emit(std::string& out, const char* text, size_t length) {
+        if (length == 0) {
+            return;
+        }
+        flush_separators(out);
+        out.append(text, length);
+        last_out = text[length - 1];
+        emitted_any = true;
+        newline_run = 0;
+    }
+    
+    void emit(std::string& out, const std::string& text) {
+        emit(out, text.data(), text.size());
+    }
+    
+    // Emit a spoken replacement as a separate word
+    void emit_word(std::string& out, const char* word) {
+        space_pending = true;
+        emit(out, word, std::strlen(word));
+        space_pending = true;
+        soft_space = true;
+    }
+    
+    // Emit punctuation attached to the previous word
+    void emit_punct(std::string& out, char c) {
+        if (!sentence_end_pending) {
+            space_pending = false;
+        }
+        emit(out, &c, 1);
+    }
+    
+    // Does the text at i start with s? Sets partial if it still might once more arrives
+    bool starts_with(size_t i, const char* s, bool& partial) const {
+        size_t length = std::strlen(s);
+        size_t available = pending.size() - i;
+        size_t n = available < length ? available : length;
+        if (pending.compare(i, n, s, n) != 0) {
+            return false;
+        }
+        if (n < length) {
+            partial = true;
+            return false;
+        }
+        return true;
+    }
+    
+    // Handle the construct at position i. Returns the number of bytes
+    // consumed, or 0 if more input is needed to decide.
+    size_t step(size_t i, std::string& out, bool final) {
+        const size_t available = pending.size() - i;
+        const char c = pending[i];
+        auto has = [&](size_t n) { return available >= n; };
+        auto at = [&](size_t n) { return pending[i + n]; };
+        
+        // Inside a code block nothing is spoken until the closing fence
+        if (in_code_block) {
+            size_t fence = pending.find("```", i);
+            if (fence != std::string::npos) {
+                in_code_block = false;
+                space_pending = true;
+                return fence + 3 - i;
+            }
+            if (final) {
+                return available;
+            }
+            // Keep enough to recognise a fence split across chunks
+            return available > 2 ? available - 2 : 0;
+        }
+        
+        // Whitespace, collapsed to a single space; a blank line ends a sentence
+        if (is_space(c)) {
+            if (c == '\n') {
+                if (line_needs_period) {
+                    sentence_end_pending = true;
+                    line_needs_period = false;
+                }
+                if (++newline_run >= 2) {
+                    sentence_end_pending = true;
+                }
+                at_line_start = true;
+            }
+            space_pending = true;
+            soft_space = false;
+            return 1;
+        }
+        
+        // Punctuation straight after a spoken replacement sticks to it
+        if (soft_space && std::strchr(".,;!?)", c) != nullptr) {
+            space_pending = false;
+        }
+        
+        // Code blocks and inline code
+        if (c == '`') {
+            if (!has(3) && !final) {
+                return 0;
+            }
+            if (has(3) && at(1) == '`' && at(2) == '`') {
+                emit(out, "I've prepared some code for you, but I won't read it aloud.");
+                space_pending = true;
+                in_code_block = true;
+                at_line_start = false;
+                return 3;
+            }
+            return 1; // Inline code is read as plain text
+        }
+        
+        // Headings and bullet points at the start of a line
+        if (at_line_start) {
+            if (c == '#') {
+                size_t level = 0;
+                while (level < available && pending[i + level] == '#') level++;
+                if (level == available && !final) {
+                    return 0;
+                }
+                if (level < available && (pending[i + level] == ' ' || pending[i + level] == '\t')) {
+                    at_line_start = false;
+                    line_needs_period = true;
+                    emit(out, level == 1 ? "Main topic: " : level == 2 ? "Subtopic: " : "Section: ");
+                    return level + 1;
+                }
+            }
+            
+            bool partial = false;
+            size_t marker = 0;
+            if (c == '*' || c == '-') {
+                marker = 1;
+            } else if (starts_with(i, "•", partial)) {
+                marker = std::strlen("•");
+            } else if (partial && !final) {
+                return 0;
+            }
+            if (marker > 0) {
+                if (!has(marker + 1) && !final) {
+                    return 0;
+                }
+                if (has(marker + 1) && (at(marker) == ' ' || at(marker) == '\t')) {
+                    at_line_start = false;
+                    line_needs_period = true;
+                    emit(out, "Point: ");
+                    return marker + 1;
+                }
+            }
+        }
+        at_line_start = false;
+        
+        const bool word_start = !is_word_char(prev_in) && prev_in != '.';
+        
+        // Abbreviations read as words
+        if (word_start && std::isalpha(static_cast<unsigned char>(c))) {
+            size_t count = 0;
+            const Replacement* table = abbreviations(count);
+            for (size_t k = 0; k < count; k++) {
+                bool partial = false;
+                size_t length = std::strlen(table[k].from);
+                if (starts_with(i, table[k].from, partial)) {
+                    if (!has(length + 1) && !final) {
+                        return 0;
+                    }
+                    if (!has(length + 1) || is_space(at(length))) {
+                        emit_word(out, table[k].to);
+                        return length;
+                    }
+                } else if (partial && !final) {
+                    return 0;
+                }
+            }
+        }
+        
+        // URLs
+        if (word_start && c == 'h') {
+            bool partial_http = false;
+            bool partial_https = false;
+            bool http = starts_with(i, "http://", partial_http);
+            bool https = starts_with(i, "https://", partial_https);
+            if (!http && !https && (partial_http || partial_https) && !final) {
+                return 0;
+            }
+            if (http || https) {
+                size_t end = i;
+                while (end < pending.size() && !is_space(pending[end])) end++;
+                if (end == pending.size() && !final && end - i < MAX_LOOKAHEAD * 8) {
+                    return 0;
+                }
+                // Trailing punctuation belongs to the sentence, not the URL
+                while (end > i && std::strchr(".,;:!?)", pending[end - 1])) end--;
+                emit_word(out, "website link");
+                return end - i;
+            }
+        }
+        
+        // Markdown links: keep the text, drop the target
+        if (c == '[') {
+            size_t close = pending.find(']', i + 1);
+            size_t newline = pending.find('\n', i + 1);
+            bool complete = false;
+            if (close != std::string::npos && close - i < MAX_LOOKAHEAD && (newline == std::string::npos || close < newline)) {
+                if (close + 1 >= pending.size()) {
+                    if (!final) return 0;
+                } else if (pending[close + 1] == '(') {
+                    size_t target_end = pending.find(')', close + 2);
+                    if (target_end != std::string::npos) {
+                        emit(out, normalize(pending.substr(i + 1, close - i - 1)));
+                        return target_end + 1 - i;
+                    }
+                    if (!final && pending.size() - i < MAX_LOOKAHEAD * 8) return 0;
+                }
+                complete = true;
+            }
+            if (!complete && close == std::string::npos && newline == std::string::npos &&
+                available < MAX_LOOKAHEAD && !final) {
+                return 0;
+            }
+            emit(out, "[", 1);
+            return 1;
+        }
+        
+        // Ordinals: 1st to 5th
+        if (word_start && c >= '1' && c <= '5') {
+            if (!has(4) && !final) {
+                return 0;
+            }
+            static const char* suffixes[] = {"st", "nd", "rd", "th", "th"};
+            static const char* words[] = {"first", "second", "third", "fourth", "fifth"};
+            int n = c - '1';
+            if (has(3) && pending.compare(i + 1, 2, suffixes[n]) == 0 && (!has(4) || !is_word_char(at(3)))) {
+                emit(out, words[n], std::strlen(words[n]));
+                return 3;
+            }
+        }
+        
+        // Runs of periods: ".." and "..." become a single period
+        if (c == '.') {
+            size_t run = 0;
+            while (run < available && pending[i + run] == '.') run++;
+            if (run == available && !final) {
+                return 0;
+            }
+            if (run >= 2 && (run == available || is_space(pending[i + run]))) {
+                emit_punct(out, '.');
+                return run;
+            }
+            emit(out, pending.data() + i, run);
+            return run;
+        }
+        
+        // Colons are spoken, except in times like 10:30
+        if (c == ':') {
+            if (!has(2) && !final) {
+                return 0;
+            }
+            char next = has(2) ? at(1) : '\0';
+            if ((std::isdigit(static_cast<unsigned char>(prev_in)) && std::isdigit(static_cast<unsigned char>(next))) ||
+                next == ':' || prev_in == ':') {
+                emit(out, ":", 1);
+            } else {
+                emit_word(out, "is");
+            }
+            return 1;
+        }
+        
+        // Hyphens: kept inside words, a pause between words, otherwise "minus"
+        if (c == '-') {
+            if (!has(2) && !final) {
+                return 0;
+            }
+            char next = has(2) ? at(1) : '\0';
+            if (std::isalpha(static_cast<unsigned char>(prev_in)) && std::isalpha(static_cast<unsigned char>(next))) {
+                emit(out, "-", 1);
+            } else if (is_space(prev_in) && (is_space(next) || next == '\0')) {
+                emit_punct(out, ',');
+            } else {
+                emit_word(out, "minus");
+            }
+            return 1;
+        }
+        
+        // Bold and italic markers
+        if (c == '*' || c == '_') {
+            return 1;
+        }
+        
+        // Symbols read as words
+        switch (c) {
+            case '&': emit_word(out, "and"); return 1;
+            case '%': emit_word(out, "percent"); return 1;
+            case '$': emit_word(out, "dollars"); return 1;
+            case '=': emit_word(out, "equals"); return 1;
+            case '+': emit_word(out, "plus"); return 1;
+            case '/': emit_word(out, "divided by"); return 1;
+            case '>': emit_word(out, "greater than"); return 1;
+            case '<': emit_word(out, "less than"); return 1;
+            default: break;
+        }
+        
+        // Emojis and other multi-byte characters
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            size_t count = 0;
+            const Replacement* table = emojis(count);
+            bool any_partial = false;
+            for (size_t k = 0; k < count; k++) {
+                bool partial = false;
+                if (starts_with(i, table[k].from, partial)) {
+                    emit_word(out, table[k].to);
+                    return std::strlen(table[k].from);
+                }
+                any_partial = any_partial || partial;
+            }
+            if (any_partial && !final) {
+                return 0;
+            }
+            
+            // A stray bullet character reads as a pause
+            bool partial = false;
+            if (starts_with(i, "•", partial)) {
+                space_pending = true;
+                return std::strlen("•");
+            }
+            
+            // Pass the whole UTF-8 sequence through
+            unsigned char lead = static_cast<unsigned char>(c);
+            size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+            if (!has(length) && !final) {
+                return 0;
+            }
+            length = has(length) ? length : available;
+            emit(out, pending.data() + i, length);
+            return length;
+        }
+        
+        emit(out, &c, 1);
+        return 1;
+    }
+    
+    void process(std::string& out, bool final) {
+        size_t i = 0;
+        while (i < pending.size()) {
+            size_t consumed = step(i, out, final);
+            if (consumed == 0) {
+                break;
+            }
+            prev_in = pending[i + consumed - 1];
+            i += consumed;
+        }
+        pending.erase(0, i);
+    }
+
+public:
+    // Normalize a complete text in one go
+    static std::string normalize(const std::string& text) {
+        TTSNormalizer normalizer;
+        std::string out;
+        normalizer.feed(text, out);
+        normalizer.flush(out);
+        return out;
+    }
+    
+    // Feed the next chunk of a stream, appending the text that is now final to out
+    void feed(const std::string& chunk, std::string& out) {
+        pending += chunk;
+        process(out, false);
+    }
+    
+    // End the stream: convert anything held back and reset for the next one
+    void flush(std::string& out) {
+        process(out, true);
+        if (line_needs_period && emitted_any && !is_sentence_punct(last_out)) {
+            out += '.';
+        }
+        reset();
+    }
+    
+    void reset() {
+        *this = TTSNormalizer();
+    }
+};
+
+#endif // TTS_NORMALIZER_H
@@ -0,0 +1,142 @@
+#ifndef TURN_PIPELINE_H
+#define TURN_PIPELINE_H
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+// Blocking FIFO with a fixed capacity, connecting two pipeline stages. A
+// full queue makes the producer wait, so a slow stage holds back the ones
+// before it instead of letting work pile up. close() wakes everybody.
+template <typename T>
+class BoundedQueue {
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+public:
+    explicit BoundedQueue(size_t max_items) : capacity(max_items > 0 ? max_items : 1) {}
+    
+    // Add an item, waiting while the queue is full. Returns false, dropping
+    // the item, once the queue is closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+    
+    // Take the oldest item, waiting while the queue is empty. Returns false
+    // once the queue is closed and everything in it has been taken.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+    
+    // Refuse new items. Those already queued can still be taken, unless
+    // drop_queued is set.
+    void close(bool drop_queued = false) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            if (drop_queued) {
+                items.clear();
+            }
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+    
+    // Drop everything queued. Returns how many items were dropped.
+    size_t clear() {
+        size_t dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            dropped = items.size();
+            items.clear();
+        }
+        not_full.notify_all();
+        return dropped;
+    }
+    
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+};
+
+// One stage of a pipeline: a worker thread handling the items submitted to
+// it in order, with a bounded queue in front. Stages hand their results to
+// the next stage by submitting to it from the handler.
+template <typename T>
+class PipelineStage {
+private:
+    BoundedQueue<T> input;
+    std::function<void(T&)> handler;
+    std::thread worker;
+    
+    void run() {
+        T item;
+        while (input.pop(item)) {
+            handler(item);
+        }
+    }
+
+public:
+    PipelineStage(size_t capacity, std::function<void(T&)> handle)
+        : input(capacity), handler(std::move(handle)), worker(&PipelineStage::run, this) {}
+    
+    ~PipelineStage() {
+        finish();
+    }
+    
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+    
+    // Queue an item, waiting while the stage is backed up. Returns false if
+    // the stage has been closed or cancelled.
+    bool submit(T item) {
+        return input.push(std::move(item));
+    }
+    
+    // Handle everything already queued, then stop the worker. Returns once
+    // it has stopped.
+    void finish() {
+        input.close();
+        if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) {
+            worker.join();
+        }
+    }
+    
+    // Stop taking items and drop the queued ones; the item being handled is
+    // left to the handler, which should watch its own cancellation signal.
+    // Does not wait for the worker.
+    void cancel() {
+        input.close(true);
+    }
+    
+    // Items waiting to be handled
+    size_t pending() { return input.size(); }
+};
+
+#endif // TURN_PIPELINE_H
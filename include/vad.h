@@ -3,69 +3,312 @@
 
 #include <vector>
 #include <cmath>
+#include <cstdio>
+#include <cstdint>
 #include <algorithm>
+#include <memory>
+#include <string>
+#include "audio_kernels.h"
+
+// Statistics of a window of audio used to make the speech decision
+struct VADStats {
+    float energy = 0.0f;         // Mean energy per sample
+    float peak_energy = 0.0f;    // Energy of the loudest sample
+    float frequency = 0.0f;      // Frequency estimated from the zero-crossing rate
+    float activity_ratio = 0.0f; // Fraction of samples above the activity level
+};
+
+// Check whether two consecutive samples cross zero
+inline bool is_zero_crossing(float previous, float current) {
+    return (current >= 0 && previous < 0) || (current < 0 && previous >= 0);
+}
+
+// Cheap first check: is the window loud enough to possibly hold speech
+inline bool passes_energy_gate(const VADStats& stats, float threshold) {
+    // Ultra-sensitive minimum for very quiet microphones
+    const float min_detection = 0.0001f;
+    return (stats.energy > threshold) || (stats.energy > min_detection);
+}
+
+// Speech decision shared by detect_voice_activity and VoiceActivityDetector
+inline bool is_speech_window(const VADStats& stats, float threshold, float freq_threshold) {
+    // Smart detection with frequency range checks
+    // Speech typically has frequencies between 85-255 Hz for fundamental frequencies
+    // We'll use a bit wider range to be safe
+    bool is_in_speech_freq_range = (stats.frequency > freq_threshold) && (stats.frequency < 3000.0f);
+    
+    // Speech has sustained energy - require at least 10% of samples to be active
+    bool sustained_activity = stats.activity_ratio > 0.10f;
+    
+    // Energy must be above threshold
+    bool energy_ok = passes_energy_gate(stats, threshold);
+    
+    // More robust detection logic
+    return energy_ok && is_in_speech_freq_range && sustained_activity;
+}
+
+// Print the statistics behind a VAD decision
+inline void print_vad_stats(const VADStats& stats, float threshold) {
+    printf("VAD: Energy: %.6f (threshold: %.6f), Peak: %.6f, Frequency: %.1f Hz, Active: %.1f%%\n",
+           stats.energy, threshold, stats.peak_energy, stats.frequency, stats.activity_ratio * 100.0f);
+}
+
+// A trained speech detector (e.g. Silero) that replaces the frequency and
+// activity heuristics. It only sees windows that pass the energy gate, so
+// silence costs nothing.
+class SpeechClassifier {
+public:
+    virtual ~SpeechClassifier() = default;
+    
+    // Probability that the audio contains speech, from 0 to 1
+    virtual float speech_probability(const float* samples, size_t count) = 0;
+    
+    virtual const char* name() const = 0;
+};
+
+// Load the whisper.cpp VAD model (Silero) at model_path for 16kHz audio.
+// Returns nullptr if it cannot be loaded. Defined in src/whisper_vad.cpp.
+std::unique_ptr<SpeechClassifier> create_whisper_vad_classifier(const std::string& model_path, int threads = 1);
 
 // Enhanced voice activity detection function with state tracking
 // Returns true if speech is detected in the audio buffer
-inline bool detect_voice_activity(const std::vector<float>& audio, int sample_rate, float threshold, float freq_threshold) {
+inline bool detect_voice_activity(const std::vector<float>& audio, int sample_rate, float threshold, float freq_threshold, bool debug = false) {
     if (audio.empty()) {
         return false;
     }
     
-    // Calculate energy of the signal
-    float energy = 0;
-    float peak_energy = 0;
+    VADStats stats;
     
-    for (float sample : audio) {
-        float sample_energy = sample * sample;
-        energy += sample_energy;
-        if (sample_energy > peak_energy) peak_energy = sample_energy;
-    }
-    energy /= audio.size();
+    // Calculate energy of the signal
+    stats.energy = audio_kernels::sum_of_squares(audio.data(), audio.size()) / audio.size();
+    float peak = audio_kernels::abs_max(audio.data(), audio.size());
+    stats.peak_energy = peak * peak;
     
     // Calculate zero-crossing rate for frequency estimation
-    int zero_crossings = 0;
-    for (size_t i = 1; i < audio.size(); i++) {
-        if ((audio[i] >= 0 && audio[i-1] < 0) || (audio[i] < 0 && audio[i-1] >= 0)) {
-            zero_crossings++;
-        }
-    }
+    size_t zero_crossings = audio_kernels::count_zero_crossings(audio.data(), audio.size());
     
     // Estimate frequency
     float duration = static_cast<float>(audio.size()) / sample_rate;
-    float freq = zero_crossings / (2 * duration);
-    
-    // Smart detection with frequency range checks
-    // Speech typically has frequencies between 85-255 Hz for fundamental frequencies
-    // We'll use a bit wider range to be safe
-    bool is_in_speech_freq_range = (freq > freq_threshold) && (freq < 3000.0f);
+    stats.frequency = zero_crossings / (2 * duration);
     
     // Calculate fraction of samples over a minimum energy level
     // This helps distinguish speech (many samples over threshold) from random noise spikes
-    int samples_over_threshold = 0;
     float sample_threshold = threshold * 0.5f;
-    for (float sample : audio) {
-        if (sample * sample > sample_threshold) {
-            samples_over_threshold++;
+    size_t samples_over_threshold = audio_kernels::count_energy_above(audio.data(), audio.size(), sample_threshold);
+    stats.activity_ratio = static_cast<float>(samples_over_threshold) / audio.size();
+    
+    if (debug) {
+        print_vad_stats(stats, threshold);
+    }
+    
+    return is_speech_window(stats, threshold, freq_threshold);
+}
+
+// Incremental voice activity detector over a sliding window.
+// Energy, zero-crossing and activity counts are updated as each sample enters
+// and leaves the window, so the cost per sample is constant regardless of the
+// window length. A decision is made every hop once the window is full, using
+// the same rules as detect_voice_activity.
+class VoiceActivityDetector {
+private:
+    int sample_rate;
+    float threshold;
+    float freq_threshold;
+    bool debug_enabled;
+    
+    size_t window_size;   // Samples in the analysis window
+    size_t hop_size;      // Samples between decisions
+    
+    std::vector<float> window; // Circular window of the newest samples
+    size_t oldest = 0;         // Index of the oldest sample in the window
+    size_t filled = 0;         // Number of valid samples in the window
+    size_t hop_fill = 0;       // Samples received since the last decision
+    size_t since_refresh = 0;  // Samples since the energy sum was recomputed
+    
+    // Running statistics
+    double energy_sum = 0.0;
+    int zero_crossings = 0;    // Crossings between consecutive samples in the window
+    int active_samples = 0;    // Samples above the activity level
+    float sample_threshold;
+    
+    // Monotonic queue of candidate peaks, for the window's peak energy
+    std::vector<uint64_t> peak_positions;
+    std::vector<float> peak_values;
+    size_t peak_head = 0;
+    size_t peak_count = 0;
+    uint64_t position = 0;     // Absolute index of the next sample
+    
+    bool last_decision = false;
+    uint64_t decision_count = 0;
+    VADStats last_stats;
+    
+    // Optional neural second stage
+    SpeechClassifier* classifier = nullptr;
+    float speech_probability_threshold = 0.5f;
+    float last_probability = -1.0f;    // -1 if the classifier did not run
+    uint64_t classifier_runs = 0;
+    std::vector<float> contiguous;     // The window in time order, for the classifier
+    
+    // Recompute the energy sum exactly to stop rounding errors accumulating
+    void refresh_energy() {
+        // The window wraps at most once, so it is two contiguous pieces
+        size_t first = std::min(filled, window_size - oldest);
+        energy_sum = static_cast<double>(audio_kernels::sum_of_squares(window.data() + oldest, first)) +
+                     audio_kernels::sum_of_squares(window.data(), filled - first);
+        since_refresh = 0;
+    }
+    
+    void push_peak(float sample_energy) {
+        // Drop the front candidate once it has left the window
+        if (peak_count > 0 && peak_positions[peak_head] + window_size <= position) {
+            peak_head = (peak_head + 1) % window_size;
+            peak_count--;
         }
+        
+        // Drop candidates that can no longer be the peak
+        while (peak_count > 0) {
+            size_t back = (peak_head + peak_count - 1) % window_size;
+            if (peak_values[back] > sample_energy) break;
+            peak_count--;
+        }
+        
+        size_t slot = (peak_head + peak_count) % window_size;
+        peak_positions[slot] = position;
+        peak_values[slot] = sample_energy;
+        peak_count++;
     }
-    float activity_ratio = static_cast<float>(samples_over_threshold) / audio.size();
     
-    // Speech has sustained energy - require at least 10% of samples to be active
-    bool sustained_activity = activity_ratio > 0.10f;
+    // Add one sample, removing the oldest one if the window is full
+    void push_sample(float sample) {
+        float sample_energy = sample * sample;
+        
+        if (filled == window_size) {
+            float leaving = window[oldest];
+            float next = window[(oldest + 1) % window_size];
+            energy_sum -= static_cast<double>(leaving) * leaving;
+            if (leaving * leaving > sample_threshold) active_samples--;
+            if (window_size > 1 && is_zero_crossing(leaving, next)) zero_crossings--;
+            oldest = (oldest + 1) % window_size;
+            filled--;
+        }
+        
+        if (filled > 0) {
+            float newest = window[(oldest + filled - 1) % window_size];
+            if (is_zero_crossing(newest, sample)) zero_crossings++;
+        }
+        
+        window[(oldest + filled) % window_size] = sample;
+        filled++;
+        energy_sum += static_cast<double>(sample) * sample;
+        if (sample_energy > sample_threshold) active_samples++;
+        
+        push_peak(sample_energy);
+        position++;
+        
+        if (++since_refresh >= window_size) {
+            refresh_energy();
+        }
+    }
     
-    // Ultra-sensitive minimum for very quiet microphones
-    const float min_detection = 0.0001f;
+    // Compute the window statistics and make a decision
+    bool decide() {
+        float duration = static_cast<float>(filled) / sample_rate;
+        last_stats.energy = static_cast<float>(std::max(0.0, energy_sum) / filled);
+        last_stats.peak_energy = peak_count > 0 ? peak_values[peak_head] : 0.0f;
+        last_stats.frequency = zero_crossings / (2 * duration);
+        last_stats.activity_ratio = static_cast<float>(active_samples) / filled;
+        
+        last_probability = -1.0f;
+        if (!classifier) {
+            last_decision = is_speech_window(last_stats, threshold, freq_threshold);
+        } else if (!passes_energy_gate(last_stats, threshold)) {
+            last_decision = false;
+        } else {
+            // Unroll the circular window; it wraps at most once
+            size_t first = std::min(filled, window_size - oldest);
+            contiguous.assign(window.begin() + oldest, window.begin() + oldest + first);
+            contiguous.insert(contiguous.end(), window.begin(), window.begin() + (filled - first));
+            last_probability = classifier->speech_probability(contiguous.data(), contiguous.size());
+            last_decision = last_probability >= speech_probability_threshold;
+            classifier_runs++;
+        }
+        
+        // Print roughly ten times a second, whatever the hop size
+        size_t print_every = std::max<size_t>(1, static_cast<size_t>(sample_rate / 10) / hop_size);
+        if (debug_enabled && decision_count % print_every == 0) {
+            print_vad_stats(last_stats, threshold);
+            if (last_probability >= 0.0f) {
+                printf("VAD: %s speech probability: %.2f\n", classifier->name(), last_probability);
+            }
+        }
+        decision_count++;
+        
+        return last_decision;
+    }
+
+public:
+    VoiceActivityDetector(int rate, int window_ms, int hop_ms, float energy_threshold, float frequency_threshold, bool debug = false)
+        : sample_rate(rate),
+          threshold(energy_threshold),
+          freq_threshold(frequency_threshold),
+          debug_enabled(debug),
+          window_size(std::max<size_t>(1, static_cast<size_t>(window_ms) * rate / 1000)),
+          hop_size(std::max<size_t>(1, static_cast<size_t>(hop_ms) * rate / 1000)),
+          window(window_size),
+          sample_threshold(energy_threshold * 0.5f),
+          peak_positions(window_size),
+          peak_values(window_size) {}
     
-    // Energy must be above threshold
-    bool energy_ok = (energy > threshold) || (energy > min_detection);
+    // Feed samples. on_decision(is_speech, offset) is called after every
+    // completed hop once the window is full, where offset is the number of
+    // samples of this call consumed up to that decision.
+    template <typename Callback>
+    void process(const float* samples, size_t count, Callback&& on_decision) {
+        for (size_t i = 0; i < count; i++) {
+            push_sample(samples[i]);
+            
+            if (++hop_fill >= hop_size) {
+                hop_fill = 0;
+                if (filled == window_size) {
+                    on_decision(decide(), i + 1);
+                }
+            }
+        }
+    }
     
-    // Debug output - always print to help diagnose issues
-    printf("VAD: Energy: %.6f (threshold: %.6f), Peak: %.6f, Frequency: %.1f Hz, Active: %.1f%%\n", 
-           energy, threshold, peak_energy, freq, activity_ratio * 100.0f);
+    // Decide with a trained classifier on windows that pass the energy gate,
+    // instead of the frequency and activity heuristics. Pass nullptr to go
+    // back to the heuristics. The classifier must outlive the detector.
+    void set_classifier(SpeechClassifier* speech_classifier, float probability_threshold = 0.5f) {
+        classifier = speech_classifier;
+        speech_probability_threshold = probability_threshold;
+        contiguous.reserve(window_size);
+    }
     
-    // More robust detection logic
-    return energy_ok && is_in_speech_freq_range && sustained_activity;
-}
+    // Clear all state, e.g. after the capture stream restarts
+    void reset() {
+        oldest = filled = hop_fill = since_refresh = 0;
+        energy_sum = 0.0;
+        zero_crossings = active_samples = 0;
+        peak_head = peak_count = 0;
+        position = 0;
+        last_decision = false;
+        decision_count = 0;
+        last_stats = VADStats();
+        last_probability = -1.0f;
+        classifier_runs = 0;
+    }
+    
+    size_t get_hop_size() const { return hop_size; }
+    size_t get_window_size() const { return window_size; }
+    bool is_speech() const { return last_decision; }
+    const VADStats& get_stats() const { return last_stats; }
+    
+    // Speech probability of the last decision, or -1 if the classifier did not run
+    float get_speech_probability() const { return last_probability; }
+    
+    // Number of windows the classifier has been run on
+    uint64_t get_classifier_runs() const { return classifier_runs; }
+};
 
-#endif // VAD_H
\ No newline at end of file
+#endif // VAD_H
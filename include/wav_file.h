@@ -0,0 +1,137 @@
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Minimal RIFF/WAVE reading and writing for recorded audio fixtures. Reads
+// 16-bit PCM and 32-bit float files with any number of channels, mixing them
+// down to mono floats in [-1, 1]; writes 16-bit mono PCM.
+namespace wav_file {
+
+inline uint32_t read_le32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint16_t read_le16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline void write_le32(std::ostream& out, uint32_t value) {
+    const char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                           static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+    out.write(bytes, 4);
+}
+
+inline void write_le16(std::ostream& out, uint16_t value) {
+    const char bytes[2] = {static_cast<char>(value), static_cast<char>(value >> 8)};
+    out.write(bytes, 2);
+}
+
+// Read a WAV file into mono samples. Returns false and prints an error if
+// the file cannot be read or uses an unsupported format.
+inline bool read(const std::string& path, std::vector<float>& samples, int& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open WAV file " << path << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 12 || std::memcmp(data.data(), "RIFF", 4) != 0 || std::memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        std::cerr << "Error: " << path << " is not a WAV file" << std::endl;
+        return false;
+    }
+    
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    sample_rate = 0;
+    const unsigned char* pcm = nullptr;
+    size_t pcm_bytes = 0;
+    
+    // Walk the chunks; each is padded to an even length
+    size_t pos = 12;
+    while (pos + 8 <= data.size()) {
+        const unsigned char* chunk = data.data() + pos;
+        size_t size = std::min<size_t>(read_le32(chunk + 4), data.size() - pos - 8);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            format = read_le16(chunk + 8);
+            channels = read_le16(chunk + 10);
+            sample_rate = static_cast<int>(read_le32(chunk + 12));
+            bits = read_le16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format in the sub-format GUID
+            if (format == 0xFFFE && size >= 40) {
+                format = read_le16(chunk + 32);
+            }
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            pcm = chunk + 8;
+            pcm_bytes = size;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    
+    const bool is_pcm16 = format == 1 && bits == 16;
+    const bool is_float32 = format == 3 && bits == 32;
+    if (!pcm || channels == 0 || sample_rate <= 0 || (!is_pcm16 && !is_float32)) {
+        std::cerr << "Error: " << path << " must be 16-bit PCM or 32-bit float audio" << std::endl;
+        return false;
+    }
+    
+    const size_t frame_bytes = static_cast<size_t>(channels) * bits / 8;
+    const size_t frames = pcm_bytes / frame_bytes;
+    samples.assign(frames, 0.0f);
+    for (size_t i = 0; i < frames; i++) {
+        const unsigned char* frame = pcm + i * frame_bytes;
+        float sum = 0.0f;
+        for (uint16_t c = 0; c < channels; c++) {
+            if (is_pcm16) {
+                sum += static_cast<int16_t>(read_le16(frame + c * 2)) / 32768.0f;
+            } else {
+                uint32_t bits_value = read_le32(frame + c * 4);
+                float value;
+                std::memcpy(&value, &bits_value, sizeof(value));
+                sum += value;
+            }
+        }
+        samples[i] = sum / channels;
+    }
+    return true;
+}
+
+// Write mono samples as a 16-bit PCM WAV file, clipping to [-1, 1]
+inline bool write(const std::string& path, const std::vector<float>& samples, int sample_rate) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot write WAV file " << path << std::endl;
+        return false;
+    }
+    
+    const uint32_t data_bytes = static_cast<uint32_t>(samples.size() * 2);
+    file.write("RIFF", 4);
+    write_le32(file, 36 + data_bytes);
+    file.write("WAVEfmt ", 8);
+    write_le32(file, 16);
+    write_le16(file, 1); // PCM
+    write_le16(file, 1); // Mono
+    write_le32(file, static_cast<uint32_t>(sample_rate));
+    write_le32(file, static_cast<uint32_t>(sample_rate) * 2);
+    write_le16(file, 2);
+    write_le16(file, 16);
+    file.write("data", 4);
+    write_le32(file, data_bytes);
+    for (float sample : samples) {
+        float clipped = std::max(-1.0f, std::min(1.0f, sample));
+        write_le16(file, static_cast<uint16_t>(static_cast<int16_t>(clipped * 32767.0f)));
+    }
+    return static_cast<bool>(file);
+}
+
+} // namespace wav_file
+
+#endif // WAV_FILE_H
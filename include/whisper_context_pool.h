@@ -0,0 +1,108 @@
+#ifndef WHISPER_CONTEXT_POOL_H
+#define WHISPER_CONTEXT_POOL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "whisper_tuning.h"
+
+// Forward declarations to avoid including the full whisper header
+struct whisper_context;
+struct whisper_state;
+
+// Loads a whisper model once and lends out decoding states created with
+// whisper_init_state, so several utterances (e.g. from different microphones
+// or clients) can be transcribed at the same time with one copy of the
+// weights. The tuning's thread budget is split evenly between the states,
+// and callers waiting for a state are served in arrival order.
+//
+// The pool must outlive every lease taken from it.
+class WhisperContextPool {
+public:
+    // A borrowed decoding state, handed back to the pool when destroyed
+    class Lease {
+    private:
+        WhisperContextPool* pool = nullptr;
+        whisper_state* state_ = nullptr;
+        
+        friend class WhisperContextPool;
+        Lease(WhisperContextPool* owner, whisper_state* state) : pool(owner), state_(state) {}
+    
+    public:
+        Lease() = default;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        
+        Lease(Lease&& other) noexcept : pool(other.pool), state_(other.state_) {
+            other.pool = nullptr;
+            other.state_ = nullptr;
+        }
+        
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool = other.pool;
+                state_ = other.state_;
+                other.pool = nullptr;
+                other.state_ = nullptr;
+            }
+            return *this;
+        }
+        
+        ~Lease() {
+            release();
+        }
+        
+        explicit operator bool() const { return state_ != nullptr; }
+        whisper_state* state() const { return state_; }
+        
+        // Threads this lease may use for whisper_full_with_state
+        int n_threads() const;
+        
+        // Hand the state back early
+        void release();
+    };
+    
+    WhisperContextPool(const std::string& model_path, int n_states, const WhisperTuning& tuning, bool debug = false);
+    ~WhisperContextPool();
+    
+    WhisperContextPool(const WhisperContextPool&) = delete;
+    WhisperContextPool& operator=(const WhisperContextPool&) = delete;
+    
+    // Check if the model loaded and at least one state was created
+    bool is_ready() const { return ctx != nullptr && !states.empty(); }
+    
+    // The shared context holding the model weights
+    whisper_context* context() const { return ctx; }
+    
+    // Wait for a free state
+    Lease acquire();
+    
+    // Take a free state only if nobody is waiting; otherwise an empty lease
+    Lease try_acquire();
+    
+    int size() const { return static_cast<int>(states.size()); }
+    int threads_per_state() const { return per_state_threads; }
+    
+    // Time a short decode with a few thread counts per state and keep the
+    // fastest. Call before handing out any leases.
+    void calibrate();
+
+private:
+    whisper_context* ctx = nullptr;
+    std::vector<whisper_state*> states;      // Every state, for cleanup
+    std::vector<whisper_state*> free_states; // States not lent out
+    int per_state_threads = 1;
+    bool debug_enabled = false;
+    
+    std::mutex pool_mutex;
+    std::condition_variable cv;
+    uint64_t next_ticket = 0; // Ticket for the next caller of acquire()
+    uint64_t now_serving = 0; // Ticket allowed to take the next free state
+    
+    void give_back(whisper_state* state);
+};
+
+#endif // WHISPER_CONTEXT_POOL_H
@@ -0,0 +1,125 @@
+#ifndef WHISPER_TUNING_H
+#define WHISPER_TUNING_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include "config.h"
+
+// Settings whisper is loaded and run with, picked from the hardware and the
+// whisper section of the config
+struct WhisperTuning {
+    int threads = 4;          // Total threads for all decoding states
+    bool use_gpu = true;
+    bool flash_attn = false;
+    int gpu_device = 0;
+    bool calibrate = false;   // Time a few thread counts at startup and keep the fastest
+    bool use_mmap = true;     // Read the model file through a memory mapping
+    bool share_weights = false; // Mark the weights mergeable by KSM
+};
+
+// Count physical cores in /proc/cpuinfo text, from its distinct
+// (physical id, core id) pairs. Returns 0 if it lists no core ids.
+inline int count_physical_cores(const std::string& cpuinfo) {
+    std::set<std::pair<int, int>> cores;
+    std::istringstream in(cpuinfo);
+    std::string line;
+    int package = 0;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+        int value = std::atoi(line.c_str() + colon + 1);
+        if (key == "processor") {
+            package = 0;
+        } else if (key == "physical id") {
+            package = value;
+        } else if (key == "core id") {
+            cores.insert({package, value});
+        }
+    }
+    return static_cast<int>(cores.size());
+}
+
+// Number of physical CPU cores, ignoring SMT siblings. Falls back to the
+// number of hardware threads if the topology is not available.
+inline int detect_physical_cores() {
+    std::ifstream file("/proc/cpuinfo");
+    if (file.is_open()) {
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        int cores = count_physical_cores(buffer.str());
+        if (cores > 0) {
+            return cores;
+        }
+    }
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Check whisper_print_system_info() output for a GPU backend compiled in.
+// Older builds print "CUDA = 1", newer ones only list enabled backends.
+inline bool system_info_has_gpu(const std::string& info) {
+    static const char* backends[] = {"CUDA", "METAL", "VULKAN", "SYCL", "CANN", "HIP", "MUSA", "OPENCL"};
+    for (const char* name : backends) {
+        std::string backend(name);
+        size_t pos = 0;
+        while ((pos = info.find(backend, pos)) != std::string::npos) {
+            size_t after = pos + backend.size();
+            while (after < info.size() && info[after] == ' ') after++;
+            bool disabled = info.compare(after, 3, "= 0") == 0;
+            if (!disabled && after < info.size() && (info[after] == '=' || info[after] == ':')) {
+                return true;
+            }
+            pos = after;
+        }
+    }
+    return false;
+}
+
+// Pick whisper settings. Cores busy with audio capture and speech are left
+// free unless the config sets the thread count itself.
+inline WhisperTuning choose_whisper_tuning(const WhisperConfig& config, int physical_cores, bool gpu_available) {
+    WhisperTuning tuning;
+    
+    // By default leave a core for the capture thread and one for TTS and the LLM client
+    int reserved = config.reserved_cores >= 0 ? config.reserved_cores : 2;
+    tuning.threads = config.threads > 0 ? config.threads : std::max(1, physical_cores - reserved);
+    
+    // With the encoder on the GPU, extra CPU threads mostly wait
+    tuning.use_gpu = config.use_gpu && gpu_available;
+    if (tuning.use_gpu && config.threads <= 0) {
+        tuning.threads = std::min(tuning.threads, 4);
+    }
+    
+    tuning.flash_attn = config.flash_attn && tuning.use_gpu;
+    tuning.gpu_device = config.gpu_device;
+    tuning.calibrate = config.calibrate;
+    tuning.use_mmap = config.mmap;
+    tuning.share_weights = config.share_weights;
+    return tuning;
+}
+
+// Thread counts worth timing during calibration: the chosen count and a few
+// smaller ones, since memory bandwidth often makes fewer threads faster
+inline std::vector<int> calibration_candidates(int threads) {
+    std::vector<int> candidates;
+    for (int n = threads; n >= 1; n = n * 3 / 4) {
+        if (candidates.empty() || candidates.back() != n) {
+            candidates.push_back(n);
+        }
+        if (candidates.size() == 4 || n == 1) {
+            break;
+        }
+    }
+    return candidates;
+}
+
+#endif // WHISPER_TUNING_H
@@ -14,10 +14,10 @@ command -v make >/dev/null 2>&1 || { echo "Error: make is required but not insta
 if command -v apt-get >/dev/null 2>&1; then
     echo "Installing system dependencies..."
     sudo apt-get update
-    sudo apt-get install -y libcurl4-openssl-dev nlohmann-json3-dev alsa-utils espeak libespeak-dev git build-essential
+    sudo apt-get install -y libcurl4-openssl-dev nlohmann-json3-dev alsa-utils espeak libespeak-dev libespeak-ng-dev git build-essential
 elif command -v yum >/dev/null 2>&1; then
     echo "Installing system dependencies (CentOS/RHEL/Fedora)..."
-    sudo yum install -y libcurl-devel alsa-utils espeak git gcc-c++ make
+    sudo yum install -y libcurl-devel alsa-utils espeak espeak-ng-devel git gcc-c++ make
     # nlohmann-json might need manual installation
     if [ ! -f "/usr/include/nlohmann/json.hpp" ]; then
         echo "Installing nlohmann/json..."
@@ -42,6 +42,9 @@ if [ ! -d "whisper.cpp" ]; then
     
     echo "Downloading whisper model..."
     ./models/download-ggml-model.sh base.en
+    
+    echo "Downloading Silero VAD model..."
+    ./models/download-vad-model.sh silero-v5.1.2
     cd ..
 fi
 
@@ -0,0 +1,206 @@
+#include "audio_source.h"
+#include <alsa/asoundlib.h>
+#include <iostream>
+#include <atomic>
+
+namespace {
+
+// Captures mono S16 from an ALSA device, at the requested rate if the
+// device supports it and the nearest rate it offers otherwise. The device
+// is opened non-blocking and read() sleeps in snd_pcm_wait until a period
+// is ready, so audio is picked up as soon as the driver has it.
+class AlsaAudioSource : public AudioSource {
+private:
+    std::string device;
+    snd_pcm_t* pcm_handle = nullptr;
+    unsigned int device_rate = 0;
+    std::atomic<uint64_t> overruns{0};
+    
+    bool fail(const char* what, int err) {
+        std::cerr << "Error: " << what << ": " << snd_strerror(err) << std::endl;
+        close();
+        return false;
+    }
+    
+    // Restart capture after an overrun or a suspend. Returns false for
+    // other errors.
+    bool recover(int err) {
+        if (err == -EPIPE) {
+            overruns.fetch_add(1);
+            std::cerr << "Warning: Capture overrun, audio was lost" << std::endl;
+            err = snd_pcm_prepare(pcm_handle);
+        } else if (err == -ESTRPIPE) {
+            err = snd_pcm_recover(pcm_handle, err, 1);
+        }
+        if (err >= 0) {
+            err = snd_pcm_start(pcm_handle);
+        }
+        if (err < 0) {
+            std::cerr << "Error: Cannot read from audio interface: " << snd_strerror(err) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    explicit AlsaAudioSource(const std::string& dev) : device(dev) {}
+    
+    ~AlsaAudioSource() override {
+        close();
+    }
+    
+    bool open(int sample_rate) override {
+        close();
+        
+        int err;
+        // Open ALSA device for capture
+        if ((err = snd_pcm_open(&pcm_handle, device.c_str(), SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK)) < 0) {
+            std::cerr << "Error: Cannot open audio device " << device << ": " << snd_strerror(err) << std::endl;
+            std::cerr << "Hint: You may need to adjust the audio.device in config.json or use --input-device" << std::endl;
+            pcm_handle = nullptr;
+            return false;
+        }
+        
+        std::cout << "Debug: Successfully opened audio device: " << device << std::endl;
+        
+        // Set hardware parameters
+        snd_pcm_hw_params_t* hw_params;
+        snd_pcm_hw_params_alloca(&hw_params);
+        snd_pcm_hw_params_any(pcm_handle, hw_params);
+        
+        // Set access type
+        err = snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+        if (err < 0) {
+            return fail("Cannot set access type", err);
+        }
+        std::cout << "Debug: Set access type to interleaved" << std::endl;
+        
+        // Set sample format (16-bit signed little endian)
+        err = snd_pcm_hw_params_set_format(pcm_handle, hw_params, SND_PCM_FORMAT_S16_LE);
+        if (err < 0) {
+            return fail("Cannot set sample format", err);
+        }
+        std::cout << "Debug: Set sample format to 16-bit signed little endian" << std::endl;
+        
+        // Set sample rate. The capture thread resamples if the device cannot run at it.
+        const unsigned int rate = static_cast<unsigned int>(sample_rate);
+        device_rate = rate;
+        err = snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &device_rate, 0);
+        if (err < 0) {
+            return fail("Cannot set sample rate", err);
+        }
+        
+        if (device_rate != rate) {
+            std::cout << "Info: Device captures at " << device_rate << " Hz, resampling to " << rate << " Hz" << std::endl;
+        } else {
+            std::cout << "Debug: Set sample rate to " << rate << " Hz" << std::endl;
+        }
+        
+        // Set channels (mono)
+        err = snd_pcm_hw_params_set_channels(pcm_handle, hw_params, 1);
+        if (err < 0) {
+            return fail("Cannot set channels", err);
+        }
+        std::cout << "Debug: Set channels to mono (1 channel)" << std::endl;
+        
+        // Half a second of buffer rides out a capture thread that is held
+        // up, while 20 ms periods still wake read() promptly
+        snd_pcm_uframes_t buffer_size = device_rate / 2;
+        err = snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params, &buffer_size);
+        if (err < 0) {
+            return fail("Cannot set buffer size", err);
+        }
+        snd_pcm_uframes_t period_size = device_rate / 50;
+        snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params, &period_size, nullptr);
+        
+        // Apply hardware parameters
+        err = snd_pcm_hw_params(pcm_handle, hw_params);
+        if (err < 0) {
+            return fail("Cannot set hardware parameters", err);
+        }
+        
+        // Prepare device for use
+        err = snd_pcm_prepare(pcm_handle);
+        if (err < 0) {
+            return fail("Cannot prepare audio interface", err);
+        }
+        
+        // Start now, since snd_pcm_wait only returns once capture runs
+        err = snd_pcm_start(pcm_handle);
+        if (err < 0) {
+            return fail("Cannot start audio capture", err);
+        }
+        return true;
+    }
+    
+    void close() override {
+        if (pcm_handle) {
+            snd_pcm_close(pcm_handle);
+            pcm_handle = nullptr;
+        }
+    }
+    
+    int sample_rate() const override { return static_cast<int>(device_rate); }
+    
+    long read(int16_t* buffer, size_t frames) override {
+        size_t got = 0;
+        while (got < frames) {
+            // Sleep in the driver until a period is ready, for 100 ms at
+            // most, so the capture thread still notices when to stop
+            int ready = snd_pcm_wait(pcm_handle, 100);
+            if (ready == 0) {
+                break;
+            }
+            if (ready < 0) {
+                if (!recover(ready)) {
+                    return -1;
+                }
+                continue;
+            }
+            
+            snd_pcm_sframes_t count = snd_pcm_readi(pcm_handle, buffer + got, frames - got);
+            if (count == -EAGAIN) {
+                continue;
+            }
+            if (count < 0) {
+                if (!recover(static_cast<int>(count))) {
+                    return -1;
+                }
+                continue;
+            }
+            got += static_cast<size_t>(count);
+        }
+        return static_cast<long>(got);
+    }
+    
+    std::string name() const override { return device; }
+    
+    uint64_t overrun_count() const override { return overruns.load(); }
+};
+
+} // namespace
+
+std::unique_ptr<AudioSource> create_alsa_audio_source(const std::string& device) {
+    return std::make_unique<AlsaAudioSource>(device);
+}
+
+std::unique_ptr<AudioSource> create_audio_source(const AudioConfig& config) {
+    AudioSourceSpec spec;
+    if (!parse_audio_source(config.device, spec)) {
+        return nullptr;
+    }
+    
+    switch (spec.kind) {
+        case AudioSourceSpec::Kind::File:
+            return std::make_unique<PcmFileSource>(spec.path);
+        case AudioSourceSpec::Kind::Stdin:
+            return std::make_unique<FdPcmSource>(STDIN_FILENO);
+        case AudioSourceSpec::Kind::Tcp:
+            return std::make_unique<TcpPcmSource>(spec.host, spec.port);
+        case AudioSourceSpec::Kind::Udp:
+            return std::make_unique<UdpPcmSource>(spec.host, spec.port);
+        case AudioSourceSpec::Kind::Alsa:
+            break;
+    }
+    return create_alsa_audio_source(spec.path);
+}
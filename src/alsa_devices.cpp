@@ -0,0 +1,142 @@
+#include "audio_devices.h"
+#include <alsa/asoundlib.h>
+#include <mutex>
+#include <cstring>
+
+namespace {
+
+// Open a hardware PCM without blocking and read the ranges it supports.
+// Leaves info unprobed if the device is busy or cannot be opened.
+void probe_capabilities(AudioDeviceInfo& info) {
+    snd_pcm_t* pcm = nullptr;
+    const snd_pcm_stream_t stream = info.capture ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK;
+    if (snd_pcm_open(&pcm, info.name.c_str(), stream, SND_PCM_NONBLOCK) < 0) {
+        return;
+    }
+    
+    snd_pcm_hw_params_t* params;
+    snd_pcm_hw_params_alloca(&params);
+    if (snd_pcm_hw_params_any(pcm, params) >= 0 &&
+        snd_pcm_hw_params_get_rate_min(params, &info.min_rate, nullptr) >= 0 &&
+        snd_pcm_hw_params_get_rate_max(params, &info.max_rate, nullptr) >= 0 &&
+        snd_pcm_hw_params_get_channels_min(params, &info.min_channels) >= 0 &&
+        snd_pcm_hw_params_get_channels_max(params, &info.max_channels) >= 0) {
+        info.s16 = snd_pcm_hw_params_test_format(pcm, params, SND_PCM_FORMAT_S16_LE) == 0;
+        info.probed = true;
+    }
+    snd_pcm_close(pcm);
+}
+
+// The hardware PCMs of every card, the same that arecord -l and aplay -l list
+void enumerate_cards(std::vector<AudioDeviceInfo>& devices) {
+    snd_ctl_card_info_t* card_info;
+    snd_pcm_info_t* pcm_info;
+    snd_ctl_card_info_alloca(&card_info);
+    snd_pcm_info_alloca(&pcm_info);
+    
+    int card = -1;
+    while (snd_card_next(&card) >= 0 && card >= 0) {
+        const std::string control_name = "hw:" + std::to_string(card);
+        snd_ctl_t* control = nullptr;
+        if (snd_ctl_open(&control, control_name.c_str(), 0) < 0) {
+            continue;
+        }
+        if (snd_ctl_card_info(control, card_info) < 0) {
+            snd_ctl_close(control);
+            continue;
+        }
+        const std::string card_id = snd_ctl_card_info_get_id(card_info);
+        const std::string card_name = snd_ctl_card_info_get_name(card_info);
+        
+        int device = -1;
+        while (snd_ctl_pcm_next_device(control, &device) >= 0 && device >= 0) {
+            for (bool capture : {true, false}) {
+                snd_pcm_info_set_device(pcm_info, static_cast<unsigned int>(device));
+                snd_pcm_info_set_subdevice(pcm_info, 0);
+                snd_pcm_info_set_stream(pcm_info, capture ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK);
+                if (snd_ctl_pcm_info(control, pcm_info) < 0) {
+                    continue; // No such direction
+                }
+                
+                AudioDeviceInfo info;
+                info.name = control_name + "," + std::to_string(device);
+                info.card_id = card_id;
+                info.card = card;
+                info.device = device;
+                info.capture = capture;
+                const std::string pcm_name = snd_pcm_info_get_name(pcm_info);
+                info.description = pcm_name.empty() ? card_name : card_name + ": " + pcm_name;
+                probe_capabilities(info);
+                devices.push_back(info);
+            }
+        }
+        snd_ctl_close(control);
+    }
+}
+
+// Plugins from the ALSA configuration with short names, such as "default",
+// "pulse" or "pipewire". The per-card aliases (front:, dsnoop: and so on)
+// are left out, as the cards are listed already.
+void enumerate_plugins(std::vector<AudioDeviceInfo>& devices) {
+    void** hints = nullptr;
+    if (snd_device_name_hint(-1, "pcm", &hints) < 0) {
+        return;
+    }
+    
+    for (void** hint = hints; *hint; hint++) {
+        char* name = snd_device_name_get_hint(*hint, "NAME");
+        char* desc = snd_device_name_get_hint(*hint, "DESC");
+        char* ioid = snd_device_name_get_hint(*hint, "IOID");
+        
+        if (name && !std::strchr(name, ':') && std::strcmp(name, "null") != 0) {
+            AudioDeviceInfo info;
+            info.name = name;
+            if (desc) {
+                // Descriptions span two lines, e.g. "PulseAudio Sound Server\n..."
+                info.description = desc;
+                info.description = info.description.substr(0, info.description.find('\n'));
+            }
+            // Without an IOID the plugin works both ways
+            if (!ioid || std::strcmp(ioid, "Input") == 0) {
+                info.capture = true;
+                devices.push_back(info);
+            }
+            if (!ioid || std::strcmp(ioid, "Output") == 0) {
+                info.capture = false;
+                devices.push_back(info);
+            }
+        }
+        std::free(name);
+        std::free(desc);
+        std::free(ioid);
+    }
+    snd_device_name_free_hint(hints);
+}
+
+} // namespace
+
+std::vector<AudioDeviceInfo> enumerate_alsa_devices() {
+    std::vector<AudioDeviceInfo> devices;
+    enumerate_plugins(devices);
+    
+    const size_t plugins = devices.size();
+    enumerate_cards(devices);
+    if (devices.size() == plugins) {
+        // No access to the control devices; /proc still tells what is there
+        for (const auto& info : list_proc_audio_devices()) {
+            devices.push_back(info);
+        }
+    }
+    return devices;
+}
+
+const std::vector<AudioDeviceInfo>& probe_audio_devices() {
+    static std::once_flag probed;
+    static std::vector<AudioDeviceInfo> devices;
+    std::call_once(probed, [] { devices = enumerate_alsa_devices(); });
+    return devices;
+}
+
+std::string alsa_library_version() {
+    return snd_asoundlib_version();
+}
@@ -0,0 +1,131 @@
+#include "speech_synthesizer.h"
+#include <alsa/asoundlib.h>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+namespace {
+
+// Plays PCM through one ALSA playback handle that stays open between
+// utterances, mirroring how StreamingAudioInput keeps its capture handle
+class AlsaPcmSink : public PcmSink {
+private:
+    std::string device;
+    snd_pcm_t* pcm_handle = nullptr;
+    int current_rate = 0;
+    std::atomic<uint64_t> underruns{0};
+    
+    void close_device() {
+        if (pcm_handle) {
+            snd_pcm_close(pcm_handle);
+            pcm_handle = nullptr;
+        }
+        current_rate = 0;
+    }
+
+public:
+    explicit AlsaPcmSink(const std::string& dev) : device(dev) {}
+    
+    ~AlsaPcmSink() override {
+        close_device();
+    }
+    
+    bool begin(int sample_rate) override {
+        if (pcm_handle && sample_rate == current_rate) {
+            return true;
+        }
+        
+        close_device();
+        
+        int err = snd_pcm_open(&pcm_handle, device.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+        if (err < 0) {
+            std::cerr << "Error: Cannot open audio output device " << device << ": " << snd_strerror(err) << std::endl;
+            pcm_handle = nullptr;
+            return false;
+        }
+        
+        // Mono S16, letting alsa-lib resample if the device needs it. About
+        // 100 ms of buffering keeps cancellation quick.
+        err = snd_pcm_set_params(pcm_handle, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                                 1, static_cast<unsigned int>(sample_rate), 1, 100000);
+        if (err < 0) {
+            std::cerr << "Error: Cannot configure audio output device " << device << ": " << snd_strerror(err) << std::endl;
+            close_device();
+            return false;
+        }
+        
+        current_rate = sample_rate;
+        return true;
+    }
+    
+    bool write(const int16_t* samples, size_t count) override {
+        if (!pcm_handle) {
+            return false;
+        }
+        
+        while (count > 0) {
+            snd_pcm_sframes_t written = snd_pcm_writei(pcm_handle, samples, count);
+            if (written == -EAGAIN) {
+                continue;
+            }
+            if (written < 0) {
+                // Recover from underruns and suspends, then try again
+                if (written == -EPIPE) {
+                    underruns.fetch_add(1);
+                }
+                int err = snd_pcm_recover(pcm_handle, static_cast<int>(written), 1);
+                if (err < 0) {
+                    std::cerr << "Error: Cannot write to audio output device: " << snd_strerror(err) << std::endl;
+                    return false;
+                }
+                continue;
+            }
+            samples += written;
+            count -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+    
+    void drain() override {
+        if (pcm_handle) {
+            snd_pcm_drain(pcm_handle);
+            snd_pcm_prepare(pcm_handle);
+        }
+    }
+    
+    void drop() override {
+        if (pcm_handle) {
+            snd_pcm_drop(pcm_handle);
+            snd_pcm_prepare(pcm_handle);
+        }
+    }
+    
+    // Wait for playback to finish in short steps, so a cancel can cut it off
+    bool wait_played(const std::atomic<bool>& cancelled) override {
+        if (!pcm_handle) {
+            return true;
+        }
+        while (!cancelled.load()) {
+            snd_pcm_sframes_t delay = 0;
+            if (snd_pcm_delay(pcm_handle, &delay) < 0 || delay <= 0) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (cancelled.load()) {
+            drop();
+            return false;
+        }
+        drain();
+        return true;
+    }
+    
+    uint64_t underrun_count() const override { return underruns.load(); }
+};
+
+} // namespace
+
+std::unique_ptr<PcmSink> create_alsa_pcm_sink(const std::string& device) {
+    return std::make_unique<AlsaPcmSink>(device);
+}
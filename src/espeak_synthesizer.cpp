@@ -0,0 +1,85 @@
+#include "speech_synthesizer.h"
+#include <iostream>
+
+#ifdef HAVE_ESPEAK_NG
+#include <espeak-ng/speak_lib.h>
+
+namespace {
+
+// Passed to the synth callback through espeak's user_data
+struct SynthContext {
+    PcmSink* sink;
+    const std::atomic<bool>* cancelled;
+    bool write_failed;
+};
+
+// Called from espeak_Synth with each block of audio. Returning 1 aborts synthesis.
+int synth_callback(short* wav, int numsamples, espeak_EVENT* events) {
+    SynthContext* context = events ? static_cast<SynthContext*>(events->user_data) : nullptr;
+    if (!context || context->cancelled->load()) {
+        return 1;
+    }
+    if (wav && numsamples > 0 && !context->sink->write(wav, static_cast<size_t>(numsamples))) {
+        context->write_failed = true;
+        return 1;
+    }
+    return 0;
+}
+
+// libespeak-ng in synchronous mode, so audio is produced on the calling
+// thread and passed straight to the sink. espeak-ng keeps global state, so
+// only one of these should exist at a time.
+class EspeakSynthesizer : public SpeechSynthesizer {
+private:
+    int rate;
+
+public:
+    explicit EspeakSynthesizer(int sample_rate) : rate(sample_rate) {}
+    
+    ~EspeakSynthesizer() override {
+        espeak_Terminate();
+    }
+    
+    bool synthesize(const std::string& text, PcmSink& sink, const std::atomic<bool>& cancelled) override {
+        SynthContext context{&sink, &cancelled, false};
+        espeak_ERROR err = espeak_Synth(text.c_str(), text.size() + 1, 0, POS_CHARACTER, 0,
+                                        espeakCHARS_UTF8, nullptr, &context);
+        if (err != EE_OK) {
+            std::cerr << "Error: espeak-ng synthesis failed" << std::endl;
+            return false;
+        }
+        return !context.write_failed && !cancelled.load();
+    }
+    
+    int sample_rate() const override {
+        return rate;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<SpeechSynthesizer> create_espeak_synthesizer(const TTSConfig& config) {
+    // Hand audio to the callback in blocks of about 50 ms
+    int rate = espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 50, nullptr, 0);
+    if (rate <= 0) {
+        std::cerr << "Error: Failed to initialize espeak-ng" << std::endl;
+        return nullptr;
+    }
+    
+    espeak_SetSynthCallback(synth_callback);
+    
+    if (espeak_SetVoiceByName(config.voice.c_str()) != EE_OK) {
+        std::cerr << "Warning: espeak-ng voice " << config.voice << " not found, using the default voice" << std::endl;
+    }
+    espeak_SetParameter(espeakRATE, config.speed, 0);
+    
+    return std::make_unique<EspeakSynthesizer>(rate);
+}
+
+#else
+
+std::unique_ptr<SpeechSynthesizer> create_espeak_synthesizer(const TTSConfig&) {
+    return nullptr;
+}
+
+#endif // HAVE_ESPEAK_NG
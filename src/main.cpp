@@ -11,18 +11,30 @@
 #include <algorithm>
 #include <nlohmann/json.hpp>
 #include <iomanip>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
 
 #include "audio_input.h"
 #include "whisper_stt.h"
 #include "ollama_client.h"
 #include "tts_engine.h"
 #include "config.h"
+#include "system_probe.h"
+#include "audio_devices.h"
+#include "response_cache.h"
+#include "conversation_logger.h"
+#include "thread_scheduling.h"
 
 // Include streaming components if enabled
 #ifdef ENABLE_STREAMING
 #include "streaming_audio_input.h"
 #include "streaming_whisper_stt.h"
+#include "turn_pipeline.h"
+#include "speculative_reply.h"
 #include "vad.h"
+#include "session_manager.h"
 #endif
 
 // Global flag for handling Ctrl+C - this is referenced in other files via extern
@@ -40,85 +52,200 @@ void signal_handler(int signal) {
 }
 
 // Forward declarations
-bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, const std::string& log_file = "");
+bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, ConversationLogger* logger = nullptr, QuickReplies* quick_replies = nullptr);
 void run_diagnostics(AudioConfig& audio_config, WhisperConfig& whisper_config);
+void check_audio_device(const std::string& device, bool capture);
 void gather_system_info(SystemInfo& info);
-void log_conversation(const std::string& log_file, const std::string& speaker, const std::string& message);
+std::string format_system_info(const Config& config);
+std::string config_relative_path(const std::string& path, const std::string& config_path);
+bool answer_quickly(QuickReplies* quick_replies, TTSEngine* tts, const std::string& transcript, std::string& reply, bool debug);
 
 // Forward declarations
-bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, const std::string& log_file = "");
+bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, ConversationLogger* logger = nullptr, bool persistent_capture = false, LatencyMetrics* metrics = nullptr, int speculative_stable_ms = 0, QuickReplies* quick_replies = nullptr, bool report_latency = false);
+std::unique_ptr<StreamingAudioInput> create_streaming_audio(const Config& config, const AudioConfig& audio_config, OllamaClient* ollama, TTSEngine* tts, bool debug);
+int run_serving_mode(Config& config, const std::string& config_path, bool debug, bool enable_logging, const std::string& log_file_path);
 bool is_silence_marker(const std::string& text);
 bool has_exit_keyword(const std::string& text);
 bool has_over_keyword(const std::string& text);
+std::string strip_over_keyword(const std::string& text);
 
-// Implementation of streaming assistant cycle
-bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, const std::string& log_file) {
-    bool should_exit = false;
+// Decodes the utterance in progress in the background so a live transcript is
+// available while the user is still speaking. With a speculative reply, a
+// partial transcript that stays the same for stable_ms is answered ahead of
+// the end of the utterance.
+class PartialTranscriber {
+private:
+    StreamingAudioInput* audio;
+    StreamingWhisperSTT* whisper;
+    SpeculativeReply* speculation;
+    std::chrono::milliseconds stable_time;
+    bool debug_enabled;
+    std::atomic<bool> running{true};
+    std::thread worker;
+    
+    void run() {
+        std::vector<float> speech;
+        std::string last_partial;
+        auto last_change = std::chrono::steady_clock::now();
+        while (running.load() && g_running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(whisper->get_partial_step_ms()));
+            
+            uint64_t utterance_id = 0;
+            if (!audio->get_active_speech(speech, &utterance_id)) {
+                continue;
+            }
+            
+            std::string partial = whisper->process_partial(speech, audio->get_sample_rate(), utterance_id);
+            if (!partial.empty() && partial != last_partial) {
+                std::cout << "... " << partial << std::endl;
+                last_partial = partial;
+                last_change = std::chrono::steady_clock::now();
+                
+                // A reply to the old text no longer fits
+                if (speculation) {
+                    speculation->invalidate();
+                }
+            } else if (speculation && !partial.empty() &&
+                       std::chrono::steady_clock::now() - last_change >= stable_time &&
+                       !has_exit_keyword(partial) && !is_silence_marker(partial)) {
+                // The user has most likely finished; start on the reply while
+                // the end of the utterance is still being confirmed
+                if (speculation->start(strip_over_keyword(partial)) && debug_enabled) {
+                    std::cout << "Debug: Replying ahead to \"" << partial << "\"" << std::endl;
+                }
+            }
+        }
+    }
+    
+public:
+    PartialTranscriber(StreamingAudioInput* audio_input, StreamingWhisperSTT* stt,
+                       SpeculativeReply* speculative_reply = nullptr, int stable_ms = 0, bool debug = false)
+        : audio(audio_input), whisper(stt), speculation(speculative_reply),
+          stable_time(stable_ms), debug_enabled(debug), worker(&PartialTranscriber::run, this) {}
+    
+    ~PartialTranscriber() {
+        running.store(false);
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+};
+
+// An utterance handed from the capture stage to transcription
+struct CapturedUtterance {
+    std::vector<float> audio;
+    uint64_t id = 0;
+    std::chrono::steady_clock::time_point speech_end;
+};
+
+// A transcript handed from transcription to the reply stage, with the
+// times the reply stage needs to start the turn's latency record
+struct TranscribedUtterance {
+    std::string text;
+    bool rejected = false; // Empty or a silence marker
+    std::chrono::steady_clock::time_point speech_end;
+    std::chrono::steady_clock::time_point stt_start;
+    std::chrono::steady_clock::time_point stt_end;
+};
+
+// Implementation of streaming assistant cycle. Capture, transcription, the
+// reply from Ollama and speech each run on their own thread, connected by
+// bounded queues, so the next utterance can be captured and transcribed
+// while the previous one is being answered.
+bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, ConversationLogger* logger, bool persistent_capture, LatencyMetrics* metrics, int speculative_stable_ms, QuickReplies* quick_replies, bool report_latency) {
+    std::atomic<bool> should_exit{false};
+    LatencyMetrics disabled_metrics; // Records nothing, so marks need no null checks
+    if (!metrics) {
+        metrics = &disabled_metrics;
+    }
     int silence_counter = 0;
     const int max_silence_turns = 5; // Exit after this many consecutive silent turns
     bool continuous_mode = true; // Always run in continuous mode for streaming
     
-    // Make sure the audio capture is started
-    if (!audio->start()) {
-        std::cerr << "Error: Failed to start audio capture" << std::endl;
-        return true; // Signal that we should exit
+    // Background speaker used when replies are streamed sentence by sentence
+    TTSSpeechQueue speech_queue(*tts);
+    
+    // Replies started on a stable partial transcript. Only streamed replies
+    // can be held back until the final transcript confirms them.
+    std::unique_ptr<SpeculativeReply> speculation;
+    if (speculative_stable_ms > 0 && whisper->is_incremental() && ollama->is_streaming()) {
+        auto speculative_turn = std::make_shared<std::atomic<uint64_t>>(0);
+        speculation = std::make_unique<SpeculativeReply>(
+            [ollama, speculative_turn](const std::string& prompt, const SpeculativeReply::SentenceCallback& on_sentence,
+                                       uint64_t token) {
+                std::string reply = ollama->process_streaming(prompt, on_sentence, token);
+                speculative_turn->store(ollama->last_turn_id());
+                return reply;
+            },
+            [ollama] { return ollama->request_token(); },
+            [ollama](uint64_t token) { ollama->cancel(token); },
+            [ollama, speculative_turn] {
+                // A reply that completed before it was cancelled joined the history
+                ollama->forget_turn(speculative_turn->exchange(0));
+            });
+    } else if (speculative_stable_ms > 0) {
+        std::cerr << "Warning: Speculative replies need incremental whisper and streamed Ollama replies" << std::endl;
     }
     
-    // Pass the running flag pointer to the whisper engine for interrupt handling
-    whisper->set_running_flag(&g_running);
-    
-    std::cout << "\nStarting streaming voice assistant. Speak to begin." << std::endl;
+    // Live transcription while the user is speaking
+    std::unique_ptr<PartialTranscriber> partial_transcriber;
+    if (whisper->is_incremental()) {
+        partial_transcriber = std::make_unique<PartialTranscriber>(audio, whisper, speculation.get(),
+                                                                   speculative_stable_ms, debug);
+    }
     
-    while (g_running && !should_exit) {
-        std::cout << "\nListening... (press Ctrl+C to stop)" << std::endl;
-        
-        // Wait for speech with a timeout
-        std::vector<float> speech_audio = audio->wait_for_speech(20000); // 20 second timeout
-        
-        // Check if the global running flag was set to 0 by the signal handler
-        if (!g_running) {
-            std::cout << "Ctrl+C detected. Exiting..." << std::endl;
-            audio->stop();
-            return true; // Signal that the app should exit
+    // Utterances handed to the pipeline and not yet answered. Without
+    // persistent capture the microphone stays closed until this is zero.
+    std::mutex turn_mutex;
+    std::condition_variable turn_done;
+    int turns_in_flight = 0;
+    auto finish_turn = [&] {
+        {
+            std::lock_guard<std::mutex> lock(turn_mutex);
+            turns_in_flight--;
         }
-        
-        if (speech_audio.empty()) {
-            std::cout << "No speech detected. Continuing to listen..." << std::endl;
-            
-            // Count consecutive silent turns
-            silence_counter++;
-            if (silence_counter >= max_silence_turns && !continuous_mode) {
-                std::cout << "Multiple silent turns detected. Ending conversation." << std::endl;
-                audio->stop();
-                break;
+        turn_done.notify_all();
+    };
+    
+    // Reply stage: one turn at a time, since every reply depends on the
+    // conversation so far. Streamed sentences go on to the TTS queue.
+    PipelineStage<TranscribedUtterance> reply_stage(2, [&](TranscribedUtterance& turn) {
+        // No new speculative reply while this turn is answered; one that is
+        // not adopted by the end of the turn is thrown away
+        struct SpeculationPause {
+            SpeculativeReply* speculation;
+            explicit SpeculationPause(SpeculativeReply* s) : speculation(s) {
+                if (speculation) speculation->pause();
             }
-            
-            continue; // Try again
-        }
-        
-        // Reset the silence counter since we detected speech
-        silence_counter = 0;
-        
-        // Stop audio capture temporarily during processing to avoid interference
-        audio->stop();
-        
-        // Process the audio with whisper
-        std::cout << "Transcribing..." << std::endl;
-        std::string transcript = whisper->process_audio(speech_audio, audio->get_sample_rate());
+            ~SpeculationPause() {
+                if (speculation) {
+                    speculation->discard();
+                    speculation->resume();
+                }
+            }
+        } speculation_pause(speculation.get());
         
-        // Check again after transcription in case Ctrl+C was pressed during processing
-        if (!g_running) {
-            std::cout << "Ctrl+C detected. Exiting..." << std::endl;
-            return true; // Signal that the app should exit
+        // Taken after the pause, so discarding the speculative reply does
+        // not cancel it, and before the checks, so Ctrl+C or a barge-in from
+        // here on stops the request below even if it has not been sent yet
+        const uint64_t request_token = ollama->request_token();
+        if (should_exit.load() || !g_running) {
+            finish_turn();
+            return;
         }
         
+        metrics->begin_turn(turn.speech_end);
+        metrics->mark(TurnEvent::SttStart, turn.stt_start);
+        metrics->mark(TurnEvent::SttEnd, turn.stt_end);
+        
         // Check if transcript is empty or a silence marker
-        if (transcript.empty() || is_silence_marker(transcript)) {
+        if (turn.rejected) {
             std::cout << "Empty transcript or silence marker detected. Continuing to listen..." << std::endl;
-            // Restart audio capture for next turn
-            audio->start();
-            continue;
+            metrics->end_turn(true);
+            finish_turn();
+            return;
         }
+        const std::string& transcript = turn.text;
         
         // Display what was heard
         std::cout << "\n------------------------------" << std::endl;
@@ -126,8 +253,8 @@ bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperS
         std::cout << "------------------------------" << std::endl;
         
         // Log the conversation if enabled
-        if (!log_file.empty()) {
-            log_conversation(log_file, "User", transcript);
+        if (logger) {
+            logger->log("User", transcript);
         }
         
         // Check for exit keywords before processing
@@ -140,13 +267,18 @@ bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperS
             std::cout << "------------------------------" << std::endl;
             
             // Log the farewell if enabled
-            if (!log_file.empty()) {
-                log_conversation(log_file, "Vibe", goodbye);
+            if (logger) {
+                logger->log("Vibe", goodbye);
             }
             
             tts->speak(goodbye);
-            should_exit = true;
-            break;
+            metrics->end_turn();
+            
+            // Stop the capture stage, which then stops the others
+            should_exit.store(true);
+            audio->interrupt_wait();
+            finish_turn();
+            return;
         }
         
         // Process with Ollama
@@ -154,18 +286,53 @@ bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperS
             std::cout << "Info: Processing with Ollama..." << std::endl;
         }
         
+        // Streamed replies start playing during generation, so ignore the
+        // microphone from here until the reply has been spoken
+        if (persistent_capture) {
+            audio->set_echo_gate(true);
+        }
+        
         // Remove "over" from the end of the transcript for processing
-        std::string clean_transcript = transcript;
-        size_t over_pos = clean_transcript.find(" over");
-        if (over_pos != std::string::npos && over_pos > 0 && 
-            (over_pos + 5 >= clean_transcript.length() || 
-             clean_transcript[over_pos + 5] == '.' || 
-             clean_transcript[over_pos + 5] == '!' ||
-             clean_transcript[over_pos + 5] == '?')) {
-            clean_transcript = clean_transcript.substr(0, over_pos);
+        std::string clean_transcript = strip_over_keyword(transcript);
+        
+        std::string response;
+        auto speak_sentence = [&speech_queue](const std::string& sentence) {
+            speech_queue.enqueue(sentence);
+        };
+        const bool quick = answer_quickly(quick_replies, tts, clean_transcript, response, debug);
+        if (quick) {
+            // Drop a speculative reply first, so forgetting it cannot take
+            // this turn out of the history again
+            if (speculation) {
+                speculation->discard();
+            }
+            ollama->add_turn(clean_transcript, response);
+            
+            // Spoken as a whole below, or as one item on the queue
+            if (ollama->is_streaming()) {
+                speak_sentence(response);
+            }
+        } else if (speculation && speculation->adopt(clean_transcript, speak_sentence, response)) {
+            // The reply was started on the partial transcript and only held back
+            if (debug) {
+                std::cout << "Info: Using the reply started before the end of speech" << std::endl;
+            }
+        } else if (ollama->is_streaming()) {
+            // Speak each sentence as soon as it has been generated
+            if (debug) {
+                std::cout << "Info: Streaming response to speech..." << std::endl;
+            }
+            response = ollama->process_streaming(clean_transcript, speak_sentence, request_token);
+        } else {
+            response = ollama->process(clean_transcript, request_token);
+        }
+        if (quick_replies && !quick && ollama->last_reply_complete()) {
+            quick_replies->remember(clean_transcript, response);
         }
         
-        std::string response = ollama->process(clean_transcript);
+        // Replies that are not streamed arrive all at once
+        metrics->mark(TurnEvent::LlmFirstByte);
+        metrics->mark(TurnEvent::LlmLastByte);
         
         // Display output in chat format
         std::cout << "\n------------------------------" << std::endl;
@@ -173,35 +340,178 @@ bool run_streaming_assistant_cycle(StreamingAudioInput* audio, StreamingWhisperS
         std::cout << "------------------------------" << std::endl;
         
         // Log the conversation if enabled
-        if (!log_file.empty()) {
-            log_conversation(log_file, "Vibe", response);
+        if (logger) {
+            logger->log("Vibe", response);
         }
         
         // Convert to speech
-        if (debug) {
-            std::cout << "Info: Converting to speech..." << std::endl;
+        if (ollama->is_streaming()) {
+            // Wait for the remaining queued sentences to finish playing
+            speech_queue.wait_until_done();
+        } else {
+            if (debug) {
+                std::cout << "Info: Converting to speech..." << std::endl;
+            }
+            tts->speak(response);
+        }
+        
+        // Turns are always counted, but only reported when metrics are on
+        LatencyMetrics::Turn timings = metrics->end_turn();
+        if (report_latency) {
+            std::cout << "Latency: " << LatencyMetrics::describe(timings) << std::endl;
+            if (logger) {
+                logger->log_timings(timings);
+            }
         }
-        tts->speak(response);
         
-        // Restart audio capture for next turn
-        // We do this AFTER the TTS is done speaking to avoid capturing the assistant's own speech
+        // Summarize turns that dropped out of the history while the next
+        // utterance is captured. Only here, once the reply is settled, and
+        // not when a speculative reply that may be thrown away is added.
+        ollama->update_summary();
+        
+        // Listen again only once the TTS is done speaking, to avoid
+        // capturing the assistant's own speech
         std::cout << "Ready for next input..." << std::endl;
-        audio->start();
+        if (persistent_capture) {
+            audio->set_echo_gate(false);
+            
+            // A barge-in only counts while the gate is closed, and its
+            // callback has finished by the time the gate opens, so once it is
+            // open the cancelled TTS engine can safely be made ready again
+            if (audio->take_barge_in()) {
+                std::cout << "Interrupted. Listening..." << std::endl;
+                speech_queue.cancel();
+                tts->reset_cancel();
+            }
+        }
+        finish_turn();
+    });
+    
+    // Transcription stage
+    PipelineStage<CapturedUtterance> stt_stage(2, [&](CapturedUtterance& utterance) {
+        if (should_exit.load() || !g_running) {
+            finish_turn();
+            return;
+        }
         
-        // In streaming mode, always continue unless exit keyword
-        should_exit = false;
+        // Process the audio with whisper
+        std::cout << "Transcribing..." << std::endl;
+        TranscribedUtterance turn;
+        turn.speech_end = utterance.speech_end;
+        turn.stt_start = std::chrono::steady_clock::now();
+        if (whisper->is_incremental()) {
+            // Only the part not yet committed by the partial passes is decoded
+            turn.text = whisper->finalize(std::move(utterance.audio), audio->get_sample_rate(), utterance.id);
+        } else {
+            turn.text = whisper->process_audio(std::move(utterance.audio), audio->get_sample_rate());
+        }
+        turn.stt_end = std::chrono::steady_clock::now();
+        turn.rejected = turn.text.empty() || is_silence_marker(turn.text);
         
-        // Small delay before next cycle
-        // Check for interrupt during the delay
-        for (int i = 0; i < 5 && g_running; i++) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!reply_stage.submit(std::move(turn))) {
+            finish_turn();
         }
+    });
+    
+    // Make sure the audio capture is started
+    if (!audio->start()) {
+        std::cerr << "Error: Failed to start audio capture" << std::endl;
+        return true; // Signal that we should exit
     }
     
-    // Stop audio capture
+    // Pass the running flag pointer to the whisper engine for interrupt handling
+    whisper->set_running_flag(&g_running);
+    
+    std::cout << "\nStarting streaming voice assistant. Speak to begin." << std::endl;
+    
+    // Capture stage, on this thread
+    bool interrupted = false; // Ctrl+C: drop the work in progress instead of finishing it
+    while (g_running && !should_exit.load()) {
+        std::cout << "\nListening... (press Ctrl+C to stop)" << std::endl;
+        
+        // Wait for speech with a timeout
+        CapturedUtterance utterance;
+        utterance.speech_end = std::chrono::steady_clock::now();
+        utterance.audio = audio->wait_for_speech(20000, &utterance.id, &utterance.speech_end); // 20 second timeout
+        
+        // Check if the global running flag was set to 0 by the signal handler
+        if (!g_running) {
+            std::cout << "Ctrl+C detected. Exiting..." << std::endl;
+            interrupted = true;
+            break;
+        }
+        if (should_exit.load()) {
+            break;
+        }
+        
+        if (utterance.audio.empty()) {
+            // A recording or stream has run out; the turns still in the
+            // pipeline are answered before exiting
+            if (audio->has_input_ended()) {
+                std::cout << "Audio input ended. Exiting..." << std::endl;
+                should_exit.store(true);
+                break;
+            }
+            
+            std::cout << "No speech detected. Continuing to listen..." << std::endl;
+            
+            // Count consecutive silent turns
+            silence_counter++;
+            if (silence_counter >= max_silence_turns && !continuous_mode) {
+                std::cout << "Multiple silent turns detected. Ending conversation." << std::endl;
+                break;
+            }
+            
+            continue; // Try again
+        }
+        
+        // Reset the silence counter since we detected speech
+        silence_counter = 0;
+        {
+            std::lock_guard<std::mutex> lock(turn_mutex);
+            turns_in_flight++;
+        }
+        
+        // Stop audio capture temporarily during processing to avoid interference,
+        // unless it keeps running for the whole session
+        if (!persistent_capture) {
+            audio->stop();
+        }
+        
+        if (!stt_stage.submit(std::move(utterance))) {
+            finish_turn();
+        }
+        
+        if (!persistent_capture) {
+            // Listen again once the reply has been spoken. The signal handler
+            // cannot notify, so Ctrl+C is noticed at the next check.
+            std::unique_lock<std::mutex> lock(turn_mutex);
+            while (turns_in_flight > 0 && g_running && !should_exit.load()) {
+                turn_done.wait_for(lock, std::chrono::milliseconds(200));
+            }
+            lock.unlock();
+            if (g_running && !should_exit.load()) {
+                audio->start();
+            }
+        }
+    }
+    
+    // Cancellation reaches every stage: queued work is dropped, and the
+    // request and speech in progress are stopped
+    if (interrupted || !g_running) {
+        stt_stage.cancel();
+        reply_stage.cancel();
+        ollama->cancel();
+        speech_queue.cancel();
+    }
+    
+    // Answer whatever is still queued (the stages skip it after an exit
+    // keyword), then stop audio capture
+    stt_stage.finish();
+    reply_stage.finish();
     audio->stop();
     
-    return should_exit;
+    return should_exit.load() || interrupted;
 }
 
 // Interactive setup function
@@ -337,6 +647,7 @@ int main(int argc, char** argv) {
     bool setup_mode = false;
     bool enable_logging = false;
     bool streaming_mode = false;
+    bool serve_mode = false;
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -362,12 +673,15 @@ int main(int argc, char** argv) {
             enable_logging = true;
         } else if (arg == "--streaming-mode") {
             streaming_mode = true;
+        } else if (arg == "--serve") {
+            serve_mode = true;
         } else if (arg == "--help") {
             std::cout << "Usage: voice_assistant [options]\n"
                       << "Options:\n"
                       << "  --config FILE         Path to configuration file\n"
                       << "  --continuous          Run in continuous mode\n"
-                      << "  --input-device DEV    Specify audio input device\n"
+                      << "  --input-device DEV    Specify audio input device, a WAV/raw file, - for stdin,\n"
+                      << "                        or tcp://[HOST]:PORT / udp://[HOST]:PORT for streamed PCM\n"
                       << "  --output-device DEV   Specify audio output device\n"
                       << "  --list-devices        List available audio devices\n"
                       << "  --debug               Run in debug mode with extra diagnostics\n"
@@ -375,6 +689,8 @@ int main(int argc, char** argv) {
                       << "  --log, --enable-logging  Enable conversation logging to a file\n"
                       << "  --log-file PATH       Specify log file path (default: conversation_log.txt)\n" 
                       << "  --streaming-mode      Enable real-time audio streaming mode\n"
+                      << "  --serve               Serve every session in the serving section of the config\n"
+                      << "                        at once, each with its own devices (implies streaming mode)\n"
                       << "  --help                Show this help message\n\n"
                       << "Voice commands:\n"
                       << "  \"over\"               Signal the end of your turn in a conversation\n"
@@ -418,10 +734,23 @@ int main(int argc, char** argv) {
         config.tts.output_device = output_device;
     }
     
-    // If list_devices is true, set devices to "list" to trigger listing
-    if (list_devices) {
-        config.audio.device = "list";
-        config.tts.output_device = "list";
+    // List the devices from the shared probe. "list" as a configured device
+    // does the same and then falls back to the default device.
+    if (list_devices || config.audio.device == "list" || config.tts.output_device == "list") {
+        const auto& devices = probe_audio_devices();
+        std::cout << "Available audio input devices:" << std::endl;
+        print_audio_devices(devices, true);
+        std::cout << "Available audio output devices:" << std::endl;
+        print_audio_devices(devices, false);
+        if (config.audio.device == "list") {
+            config.audio.device = "default";
+        }
+        if (config.tts.output_device == "list") {
+            config.tts.output_device = "default";
+        }
+    } else {
+        check_audio_device(config.audio.device, true);
+        check_audio_device(config.tts.output_device, false);
     }
     
     // Gather system information
@@ -438,21 +767,81 @@ int main(int argc, char** argv) {
     }
     config.system_info.current_time = current_time;
     
-    // Format system info with current configuration details
-    std::stringstream detailed_info;
-    detailed_info << config.system_info.get_formatted_info() << "\n"
-                  << "- Current configuration:\n"
-                  << "  * Speech-to-text model: " << config.whisper.model << " (Whisper)\n"
-                  << "  * Language model: " << config.ollama.model << " (Ollama)\n"
-                  << "  * Voice: " << config.tts.voice << " (ESpeak)\n";
-                  
-    std::string system_info_str = detailed_info.str();
-    std::cout << "\nSystem Information:\n" << system_info_str << std::endl;
+    // Many sessions in one process, set up and run on their own path
+    if (serve_mode && !list_devices) {
+        return run_serving_mode(config, config_path, debug_mode, enable_logging, log_file_path);
+    }
     
     // Initialize Ollama and TTS components (common to both modes)
-    std::unique_ptr<OllamaClient> ollama = std::make_unique<OllamaClient>(config.ollama, system_info_str);
+    std::unique_ptr<OllamaClient> ollama = std::make_unique<OllamaClient>(config.ollama, format_system_info(config));
     std::unique_ptr<TTSEngine> tts = std::make_unique<TTSEngine>(config.tts);
     
+    // Keep whisper, the Ollama client and every other thread started from
+    // here off the cores given to capture and playback; threads inherit the
+    // affinity of the thread that creates them
+    if (!list_devices) {
+        ThreadPolicy workers;
+        workers.cpus = worker_cpus(config.scheduling, allowed_cpus());
+        if (workers.is_set()) {
+            apply_thread_policy(workers, "worker", debug_mode);
+        }
+        tts->set_playback_policy(audio_thread_policy(config.scheduling, false));
+    }
+    
+    // Load the models in the background while the audio devices are set up,
+    // so the first turn does not wait for them: the Ollama server loads its
+    // model after a request with no prompt, and the whisper model is read in
+    // on a thread of its own
+    auto startup_begin = std::chrono::steady_clock::now();
+    std::future<std::string> ollama_startup;
+    std::future<std::unique_ptr<StreamingWhisperSTT>> whisper_startup;
+    if (!list_devices) {
+        const OllamaClient* ollama_ptr = ollama.get();
+        ollama_startup = std::async(std::launch::async, [ollama_ptr] {
+            std::string version = ollama_ptr->server_version();
+            if (!version.empty()) {
+                ollama_ptr->warm_up();
+            }
+            return version;
+        });
+        
+        if (streaming_mode) {
+            whisper_startup = std::async(std::launch::async, [whisper_config = config.whisper, debug_mode] {
+                return std::make_unique<StreamingWhisperSTT>(whisper_config, debug_mode);
+            });
+        }
+    }
+    
+    // Prefer in-process synthesis straight into a long-lived ALSA handle
+    if (config.tts.native && config.tts.engine == "espeak") {
+        if (!TTSEngine::is_alsa_device(tts->get_output_device())) {
+            std::cout << "Info: Output device is not an ALSA device, using the espeak command for speech" << std::endl;
+        } else if (auto synthesizer = create_espeak_synthesizer(config.tts)) {
+            tts->set_native_backend(std::move(synthesizer), create_alsa_pcm_sink(tts->get_output_device()));
+            
+            // Keep the phrase cache next to the config file
+            std::string cache_file = config_relative_path(config.tts.phrase_cache_file, config_path);
+            size_t synthesized = tts->warm_phrase_cache(config.tts.cached_phrases, cache_file);
+            if (debug_mode) {
+                std::cout << "Info: " << tts->cached_phrase_count() << " cached phrases ("
+                          << synthesized << " synthesized now)" << std::endl;
+            }
+        } else if (debug_mode) {
+            std::cout << "Info: Built without espeak-ng, using the espeak command for speech" << std::endl;
+        }
+    }
+    
+    // Per-turn latency of the streaming pipeline
+    LatencyMetrics latency_metrics;
+    if (config.metrics.enabled) {
+        latency_metrics.enable(config.metrics.jsonl_file, config.metrics.prometheus_file);
+        ollama->set_metrics(&latency_metrics);
+        tts->set_metrics(&latency_metrics);
+        
+        const TTSEngine* tts_ptr = tts.get();
+        latency_metrics.add_counter("playback_underruns", [tts_ptr] { return tts_ptr->underrun_count(); });
+    }
+    
     // Initialize mode-specific components
     // Streaming mode components
     std::unique_ptr<StreamingAudioInput> streaming_audio;
@@ -465,18 +854,15 @@ int main(int argc, char** argv) {
     // Initialize appropriate components based on mode
     if (streaming_mode) {
         // Set up streaming components
-        streaming_audio = std::make_unique<StreamingAudioInput>(config.audio, debug_mode);
-        streaming_whisper = std::make_unique<StreamingWhisperSTT>(config.whisper, debug_mode);
-        
-        // Set VAD parameters if defined in config
-        if (config.streaming.enabled) {
-            VADParams vad_params;
-            vad_params.threshold = config.streaming.vad_threshold;
-            vad_params.freq_threshold = config.streaming.vad_freq_threshold;
-            vad_params.min_speech_ms = config.streaming.min_speech_ms;
-            vad_params.max_silence_ms = config.streaming.max_silence_ms;
-            vad_params.padding_ms = config.streaming.padding_ms;
-            streaming_audio->set_vad_params(vad_params);
+        streaming_audio = create_streaming_audio(config, config.audio, ollama.get(), tts.get(), debug_mode);
+        if (config.metrics.enabled) {
+            const StreamingAudioInput* audio_ptr = streaming_audio.get();
+            latency_metrics.add_counter("capture_overruns", [audio_ptr] { return audio_ptr->get_overrun_count(); });
+        }
+        
+        // Open the microphone while the whisper model is still loading
+        if (!list_devices) {
+            streaming_audio->start();
         }
     } else {
         // Set up file-based components
@@ -484,6 +870,32 @@ int main(int argc, char** argv) {
         whisper = std::make_unique<WhisperSTT>(config.whisper);
     }
     
+    // Wait for the background startup work
+    if (whisper_startup.valid()) {
+        streaming_whisper = whisper_startup.get();
+    }
+    if (ollama_startup.valid()) {
+        std::string version = ollama_startup.get();
+        if (!version.empty()) {
+            config.system_info.ollama_version = version;
+        }
+    }
+    if (debug_mode && !list_devices) {
+        auto startup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startup_begin).count();
+        std::cout << "Debug: Models ready after " << startup_ms << " ms" << std::endl;
+    }
+    
+    std::string system_info_str = format_system_info(config);
+    ollama->set_system_info(system_info_str);
+    std::cout << "\nSystem Information:\n" << system_info_str << std::endl;
+    
+    // Replies given without a round trip to Ollama
+    std::unique_ptr<QuickReplies> quick_replies;
+    if (config.response_cache.enabled || config.response_cache.quick_intents) {
+        quick_replies = std::make_unique<QuickReplies>(config.response_cache, config.ollama, config.system_info);
+    }
+    
     if (debug_mode) {
         std::cout << "Info: Vibe Voice Assistant Configuration:" << std::endl;
         std::cout << "Info: - Speech recognition: Whisper (" << config.whisper.model << " model)" << std::endl;
@@ -528,6 +940,7 @@ int main(int argc, char** argv) {
     }
     
     // Set up logging
+    std::unique_ptr<ConversationLogger> logger;
     if (enable_logging) {
         if (log_file_path.empty()) {
             // Use default log file with timestamp
@@ -538,16 +951,14 @@ int main(int argc, char** argv) {
             log_file_path = log_name.str();
         }
         
-        // Test if we can write to the log file
-        std::ofstream test_log(log_file_path, std::ios::app);
-        if (!test_log) {
+        // Written on a background thread, so turns never wait for the disk
+        logger = std::make_unique<ConversationLogger>(log_file_path, config.logging);
+        if (!logger->open()) {
             std::cerr << "Error: Cannot write to log file at " << log_file_path << std::endl;
             std::cerr << "Disabling logging..." << std::endl;
-            enable_logging = false;
+            logger.reset();
         } else {
-            std::time_t now = std::time(nullptr);
-            test_log << "=== Conversation started at " << std::ctime(&now) << "===" << std::endl;
-            test_log.close();
+            logger->log_event("Conversation started");
             std::cout << "Info: Logging conversation to " << log_file_path << std::endl;
         }
     }
@@ -564,7 +975,12 @@ int main(int argc, char** argv) {
             ollama.get(), 
             tts.get(), 
             debug_mode, 
-            enable_logging ? log_file_path : ""
+            logger.get(),
+            config.streaming.persistent_capture,
+            &latency_metrics,
+            config.streaming.speculative_reply ? config.streaming.speculative_stable_ms : 0,
+            quick_replies.get(),
+            config.metrics.enabled
         );
     } else
     if (continuous_mode) {
@@ -575,388 +991,367 @@ int main(int argc, char** argv) {
         bool should_exit = false;
         while (g_running && !should_exit) {
             should_exit = run_assistant_cycle(audio.get(), whisper.get(), ollama.get(), tts.get(), debug_mode, 
-                                             enable_logging ? log_file_path : "");
+                                             logger.get(), quick_replies.get());
         }
     } else {
         // Run in single-cycle file-based mode
         std::cout << "Info: Press Ctrl+C to exit or say 'exit', 'quit', 'goodbye', or 'end conversation'." << std::endl;
         std::cout << "\n--- Starting Conversation ---\n" << std::endl;
         run_assistant_cycle(audio.get(), whisper.get(), ollama.get(), tts.get(), debug_mode,
-                           enable_logging ? log_file_path : "");
+                           logger.get(), quick_replies.get());
     }
     
     std::cout << "Voice Assistant Exiting" << std::endl;
+    if (latency_metrics.is_enabled()) {
+        std::cout << latency_metrics.summary();
+    }
     
-    // Log conversation end if logging is enabled
-    if (enable_logging) {
-        std::ofstream log_file(log_file_path, std::ios::app);
-        if (log_file) {
-            std::time_t now = std::time(nullptr);
-            log_file << "=== Conversation ended at " << std::ctime(&now) << "===" << std::endl;
-            log_file.close();
-        }
+    // Log conversation end if logging is enabled, and write out the rest
+    if (logger) {
+        logger->log_event("Conversation ended");
+        logger->close();
     }
     
     return 0;
 }
 
-// Function to log conversation exchanges to a file
-void log_conversation(const std::string& log_file, const std::string& speaker, const std::string& message) {
-    if (log_file.empty()) return;
-    
-    std::ofstream log(log_file, std::ios::app);
-    if (!log) {
-        std::cerr << "Error: Failed to open log file: " << log_file << std::endl;
-        return;
+// Format system info with current configuration details
+std::string format_system_info(const Config& config) {
+    std::stringstream detailed_info;
+    detailed_info << config.system_info.get_formatted_info() << "\n"
+                  << "- Current configuration:\n"
+                  << "  * Speech-to-text model: " << config.whisper.model << " (Whisper)\n"
+                  << "  * Language model: " << config.ollama.model << " (Ollama)\n"
+                  << "  * Voice: " << config.tts.voice << " (ESpeak)\n";
+    return detailed_info.str();
+}
+
+// A relative path from the config, taken as relative to the config file
+std::string config_relative_path(const std::string& path, const std::string& config_path) {
+    if (path.empty() || path[0] == '/') {
+        return path;
+    }
+    size_t slash = config_path.find_last_of('/');
+    return (slash == std::string::npos ? "" : config_path.substr(0, slash + 1)) + path;
+}
+
+// Set up a streaming audio input reading from audio_config's device, with
+// the capture thread policy, VAD and barge-in from config. Capture is not
+// started yet.
+std::unique_ptr<StreamingAudioInput> create_streaming_audio(const Config& config, const AudioConfig& audio_config, OllamaClient* ollama, TTSEngine* tts, bool debug) {
+    auto audio = std::make_unique<StreamingAudioInput>(audio_config, debug);
+    audio->set_thread_policy(audio_thread_policy(config.scheduling, true));
+    
+    // Set VAD parameters if defined in config
+    if (config.streaming.enabled) {
+        audio->set_vad_params(make_vad_params(config.streaming));
+        
+        // Windows loud enough to be speech are checked by the Silero model,
+        // so fan and other steady noise does not start a transcription
+        if (!config.streaming.vad_model.empty()) {
+            if (audio_config.sample_rate != 16000) {
+                std::cerr << "Warning: The VAD model needs a 16000 Hz sample_rate, using the energy VAD" << std::endl;
+            } else if (auto classifier = create_whisper_vad_classifier(config.streaming.vad_model)) {
+                std::cout << "Info: Using the " << classifier->name() << " VAD model" << std::endl;
+                audio->set_speech_classifier(std::move(classifier));
+            }
+        }
     }
     
-    // Get current timestamp
-    auto now = std::chrono::system_clock::now();
-    auto now_time_t = std::chrono::system_clock::to_time_t(now);
-    std::tm now_tm = *std::localtime(&now_time_t);
-    
-    // Format timestamp as [HH:MM:SS]
-    log << "[" << std::put_time(&now_tm, "%H:%M:%S") << "] " 
-        << speaker << ": " << message << std::endl;
+    // Leave room for whisper's tail padding so utterances are padded in place
+    audio->set_output_reserve_ms(config.whisper.tail_padding_ms);
     
-    log.close();
+    // Talking over the assistant stops generation and playback. This needs
+    // the microphone open while the reply plays.
+    if (config.streaming.persistent_capture && config.streaming.barge_in) {
+        audio->set_barge_in_callback([ollama, tts] {
+            ollama->cancel();
+            tts->cancel();
+        });
+    }
+    return audio;
 }
 
-// Gather system information
-void gather_system_info(SystemInfo& info) {
-    // Get current date and time
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-    std::stringstream date_ss;
-    date_ss << std::ctime(&now_time);
-    info.build_date = date_ss.str();
-    if (!info.build_date.empty() && info.build_date.back() == '\n') {
-        info.build_date.pop_back();  // Remove trailing newline
+// One room or client of the serving mode, with everything it does not share
+struct ServedSession {
+    SessionConfig config;
+    LatencyMetrics metrics;
+    std::unique_ptr<OllamaClient> ollama;
+    std::unique_ptr<TTSEngine> tts;
+    std::unique_ptr<StreamingAudioInput> audio;
+    std::unique_ptr<StreamingWhisperSTT> whisper;
+    std::unique_ptr<ConversationLogger> logger;
+};
+
+// Serve every session in config.serving from this process until Ctrl+C.
+// The sessions share the whisper model and its decoding states, the
+// connections to the Ollama server, the cached replies and the synthesized
+// phrases; each has its own audio devices, voice activity state, history
+// and speaker. Sessions take their turn at the whisper states and the LLM
+// slots in arrival order, so none can starve the others.
+int run_serving_mode(Config& config, const std::string& config_path, bool debug, bool enable_logging, const std::string& log_file_path) {
+    const std::vector<SessionConfig>& session_configs = config.serving.sessions;
+    if (session_configs.empty()) {
+        std::cerr << "Error: --serve needs at least one session in the serving section of " << config_path << std::endl;
+        return 1;
+    }
+    for (const auto& session_config : session_configs) {
+        check_audio_device(session_config.input_device, true);
+        check_audio_device(session_config.output_device, false);
     }
     
-    // Get current timestamp for the assistant
-    auto current_time = std::chrono::system_clock::now();
-    std::time_t current_time_t = std::chrono::system_clock::to_time_t(current_time);
-    std::stringstream current_time_ss;
-    current_time_ss << std::ctime(&current_time_t);
-    info.current_time = current_time_ss.str();
-    if (!info.current_time.empty() && info.current_time.back() == '\n') {
-        info.current_time.pop_back();  // Remove trailing newline
+    // The throughput summary is per CPU the process was given
+    const size_t cpus = allowed_cpus().size();
+    
+    // As with a single session, keep every other thread off the cores given
+    // to capture and playback
+    ThreadPolicy workers;
+    workers.cpus = worker_cpus(config.scheduling, allowed_cpus());
+    if (workers.is_set()) {
+        apply_thread_policy(workers, "worker", debug);
     }
     
-    // Get OS information in simplified format
-    FILE* pipe = popen("cat /etc/os-release | grep -E '^NAME=' | cut -d'=' -f2", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream os_ss;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            os_ss << buffer;
-        }
-        std::string os_name = os_ss.str();
-        if (!os_name.empty() && os_name.back() == '\n') {
-            os_name.pop_back();  // Remove trailing newline
+    // Load the models in the background while the devices are opened; the
+    // whisper model is loaded once for every session
+    auto startup_begin = std::chrono::steady_clock::now();
+    auto whisper_startup = std::async(std::launch::async, [whisper_config = config.whisper, debug] {
+        return std::make_unique<StreamingWhisperSTT>(whisper_config, debug);
+    });
+    auto startup_client = std::make_unique<OllamaClient>(config.ollama);
+    auto ollama_startup = std::async(std::launch::async, [client = startup_client.get()] {
+        std::string version = client->server_version();
+        if (!version.empty()) {
+            client->warm_up();
         }
+        return version;
+    });
+    
+    // Shared by the sessions
+    auto connections = std::make_shared<CurlShare>();
+    std::shared_ptr<JobSlots> llm_slots;
+    if (config.serving.llm_slots > 0) {
+        llm_slots = std::make_shared<JobSlots>(config.serving.llm_slots);
+    }
+    std::unique_ptr<SharedSynthesizer> synthesizer;
+    bool synthesizer_tried = false;
+    std::shared_ptr<PhraseCache> phrases;
+    
+    std::string log_base = log_file_path;
+    if (enable_logging && log_base.empty()) {
+        auto t = std::time(nullptr);
+        auto tm = *std::localtime(&t);
+        std::ostringstream log_name;
+        log_name << "conversation_" << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".log";
+        log_base = log_name.str();
+    }
+    
+    std::vector<std::unique_ptr<ServedSession>> sessions;
+    for (const auto& session_config : session_configs) {
+        auto session = std::make_unique<ServedSession>();
+        session->config = session_config;
+        const std::string& name = session_config.name;
         
-        // Remove quotes if present
-        if (os_name.front() == '"' && os_name.back() == '"') {
-            os_name = os_name.substr(1, os_name.length() - 2);
-        }
+        session->ollama = std::make_unique<OllamaClient>(config.ollama, format_system_info(config));
+        session->ollama->set_connection_share(connections);
+        session->ollama->set_request_slots(llm_slots);
         
-        // Get OS version
-        pclose(pipe);
-        pipe = popen("cat /etc/os-release | grep -E '^VERSION=' | cut -d'=' -f2", "r");
-        if (pipe) {
-            std::stringstream version_ss;
-            while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-                version_ss << buffer;
-            }
-            std::string version = version_ss.str();
-            if (!version.empty() && version.back() == '\n') {
-                version.pop_back();
-            }
-            
-            // Remove quotes if present
-            if (version.front() == '"' && version.back() == '"') {
-                version = version.substr(1, version.length() - 2);
-            }
-            
-            if (!version.empty()) {
-                info.os_info = os_name + " " + version;
-            } else {
-                info.os_info = os_name;
-            }
-            
-            pclose(pipe);
-        } else {
-            info.os_info = os_name;
-        }
+        TTSConfig tts_config = config.tts;
+        tts_config.output_device = session_config.output_device;
+        session->tts = std::make_unique<TTSEngine>(tts_config);
+        session->tts->set_playback_policy(audio_thread_policy(config.scheduling, false));
         
-    } else {
-        // Fallback to uname if /etc/os-release doesn't exist
-        pipe = popen("uname -s", "r");
-        if (pipe) {
-            std::stringstream kernel_ss;
-            char buffer[256];
-            while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-                kernel_ss << buffer;
+        // espeak-ng keeps global state, so the sessions take turns at one
+        // synthesizer and each plays through a sink of its own
+        if (config.tts.native && config.tts.engine == "espeak") {
+            if (!synthesizer_tried) {
+                synthesizer_tried = true;
+                if (auto espeak = create_espeak_synthesizer(config.tts)) {
+                    synthesizer = std::make_unique<SharedSynthesizer>(std::move(espeak));
+                } else if (debug) {
+                    std::cout << "Info: Built without espeak-ng, using the espeak command for speech" << std::endl;
+                }
             }
-            std::string kernel = kernel_ss.str();
-            if (!kernel.empty() && kernel.back() == '\n') {
-                kernel.pop_back();
+            if (!TTSEngine::is_alsa_device(session->tts->get_output_device())) {
+                std::cout << "Info: Output device of session " << name << " is not an ALSA device, using the espeak command for speech" << std::endl;
+            } else if (synthesizer) {
+                session->tts->set_native_backend(synthesizer->share(), create_alsa_pcm_sink(session->tts->get_output_device()));
+                if (phrases) {
+                    session->tts->set_phrase_cache(phrases);
+                } else {
+                    session->tts->warm_phrase_cache(config.tts.cached_phrases,
+                                                    config_relative_path(config.tts.phrase_cache_file, config_path));
+                    phrases = session->tts->get_phrase_cache();
+                }
             }
-            
-            info.os_info = kernel + " Operating System";
-            pclose(pipe);
-        } else {
-            info.os_info = "Unknown Operating System";
-        }
-    }
-    
-    // Get CPU information in a more human-friendly format
-    pipe = popen("cat /proc/cpuinfo | grep 'model name' | head -n 1 | cut -d: -f2", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream cpu_ss;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            cpu_ss << buffer;
-        }
-        std::string full_cpu_info = cpu_ss.str();
-        if (!full_cpu_info.empty() && full_cpu_info.back() == '\n') {
-            full_cpu_info.pop_back();  // Remove trailing newline
         }
         
-        // Simplify CPU info - extract brand and basic info
-        std::string simplified_cpu;
-        if (full_cpu_info.find("Intel") != std::string::npos) {
-            simplified_cpu = "Intel";
-        } else if (full_cpu_info.find("AMD") != std::string::npos) {
-            simplified_cpu = "AMD";
-        } else {
-            simplified_cpu = "Generic";
-        }
-        
-        // Try to extract processor type
-        if (full_cpu_info.find("Core") != std::string::npos) {
-            if (full_cpu_info.find("i7") != std::string::npos) 
-                simplified_cpu += " Core i7";
-            else if (full_cpu_info.find("i5") != std::string::npos) 
-                simplified_cpu += " Core i5";
-            else if (full_cpu_info.find("i3") != std::string::npos) 
-                simplified_cpu += " Core i3";
-            else if (full_cpu_info.find("i9") != std::string::npos) 
-                simplified_cpu += " Core i9";
-            else 
-                simplified_cpu += " Core processor";
-        } else if (full_cpu_info.find("Ryzen") != std::string::npos) {
-            simplified_cpu += " Ryzen processor";
-        } else {
-            simplified_cpu += " processor";
-        }
+        // Every session times its turns, for the throughput summary on exit,
+        // but only exports them when metrics are on
+        session->metrics.enable(config.metrics.enabled ? session_file_path(config.metrics.jsonl_file, name) : "",
+                                config.metrics.enabled ? session_file_path(config.metrics.prometheus_file, name) : "");
+        session->ollama->set_metrics(&session->metrics);
+        session->tts->set_metrics(&session->metrics);
         
-        // Get CPU clock speed
-        pipe = popen("cat /proc/cpuinfo | grep 'cpu MHz' | head -n 1 | cut -d: -f2", "r");
-        if (pipe) {
-            char buffer[50];
-            std::stringstream mhz_ss;
-            while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-                mhz_ss << buffer;
-            }
-            std::string mhz = mhz_ss.str();
-            if (!mhz.empty() && mhz.back() == '\n') {
-                mhz.pop_back();
-            }
-            
-            // Convert to GHz for better readability
-            try {
-                float mhz_float = std::stof(mhz);
-                float ghz = mhz_float / 1000.0f;
-                std::stringstream ghz_ss;
-                ghz_ss << std::fixed << std::setprecision(1) << ghz;
-                simplified_cpu += " running at " + ghz_ss.str() + " GHz";
-            } catch (const std::exception&) {
-                // If conversion fails, just use the MHz value
-                simplified_cpu += " running at " + mhz + " MHz";
-            }
-            
-            pclose(pipe);
-        }
+        AudioConfig audio_config = config.audio;
+        audio_config.device = session_config.input_device;
+        session->audio = create_streaming_audio(config, audio_config, session->ollama.get(), session->tts.get(), debug);
         
-        // Get CPU core count
-        pipe = popen("nproc", "r");
-        if (pipe) {
-            char buffer[50];
-            std::stringstream cores_ss;
-            while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-                cores_ss << buffer;
-            }
-            std::string cores = cores_ss.str();
-            if (!cores.empty() && cores.back() == '\n') {
-                cores.pop_back();
+        const TTSEngine* tts_ptr = session->tts.get();
+        const StreamingAudioInput* audio_ptr = session->audio.get();
+        session->metrics.add_counter("playback_underruns", [tts_ptr] { return tts_ptr->underrun_count(); });
+        session->metrics.add_counter("capture_overruns", [audio_ptr] { return audio_ptr->get_overrun_count(); });
+        
+        if (enable_logging) {
+            std::string path = session_file_path(log_base, name);
+            session->logger = std::make_unique<ConversationLogger>(path, config.logging);
+            if (!session->logger->open()) {
+                std::cerr << "Error: Cannot write to log file at " << path << ", no log for session " << name << std::endl;
+                session->logger.reset();
+            } else {
+                std::cout << "Info: Logging session " << name << " to " << path << std::endl;
             }
-            simplified_cpu += " with " + cores + " cores";
-            pclose(pipe);
         }
         
-        info.cpu_info = simplified_cpu;
-        
-    } else {
-        info.cpu_info = "Unknown CPU";
-    }
-    
-    // Try to get GPU information in a simplified format
-    pipe = popen("lspci | grep -i 'vga\\|3d\\|2d' | cut -d: -f3", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream gpu_ss;
-        bool found_gpu = false;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            gpu_ss << buffer;
-            found_gpu = true;
-        }
-        if (found_gpu) {
-            std::string full_gpu_info = gpu_ss.str();
-            if (!full_gpu_info.empty() && full_gpu_info.back() == '\n') {
-                full_gpu_info.pop_back();  // Remove trailing newline
+        // Open the microphone while the whisper model is still loading
+        session->audio->start();
+        sessions.push_back(std::move(session));
+    }
+    
+    // Wait for the background startup work
+    std::unique_ptr<StreamingWhisperSTT> first_whisper = whisper_startup.get();
+    std::shared_ptr<WhisperContextPool> pool = first_whisper->get_pool();
+    if (!pool || !pool->is_ready()) {
+        std::cerr << "Error: The whisper model did not load, cannot serve any session" << std::endl;
+        return 1;
+    }
+    sessions[0]->whisper = std::move(first_whisper);
+    for (size_t i = 1; i < sessions.size(); i++) {
+        sessions[i]->whisper = std::make_unique<StreamingWhisperSTT>(config.whisper, debug, pool);
+    }
+    if (static_cast<size_t>(pool->size()) < sessions.size()) {
+        std::cout << "Info: " << sessions.size() << " sessions share " << pool->size()
+                  << " whisper state(s); raise whisper.pool_size to transcribe more of them at once" << std::endl;
+    }
+    
+    std::string version = ollama_startup.get();
+    startup_client.reset();
+    if (!version.empty()) {
+        config.system_info.ollama_version = version;
+    }
+    if (debug) {
+        auto startup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startup_begin).count();
+        std::cout << "Debug: Models ready after " << startup_ms << " ms" << std::endl;
+    }
+    
+    std::string system_info_str = format_system_info(config);
+    for (auto& session : sessions) {
+        session->ollama->set_system_info(system_info_str);
+    }
+    std::cout << "\nSystem Information:\n" << system_info_str << std::endl;
+    
+    // Cached replies are keyed by model and system prompt, so sessions can
+    // answer from each other's
+    std::unique_ptr<QuickReplies> quick_replies;
+    if (config.response_cache.enabled || config.response_cache.quick_intents) {
+        quick_replies = std::make_unique<QuickReplies>(config.response_cache, config.ollama, config.system_info);
+    }
+    
+    const bool persistent_capture = config.streaming.persistent_capture;
+    const int speculative_stable_ms = config.streaming.speculative_reply ? config.streaming.speculative_stable_ms : 0;
+    const bool report_latency = config.metrics.enabled;
+    SessionManager manager(&g_running);
+    for (auto& session : sessions) {
+        ServedSession* s = session.get();
+        QuickReplies* replies = quick_replies.get();
+        manager.add(s->config.name, [s, replies, persistent_capture, speculative_stable_ms, report_latency, debug] {
+            // Each conversation starts afresh
+            s->ollama->clear_history();
+            if (s->logger) {
+                s->logger->log_event("Conversation started");
             }
-            
-            // Simplify GPU info
-            std::string simplified_gpu;
-            if (full_gpu_info.find("NVIDIA") != std::string::npos) {
-                simplified_gpu = "NVIDIA";
-                
-                // Try to get more specific for NVIDIA
-                if (full_gpu_info.find("GeForce") != std::string::npos) {
-                    simplified_gpu += " GeForce";
-                    
-                    // Try to get the series (RTX, GTX, etc)
-                    if (full_gpu_info.find("RTX") != std::string::npos) {
-                        simplified_gpu += " RTX";
-                    } else if (full_gpu_info.find("GTX") != std::string::npos) {
-                        simplified_gpu += " GTX";
-                    }
-                } else if (full_gpu_info.find("Quadro") != std::string::npos) {
-                    simplified_gpu += " Quadro";
-                }
-            } else if (full_gpu_info.find("AMD") != std::string::npos || 
-                      full_gpu_info.find("ATI") != std::string::npos || 
-                      full_gpu_info.find("Radeon") != std::string::npos) {
-                if (full_gpu_info.find("Radeon") != std::string::npos) {
-                    simplified_gpu = "AMD Radeon";
-                } else {
-                    simplified_gpu = "AMD";
-                }
-            } else if (full_gpu_info.find("Intel") != std::string::npos) {
-                simplified_gpu = "Intel";
-                if (full_gpu_info.find("Iris") != std::string::npos) {
-                    simplified_gpu += " Iris";
-                } else if (full_gpu_info.find("HD Graphics") != std::string::npos) {
-                    simplified_gpu += " HD Graphics";
-                } else if (full_gpu_info.find("UHD Graphics") != std::string::npos) {
-                    simplified_gpu += " UHD Graphics";
-                }
-            } else {
-                // Just use the first few words to keep it simple
-                std::istringstream iss(full_gpu_info);
-                std::string word;
-                int count = 0;
-                while (iss >> word && count < 3) {
-                    if (count > 0) simplified_gpu += " ";
-                    simplified_gpu += word;
-                    count++;
-                }
-                if (simplified_gpu.empty()) {
-                    simplified_gpu = "Graphics card";
-                }
+            const uint64_t turns_before = s->metrics.turn_count();
+            run_streaming_assistant_cycle(s->audio.get(), s->whisper.get(), s->ollama.get(), s->tts.get(), debug,
+                                          s->logger.get(), persistent_capture, &s->metrics, speculative_stable_ms, replies, report_latency);
+            if (s->logger) {
+                s->logger->log_event("Conversation ended");
             }
             
-            info.gpu_info = simplified_gpu;
-        }
-        pclose(pipe);
+            // Only a goodbye ends a conversation normally, and that is a
+            // turn too; one ended without any, e.g. by an audio failure, failed
+            if (s->audio->has_input_ended()) {
+                return SessionManager::Outcome::Stopped;
+            }
+            return s->metrics.turn_count() > turns_before ? SessionManager::Outcome::Ended
+                                                          : SessionManager::Outcome::Failed;
+        }, [s] { return s->metrics.turn_count(); });
     }
     
-    // Get memory information in simplified format
-    pipe = popen("free -h | grep Mem: | awk '{print $2}'", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream mem_ss;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            mem_ss << buffer;
-        }
-        std::string total_mem = mem_ss.str();
-        if (!total_mem.empty() && total_mem.back() == '\n') {
-            total_mem.pop_back();  // Remove trailing newline
-        }
-        
-        // Clean up the memory value
-        total_mem.erase(std::remove_if(total_mem.begin(), total_mem.end(), ::isspace), total_mem.end());
-        
-        info.memory_info = total_mem + " of RAM";
-        pclose(pipe);
+    std::cout << "Info: Serving " << sessions.size() << " session(s). Press Ctrl+C to exit." << std::endl;
+    for (const auto& session : sessions) {
+        std::cout << "Info: - " << session->config.name << ": " << session->config.input_device
+                  << " -> " << session->tts->get_output_device() << std::endl;
     }
+    manager.start();
+    manager.join();
     
-    // Get disk information in simplified format
-    pipe = popen("df -h / | tail -1 | awk '{print $2\" total, \"$4\" free (\"$5\" used)\"}'", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream disk_ss;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            disk_ss << buffer;
-        }
-        std::string disk_info = disk_ss.str();
-        if (!disk_info.empty() && disk_info.back() == '\n') {
-            disk_info.pop_back();  // Remove trailing newline
-        }
-        
-        info.disk_info = disk_info + " disk space";
-        pclose(pipe);
+    std::cout << "Voice Assistant Exiting" << std::endl;
+    std::cout << manager.summary(cpus);
+    if (llm_slots) {
+        std::cout << "Info: Replies waited " << llm_slots->wait_count() << " time(s) for one of the "
+                  << llm_slots->size() << " LLM slot(s)" << std::endl;
     }
-    
-    // Get basic network information
-    // For privacy reasons, we'll just indicate network connectivity without showing the actual IP
-    pipe = popen("ping -c 1 -W 1 8.8.8.8 > /dev/null 2>&1 && echo 'Connected to the internet' || echo 'Not connected to the internet'", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream net_ss;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            net_ss << buffer;
+    if (config.metrics.enabled) {
+        for (const auto& session : sessions) {
+            std::cout << "Session " << session->config.name << ": " << session->metrics.summary();
         }
-        info.network_info = net_ss.str();
-        if (!info.network_info.empty() && info.network_info.back() == '\n') {
-            info.network_info.pop_back();  // Remove trailing newline
+    }
+    for (auto& session : sessions) {
+        if (session->logger) {
+            session->logger->close();
         }
-        pclose(pipe);
+    }
+    return 0;
+}
+
+// Gather system information
+void gather_system_info(SystemInfo& info) {
+    // Get current date and time
+    auto now = std::chrono::system_clock::now();
+    std::time_t now_time = std::chrono::system_clock::to_time_t(now);
+    std::stringstream date_ss;
+    date_ss << std::ctime(&now_time);
+    info.build_date = date_ss.str();
+    if (!info.build_date.empty() && info.build_date.back() == '\n') {
+        info.build_date.pop_back();  // Remove trailing newline
     }
     
-    // Get whisper.cpp version
-    pipe = popen("./whisper.cpp/build/bin/whisper-cli --version 2>&1 | grep -o 'whisper.cpp.*'", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream whisper_ss;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            whisper_ss << buffer;
-        }
-        std::string version = whisper_ss.str();
-        if (!version.empty()) {
-            if (version.back() == '\n') version.pop_back();
-            info.whisper_version = version;
-        }
-        pclose(pipe);
+    // Get current timestamp for the assistant
+    auto current_time = std::chrono::system_clock::now();
+    std::time_t current_time_t = std::chrono::system_clock::to_time_t(current_time);
+    std::stringstream current_time_ss;
+    current_time_ss << std::ctime(&current_time_t);
+    info.current_time = current_time_ss.str();
+    if (!info.current_time.empty() && info.current_time.back() == '\n') {
+        info.current_time.pop_back();  // Remove trailing newline
     }
     
-    // Get ollama version
-    pipe = popen("ollama --version 2>&1", "r");
-    if (pipe) {
-        char buffer[256];
-        std::stringstream ollama_ss;
-        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-            ollama_ss << buffer;
-        }
-        std::string version = ollama_ss.str();
-        if (!version.empty()) {
-            if (version.back() == '\n') version.pop_back();
-            info.ollama_version = version;
-        }
-        pclose(pipe);
+    // OS, hardware and whisper.cpp version, read straight from /etc, /proc and /sys
+    probe_system_info(info);
+}
+
+// Warn about a configured hardware device (hw:1,0 and the like) that the
+// device probe says is missing or will not take our format. Other names are
+// left alone, so the probe only runs when it can tell something.
+void check_audio_device(const std::string& device, bool capture) {
+    std::string card;
+    int number = 0;
+    if (!parse_hw_device_name(device, card, number)) {
+        return;
+    }
+    std::string warning = audio_device_warning(probe_audio_devices(), device, capture);
+    if (!warning.empty()) {
+        std::cerr << "Warning: " << warning << std::endl;
     }
 }
 
@@ -966,30 +1361,51 @@ void run_diagnostics(AudioConfig& audio_config, WhisperConfig& whisper_config) {
     
     // Check system audio setup
     std::cout << "Checking audio setup..." << std::endl;
-    std::system("which arecord parecord rec");
-    std::system("arecord --version | head -n 1");
-    
-    // List PulseAudio sources
-    std::cout << "\nPulseAudio sources:" << std::endl;
-    std::system("pactl list sources short 2>/dev/null || echo 'PulseAudio not installed or not running'");
-    
-    // Check ALSA devices
-    std::cout << "\nALSA recording devices:" << std::endl;
-    std::system("arecord -l 2>/dev/null || echo 'ALSA tools not installed or no devices found'");
+    const char* path_env = std::getenv("PATH");
+    const std::string path_list = path_env ? path_env : "";
+    for (const char* tool : {"arecord", "parecord", "rec"}) {
+        std::string found = find_in_path(tool, path_list);
+        std::cout << "  " << tool << ": " << (found.empty() ? "not found" : found) << std::endl;
+    }
+    std::cout << "  ALSA library version: " << alsa_library_version() << std::endl;
+    
+    // Capture devices, including plugins such as pulse or pipewire when
+    // their ALSA plugins are installed
+    const auto& devices = probe_audio_devices();
+    std::cout << "\nRecording devices:" << std::endl;
+    print_audio_devices(devices, true);
+    std::string device_warning = audio_device_warning(devices, audio_config.device, true);
+    if (!device_warning.empty()) {
+        std::cout << "  WARNING: " << device_warning << std::endl;
+    }
     
     // Check for microphone permissions
     std::cout << "\nChecking microphone permissions..." << std::endl;
-    std::system("ls -l /dev/snd/* 2>/dev/null");
+    std::error_code error;
+    std::vector<std::string> nodes;
+    for (const auto& entry : fs::directory_iterator("/dev/snd", error)) {
+        nodes.push_back(entry.path().string());
+    }
+    std::sort(nodes.begin(), nodes.end());
+    if (nodes.empty()) {
+        std::cout << "  No sound devices in /dev/snd" << std::endl;
+    }
+    for (const auto& node : nodes) {
+        bool usable = access(node.c_str(), R_OK | W_OK) == 0;
+        std::cout << "  " << node << (usable ? ": read/write" : ": NO ACCESS (is the user in the audio group?)") << std::endl;
+    }
     
-    // Test recording with multiple methods
+    // Test recording with the tool the file-based mode records with
     std::cout << "\nTesting recording with ALSA..." << std::endl;
     std::string test_file = "/tmp/test_recording.wav";
-    std::stringstream cmd;
-    
-    // Try ALSA
-    cmd << "arecord -d 3 -f S16_LE -r 16000 -c 1 " << test_file << " && echo 'ALSA recording successful: " 
-        << test_file << "' || echo 'ALSA recording failed'";
-    std::system(cmd.str().c_str());
+    if (find_in_path("arecord", path_list).empty()) {
+        std::cout << "  arecord not found; install alsa-utils for the file-based mode" << std::endl;
+    } else {
+        std::stringstream cmd;
+        cmd << "arecord -d 3 -f S16_LE -r 16000 -c 1 " << test_file << " && echo 'ALSA recording successful: "
+            << test_file << "' || echo 'ALSA recording failed'";
+        std::system(cmd.str().c_str());
+    }
     
     // Check file size
     if (fs::exists(test_file)) {
@@ -1053,6 +1469,41 @@ bool has_over_keyword(const std::string& text) {
             lower_text.find(" over") == lower_text.length() - 5);
 }
 
+// Answer transcript without Ollama when quick_replies can. The speech of a
+// cached reply is kept, so the next time it is asked it plays straight from
+// memory. The caller adds the turn to the conversation history.
+bool answer_quickly(QuickReplies* quick_replies, TTSEngine* tts, const std::string& transcript, std::string& reply, bool debug) {
+    if (!quick_replies || transcript.empty()) {
+        return false;
+    }
+    
+    bool from_cache = false;
+    if (!quick_replies->find(transcript, reply, &from_cache)) {
+        return false;
+    }
+    if (debug) {
+        std::cout << "Info: Answered from " << (from_cache ? "the response cache" : "a quick intent") << std::endl;
+    }
+    if (from_cache) {
+        tts->keep_audio(reply, quick_replies->kept_audio_limit());
+    }
+    return true;
+}
+
+// Remove a trailing "over" (possibly followed by punctuation) from the transcript
+std::string strip_over_keyword(const std::string& text) {
+    std::string clean_transcript = text;
+    size_t over_pos = clean_transcript.find(" over");
+    if (over_pos != std::string::npos && over_pos > 0 && 
+        (over_pos + 5 >= clean_transcript.length() || 
+         clean_transcript[over_pos + 5] == '.' || 
+         clean_transcript[over_pos + 5] == '!' ||
+         clean_transcript[over_pos + 5] == '?')) {
+        clean_transcript = clean_transcript.substr(0, over_pos);
+    }
+    return clean_transcript;
+}
+
 // Check if transcript contains the exit keyword
 bool has_exit_keyword(const std::string& text) {
     // Convert to lowercase for case-insensitive matching
@@ -1150,7 +1601,7 @@ bool is_silence_marker(const std::string& text) {
 }
 
 // Process a single transcript and return true if conversation should continue
-bool process_transcript(const std::string& transcript, OllamaClient* ollama, TTSEngine* tts, bool debug, const std::string& log_file = "") {
+bool process_transcript(const std::string& transcript, OllamaClient* ollama, TTSEngine* tts, bool debug, ConversationLogger* logger = nullptr, QuickReplies* quick_replies = nullptr) {
     // Safety check: We should never process silence markers or empty transcripts
     if (transcript.empty() || is_silence_marker(transcript)) {
         if (debug) {
@@ -1171,10 +1622,18 @@ bool process_transcript(const std::string& transcript, OllamaClient* ollama, TTS
     }
 
     // Process with Ollama
-    if (debug) {
-        std::cout << "Info: Processing with Ollama..." << std::endl;
+    std::string response;
+    if (answer_quickly(quick_replies, tts, clean_transcript, response, debug)) {
+        ollama->add_turn(clean_transcript, response);
+    } else {
+        if (debug) {
+            std::cout << "Info: Processing with Ollama..." << std::endl;
+        }
+        response = ollama->process(clean_transcript);
+        if (quick_replies && ollama->last_reply_complete()) {
+            quick_replies->remember(clean_transcript, response);
+        }
     }
-    std::string response = ollama->process(clean_transcript);
     
     // Display output in chat format with separator line
     std::cout << "\n------------------------------" << std::endl;
@@ -1182,8 +1641,8 @@ bool process_transcript(const std::string& transcript, OllamaClient* ollama, TTS
     std::cout << "------------------------------" << std::endl;
     
     // Log the conversation if enabled
-    if (!log_file.empty()) {
-        log_conversation(log_file, "Vibe", response);
+    if (logger) {
+        logger->log("Vibe", response);
     }
     
     // Convert to speech
@@ -1192,12 +1651,15 @@ bool process_transcript(const std::string& transcript, OllamaClient* ollama, TTS
     }
     tts->speak(response);
     
+    // Summarize any turns that dropped out of the history while listening
+    ollama->update_summary();
+    
     // Check if the user said "over" to indicate conversation should continue
     return has_over_keyword(transcript);
 }
 
 // Run voice assistant in conversational mode - returns true if application should exit
-bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, const std::string& log_file) {
+bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* ollama, TTSEngine* tts, bool debug, ConversationLogger* logger, QuickReplies* quick_replies) {
     bool continue_conversation = true;
     bool should_exit = false;
     int silence_counter = 0;
@@ -1317,8 +1779,8 @@ bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* o
                                     std::cout << "------------------------------" << std::endl;
                                     
                                     // Log the farewell if enabled
-                                    if (!log_file.empty()) {
-                                        log_conversation(log_file, "Vibe", goodbye);
+                                    if (logger) {
+                                        logger->log("Vibe", goodbye);
                                     }
                                     
                                     tts->speak(goodbye);
@@ -1390,8 +1852,8 @@ bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* o
             std::cout << "------------------------------" << std::endl;
             
             // Log the conversation if enabled
-            if (!log_file.empty()) {
-                log_conversation(log_file, "User", transcript);
+            if (logger) {
+                logger->log("User", transcript);
             }
             
             // Check for exit keywords before processing
@@ -1404,8 +1866,8 @@ bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* o
                 std::cout << "------------------------------" << std::endl;
                 
                 // Log the farewell if enabled
-                if (!log_file.empty()) {
-                    log_conversation(log_file, "Vibe", goodbye);
+                if (logger) {
+                    logger->log("Vibe", goodbye);
                 }
                 
                 tts->speak(goodbye);
@@ -1414,7 +1876,7 @@ bool run_assistant_cycle(AudioInput* audio, WhisperSTT* whisper, OllamaClient* o
             }
             
             // Process the transcript and check if we should continue
-            continue_conversation = process_transcript(transcript, ollama, tts, debug, log_file);
+            continue_conversation = process_transcript(transcript, ollama, tts, debug, logger, quick_replies);
             
             // If not in continuous mode and no "over" was detected, stop the conversation
             if (!audio->is_continuous_mode() && !continue_conversation) {
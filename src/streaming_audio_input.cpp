@@ -1,14 +1,15 @@
 #include "streaming_audio_input.h"
 #include "vad.h"
+#include "audio_kernels.h"
+#include "resampler.h"
+#include "audio_devices.h"
 #include <iostream>
 #include <chrono>
 #include <memory>
 #include <fstream>
 #include <cstdio>
 #include <array>
-
-// ALSA headers
-#include <alsa/asoundlib.h>
+#include <algorithm>
 
 // Constructor
 StreamingAudioInput::StreamingAudioInput(const AudioConfig& cfg, bool debug)
@@ -28,12 +29,7 @@ StreamingAudioInput::~StreamingAudioInput() {
 // List available audio devices
 void StreamingAudioInput::list_devices() {
     std::cout << "Available audio input devices:" << std::endl;
-    
-    // Try ALSA devices
-    std::system("arecord -l 2>/dev/null");
-    
-    // Try PulseAudio devices
-    std::system("pactl list sources 2>/dev/null | grep -E 'Name:|Description:' | grep -v monitor");
+    print_audio_devices(probe_audio_devices(), true);
 }
 
 // Start audio capture thread
@@ -45,15 +41,25 @@ bool StreamingAudioInput::start() {
         return true;
     }
     
-    // Clear any existing audio data
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex);
-        audio_buffer.clear();
-        capture_buffer.clear();
+    // A recording or stream that has ended is not restarted
+    if (input_ended.load()) {
+        return false;
     }
+    if (!source) {
+        source = create_audio_source(config);
+        if (!source) {
+            return false;
+        }
+    }
+    
+    // Clear any existing audio data (the capture thread is not running yet)
+    active_segment_start.store(NO_ACTIVE_SEGMENT);
+    capture_ring.reset(ring_capacity_for_rate(static_cast<unsigned int>(config.sample_rate)));
+    segment_queue.clear();
     
     is_capturing.store(true);
     speech_detected.store(false);
+    echo_gate.reset();
     
     try {
         capture_thread = std::thread(&StreamingAudioInput::capture_thread_func, this);
@@ -72,6 +78,7 @@ bool StreamingAudioInput::start() {
 // Stop audio capture thread
 void StreamingAudioInput::stop() {
     is_capturing.store(false);
+    active_segment_start.store(NO_ACTIVE_SEGMENT);
     
     if (capture_thread.joinable()) {
         cv.notify_all(); // Wake up any waiting threads
@@ -88,347 +95,268 @@ void StreamingAudioInput::set_vad_params(const VADParams& params) {
     vad_params = params;
 }
 
+// The ring holds the context history plus the longest utterance and its end padding
+size_t StreamingAudioInput::ring_capacity_for_rate(unsigned int rate) const {
+    size_t total_ms = static_cast<size_t>(vad_params.buffer_history_ms) +
+                      static_cast<size_t>(vad_params.max_speech_ms) +
+                      static_cast<size_t>(vad_params.max_silence_ms) +
+                      static_cast<size_t>(vad_params.padding_ms);
+    return total_ms * rate / 1000;
+}
+
 // Check if speech is currently active
 bool StreamingAudioInput::is_speech_active() const {
     return speech_detected.load();
 }
 
+// Gate speech detection, e.g. while the assistant's own voice is playing
+void StreamingAudioInput::set_echo_gate(bool closed) {
+    if (closed) {
+        echo_gate.close();
+    } else {
+        // The capture thread ignores audio up to here, plus the echo tail.
+        // After barge-in the gate is already open and the user is speaking.
+        echo_gate.open(capture_ring.write_position());
+    }
+}
+
+// Wake up wait_for_speech without an utterance
+void StreamingAudioInput::interrupt_wait() {
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex);
+        wait_interrupted.store(true);
+    }
+    cv.notify_all();
+}
+
 // Wait for speech and return audio buffer
-std::vector<float> StreamingAudioInput::wait_for_speech(int timeout_ms) {
-    // Start audio capture if not already running
-    if (!is_capturing.load()) {
+std::vector<float> StreamingAudioInput::wait_for_speech(int timeout_ms, uint64_t* utterance_id, std::chrono::steady_clock::time_point* speech_end) {
+    // Start audio capture if not already running. Once the input has ended
+    // only the utterances still queued are returned.
+    if (!is_capturing.load() && !input_ended.load()) {
         if (!start()) {
             std::cerr << "Error: Failed to start audio capture" << std::endl;
             return {};
         }
     }
     
-    std::unique_lock<std::mutex> lock(buffer_mutex);
-    
-    // Wait for speech detection or timeout
-    auto timeout = std::chrono::milliseconds(timeout_ms);
-    bool speech_found = cv.wait_for(lock, timeout, [this] {
-        return !is_capturing.load() || !audio_buffer.empty();
-    });
-    
-    if (!speech_found || audio_buffer.empty()) {
-        if (debug_enabled) {
-            std::cout << "Info: No speech detected within timeout" << std::endl;
+    // Wait for a completed utterance or timeout
+    // The mutex only guards the wait itself; audio is handed over lock-free
+    SpeechSegment segment;
+    {
+        std::unique_lock<std::mutex> lock(buffer_mutex);
+        auto timeout = std::chrono::milliseconds(timeout_ms);
+        bool speech_found = cv.wait_for(lock, timeout, [this] {
+            return !is_capturing.load() || !segment_queue.empty() || wait_interrupted.load();
+        });
+        
+        if (wait_interrupted.exchange(false)) {
+            return {};
+        }
+        if (!speech_found || !segment_queue.pop(segment)) {
+            if (debug_enabled) {
+                std::cout << "Info: No speech detected within timeout" << std::endl;
+            }
+            return {};
         }
-        return {};
     }
     
-    // Copy the audio data and clear the buffer
-    std::vector<float> result = audio_buffer;
-    audio_buffer.clear();
+    // Copy the utterance out of the ring, skipping anything already overwritten
+    std::vector<float> result;
+    uint64_t start = std::max(segment.start, capture_ring.oldest_position());
+    result.reserve(segment.end - start + output_reserve);
+    if (!capture_ring.copy(start, segment.end, result)) {
+        start = std::max(segment.start, capture_ring.oldest_position());
+        if (!capture_ring.copy(start, segment.end, result)) {
+            std::cerr << "Warning: Speech audio was overwritten before it could be read" << std::endl;
+            result.clear();
+        }
+    }
+    if (start != segment.start) {
+        std::cerr << "Warning: Beginning of speech was lost, capture ring too small" << std::endl;
+    }
     
+    if (utterance_id) {
+        *utterance_id = segment.start;
+    }
+    if (speech_end) {
+        *speech_end = segment.detected_at;
+    }
     return result;
 }
 
-// Main capture thread function
-void StreamingAudioInput::capture_thread_func() {
-    if (debug_enabled) {
-        std::cout << "Info: Audio capture thread starting on device: " << config.device << std::endl;
-    }
-    
-    snd_pcm_t* pcm_handle = nullptr;
-    int err;
-    
-    // Open ALSA device for capture
-    if ((err = snd_pcm_open(&pcm_handle, config.device.c_str(), SND_PCM_STREAM_CAPTURE, 0)) < 0) {
-        std::cerr << "Error: Cannot open audio device " << config.device << ": " << snd_strerror(err) << std::endl;
-        std::cerr << "Hint: You may need to adjust the audio.device in config.json or use --input-device" << std::endl;
-        is_capturing.store(false);
-        return;
-    }
-    
-    std::cout << "Debug: Successfully opened audio device: " << config.device << std::endl;
-    
-    // Set hardware parameters
-    snd_pcm_hw_params_t* hw_params;
-    snd_pcm_hw_params_alloca(&hw_params);
-    snd_pcm_hw_params_any(pcm_handle, hw_params);
-    
-    // Set access type
-    err = snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
-    if (err < 0) {
-        std::cerr << "Error: Cannot set access type: " << snd_strerror(err) << std::endl;
-        snd_pcm_close(pcm_handle);
-        is_capturing.store(false);
-        return;
+// Snapshot the utterance in progress, identified by its start position
+bool StreamingAudioInput::get_active_speech(std::vector<float>& out, uint64_t* utterance_id) const {
+    uint64_t segment_start = active_segment_start.load();
+    if (segment_start == NO_ACTIVE_SEGMENT || !is_capturing.load()) {
+        return false;
     }
-    std::cout << "Debug: Set access type to interleaved" << std::endl;
     
-    // Set sample format (16-bit signed little endian)
-    err = snd_pcm_hw_params_set_format(pcm_handle, hw_params, SND_PCM_FORMAT_S16_LE);
-    if (err < 0) {
-        std::cerr << "Error: Cannot set sample format: " << snd_strerror(err) << std::endl;
-        snd_pcm_close(pcm_handle);
-        is_capturing.store(false);
-        return;
+    // Anything overwritten already would be lost from the final utterance too
+    uint64_t start = std::max(segment_start, capture_ring.oldest_position());
+    if (start != segment_start || !capture_ring.copy(start, capture_ring.write_position(), out)) {
+        return false;
     }
-    std::cout << "Debug: Set sample format to 16-bit signed little endian" << std::endl;
     
-    // Set sample rate
-    unsigned int rate = static_cast<unsigned int>(config.sample_rate);
-    unsigned int original_rate = rate;
-    err = snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &rate, 0);
-    if (err < 0) {
-        std::cerr << "Error: Cannot set sample rate: " << snd_strerror(err) << std::endl;
-        snd_pcm_close(pcm_handle);
-        is_capturing.store(false);
-        return;
+    if (utterance_id) {
+        *utterance_id = segment_start;
     }
-    
-    if (rate != original_rate) {
-        std::cout << "Debug: Requested sample rate " << original_rate << " Hz, but got " << rate << " Hz" << std::endl;
-    } else {
-        std::cout << "Debug: Set sample rate to " << rate << " Hz" << std::endl;
+    return true;
+}
+
+// Main capture thread function
+void StreamingAudioInput::capture_thread_func() {
+    if (debug_enabled) {
+        std::cout << "Info: Audio capture thread starting on " << source->name() << std::endl;
     }
     
-    // Set channels (mono)
-    err = snd_pcm_hw_params_set_channels(pcm_handle, hw_params, 1);
-    if (err < 0) {
-        std::cerr << "Error: Cannot set channels: " << snd_strerror(err) << std::endl;
-        snd_pcm_close(pcm_handle);
-        is_capturing.store(false);
-        return;
+    // Its own cores and a real-time priority, if configured, so whisper
+    // cannot keep it from emptying the device buffer
+    if (capture_policy.is_set()) {
+        apply_thread_policy(capture_policy, "capture", debug_enabled);
     }
-    std::cout << "Debug: Set channels to mono (1 channel)" << std::endl;
     
-    // Set buffer size (100ms worth of samples)
-    snd_pcm_uframes_t buffer_size = rate / 10;
-    err = snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params, &buffer_size);
-    if (err < 0) {
-        std::cerr << "Error: Cannot set buffer size: " << snd_strerror(err) << std::endl;
-        snd_pcm_close(pcm_handle);
+    // Sources that are not devices carry on where the last capture stopped
+    const unsigned int rate = static_cast<unsigned int>(config.sample_rate);
+    if (!source->open(static_cast<int>(rate))) {
         is_capturing.store(false);
+        cv.notify_all();
         return;
     }
     
-    // Apply hardware parameters
-    err = snd_pcm_hw_params(pcm_handle, hw_params);
-    if (err < 0) {
-        std::cerr << "Error: Cannot set hardware parameters: " << snd_strerror(err) << std::endl;
-        snd_pcm_close(pcm_handle);
-        is_capturing.store(false);
-        return;
+    // Audio is resampled to the configured rate if the source cannot
+    // deliver it, so everything after capture sees one rate
+    const unsigned int device_rate = static_cast<unsigned int>(source->sample_rate());
+    if (device_rate != rate && debug_enabled) {
+        std::cout << "Debug: " << source->name() << " delivers " << device_rate << " Hz audio" << std::endl;
     }
     
-    // Prepare device for use
-    err = snd_pcm_prepare(pcm_handle);
-    if (err < 0) {
-        std::cerr << "Error: Cannot prepare audio interface: " << snd_strerror(err) << std::endl;
-        snd_pcm_close(pcm_handle);
-        is_capturing.store(false);
-        return;
+    // Incremental VAD over a sliding window, deciding once per hop, feeding
+    // the utterance state machine
+    SpeechSegmenter segmenter(vad_params, static_cast<int>(rate), capture_ring.capacity(), debug_enabled);
+    if (speech_classifier) {
+        segmenter.set_classifier(speech_classifier.get());
     }
+    segmenter.set_barge_in_enabled(static_cast<bool>(barge_in_callback));
+    const int hop_frames = static_cast<int>(segmenter.get_hop_size());
     
-    // Buffer to store 100ms of 16-bit PCM samples
-    const int frames_per_chunk = static_cast<int>(rate / 10);
+    // Read at most 100ms at a time, or one hop if hops are shorter
+    const int device_hop_frames = static_cast<int>(static_cast<uint64_t>(hop_frames) * device_rate / rate);
+    const int frames_per_chunk = std::max(1, std::min(static_cast<int>(device_rate / 10), device_hop_frames));
     std::vector<int16_t> pcm_buffer(frames_per_chunk);
+    std::vector<float> float_buffer(frames_per_chunk);
     
-    // Buffers for VAD processing
-    std::vector<float> vad_buffer;
-    vad_buffer.reserve(static_cast<size_t>(rate) * 2); // Reserve 2 seconds worth of samples
+    // Resampling state is carried from chunk to chunk
+    PolyphaseResampler resampler(static_cast<int>(device_rate), static_cast<int>(rate));
+    std::vector<float> resampled_buffer;
+    resampled_buffer.reserve(resampler.max_output(frames_per_chunk));
+    const size_t buffer_history_frames = (static_cast<size_t>(vad_params.buffer_history_ms) * rate) / 1000;
     
-    // Detection state variables
-    bool was_speaking = false;           // Was speaking in previous chunk
-    int silence_frames = 0;              // Consecutive silence frames
-    int speech_frames = 0;               // Consecutive speech frames
-    int padding_frames = vad_params.padding_ms * rate / 1000; // Frames to add as padding
-    int min_speech_frames = vad_params.min_speech_ms * rate / 1000; // Minimum speech duration
-    int max_silence_frames = vad_params.max_silence_ms * rate / 1000; // Maximum silence duration
+    // Publish a completed utterance; the lock only pairs with the waiter's predicate check
+    auto publish_segment = [this](uint64_t start, uint64_t end) {
+        {
+            std::lock_guard<std::mutex> lock(buffer_mutex);
+            if (!segment_queue.push({start, end, std::chrono::steady_clock::now()})) {
+                std::cerr << "Warning: Speech queue is full, dropping utterance" << std::endl;
+            }
+        }
+        cv.notify_all();
+    };
+    
+    // Mirror the segmenter's utterance boundaries into the state readers see
+    auto handle_segment_event = [&](SpeechSegmenter::Event event, uint64_t start, uint64_t end) {
+        switch (event) {
+            case SpeechSegmenter::Event::Started:
+                speech_detected.store(true);
+                active_segment_start.store(start);
+                break;
+            case SpeechSegmenter::Event::Ended:
+                active_segment_start.store(NO_ACTIVE_SEGMENT);
+                speech_detected.store(false);
+                
+                // Notify waiting threads that we have audio data
+                publish_segment(start, end);
+                break;
+            case SpeechSegmenter::Event::Split:
+                publish_segment(start, end);
+                active_segment_start.store(end);
+                break;
+            case SpeechSegmenter::Event::Dropped:
+                active_segment_start.store(NO_ACTIVE_SEGMENT);
+                speech_detected.store(false);
+                break;
+            case SpeechSegmenter::Event::BargeIn:
+                // The user's speech starts a new utterance right away. It
+                // only interrupts if the gate is still closed: the chunk was
+                // segmented with an earlier snapshot, and if the reply has
+                // finished since, this is ordinary speech.
+                echo_gate.barge_in(barge_in_callback);
+                active_segment_start.store(start);
+                speech_detected.store(true);
+                break;
+        }
+    };
     
     // Main capture loop
-    std::cout << "Debug: Starting audio capture loop" << std::endl;
+    std::cout << "Debug: Starting audio capture loop (" << audio_kernels::backend_name() << " audio kernels)" << std::endl;
     int buffer_count = 0;
+    const int buffers_per_second = std::max(1, static_cast<int>(device_rate) / frames_per_chunk);
     while (is_capturing.load() && g_running) {
-        // Read audio data from device
-        err = snd_pcm_readi(pcm_handle, pcm_buffer.data(), frames_per_chunk);
+        // Read audio data from the source
+        const long err = source->read(pcm_buffer.data(), static_cast<size_t>(frames_per_chunk));
         
-        // Every 100 buffers (10 seconds at 100ms buffers), print an info message
-        if (++buffer_count % 100 == 0) {
+        // Every 10 seconds, print an info message
+        if (++buffer_count % (10 * buffers_per_second) == 0) {
             std::cout << "Debug: Still capturing audio, processed " << buffer_count << " buffers" << std::endl;
         }
         
-        if (err == -EPIPE) {
-            // Underrun occurred, recover
-            snd_pcm_prepare(pcm_handle);
-            std::cerr << "Warning: Buffer underrun occurred" << std::endl;
-            continue;
-        } else if (err < 0) {
-            // Other error
-            std::cerr << "Error: Cannot read from audio interface: " << snd_strerror(err) << std::endl;
+        if (err < 0) {
+            // The source is finished; speech still in progress ends here
+            input_ended.store(true);
+            segmenter.finish(capture_ring.write_position(), handle_segment_event);
             break;
-        } else if (err != frames_per_chunk) {
-            // Partial read
-            std::cerr << "Warning: Partial read, only got " << err << " frames" << std::endl;
-        } else {
-            if (debug_enabled && buffer_count % 50 == 0) {
-                // Calculate peak amplitude of this buffer
-                float peak = 0.0f;
-                for (int i = 0; i < err; i++) {
-                    float sample = std::abs(pcm_buffer[i]) / 32768.0f;
-                    if (sample > peak) peak = sample;
-                }
-                std::cout << "Debug: Successfully read " << err << " frames, peak amplitude: " << peak << std::endl;
-            }
+        } else if (err == 0) {
+            // Nothing arrived yet, e.g. a network client has not connected
+            continue;
         }
         
         // Convert int16 PCM to float32 normalized to [-1, 1]
-        std::vector<float> float_buffer(frames_per_chunk);
-        for (int i = 0; i < err; i++) {
-            float_buffer[i] = static_cast<float>(pcm_buffer[i]) / 32768.0f;
+        audio_kernels::convert_s16_to_f32(pcm_buffer.data(), float_buffer.data(), static_cast<size_t>(err));
+        
+        if (debug_enabled && err == frames_per_chunk && buffer_count % (5 * buffers_per_second) == 0) {
+            // Calculate peak amplitude of this buffer
+            float peak = audio_kernels::abs_max(float_buffer.data(), static_cast<size_t>(err));
+            std::cout << "Debug: Successfully read " << err << " frames, peak amplitude: " << peak << std::endl;
         }
         
-        // Add to capture buffer for continuous processing
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex);
-            capture_buffer.insert(capture_buffer.end(), float_buffer.begin(), float_buffer.end());
-            
-            // Keep a reasonable size for the capture buffer based on buffer_history_ms
-            const size_t buffer_history_frames = (vad_params.buffer_history_ms * rate) / 1000;
-            if (capture_buffer.size() > buffer_history_frames) {
-                // Instead of removing entire excess, keep at least double the history
-                // This gives us plenty of context before speech starts
-                capture_buffer.erase(capture_buffer.begin(), 
-                                    capture_buffer.begin() + (capture_buffer.size() - buffer_history_frames));
-            }
-            
-            // Print capture buffer size periodically (every 200 buffers)
-            if (debug_enabled && buffer_count % 200 == 0) {
-                const float buffer_seconds = static_cast<float>(capture_buffer.size()) / rate;
-                std::cout << "Debug: Capture buffer size: " << capture_buffer.size() 
-                          << " samples (" << buffer_seconds << " seconds)" << std::endl;
-            }
+        // Bring the audio to the configured rate
+        const float* samples = float_buffer.data();
+        size_t sample_count = static_cast<size_t>(err);
+        if (!resampler.is_passthrough()) {
+            resampled_buffer.clear();
+            resampler.process(float_buffer.data(), sample_count, resampled_buffer);
+            samples = resampled_buffer.data();
+            sample_count = resampled_buffer.size();
         }
         
-        // Add to VAD buffer for speech detection
-        vad_buffer.insert(vad_buffer.end(), float_buffer.begin(), float_buffer.end());
+        // Append to the capture ring; this never blocks or allocates
+        const uint64_t chunk_start = capture_ring.write_position();
+        capture_ring.write(samples, sample_count);
         
-        // Process VAD on a 500ms window for better speech detection
-        const size_t vad_window_size = rate / 2; // 500ms for better speech detection
-        if (vad_buffer.size() >= vad_window_size) {
-            // Process a sliding window for VAD
-            std::vector<float> vad_window(vad_buffer.end() - vad_window_size, vad_buffer.end());
-            
-            // Detect speech in the current window
-            bool is_speech = detect_voice_activity(vad_window, rate, vad_params.threshold, vad_params.freq_threshold);
-            
-            if (is_speech) {
-                speech_frames += err;
-                silence_frames = 0;
-                
-                if (!was_speaking && speech_frames >= min_speech_frames) {
-                    // Speech start detected
-                    if (debug_enabled) {
-                        std::cout << "Info: Speech detected" << std::endl;
-                    }
-                    
-                    speech_detected.store(true);
-                    was_speaking = true;
-                    
-                    // When speech starts, grab audio from the beginning with ample padding
-                    std::lock_guard<std::mutex> lock(buffer_mutex);
-                    
-                    // Use more padding to ensure we capture the beginning of speech
-                    // Instead of just using padding_frames, use at least 50% of the available buffer
-                    size_t padding_start = 0;
-                    if (capture_buffer.size() > padding_frames) {
-                        // Use the larger of: specified padding OR half the available buffer
-                        size_t half_buffer = capture_buffer.size() / 2;
-                        size_t padding_frames_size = static_cast<size_t>(padding_frames);
-                        size_t extended_padding = (padding_frames_size > half_buffer) ? padding_frames_size : half_buffer;
-                        
-                        // But don't go beyond the buffer start
-                        if (extended_padding < capture_buffer.size()) {
-                            padding_start = capture_buffer.size() - extended_padding;
-                        }
-                    }
-                    
-                    // Log how much context we're including
-                    if (debug_enabled) {
-                        float context_seconds = static_cast<float>(padding_start) / rate;
-                        std::cout << "Debug: Including " << context_seconds << " seconds of audio context" << std::endl;
-                    }
-                    
-                    // Start a new audio buffer from the padded point
-                    audio_buffer.assign(capture_buffer.begin() + padding_start, capture_buffer.end());
-                }
-            } else {
-                // Not speech
-                silence_frames += err;
-                
-                if (was_speaking) {
-                    // Check if silence has been detected for max_silence_ms milliseconds
-                    // Or if silence detected after at least 1 second of speech
-                    bool long_enough_speech = speech_frames > rate; // At least 1 second of speech
-                    bool silence_detected = silence_frames >= max_silence_frames;
-                    bool speech_followed_by_short_silence = long_enough_speech && silence_frames >= (max_silence_frames / 3);
-                    
-                    if (silence_detected || speech_followed_by_short_silence) {
-                        // Speech end detected
-                        if (debug_enabled) {
-                            std::cout << "Info: Speech ended after " << speech_frames * 1000 / rate << " ms "
-                                      << "(silence: " << silence_frames * 1000 / rate << " ms)" << std::endl;
-                            
-                            if (speech_followed_by_short_silence && !silence_detected) {
-                                std::cout << "Info: Detected end of speech due to short silence after long speech" << std::endl;
-                            }
-                        }
-                        
-                        // When speech ends, include the silence as padding
-                        {
-                            std::lock_guard<std::mutex> lock(buffer_mutex);
-                            
-                            // Add the silence as padding, but add even more for safety
-                            // We want to ensure we don't cut off any speech at the end
-                            size_t silence_padding = static_cast<size_t>(silence_frames + padding_frames);
-                            size_t available_padding = 0;
-                            if (capture_buffer.size() > audio_buffer.size()) {
-                                available_padding = capture_buffer.size() - audio_buffer.size();
-                            }
-                            size_t padding_to_add = (silence_padding < available_padding) ? silence_padding : available_padding;
-                            
-                            if (debug_enabled) {
-                                float padding_seconds = static_cast<float>(padding_to_add) / rate;
-                                std::cout << "Debug: Adding " << padding_seconds << " seconds of end padding" << std::endl;
-                            }
-                            
-                            if (padding_to_add > 0) {
-                                audio_buffer.insert(audio_buffer.end(), 
-                                                  capture_buffer.end() - padding_to_add,
-                                                  capture_buffer.end());
-                            }
-                        }
-                        
-                        // Reset state
-                        was_speaking = false;
-                        speech_frames = 0;
-                        speech_detected.store(false);
-                        
-                        // Notify waiting threads that we have audio data
-                        cv.notify_all();
-                    }
-                } else {
-                    // Reset detection if we've been silent too long
-                    speech_frames = 0;
-                }
-            }
-            
-            // Slide the VAD buffer, keeping just enough for next window
-            if (vad_buffer.size() > vad_window_size) {
-                vad_buffer.erase(vad_buffer.begin(), vad_buffer.end() - vad_window_size/2);
-            }
+        // Print capture history size periodically (every 20 seconds)
+        if (debug_enabled && buffer_count % (20 * buffers_per_second) == 0) {
+            const size_t history_size = std::min<size_t>(capture_ring.size(), buffer_history_frames);
+            const float buffer_seconds = static_cast<float>(history_size) / rate;
+            std::cout << "Debug: Capture buffer size: " << history_size 
+                      << " samples (" << buffer_seconds << " seconds)" << std::endl;
         }
         
-        // Small sleep to prevent high CPU usage
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        // Update the VAD with just the new samples; it decides once per hop
+        segmenter.process(samples, sample_count, chunk_start, echo_gate.snapshot(), handle_segment_event);
     }
     
     // Close the audio device
-    snd_pcm_close(pcm_handle);
+    source->close();
     
     // Signal end of capture
     is_capturing.store(false);
@@ -3,13 +3,18 @@
 #include <filesystem>
 #include <cstring>
 #include <cctype>  // For std::isspace
+#include <sstream>
+#include <algorithm>
 #include <whisper.h>
+#include "audio_kernels.h"
+#include "resampler.h"
+#include "thread_scheduling.h"
 
 namespace fs = std::filesystem;
 
 // Constructor
-StreamingWhisperSTT::StreamingWhisperSTT(const WhisperConfig& cfg, bool debug)
-    : config(cfg), debug_enabled(debug) {
+StreamingWhisperSTT::StreamingWhisperSTT(const WhisperConfig& cfg, bool debug, std::shared_ptr<WhisperContextPool> shared_pool)
+    : config(cfg), pool(std::move(shared_pool)), debug_enabled(debug) {
     // Initialize whisper context
     if (!initialize()) {
         std::cerr << "Error: Failed to initialize Whisper model" << std::endl;
@@ -30,6 +35,12 @@ bool StreamingWhisperSTT::initialize() {
         return true;
     }
     
+    // Sessions sharing a pool don't load the model again
+    if (pool) {
+        is_initialized = pool->is_ready();
+        return is_initialized;
+    }
+    
     // Check if whisper executable exists (for validation, not used directly)
     if (!fs::exists(config.executable)) {
         std::cerr << "Error: Whisper executable not found at " << config.executable << std::endl;
@@ -50,146 +61,143 @@ bool StreamingWhisperSTT::initialize() {
         std::cout << "Info: Loading Whisper model from " << model_path << std::endl;
     }
     
-    // Initialize whisper context with the model
-    ctx = whisper_init_from_file_with_params(model_path.c_str(), whisper_context_default_params());
+    // Pick threads and backend for this machine
+    const int physical_cores = detect_physical_cores();
+    const bool gpu_available = system_info_has_gpu(whisper_print_system_info());
+    WhisperTuning tuning = choose_whisper_tuning(config, physical_cores, gpu_available);
+    
+    // No more threads than the cores left to this one, e.g. when the audio
+    // threads have cores of their own
+    const size_t usable_cpus = allowed_cpus().size();
+    if (config.threads <= 0 && usable_cpus > 0) {
+        tuning.threads = std::min(tuning.threads, static_cast<int>(usable_cpus));
+    }
+    if (debug_enabled) {
+        std::cout << "Info: " << physical_cores << " physical core(s), GPU backend "
+                  << (gpu_available ? "available" : "not available") << ", using "
+                  << tuning.threads << " whisper thread(s)" << std::endl;
+    }
     
-    if (!ctx) {
-        std::cerr << "Error: Failed to initialize whisper context" << std::endl;
+    // Load the model once with a decoding state per parallel session
+    auto new_pool = std::make_shared<WhisperContextPool>(model_path, config.pool_size, tuning, debug_enabled);
+    if (!new_pool->is_ready()) {
         return false;
     }
+    if (tuning.calibrate) {
+        new_pool->calibrate();
+    }
+    pool = std::move(new_pool);
     
     is_initialized = true;
     return true;
 }
 
-// Free whisper context
+// Drop the pool (freeing it if no other session uses it)
 void StreamingWhisperSTT::cleanup() {
-    if (ctx) {
-        whisper_free(ctx);
-        ctx = nullptr;
-    }
+    lease.release();
+    pool.reset();
     is_initialized = false;
 }
 
-// Simple linear resampling function
-std::vector<float> resample_audio(const std::vector<float>& input, int input_rate, int output_rate) {
-    if (input_rate == output_rate) {
-        return input;
-    }
-    
-    double ratio = static_cast<double>(output_rate) / input_rate;
-    size_t output_size = static_cast<size_t>(input.size() * ratio);
-    std::vector<float> output(output_size);
-    
-    for (size_t i = 0; i < output_size; i++) {
-        double input_idx = i / ratio;
-        size_t idx = static_cast<size_t>(input_idx);
-        double frac = input_idx - idx;
-        
-        if (idx + 1 < input.size()) {
-            // Linear interpolation
-            output[i] = input[idx] * (1.0 - frac) + input[idx + 1] * frac;
-        } else if (idx < input.size()) {
-            output[i] = input[idx];
-        } else {
-            output[i] = 0.0f;
-        }
+// Samples of silence to append after speech_samples of 16kHz speech.
+// whisper.cpp skips input shorter than one second, so short utterances are
+// padded up to that regardless of padding_ms.
+static size_t padding_for(size_t speech_samples, int padding_ms) {
+    const size_t min_samples = 16000 * 1050 / 1000;
+    size_t padding = static_cast<size_t>(16000) * std::max(0, padding_ms) / 1000;
+    if (speech_samples + padding < min_samples) {
+        padding = min_samples - speech_samples;
     }
-    
-    return output;
+    return padding;
 }
 
-// Process audio buffer
-std::string StreamingWhisperSTT::process_audio(const std::vector<float>& audio_buffer, int sample_rate) {
-    if (!is_initialized) {
-        if (!initialize()) {
-            std::cerr << "Error: Whisper context not initialized" << std::endl;
-            return "";
+// Gain that boosts quiet audio to 80% of full scale, or 1 if it is loud enough
+float StreamingWhisperSTT::quiet_gain(const float* audio, size_t count) const {
+    float max_amplitude = audio_kernels::abs_max(audio, count);
+    if (max_amplitude > 0.0f && max_amplitude < 0.1f) {
+        float gain = 0.8f / max_amplitude;
+        if (debug_enabled) {
+            std::cout << "Debug: Audio is quiet (max amplitude: " << max_amplitude 
+                      << "), applying gain of " << gain << std::endl;
         }
+        return gain;
     }
-    
-    if (audio_buffer.empty()) {
-        std::cerr << "Error: Empty audio buffer" << std::endl;
-        return "";
-    }
-    
-    // Prevent concurrent processing
-    if (is_processing.exchange(true)) {
-        std::cerr << "Error: Whisper is already processing audio" << std::endl;
-        return "";
-    }
-    
-    // Check and convert sample rate if needed
+    return 1.0f;
+}
+
+// Resample, boost and pad audio for whisper into work_buffer
+const std::vector<float>& StreamingWhisperSTT::prepare_audio(const float* audio, size_t count, int sample_rate, int padding_ms) {
     // Whisper expects 16kHz mono audio
-    std::vector<float> processed_audio;
     if (sample_rate != 16000) {
         if (debug_enabled) {
             std::cout << "Warning: Sample rate " << sample_rate << " Hz doesn't match Whisper's expected 16kHz" << std::endl;
-            std::cout << "Info: Performing simple resampling" << std::endl;
+            std::cout << "Info: Resampling to 16kHz" << std::endl;
         }
-        
-        // Resample to 16kHz (what Whisper expects)
-        processed_audio = resample_audio(audio_buffer, sample_rate, 16000);
-    } else {
-        // No resampling needed
-        processed_audio = audio_buffer;
+        PolyphaseResampler::resample(audio, count, sample_rate, 16000, work_buffer);
+        return finish_prepared_audio(padding_ms);
     }
     
-    // Add significant silence padding (3 seconds) at the end to help Whisper detect the end of sentences
-    const int padding_samples = 16000 * 3; // 3 seconds of silence at 16kHz
-    std::vector<float> padded_audio(processed_audio.size() + padding_samples);
-    
-    // Copy the original audio
-    std::copy(processed_audio.begin(), processed_audio.end(), padded_audio.begin());
-    
-    // Set the padding to zero (silence)
-    std::fill(padded_audio.begin() + processed_audio.size(), padded_audio.end(), 0.0f);
-    
-    // Boost the audio signal to improve detection
-    // Find the max amplitude to normalize
-    float max_amplitude = 0.0f;
-    for (float sample : processed_audio) {
-        float abs_sample = std::abs(sample);
-        if (abs_sample > max_amplitude) max_amplitude = abs_sample;
+    // Copy and boost in one pass
+    const float gain = quiet_gain(audio, count);
+    work_buffer.clear();
+    work_buffer.reserve(count + padding_for(count, padding_ms));
+    if (gain == 1.0f) {
+        work_buffer.assign(audio, audio + count);
+    } else {
+        work_buffer.resize(count);
+        audio_kernels::scale(audio, work_buffer.data(), count, gain);
     }
-    
-    // If audio is very quiet, apply gain
-    if (max_amplitude > 0.0f && max_amplitude < 0.1f) {
-        float gain = 0.8f / max_amplitude; // Boost to 80% of maximum
-        if (debug_enabled) {
-            std::cout << "Debug: Audio is quiet (max amplitude: " << max_amplitude 
-                      << "), applying gain of " << gain << std::endl;
-        }
-        
-        // Apply the gain
-        for (size_t i = 0; i < processed_audio.size(); i++) {
-            padded_audio[i] = processed_audio[i] * gain;
-        }
+    return pad_prepared_audio(count, padding_ms);
+}
+
+// Same, taking over the caller's buffer so 16kHz audio is not copied at all
+const std::vector<float>& StreamingWhisperSTT::prepare_audio(std::vector<float>&& audio, int sample_rate, int padding_ms) {
+    if (sample_rate != 16000) {
+        return prepare_audio(audio.data(), audio.size(), sample_rate, padding_ms);
     }
-    
-    // Use the padded audio for processing
-    processed_audio = padded_audio;
+    work_buffer.swap(audio);
+    return finish_prepared_audio(padding_ms);
+}
+
+// Boost work_buffer in place and pad it
+const std::vector<float>& StreamingWhisperSTT::finish_prepared_audio(int padding_ms) {
+    const size_t speech_samples = work_buffer.size();
+    const float gain = quiet_gain(work_buffer.data(), speech_samples);
+    if (gain != 1.0f) {
+        audio_kernels::scale(work_buffer.data(), work_buffer.data(), speech_samples, gain);
+    }
+    return pad_prepared_audio(speech_samples, padding_ms);
+}
+
+// Append silence after the speech_samples in work_buffer so whisper sees the end of the sentence
+const std::vector<float>& StreamingWhisperSTT::pad_prepared_audio(size_t speech_samples, int padding_ms) {
+    work_buffer.resize(speech_samples + padding_for(speech_samples, padding_ms), 0.0f);
     
     if (debug_enabled) {
-        std::cout << "Info: Processing " << processed_audio.size() << " audio samples with Whisper" << std::endl;
+        std::cout << "Info: Processing " << work_buffer.size() << " audio samples with Whisper" << std::endl;
         
         // Print some stats about the audio
-        float max_amplitude = 0.0f;
+        float max_amplitude = audio_kernels::abs_max(work_buffer.data(), work_buffer.size());
         float avg_amplitude = 0.0f;
-        for (float sample : processed_audio) {
-            float abs_sample = std::abs(sample);
-            if (abs_sample > max_amplitude) max_amplitude = abs_sample;
-            avg_amplitude += abs_sample;
-        }
-        
-        if (!processed_audio.empty()) {
-            avg_amplitude /= processed_audio.size();
+        if (!work_buffer.empty()) {
+            avg_amplitude = audio_kernels::abs_sum(work_buffer.data(), work_buffer.size()) / work_buffer.size();
         }
         
         std::cout << "Debug: Audio stats - Max amplitude: " << max_amplitude 
                   << ", Avg amplitude: " << avg_amplitude << std::endl;
     }
     
+    return work_buffer;
+}
+
+// Run whisper over prepared audio
+bool StreamingWhisperSTT::run_whisper(const std::vector<float>& audio, const std::vector<int32_t>& prompt_tokens, bool use_context, bool wait) {
+    // Borrow a decoding state, with this session's share of the thread budget
+    lease = wait ? pool->acquire() : pool->try_acquire();
+    if (!lease) {
+        return false;
+    }
+    
     // Set up whisper parameters - switch to greedy sampling for more reliable basic transcription
     whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
     wparams.print_realtime = false;
@@ -197,15 +205,18 @@ std::string StreamingWhisperSTT::process_audio(const std::vector<float>& audio_b
     wparams.print_timestamps = false;
     wparams.translate = false;
     wparams.language = "en"; // Language code for English
-    wparams.n_threads = 4;   // Use 4 threads for processing
+    wparams.n_threads = lease.n_threads();
     
     // For our use case, trying to get complete sentences:
-    wparams.no_context = false;               // Use context for better continuity
+    // Use context for better continuity, but only if no other session can
+    // have decoded with this state last
+    const bool state_is_ours = pool.use_count() == 1 && pool->size() == 1;
+    wparams.no_context = !use_context || !state_is_ours;
     wparams.single_segment = false;           // Allow multiple segments for longer sentences
     wparams.max_len = 0;                      // No length limit on transcription
     wparams.temperature = 0.0f;               // Zero temperature for deterministic output
-    wparams.prompt_tokens = nullptr;          // No prompt tokens
-    wparams.prompt_n_tokens = 0;              // No prompt tokens count
+    wparams.prompt_tokens = prompt_tokens.empty() ? nullptr : prompt_tokens.data();
+    wparams.prompt_n_tokens = static_cast<int>(prompt_tokens.size());
     
     // These parameters work better for sentence detection
     wparams.token_timestamps = false;         // Don't need token timestamps
@@ -214,6 +225,7 @@ std::string StreamingWhisperSTT::process_audio(const std::vector<float>& audio_b
     wparams.duration_ms = 0;                  // Process the entire thing at once
     
     // Parse any additional parameters from config
+    std::string lang;
     if (!config.params.empty()) {
         std::istringstream params_stream(config.params);
         std::string param;
@@ -221,7 +233,6 @@ std::string StreamingWhisperSTT::process_audio(const std::vector<float>& audio_b
             if (param == "--translate") {
                 wparams.translate = true;
             } else if (param == "-l" || param == "--language") {
-                std::string lang;
                 params_stream >> lang;
                 wparams.language = lang.c_str();
             } else if (param == "-t" || param == "--threads") {
@@ -233,40 +244,27 @@ std::string StreamingWhisperSTT::process_audio(const std::vector<float>& audio_b
     }
     
     // Run whisper processing
-    if (whisper_full(ctx, wparams, processed_audio.data(), processed_audio.size()) != 0) {
+    if (whisper_full_with_state(pool->context(), lease.state(), wparams, audio.data(), audio.size()) != 0) {
         std::cerr << "Error: Failed to process audio with whisper" << std::endl;
-        is_processing.store(false);
-        return "";
+        return false;
     }
     
     // Check if we've been interrupted
     if (running_flag && !(*running_flag)) {
         std::cout << "Info: Processing interrupted by signal" << std::endl;
-        is_processing.store(false);
-        return "";
-    }
-    
-    // Get the number of segments
-    const int n_segments = whisper_full_n_segments(ctx);
-    if (n_segments <= 0) {
-        if (debug_enabled) {
-            std::cout << "Info: No speech detected in audio" << std::endl;
-        }
-        is_processing.store(false);
-        return "";
+        return false;
     }
     
-    // Extract the transcription text from all segments
+    return true;
+}
+
+// Join the text of a range of segments from the last whisper run
+std::string StreamingWhisperSTT::collect_segments(int first, int last) const {
     std::string result;
     
-    // Log how many segments we found
-    if (debug_enabled) {
-        std::cout << "Debug: Whisper found " << n_segments << " segment(s)" << std::endl;
-    }
-    
     // Join all segments into one complete transcript
-    for (int i = 0; i < n_segments; i++) {
-        const char* text = whisper_full_get_segment_text(ctx, i);
+    for (int i = first; i < last; i++) {
+        const char* text = whisper_full_get_segment_text_from_state(lease.state(), i);
         
         // Log each segment separately for debugging
         if (debug_enabled) {
@@ -288,40 +286,233 @@ std::string StreamingWhisperSTT::process_audio(const std::vector<float>& audio_b
             result += text;
             
             // Add space between segments if needed
-            if (i < n_segments - 1 && !segment_text.empty() && 
+            if (i < last - 1 && !segment_text.empty() && 
                 segment_text.back() != ' ' && segment_text.back() != '\n') {
                 result += " ";
             }
         }
     }
     
+    return result;
+}
+
+// Join committed text and the text after it
+static std::string join_transcript(const std::string& head, const std::string& tail) {
+    if (head.empty()) return tail;
+    if (tail.empty()) return head;
+    if (std::isspace(static_cast<unsigned char>(head.back())) || std::isspace(static_cast<unsigned char>(tail.front()))) {
+        return head + tail;
+    }
+    return head + " " + tail;
+}
+
+void StreamingWhisperSTT::set_live_transcript(const std::string& text) {
+    std::lock_guard<std::mutex> lock(transcript_mutex);
+    live_transcript = text;
+}
+
+// Process audio buffer
+std::string StreamingWhisperSTT::process_audio(const std::vector<float>& audio_buffer, int sample_rate) {
+    if (!ready_for(audio_buffer)) {
+        return "";
+    }
+    
+    // Calls on the same session take turns; other sessions run in parallel
+    // on their own pool states
+    std::lock_guard<std::mutex> lock(whisper_mutex);
+    is_processing.store(true);
+    prepare_audio(audio_buffer.data(), audio_buffer.size(), sample_rate, config.tail_padding_ms);
+    return transcribe_prepared();
+}
+
+// Process audio buffer the caller no longer needs, without copying it
+std::string StreamingWhisperSTT::process_audio(std::vector<float>&& audio_buffer, int sample_rate) {
+    if (!ready_for(audio_buffer)) {
+        return "";
+    }
+    
+    std::lock_guard<std::mutex> lock(whisper_mutex);
+    is_processing.store(true);
+    prepare_audio(std::move(audio_buffer), sample_rate, config.tail_padding_ms);
+    return transcribe_prepared();
+}
+
+// Make sure the model is loaded and there is audio to transcribe
+bool StreamingWhisperSTT::ready_for(const std::vector<float>& audio_buffer) {
+    if (!is_initialized) {
+        if (!initialize()) {
+            std::cerr << "Error: Whisper context not initialized" << std::endl;
+            return false;
+        }
+    }
+    
+    if (audio_buffer.empty()) {
+        std::cerr << "Error: Empty audio buffer" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Transcribe work_buffer as a whole utterance; the caller holds whisper_mutex
+std::string StreamingWhisperSTT::transcribe_prepared() {
+    if (!run_whisper(work_buffer, {}, true)) {
+        release_state();
+        is_processing.store(false);
+        return "";
+    }
+    
+    // Get the number of segments
+    const int n_segments = whisper_full_n_segments_from_state(lease.state());
+    if (n_segments <= 0) {
+        if (debug_enabled) {
+            std::cout << "Info: No speech detected in audio" << std::endl;
+        }
+        set_live_transcript("");
+        release_state();
+        is_processing.store(false);
+        return "";
+    }
+    
+    // Log how many segments we found
+    if (debug_enabled) {
+        std::cout << "Debug: Whisper found " << n_segments << " segment(s)" << std::endl;
+    }
+    
+    // Extract the transcription text from all segments
+    std::string result = collect_segments(0, n_segments);
+    
     if (debug_enabled) {
         std::cout << "Info: Whisper transcription: \"" << result << "\"" << std::endl;
     }
     
+    set_live_transcript(result);
+    release_state();
     is_processing.store(false);
     return result;
 }
 
-// Get the last transcript
-std::string StreamingWhisperSTT::get_last_transcript() const {
-    if (!ctx || !is_initialized) {
-        return "";
+// Decode the uncommitted part of an utterance that is still being spoken
+std::string StreamingWhisperSTT::process_partial(const std::vector<float>& audio, int sample_rate, uint64_t utterance_id) {
+    if (!is_initialized || audio.empty()) {
+        return get_last_transcript();
     }
     
-    const int n_segments = whisper_full_n_segments(ctx);
-    if (n_segments <= 0) {
-        return "";
+    // Never make the final pass wait behind a partial one
+    std::unique_lock<std::mutex> lock(whisper_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || is_processing.exchange(true)) {
+        return get_last_transcript();
     }
     
-    std::string result;
+    if (utterance_id != partial.utterance_id) {
+        partial = PartialState();
+        partial.utterance_id = utterance_id;
+        set_live_transcript("");
+    }
+    
+    // Whisper is unreliable on very short clips, so wait for a full second
+    const size_t start = std::min(partial.committed_samples, audio.size());
+    const size_t window = audio.size() - start;
+    if (window < static_cast<size_t>(sample_rate)) {
+        is_processing.store(false);
+        return get_last_transcript();
+    }
+    
+    const std::vector<float>& processed_audio = prepare_audio(audio.data() + start, window, sample_rate, 0);
+    // Re-decoded windows must not leak into whisper's own context, so only
+    // the committed prompt is used
+    if (!run_whisper(processed_audio, partial.prompt_tokens, false, false)) {
+        release_state();
+        is_processing.store(false);
+        return get_last_transcript();
+    }
+    
+    // Commit segments that end well before the newest audio; the last segment
+    // stays tentative unless the window has grown too long to keep re-decoding
+    const int n_segments = whisper_full_n_segments_from_state(lease.state());
+    const int64_t window_ms = static_cast<int64_t>(window) * 1000 / sample_rate;
+    const int64_t commit_limit_ms = window_ms - config.partial_keep_ms;
+    const bool force_commit = window_ms > config.partial_length_ms;
+    const whisper_token eot = whisper_token_eot(pool->context());
+    
+    int committed = 0;
+    int64_t committed_end_ms = 0;
     for (int i = 0; i < n_segments; i++) {
-        const char* text = whisper_full_get_segment_text(ctx, i);
-        result += text;
-        if (i < n_segments - 1) {
-            result += " ";
+        int64_t t1_ms = whisper_full_get_segment_t1_from_state(lease.state(), i) * 10;
+        if (t1_ms > commit_limit_ms || (i == n_segments - 1 && !force_commit)) {
+            break;
+        }
+        
+        // Text tokens become the prompt for the next window
+        const int n_tokens = whisper_full_n_tokens_from_state(lease.state(), i);
+        for (int k = 0; k < n_tokens; k++) {
+            whisper_token token = whisper_full_get_token_id_from_state(lease.state(), i, k);
+            if (token < eot) {
+                partial.prompt_tokens.push_back(token);
+            }
+        }
+        committed = i + 1;
+        committed_end_ms = t1_ms;
+    }
+    
+    if (committed > 0) {
+        partial.committed_text = join_transcript(partial.committed_text, collect_segments(0, committed));
+        partial.committed_samples = start + static_cast<size_t>(committed_end_ms * sample_rate / 1000);
+        
+        // Whisper only looks at the most recent prompt tokens anyway
+        const size_t max_prompt_tokens = 224;
+        if (partial.prompt_tokens.size() > max_prompt_tokens) {
+            partial.prompt_tokens.erase(partial.prompt_tokens.begin(),
+                                        partial.prompt_tokens.end() - max_prompt_tokens);
         }
     }
     
+    std::string result = join_transcript(partial.committed_text, collect_segments(committed, n_segments));
+    if (debug_enabled) {
+        std::cout << "Debug: Partial transcript (" << committed << " of " << n_segments
+                  << " new segment(s) committed): \"" << result << "\"" << std::endl;
+    }
+    
+    set_live_transcript(result);
+    release_state();
+    is_processing.store(false);
     return result;
-}
\ No newline at end of file
+}
+
+// Finish an utterance, decoding only what the partial passes have not committed
+std::string StreamingWhisperSTT::finalize(std::vector<float> audio, int sample_rate, uint64_t utterance_id) {
+    std::unique_lock<std::mutex> lock(whisper_mutex);
+    if (!config.incremental || utterance_id != partial.utterance_id || partial.committed_samples == 0) {
+        partial = PartialState();
+        lock.unlock();
+        return process_audio(std::move(audio), sample_rate);
+    }
+    
+    PartialState state = partial;
+    partial = PartialState();
+    
+    const size_t start = std::min(state.committed_samples, audio.size());
+    std::string tail;
+    if (audio.size() - start > 0) {
+        is_processing.store(true);
+        const std::vector<float>& processed_audio = prepare_audio(audio.data() + start, audio.size() - start, sample_rate, config.tail_padding_ms);
+        if (run_whisper(processed_audio, state.prompt_tokens, false)) {
+            tail = collect_segments(0, whisper_full_n_segments_from_state(lease.state()));
+        }
+        release_state();
+        is_processing.store(false);
+    }
+    
+    std::string result = join_transcript(state.committed_text, tail);
+    if (debug_enabled) {
+        std::cout << "Info: Whisper transcription (incremental): \"" << result << "\"" << std::endl;
+    }
+    
+    set_live_transcript(result);
+    return result;
+}
+
+// Get the last transcript
+std::string StreamingWhisperSTT::get_last_transcript() const {
+    std::lock_guard<std::mutex> lock(transcript_mutex);
+    return live_transcript;
+}
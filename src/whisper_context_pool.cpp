@@ -0,0 +1,212 @@
+#include "whisper_context_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sys/prctl.h>
+#include <whisper.h>
+#include "mapped_file.h"
+
+#ifndef PR_SET_MEMORY_MERGE
+#define PR_SET_MEMORY_MERGE 67
+#endif
+
+namespace {
+
+// whisper_model_loader callbacks reading from a MappedFile
+size_t mapped_read(void* context, void* output, size_t read_size) {
+    return static_cast<MappedFile*>(context)->read(output, read_size);
+}
+
+bool mapped_eof(void* context) {
+    return static_cast<MappedFile*>(context)->eof();
+}
+
+void mapped_close(void* context) {
+    static_cast<MappedFile*>(context)->close();
+}
+
+// Let KSM merge this process's identical anonymous pages with those of
+// other processes, so instances loading the same model end up sharing one
+// copy of the weights. Needs Linux 6.4 and KSM switched on by the admin.
+void enable_weight_sharing(bool debug) {
+    if (prctl(PR_SET_MEMORY_MERGE, 1, 0, 0, 0) != 0) {
+        std::cerr << "Warning: Cannot share whisper weights between processes: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    
+    std::ifstream ksm_run("/sys/kernel/mm/ksm/run");
+    int run = 0;
+    if (!(ksm_run >> run) || run != 1) {
+        std::cerr << "Warning: KSM is not running, so whisper weights are not shared yet. "
+                  << "Enable it with: echo 1 | sudo tee /sys/kernel/mm/ksm/run" << std::endl;
+    } else if (debug) {
+        std::cout << "Info: Whisper weights can be shared with other processes through KSM" << std::endl;
+    }
+}
+
+} // namespace
+
+WhisperContextPool::WhisperContextPool(const std::string& model_path, int n_states, const WhisperTuning& tuning, bool debug)
+    : debug_enabled(debug) {
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = tuning.use_gpu;
+    cparams.flash_attn = tuning.flash_attn;
+    cparams.gpu_device = tuning.gpu_device;
+    
+    if (tuning.share_weights) {
+        enable_weight_sharing(debug);
+    }
+    
+    // Load the weights once, without the per-context decoding state. Through
+    // a mapping the file is read straight out of the page cache, which other
+    // instances loading the same model have already filled.
+    MappedFile model_file;
+    if (tuning.use_mmap && model_file.open(model_path)) {
+        whisper_model_loader loader = {};
+        loader.context = &model_file;
+        loader.read = mapped_read;
+        loader.eof = mapped_eof;
+        loader.close = mapped_close;
+        ctx = whisper_init_with_params_no_state(&loader, cparams);
+    } else {
+        if (tuning.use_mmap) {
+            std::cerr << "Warning: Cannot map " << model_path << ", reading it instead" << std::endl;
+        }
+        ctx = whisper_init_from_file_with_params_no_state(model_path.c_str(), cparams);
+    }
+    if (!ctx) {
+        std::cerr << "Error: Failed to initialize whisper context" << std::endl;
+        return;
+    }
+    
+    n_states = std::max(1, n_states);
+    for (int i = 0; i < n_states; i++) {
+        whisper_state* state = whisper_init_state(ctx);
+        if (!state) {
+            std::cerr << "Error: Failed to create whisper state " << i + 1 << " of " << n_states << std::endl;
+            break;
+        }
+        states.push_back(state);
+    }
+    free_states = states;
+    
+    per_state_threads = std::max(1, tuning.threads / std::max(1, size()));
+    
+    if (debug) {
+        std::cout << "Info: Whisper pool with " << size() << " state(s), "
+                  << per_state_threads << " thread(s) each, GPU " << (tuning.use_gpu ? "on" : "off")
+                  << ", flash attention " << (tuning.flash_attn ? "on" : "off") << std::endl;
+    }
+}
+
+void WhisperContextPool::calibrate() {
+    if (!is_ready()) {
+        return;
+    }
+    
+    // Three seconds of a quiet tone: enough to run the encoder and a short decode
+    const int sample_rate = 16000;
+    std::vector<float> audio(3 * sample_rate);
+    for (size_t i = 0; i < audio.size(); i++) {
+        audio[i] = 0.05f * std::sin(2.0f * 3.14159265f * 220.0f * i / sample_rate);
+    }
+    const double audio_ms = 1000.0 * audio.size() / sample_rate;
+    
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.print_realtime = false;
+    wparams.print_progress = false;
+    wparams.print_timestamps = false;
+    wparams.no_context = true;
+    wparams.single_segment = true;
+    wparams.language = "en";
+    
+    whisper_state* state = states.front();
+    auto time_run = [&](int threads) {
+        wparams.n_threads = threads;
+        auto start = std::chrono::steady_clock::now();
+        whisper_full_with_state(ctx, state, wparams, audio.data(), static_cast<int>(audio.size()));
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    
+    // The first run pays for allocating buffers, so it is not timed
+    time_run(per_state_threads);
+    
+    int best_threads = per_state_threads;
+    double best_ms = 0.0;
+    for (int threads : calibration_candidates(per_state_threads)) {
+        double ms = time_run(threads);
+        if (debug_enabled) {
+            std::cout << "Info: Whisper calibration: " << threads << " thread(s) took " << ms
+                      << " ms (real-time factor " << ms / audio_ms << ")" << std::endl;
+        }
+        if (best_ms == 0.0 || ms < best_ms) {
+            best_ms = ms;
+            best_threads = threads;
+        }
+    }
+    
+    per_state_threads = best_threads;
+    std::cout << "Info: Whisper calibrated to " << best_threads << " thread(s) per state, real-time factor "
+              << best_ms / audio_ms << std::endl;
+}
+
+WhisperContextPool::~WhisperContextPool() {
+    for (whisper_state* state : states) {
+        whisper_free_state(state);
+    }
+    if (ctx) {
+        whisper_free(ctx);
+    }
+}
+
+WhisperContextPool::Lease WhisperContextPool::acquire() {
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    if (states.empty()) {
+        return Lease();
+    }
+    
+    // Serve callers in the order they arrived
+    const uint64_t ticket = next_ticket++;
+    cv.wait(lock, [this, ticket] { return ticket == now_serving && !free_states.empty(); });
+    
+    whisper_state* state = free_states.back();
+    free_states.pop_back();
+    now_serving++;
+    cv.notify_all();
+    return Lease(this, state);
+}
+
+WhisperContextPool::Lease WhisperContextPool::try_acquire() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (free_states.empty() || next_ticket != now_serving) {
+        return Lease();
+    }
+    
+    whisper_state* state = free_states.back();
+    free_states.pop_back();
+    return Lease(this, state);
+}
+
+void WhisperContextPool::give_back(whisper_state* state) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        free_states.push_back(state);
+    }
+    cv.notify_all();
+}
+
+int WhisperContextPool::Lease::n_threads() const {
+    return pool ? pool->threads_per_state() : 1;
+}
+
+void WhisperContextPool::Lease::release() {
+    if (pool && state_) {
+        pool->give_back(state_);
+    }
+    pool = nullptr;
+    state_ = nullptr;
+}
@@ -0,0 +1,60 @@
+#include "vad.h"
+#include <iostream>
+#include <filesystem>
+#include <whisper.h>
+
+namespace {
+
+// Silero VAD through whisper.cpp. The model scores each 32 ms of 16kHz audio;
+// a window counts as speech if any of its chunks does, so onsets are not
+// averaged away by the silence before them.
+class WhisperVadClassifier : public SpeechClassifier {
+private:
+    whisper_vad_context* ctx;
+
+public:
+    explicit WhisperVadClassifier(whisper_vad_context* context) : ctx(context) {}
+    
+    ~WhisperVadClassifier() override {
+        whisper_vad_free(ctx);
+    }
+    
+    float speech_probability(const float* samples, size_t count) override {
+        if (!whisper_vad_detect_speech(ctx, samples, static_cast<int>(count))) {
+            return 0.0f;
+        }
+        
+        const int n_probs = whisper_vad_n_probs(ctx);
+        const float* probs = whisper_vad_probs(ctx);
+        float best = 0.0f;
+        for (int i = 0; i < n_probs; i++) {
+            best = std::max(best, probs[i]);
+        }
+        return best;
+    }
+    
+    const char* name() const override {
+        return "silero";
+    }
+};
+
+} // namespace
+
+std::unique_ptr<SpeechClassifier> create_whisper_vad_classifier(const std::string& model_path, int threads) {
+    if (!std::filesystem::exists(model_path)) {
+        std::cerr << "Warning: VAD model " << model_path << " not found, using the energy VAD" << std::endl;
+        return nullptr;
+    }
+    
+    // The model is tiny; the GPU would only add transfer latency
+    whisper_vad_context_params params = whisper_vad_default_context_params();
+    params.n_threads = std::max(1, threads);
+    params.use_gpu = false;
+    
+    whisper_vad_context* ctx = whisper_vad_init_from_file_with_params(model_path.c_str(), params);
+    if (!ctx) {
+        std::cerr << "Warning: Cannot load VAD model " << model_path << ", using the energy VAD" << std::endl;
+        return nullptr;
+    }
+    return std::make_unique<WhisperVadClassifier>(ctx);
+}
@@ -0,0 +1,570 @@
+// Pipeline benchmark: replays recorded utterances through the assistant's
+// stages and reports how fast each one runs, so changes that slow down a
+// stage or make it allocate per turn show up before they are deployed.
+//
+//   bench_pipeline [options] [fixture.wav ...]
+//
+// Each WAV fixture is fed to the capture stage the way the ALSA thread sees
+// it (device-rate chunks, resampled, then the VAD and speech segmenter).
+// Every utterance found is transcribed by StreamingWhisperSTT if the model
+// exists, sent to a local mock Ollama server that streams a canned reply,
+// and the reply is normalized for TTS. Without fixtures a reproducible
+// synthetic recording is used.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+#include "config.h"
+#include "audio_kernels.h"
+#include "resampler.h"
+#include "speech_segmenter.h"
+#include "audio_source.h"
+#include "wav_file.h"
+#include "streaming_whisper_stt.h"
+#include "ollama_client.h"
+#include "tts_normalizer.h"
+
+// Count heap allocations made by each thread, so a stage can report how
+// many it needed. Threads the stages start themselves are not included.
+static thread_local uint64_t t_allocations = 0;
+
+static void* counted_malloc(size_t size) {
+    t_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return counted_malloc(size); }
+void* operator new[](size_t size) { return counted_malloc(size); }
+
+// Kept out of line so the compiler does not pair new expressions with free()
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Timings of one stage
+struct StageStats {
+    std::string name;
+    std::vector<double> samples_ms; // One per call
+    double audio_seconds = 0.0;     // Audio covered by the calls, for the real-time factor
+    uint64_t allocations = 0;
+    
+    explicit StageStats(const std::string& stage_name) : name(stage_name) {}
+    
+    double total_ms() const {
+        double total = 0.0;
+        for (double ms : samples_ms) total += ms;
+        return total;
+    }
+    
+    // Nearest-rank percentile, q from 0 to 1
+    double percentile(double q) const {
+        if (samples_ms.empty()) return 0.0;
+        std::vector<double> sorted = samples_ms;
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+    
+    // Processing time over audio time; below 1 keeps up with real time
+    double real_time_factor() const {
+        return audio_seconds > 0.0 ? total_ms() / (1000.0 * audio_seconds) : 0.0;
+    }
+};
+
+// A reproducible stand-in for a recording: voiced bursts of 1 to 2.5 s with
+// harmonics and a syllable-rate envelope, separated by quiet room noise. The
+// utterances come from their own generator, so every rate gets the same ones.
+std::vector<float> synthesize_fixture(int sample_rate, int utterances, uint32_t seed) {
+    auto generator = [](uint32_t state) {
+        return [state]() mutable {
+            state = state * 1664525u + 1013904223u;
+            return static_cast<float>(state >> 8) / 16777216.0f; // [0, 1)
+        };
+    };
+    auto next = generator(seed);
+    auto noise = generator(seed ^ 0x9e3779b9u);
+    
+    std::vector<float> audio;
+    auto add_noise = [&](float seconds) {
+        size_t count = static_cast<size_t>(seconds * sample_rate);
+        for (size_t i = 0; i < count; i++) {
+            audio.push_back(0.002f * (2.0f * noise() - 1.0f));
+        }
+    };
+    
+    add_noise(1.5f);
+    for (int u = 0; u < utterances; u++) {
+        const float seconds = 1.0f + 1.5f * next();
+        const float pitch = 110.0f + 80.0f * next();
+        const float syllable_rate = 3.0f + 2.0f * next();
+        const size_t count = static_cast<size_t>(seconds * sample_rate);
+        double phase = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            float t = static_cast<float>(i) / sample_rate;
+            // A slow pitch glide so the harmonics are not perfectly periodic
+            float f0 = pitch * (1.0f + 0.05f * std::sin(2.0f * static_cast<float>(M_PI) * 0.7f * t));
+            phase += 2.0 * M_PI * f0 / sample_rate;
+            float voiced = 0.0f;
+            for (int k = 1; k <= 10; k++) {
+                voiced += std::sin(static_cast<float>(k * phase)) / k;
+            }
+            float envelope = 0.5f - 0.5f * std::cos(2.0f * static_cast<float>(M_PI) * syllable_rate * t);
+            audio.push_back(0.12f * envelope * voiced + 0.002f * (2.0f * noise() - 1.0f));
+        }
+        add_noise(1.0f + 0.5f * next());
+    }
+    add_noise(1.0f);
+    return audio;
+}
+
+// Replay a recording the way the capture thread sees it: int16 device-rate
+// chunks read from an AudioSource, converted, resampled to 16 kHz, appended
+// to the history and fed to the segmenter. Returns the utterances found.
+std::vector<std::vector<float>> replay_capture(const std::vector<float>& recording, int device_rate,
+                                               const VADParams& vad_params, SpeechClassifier* classifier,
+                                               StageStats& stats) {
+    const int rate = 16000;
+    std::vector<int16_t> pcm(recording.size());
+    for (size_t i = 0; i < recording.size(); i++) {
+        pcm[i] = static_cast<int16_t>(std::max(-1.0f, std::min(1.0f, recording[i])) * 32767.0f);
+    }
+    
+    // Read through the same source interface as the capture thread, as fast as possible
+    PcmFileSource source(std::move(pcm), device_rate);
+    source.open(rate);
+    
+    const size_t history_ms = static_cast<size_t>(vad_params.buffer_history_ms) + vad_params.max_speech_ms +
+                              vad_params.max_silence_ms + vad_params.padding_ms;
+    SpeechSegmenter segmenter(vad_params, rate, history_ms * rate / 1000);
+    if (classifier) {
+        segmenter.set_classifier(classifier);
+    }
+    
+    // Same chunking as the capture thread
+    const int hop_frames = static_cast<int>(segmenter.get_hop_size());
+    const int device_hop_frames = static_cast<int>(static_cast<uint64_t>(hop_frames) * device_rate / rate);
+    const size_t frames_per_chunk = static_cast<size_t>(std::max(1, std::min(device_rate / 10, device_hop_frames)));
+    std::vector<int16_t> pcm_buffer(frames_per_chunk);
+    std::vector<float> float_buffer(frames_per_chunk);
+    PolyphaseResampler resampler(device_rate, rate);
+    std::vector<float> resampled_buffer;
+    resampled_buffer.reserve(resampler.max_output(frames_per_chunk));
+    
+    // The whole stream stands in for the capture ring
+    std::vector<float> stream;
+    stream.reserve(resampler.max_output(recording.size()));
+    
+    struct Boundary {
+        uint64_t start;
+        uint64_t end;
+    };
+    std::vector<Boundary> boundaries;
+    boundaries.reserve(64);
+    auto on_event = [&boundaries](SpeechSegmenter::Event event, uint64_t start, uint64_t end) {
+        if (event == SpeechSegmenter::Event::Ended || event == SpeechSegmenter::Event::Split) {
+            boundaries.push_back({start, end});
+        }
+    };
+    
+    // Allocations are counted after the first second, once buffers have grown
+    const size_t warmup_frames = static_cast<size_t>(device_rate);
+    uint64_t allocations_before = 0;
+    size_t frames_read = 0;
+    while (true) {
+        if (frames_read >= warmup_frames && allocations_before == 0) {
+            allocations_before = t_allocations;
+        }
+        auto start = Clock::now();
+        const long read = source.read(pcm_buffer.data(), frames_per_chunk);
+        if (read <= 0) {
+            break;
+        }
+        const size_t count = static_cast<size_t>(read);
+        frames_read += count;
+        
+        audio_kernels::convert_s16_to_f32(pcm_buffer.data(), float_buffer.data(), count);
+        const float* samples = float_buffer.data();
+        size_t sample_count = count;
+        if (!resampler.is_passthrough()) {
+            resampled_buffer.clear();
+            resampler.process(float_buffer.data(), count, resampled_buffer);
+            samples = resampled_buffer.data();
+            sample_count = resampled_buffer.size();
+        }
+        const uint64_t chunk_start = stream.size();
+        stream.insert(stream.end(), samples, samples + sample_count);
+        segmenter.process(samples, sample_count, chunk_start, SpeechSegmenter::EchoGate(), on_event);
+        
+        stats.samples_ms.push_back(elapsed_ms(start));
+    }
+    segmenter.finish(stream.size(), on_event);
+    if (allocations_before > 0) {
+        stats.allocations += t_allocations - allocations_before;
+    }
+    stats.audio_seconds += static_cast<double>(recording.size()) / device_rate;
+    
+    std::vector<std::vector<float>> utterances;
+    for (const Boundary& boundary : boundaries) {
+        utterances.emplace_back(stream.begin() + boundary.start, stream.begin() + boundary.end);
+    }
+    return utterances;
+}
+
+// Streams a canned NDJSON reply to every request, like `ollama serve` with
+// a very fast model. token_ms delays each piece to mimic generation.
+class MockOllamaServer {
+private:
+    int server = -1;
+    std::thread worker;
+    std::atomic<bool> running{true};
+    std::string reply;
+    int token_ms;
+    
+    void serve(int client) {
+        // Read the request headers and the body announced by Content-Length
+        std::string received;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+            received.append(buffer, n);
+            size_t header_end = received.find("\r\n\r\n");
+            size_t length_pos = received.find("Content-Length: ");
+            if (header_end != std::string::npos &&
+                (length_pos == std::string::npos ||
+                 received.size() >= header_end + 4 + std::stoul(received.substr(length_pos + 16)))) {
+                break;
+            }
+        }
+        
+        std::string header = "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\nConnection: close\r\n\r\n";
+        send(client, header.data(), header.size(), MSG_NOSIGNAL);
+        
+        // A few characters per chunk, like tokens
+        for (size_t pos = 0; pos < reply.size(); pos += 4) {
+            nlohmann::json chunk = {{"model", "bench"}, {"response", reply.substr(pos, 4)}, {"done", false}};
+            std::string line = chunk.dump() + "\n";
+            send(client, line.data(), line.size(), MSG_NOSIGNAL);
+            if (token_ms > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(token_ms));
+            }
+        }
+        std::string done = "{\"model\":\"bench\",\"response\":\"\",\"done\":true}\n";
+        send(client, done.data(), done.size(), MSG_NOSIGNAL);
+        close(client);
+    }
+
+public:
+    int port = 0;
+    
+    MockOllamaServer(const std::string& reply_text, int delay_ms) : reply(reply_text), token_ms(delay_ms) {
+        server = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        listen(server, 4);
+        socklen_t addr_len = sizeof(addr);
+        getsockname(server, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+        port = ntohs(addr.sin_port);
+        
+        worker = std::thread([this] {
+            while (running.load()) {
+                int client = accept(server, nullptr, nullptr);
+                if (client < 0) break;
+                serve(client);
+            }
+        });
+    }
+    
+    ~MockOllamaServer() {
+        running.store(false);
+        shutdown(server, SHUT_RDWR); // Wakes up accept()
+        if (worker.joinable()) worker.join();
+        close(server);
+    }
+};
+
+// A reply with the abbreviations, numbers and markdown the normalizer handles
+const char* kCannedReply =
+    "Sure! Dr. Smith's meeting is at 3 p.m. in St. Louis, and it should take about 45 minutes. "
+    "The forecast says 72 degrees with a 10% chance of rain, so **bring** an umbrella just in case. "
+    "Tickets cost $4.50 each, e.g. $18 for a group of 4. Is there anything else I can help you with?";
+
+// Prompts used when there is no whisper model to transcribe the fixtures
+const char* kFallbackPrompts[] = {
+    "What's on my calendar this afternoon?",
+    "Will it rain in St. Louis today?",
+    "How much are the tickets?",
+};
+
+void print_table(const std::vector<const StageStats*>& stages, size_t turns) {
+    std::cout << "\n" << std::left << std::setw(20) << "Stage" << std::right
+              << std::setw(7) << "calls" << std::setw(11) << "p50 ms" << std::setw(11) << "p90 ms"
+              << std::setw(11) << "p99 ms" << std::setw(11) << "max ms" << std::setw(9) << "RTF"
+              << std::setw(13) << "allocs/turn" << "\n";
+    for (const StageStats* stage : stages) {
+        if (stage->samples_ms.empty()) continue;
+        std::cout << std::left << std::setw(20) << stage->name << std::right << std::fixed
+                  << std::setw(7) << stage->samples_ms.size() << std::setprecision(3)
+                  << std::setw(11) << stage->percentile(0.5) << std::setw(11) << stage->percentile(0.9)
+                  << std::setw(11) << stage->percentile(0.99) << std::setw(11) << stage->percentile(1.0);
+        if (stage->audio_seconds > 0.0) {
+            std::cout << std::setw(9) << stage->real_time_factor();
+        } else {
+            std::cout << std::setw(9) << "-";
+        }
+        std::cout << std::setprecision(1) << std::setw(13)
+                  << (turns ? static_cast<double>(stage->allocations) / turns : 0.0) << "\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+nlohmann::json to_json(const std::vector<const StageStats*>& stages, size_t turns) {
+    nlohmann::json result;
+    result["turns"] = turns;
+    for (const StageStats* stage : stages) {
+        if (stage->samples_ms.empty()) continue;
+        nlohmann::json entry;
+        entry["calls"] = stage->samples_ms.size();
+        entry["p50_ms"] = stage->percentile(0.5);
+        entry["p90_ms"] = stage->percentile(0.9);
+        entry["p99_ms"] = stage->percentile(0.99);
+        entry["max_ms"] = stage->percentile(1.0);
+        entry["total_ms"] = stage->total_ms();
+        if (stage->audio_seconds > 0.0) {
+            entry["real_time_factor"] = stage->real_time_factor();
+        }
+        entry["allocations_per_turn"] = turns ? static_cast<double>(stage->allocations) / turns : 0.0;
+        result["stages"][stage->name] = entry;
+    }
+    return result;
+}
+
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [options] [fixture.wav ...]\n"
+              << "  --config FILE        Read VAD and whisper settings (default: config.json if present)\n"
+              << "  --model NAME         Whisper model to benchmark, e.g. base.en (default: from the config)\n"
+              << "  --no-stt             Skip transcription even if the model exists\n"
+              << "  --repeat N           Replay the fixtures N times (default: 1)\n"
+              << "  --token-ms MS        Delay between streamed reply chunks (default: 0)\n"
+              << "  --rate HZ            Sample rate of the synthetic fixture (default: 16000)\n"
+              << "  --write-fixture FILE Save the synthetic fixture as a WAV file and exit\n"
+              << "  --json FILE          Also write the results as JSON\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string config_path = std::filesystem::exists("config.json") ? "config.json" : "";
+    std::string model_name;
+    std::string json_path;
+    std::string fixture_out;
+    std::vector<std::string> fixtures;
+    bool run_stt = true;
+    int repeat = 1;
+    int token_ms = 0;
+    int synthetic_rate = 16000;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](const char* name) -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << name << " needs a value" << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--config") config_path = value("--config");
+        else if (arg == "--model") model_name = value("--model");
+        else if (arg == "--no-stt") run_stt = false;
+        else if (arg == "--repeat") repeat = std::max(1, std::atoi(value("--repeat").c_str()));
+        else if (arg == "--token-ms") token_ms = std::max(0, std::atoi(value("--token-ms").c_str()));
+        else if (arg == "--rate") synthetic_rate = std::max(8000, std::atoi(value("--rate").c_str()));
+        else if (arg == "--write-fixture") fixture_out = value("--write-fixture");
+        else if (arg == "--json") json_path = value("--json");
+        else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            fixtures.push_back(arg);
+        }
+    }
+    
+    // The synthetic fixture is seeded, so every run replays the same audio
+    if (!fixture_out.empty()) {
+        return wav_file::write(fixture_out, synthesize_fixture(synthetic_rate, 4, 12345), synthetic_rate) ? 0 : 1;
+    }
+    
+    Config config;
+    if (!config_path.empty()) {
+        try {
+            config.load(config_path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Cannot load " << config_path << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!model_name.empty()) {
+        config.whisper.model = model_name;
+    }
+    const VADParams vad_params = make_vad_params(config.streaming);
+    
+    // Load the recordings
+    struct Recording {
+        std::string name;
+        std::vector<float> audio;
+        int rate = 16000;
+    };
+    std::vector<Recording> recordings;
+    for (const std::string& path : fixtures) {
+        Recording recording;
+        recording.name = path;
+        if (!wav_file::read(path, recording.audio, recording.rate)) {
+            return 1;
+        }
+        recordings.push_back(std::move(recording));
+    }
+    if (recordings.empty()) {
+        Recording recording;
+        recording.name = "synthetic";
+        recording.rate = synthetic_rate;
+        recording.audio = synthesize_fixture(synthetic_rate, 4, 12345);
+        recordings.push_back(std::move(recording));
+    }
+    
+    // The optional Silero stage needs 16 kHz, as in the assistant
+    std::unique_ptr<SpeechClassifier> classifier;
+    if (!config.streaming.vad_model.empty() && std::filesystem::exists(config.streaming.vad_model)) {
+        classifier = create_whisper_vad_classifier(config.streaming.vad_model);
+    }
+    
+    // StreamingWhisperSTT looks for the model in the same place
+    std::unique_ptr<StreamingWhisperSTT> stt;
+    const std::string model_path = "./whisper.cpp/models/ggml-" + config.whisper.model + ".bin";
+    if (run_stt && std::filesystem::exists(model_path)) {
+        stt = std::make_unique<StreamingWhisperSTT>(config.whisper);
+    } else if (run_stt) {
+        std::cout << "Info: Whisper model " << model_path << " not found, skipping transcription" << std::endl;
+    }
+    
+    MockOllamaServer server(kCannedReply, token_ms);
+    OllamaConfig ollama_config = config.ollama;
+    ollama_config.host = "http://127.0.0.1:" + std::to_string(server.port);
+    ollama_config.api = "generate";
+    ollama_config.stream = true;
+    ollama_config.keep_alive = "";
+    OllamaClient ollama(ollama_config);
+    
+    // Capture is timed per chunk, the other stages per turn
+    StageStats capture("capture");
+    StageStats transcription("stt");
+    StageStats llm_first("llm_first_sentence");
+    StageStats llm_total("llm_total");
+    StageStats tts_text("tts_text");
+    size_t turns = 0;
+    
+    std::cout << "Replaying " << recordings.size() << " fixture(s) x" << repeat << " with "
+              << audio_kernels::backend_name() << " audio kernels"
+              << (classifier ? " and the Silero VAD" : "") << std::endl;
+    
+    for (int r = 0; r < repeat; r++) {
+        for (const Recording& recording : recordings) {
+            std::vector<std::vector<float>> utterances =
+                replay_capture(recording.audio, recording.rate, vad_params,
+                               recording.rate == 16000 ? classifier.get() : nullptr, capture);
+            if (r == 0) {
+                std::cout << recording.name << ": " << recording.audio.size() / static_cast<double>(recording.rate)
+                          << " s at " << recording.rate << " Hz, " << utterances.size() << " utterance(s)" << std::endl;
+            }
+            
+            for (std::vector<float>& utterance : utterances) {
+                turns++;
+                std::string prompt = kFallbackPrompts[turns % (sizeof(kFallbackPrompts) / sizeof(kFallbackPrompts[0]))];
+                
+                if (stt) {
+                    const double seconds = utterance.size() / 16000.0;
+                    uint64_t allocations_before = t_allocations;
+                    auto start = Clock::now();
+                    std::string transcript = stt->process_audio(std::move(utterance), 16000);
+                    transcription.samples_ms.push_back(elapsed_ms(start));
+                    transcription.allocations += t_allocations - allocations_before;
+                    transcription.audio_seconds += seconds;
+                    if (!transcript.empty()) {
+                        prompt = transcript;
+                    }
+                }
+                
+                // Start from an empty history so every turn sends the same request size
+                ollama.clear_history();
+                uint64_t allocations_before = t_allocations;
+                auto start = Clock::now();
+                bool first = true;
+                std::string reply = ollama.process_streaming(prompt, [&](const std::string&) {
+                    if (first) {
+                        llm_first.samples_ms.push_back(elapsed_ms(start));
+                        first = false;
+                    }
+                });
+                llm_total.samples_ms.push_back(elapsed_ms(start));
+                llm_total.allocations += t_allocations - allocations_before;
+                
+                // What OllamaClient does to a whole reply before it is spoken
+                allocations_before = t_allocations;
+                start = Clock::now();
+                std::string spoken = TTSNormalizer::normalize(kCannedReply);
+                tts_text.samples_ms.push_back(elapsed_ms(start));
+                tts_text.allocations += t_allocations - allocations_before;
+                if (spoken.empty() || reply.empty()) {
+                    std::cerr << "Warning: Empty reply from the mock server" << std::endl;
+                }
+            }
+        }
+    }
+    
+    std::vector<const StageStats*> stages = {&capture, &transcription, &llm_first, &llm_total, &tts_text};
+    print_table(stages, turns);
+    std::cout << "Turns: " << turns << std::endl;
+    
+    if (!json_path.empty()) {
+        std::ofstream file(json_path, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write " << json_path << std::endl;
+            return 1;
+        }
+        file << to_json(stages, turns).dump(2) << "\n";
+    }
+    return turns > 0 ? 0 : 1;
+}
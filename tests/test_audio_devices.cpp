@@ -0,0 +1,143 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include "audio_devices.h"
+
+namespace {
+
+const char* cards_text =
+    " 0 [PCH            ]: HDA-Intel - HDA Intel PCH\n"
+    "                      HDA Intel PCH at 0xf7f10000 irq 32\n"
+    " 1 [Device         ]: USB-Audio - USB Audio Device\n"
+    "                      C-Media Electronics Inc. USB Audio Device at usb-0000:00:14.0-2, full speed\n";
+
+const char* pcm_text =
+    "00-00: ALC887-VD Analog : ALC887-VD Analog : playback 1 : capture 1\n"
+    "00-03: HDMI 0 : HDMI 0 : playback 1\n"
+    "01-00: USB Audio : USB Audio : playback 1 : capture 1\n";
+
+std::vector<AudioDeviceInfo> proc_devices() {
+    return parse_asound_pcm(pcm_text, parse_asound_cards(cards_text));
+}
+
+} // namespace
+
+TEST_CASE("parse_asound_cards reads /proc/asound/cards", "[devices]") {
+    auto cards = parse_asound_cards(cards_text);
+    REQUIRE(cards.size() == 2);
+    REQUIRE(cards[0].index == 0);
+    REQUIRE(cards[0].id == "PCH");
+    REQUIRE(cards[0].name == "HDA Intel PCH");
+    REQUIRE(cards[1].index == 1);
+    REQUIRE(cards[1].id == "Device");
+    REQUIRE(cards[1].name == "USB Audio Device");
+    
+    REQUIRE(parse_asound_cards("--- no soundcards ---\n").empty());
+}
+
+TEST_CASE("parse_asound_pcm lists each direction of each PCM", "[devices]") {
+    auto devices = proc_devices();
+    REQUIRE(devices.size() == 5);
+    
+    REQUIRE(devices[0].name == "hw:0,0");
+    REQUIRE(devices[0].card_id == "PCH");
+    REQUIRE(devices[0].description == "HDA Intel PCH: ALC887-VD Analog");
+    REQUIRE_FALSE(devices[0].capture);
+    REQUIRE(devices[1].name == "hw:0,0");
+    REQUIRE(devices[1].capture);
+    
+    // HDMI only plays
+    REQUIRE(devices[2].name == "hw:0,3");
+    REQUIRE_FALSE(devices[2].capture);
+    
+    REQUIRE(devices[4].name == "hw:1,0");
+    REQUIRE(devices[4].description == "USB Audio Device: USB Audio");
+    REQUIRE(devices[4].capture);
+    REQUIRE_FALSE(devices[4].probed);
+}
+
+TEST_CASE("parse_hw_device_name accepts the usual spellings", "[devices]") {
+    std::string card;
+    int device = -1;
+    bool plugin = false;
+    
+    REQUIRE(parse_hw_device_name("hw:1,0", card, device, &plugin));
+    REQUIRE(card == "1");
+    REQUIRE(device == 0);
+    REQUIRE_FALSE(plugin);
+    
+    REQUIRE(parse_hw_device_name("plughw:1", card, device, &plugin));
+    REQUIRE(card == "1");
+    REQUIRE(device == 0);
+    REQUIRE(plugin);
+    
+    REQUIRE(parse_hw_device_name("hw:CARD=Device,DEV=2", card, device));
+    REQUIRE(card == "Device");
+    REQUIRE(device == 2);
+    
+    REQUIRE_FALSE(parse_hw_device_name("default", card, device));
+    REQUIRE_FALSE(parse_hw_device_name("pulse", card, device));
+    REQUIRE_FALSE(parse_hw_device_name("sysdefault:CARD=PCH", card, device));
+    REQUIRE_FALSE(parse_hw_device_name("hw:1,x", card, device));
+}
+
+TEST_CASE("find_audio_device matches by card number or id", "[devices]") {
+    auto devices = proc_devices();
+    
+    const AudioDeviceInfo* usb = find_audio_device(devices, "hw:1,0", true);
+    REQUIRE(usb != nullptr);
+    REQUIRE(usb->card_id == "Device");
+    REQUIRE(find_audio_device(devices, "plughw:Device,0", true) == usb);
+    REQUIRE(find_audio_device(devices, "hw:CARD=Device,DEV=0", true) == usb);
+    
+    REQUIRE(find_audio_device(devices, "hw:0,3", false) != nullptr);
+    REQUIRE(find_audio_device(devices, "hw:0,3", true) == nullptr);
+    REQUIRE(find_audio_device(devices, "hw:2,0", true) == nullptr);
+}
+
+TEST_CASE("audio_device_warning flags devices that will not work", "[devices]") {
+    auto devices = proc_devices();
+    
+    // Only hardware names can be checked
+    REQUIRE(audio_device_warning(devices, "default", true).empty());
+    REQUIRE(audio_device_warning(devices, "pulse", true).empty());
+    
+    REQUIRE(audio_device_warning(devices, "hw:0,3", true).find("No capture device hw:0,3") == 0);
+    REQUIRE(audio_device_warning(devices, "hw:0,3", false).empty());
+    
+    // A stereo-only device needs the plug layer for mono capture
+    devices[4].probed = true;
+    devices[4].s16 = true;
+    devices[4].min_channels = 2;
+    devices[4].max_channels = 2;
+    devices[4].min_rate = 44100;
+    devices[4].max_rate = 48000;
+    REQUIRE(audio_device_warning(devices, "hw:1,0", true) == "hw:1,0 cannot capture mono; try plughw:1,0");
+    REQUIRE(audio_device_warning(devices, "plughw:1,0", true).empty());
+    
+    devices[4].s16 = false;
+    REQUIRE(audio_device_warning(devices, "hw:1,0", true) == "hw:1,0 does not take 16-bit samples; try plughw:1,0");
+}
+
+TEST_CASE("print_audio_devices shows what was probed", "[devices]") {
+    auto devices = proc_devices();
+    devices[4].probed = true;
+    devices[4].s16 = true;
+    devices[4].min_channels = 1;
+    devices[4].max_channels = 2;
+    devices[4].min_rate = 44100;
+    devices[4].max_rate = 48000;
+    
+    std::ostringstream out;
+    print_audio_devices(devices, true, out);
+    REQUIRE(out.str() ==
+            "  hw:0,0  HDA Intel PCH: ALC887-VD Analog\n"
+            "  hw:1,0  USB Audio Device: USB Audio (1-2 channels, 44100-48000 Hz)\n");
+    
+    std::ostringstream none;
+    print_audio_devices({}, false, none);
+    REQUIRE(none.str() == "  (none found)\n");
+}
@@ -0,0 +1,66 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+#include "audio_kernels.h"
+
+// Deterministic test signal with both signs, zeros and odd lengths
+static std::vector<float> make_signal(size_t count) {
+    std::vector<float> audio(count);
+    for (size_t i = 0; i < count; i++) {
+        audio[i] = 0.5f * std::sin(0.37f * i) + 0.2f * std::sin(2.9f * i);
+        if (i % 17 == 0) audio[i] = 0.0f;
+    }
+    return audio;
+}
+
+TEST_CASE("convert_s16_to_f32 matches the scalar conversion", "[audio_kernels]") {
+    std::vector<int16_t> pcm = {0, 1, -1, 32767, -32768, 12345, -12345, 100, -100, 7, -7};
+    std::vector<float> out(pcm.size());
+    audio_kernels::convert_s16_to_f32(pcm.data(), out.data(), pcm.size());
+    
+    for (size_t i = 0; i < pcm.size(); i++) {
+        REQUIRE(out[i] == static_cast<float>(pcm[i]) / 32768.0f);
+    }
+}
+
+TEST_CASE("Audio statistics match the scalar loops", "[audio_kernels]") {
+    // Lengths around the vector widths exercise the remainder loops
+    for (size_t count : {0, 1, 3, 4, 7, 8, 9, 31, 1000, 1601}) {
+        std::vector<float> audio = make_signal(count);
+        std::vector<float> reversed(audio.rbegin(), audio.rend());
+        
+        float energy = 0.0f;
+        float product = 0.0f;
+        float peak = 0.0f;
+        float total = 0.0f;
+        size_t crossings = 0;
+        size_t active = 0;
+        for (size_t i = 0; i < count; i++) {
+            energy += audio[i] * audio[i];
+            product += audio[i] * reversed[i];
+            peak = std::max(peak, std::fabs(audio[i]));
+            total += std::fabs(audio[i]);
+            if (audio[i] * audio[i] > 0.05f) active++;
+            if (i > 0 && (audio[i - 1] < 0) != (audio[i] < 0)) crossings++;
+        }
+        
+        REQUIRE(audio_kernels::sum_of_squares(audio.data(), count) == Approx(energy).epsilon(1e-5));
+        REQUIRE(audio_kernels::dot(audio.data(), reversed.data(), count) == Approx(product).epsilon(1e-5).margin(1e-6));
+        REQUIRE(audio_kernels::abs_sum(audio.data(), count) == Approx(total).epsilon(1e-5));
+        REQUIRE(audio_kernels::abs_max(audio.data(), count) == peak);
+        REQUIRE(audio_kernels::count_zero_crossings(audio.data(), count) == crossings);
+        REQUIRE(audio_kernels::count_energy_above(audio.data(), count, 0.05f) == active);
+    }
+}
+
+TEST_CASE("scale works in place", "[audio_kernels]") {
+    std::vector<float> audio = make_signal(13);
+    std::vector<float> expected = audio;
+    for (float& sample : expected) sample *= 2.5f;
+    
+    audio_kernels::scale(audio.data(), audio.data(), audio.size(), 2.5f);
+    REQUIRE(audio == expected);
+}
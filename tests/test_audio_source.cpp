@@ -0,0 +1,222 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <arpa/inet.h>
+
+#include "audio_source.h"
+
+// A port nothing is listening on right now
+static int free_port(int type) {
+    int sock = socket(AF_INET, type, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t addr_len = sizeof(addr);
+    getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    close(sock);
+    return ntohs(addr.sin_port);
+}
+
+static int connect_loopback(int type, int port) {
+    int sock = socket(AF_INET, type, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    return sock;
+}
+
+// Read until count samples arrived, giving up after a few empty reads
+static std::vector<int16_t> read_samples(AudioSource& source, size_t count) {
+    std::vector<int16_t> result;
+    std::vector<int16_t> buffer(count);
+    for (int idle = 0; result.size() < count && idle < 20;) {
+        long n = source.read(buffer.data(), count - result.size());
+        if (n < 0) break;
+        if (n == 0) {
+            idle++;
+            continue;
+        }
+        result.insert(result.end(), buffer.begin(), buffer.begin() + n);
+    }
+    return result;
+}
+
+TEST_CASE("Device strings select the audio source", "[audio_source]") {
+    AudioSourceSpec spec;
+    
+    REQUIRE(parse_audio_source("default", spec));
+    REQUIRE(spec.kind == AudioSourceSpec::Kind::Alsa);
+    REQUIRE(spec.path == "default");
+    
+    REQUIRE(parse_audio_source("plughw:1,0", spec));
+    REQUIRE(spec.kind == AudioSourceSpec::Kind::Alsa);
+    
+    REQUIRE(parse_audio_source("-", spec));
+    REQUIRE(spec.kind == AudioSourceSpec::Kind::Stdin);
+    
+    REQUIRE(parse_audio_source("recordings/turn1.wav", spec));
+    REQUIRE(spec.kind == AudioSourceSpec::Kind::File);
+    REQUIRE(spec.path == "recordings/turn1.wav");
+    
+    REQUIRE(parse_audio_source("file:capture.s16", spec));
+    REQUIRE(spec.kind == AudioSourceSpec::Kind::File);
+    REQUIRE(spec.path == "capture.s16");
+    
+    REQUIRE(parse_audio_source("tcp://0.0.0.0:5000", spec));
+    REQUIRE(spec.kind == AudioSourceSpec::Kind::Tcp);
+    REQUIRE(spec.host == "0.0.0.0");
+    REQUIRE(spec.port == 5000);
+    
+    REQUIRE(parse_audio_source("udp://:6000", spec));
+    REQUIRE(spec.kind == AudioSourceSpec::Kind::Udp);
+    REQUIRE(spec.host.empty());
+    REQUIRE(spec.port == 6000);
+    
+    REQUIRE_FALSE(parse_audio_source("tcp://localhost", spec));
+    REQUIRE_FALSE(parse_audio_source("udp://:70000", spec));
+    REQUIRE_FALSE(parse_audio_source("file:", spec));
+}
+
+TEST_CASE("PcmFileSource replays a recording", "[audio_source]") {
+    std::vector<int16_t> pcm(1000);
+    for (size_t i = 0; i < pcm.size(); i++) {
+        pcm[i] = static_cast<int16_t>(i * 7);
+    }
+    
+    SECTION("Samples in memory keep their rate and carry on after a restart") {
+        PcmFileSource source(pcm, 8000);
+        REQUIRE(source.open(16000));
+        REQUIRE(source.sample_rate() == 8000);
+        
+        std::vector<int16_t> buffer(300);
+        REQUIRE(source.read(buffer.data(), buffer.size()) == 300);
+        REQUIRE(buffer[299] == pcm[299]);
+        source.close();
+        
+        REQUIRE(source.open(16000));
+        std::vector<int16_t> rest = read_samples(source, 700);
+        REQUIRE(rest.size() == 700);
+        REQUIRE(rest.front() == pcm[300]);
+        REQUIRE(rest.back() == pcm[999]);
+        REQUIRE(source.read(buffer.data(), buffer.size()) < 0);
+    }
+    
+    SECTION("Raw files play at the requested rate") {
+        const char* path = "test_audio_source.raw";
+        {
+            std::ofstream file(path, std::ios::binary);
+            for (int16_t sample : pcm) {
+                wav_file::write_le16(file, static_cast<uint16_t>(sample));
+            }
+        }
+        PcmFileSource source(path, false);
+        REQUIRE(source.open(16000));
+        REQUIRE(source.sample_rate() == 16000);
+        REQUIRE(read_samples(source, pcm.size()) == pcm);
+        std::remove(path);
+    }
+    
+    SECTION("WAV files play at their own rate") {
+        const char* path = "test_audio_source.wav";
+        std::vector<float> audio(pcm.size());
+        for (size_t i = 0; i < audio.size(); i++) {
+            audio[i] = pcm[i] / 32767.0f;
+        }
+        REQUIRE(wav_file::write(path, audio, 22050));
+        PcmFileSource source(path, false);
+        REQUIRE(source.open(16000));
+        REQUIRE(source.sample_rate() == 22050);
+        std::vector<int16_t> read = read_samples(source, pcm.size());
+        REQUIRE(read.size() == pcm.size());
+        for (size_t i = 0; i < pcm.size(); i++) {
+            REQUIRE(std::abs(read[i] - pcm[i]) <= 1);
+        }
+        std::remove(path);
+    }
+    
+    SECTION("Missing files fail to open") {
+        PcmFileSource source("does_not_exist.raw");
+        REQUIRE_FALSE(source.open(16000));
+    }
+    
+    SECTION("Real-time playback keeps pace with the clock") {
+        PcmFileSource source(std::vector<int16_t>(1600), 16000, true);
+        REQUIRE(source.open(16000));
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(read_samples(source, 1600).size() == 1600);
+        REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(90));
+    }
+}
+
+TEST_CASE("FdPcmSource reads PCM from a pipe", "[audio_source]") {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    FdPcmSource source(fds[0]);
+    REQUIRE(source.open(16000));
+    
+    std::vector<int16_t> buffer(16);
+    SECTION("Nothing written yet") {
+        REQUIRE(source.read(buffer.data(), buffer.size()) == 0);
+    }
+    
+    SECTION("A sample split across writes is put back together") {
+        const unsigned char first[] = {0x01, 0x00, 0x34};
+        const unsigned char second[] = {0x12, 0xff, 0xff};
+        REQUIRE(write(fds[1], first, sizeof(first)) == 3);
+        REQUIRE(source.read(buffer.data(), buffer.size()) == 1);
+        REQUIRE(buffer[0] == 1);
+        REQUIRE(write(fds[1], second, sizeof(second)) == 3);
+        REQUIRE(source.read(buffer.data(), buffer.size()) == 2);
+        REQUIRE(buffer[0] == 0x1234);
+        REQUIRE(buffer[1] == -1);
+    }
+    
+    SECTION("Closing the pipe ends the stream") {
+        close(fds[1]);
+        fds[1] = -1;
+        REQUIRE(source.read(buffer.data(), buffer.size()) < 0);
+    }
+    
+    if (fds[1] >= 0) close(fds[1]);
+    close(fds[0]);
+}
+
+TEST_CASE("Network sources receive streamed PCM", "[audio_source]") {
+    std::vector<int16_t> pcm = {100, -200, 300, -400, 500, -600};
+    
+    SECTION("TCP accepts one client after another") {
+        const int port = free_port(SOCK_STREAM);
+        TcpPcmSource source("127.0.0.1", port);
+        REQUIRE(source.open(16000));
+        
+        for (int client_number = 0; client_number < 2; client_number++) {
+            int client = connect_loopback(SOCK_STREAM, port);
+            REQUIRE(send(client, pcm.data(), pcm.size() * 2, 0) == static_cast<ssize_t>(pcm.size() * 2));
+            REQUIRE(read_samples(source, pcm.size()) == pcm);
+            close(client);
+            
+            // A disconnect is not the end of the stream
+            std::vector<int16_t> buffer(4);
+            REQUIRE(source.read(buffer.data(), buffer.size()) == 0);
+        }
+    }
+    
+    SECTION("UDP datagrams longer than a read are split up") {
+        const int port = free_port(SOCK_DGRAM);
+        UdpPcmSource source("127.0.0.1", port);
+        REQUIRE(source.open(16000));
+        
+        int client = connect_loopback(SOCK_DGRAM, port);
+        REQUIRE(send(client, pcm.data(), pcm.size() * 2, 0) == static_cast<ssize_t>(pcm.size() * 2));
+        std::vector<int16_t> buffer(4);
+        REQUIRE(source.read(buffer.data(), 4) == 4);
+        REQUIRE(source.read(buffer.data() + 0, 4) == 2);
+        REQUIRE(buffer[1] == -600);
+        close(client);
+    }
+}
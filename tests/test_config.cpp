@@ -18,6 +18,7 @@ TEST_CASE("Config can be created with default values", "[config]") {
     REQUIRE(config.whisper.model == "base.en");
     REQUIRE(config.whisper.executable == "./whisper.cpp/main");
     REQUIRE(config.whisper.params == "-l en");
+    REQUIRE(config.whisper.tail_padding_ms == 300);
     
     REQUIRE(config.ollama.model == "llama3");
     REQUIRE(config.ollama.system_prompt == "You are a helpful voice assistant. Provide concise responses.");
@@ -42,6 +43,7 @@ TEST_CASE("Config can be saved and loaded", "[config]") {
     config1.whisper.model = "tiny";
     config1.whisper.executable = "/custom/path/whisper";
     config1.whisper.params = "-custom params";
+    config1.whisper.tail_padding_ms = 1000;
     
     config1.ollama.model = "mistral";
     config1.ollama.system_prompt = "Custom prompt";
@@ -67,6 +69,7 @@ TEST_CASE("Config can be saved and loaded", "[config]") {
     REQUIRE(config2.whisper.model == "tiny");
     REQUIRE(config2.whisper.executable == "/custom/path/whisper");
     REQUIRE(config2.whisper.params == "-custom params");
+    REQUIRE(config2.whisper.tail_padding_ms == 1000);
     
     REQUIRE(config2.ollama.model == "mistral");
     REQUIRE(config2.ollama.system_prompt == "Custom prompt");
@@ -90,4 +93,59 @@ TEST_CASE("Config handles missing file", "[config]") {
     
     // Attempt to load should throw
     REQUIRE_THROWS(config.load(nonexistent_file));
-}
\ No newline at end of file
+}
+TEST_CASE("Config accepts keep_alive as a duration or a number", "[config]") {
+    std::string temp_file = "/tmp/test_config_keep_alive.json";
+    
+    {
+        std::ofstream file(temp_file);
+        file << R"({"ollama": {"keep_alive": -1}})";
+    }
+    Config config1;
+    config1.load(temp_file);
+    REQUIRE(config1.ollama.keep_alive == "-1");
+    
+    {
+        std::ofstream file(temp_file);
+        file << R"({"ollama": {"keep_alive": "30m"}})";
+    }
+    Config config2;
+    config2.load(temp_file);
+    REQUIRE(config2.ollama.keep_alive == "30m");
+    
+    // Clean up
+    std::remove(temp_file.c_str());
+}
+
+TEST_CASE("Config keeps the sessions of the serving mode", "[config]") {
+    std::string temp_file = "/tmp/test_config_serving.json";
+    
+    {
+        std::ofstream file(temp_file);
+        file << R"({"serving": {"llm_slots": 3, "sessions": [
+            {"name": "kitchen", "input_device": "hw:1,0", "output_device": "hw:1,0"},
+            {"input_device": "tcp://:5001"}
+        ]}})";
+    }
+    Config config1;
+    config1.load(temp_file);
+    REQUIRE(config1.serving.llm_slots == 3);
+    REQUIRE(config1.serving.sessions.size() == 2);
+    REQUIRE(config1.serving.sessions[0].name == "kitchen");
+    REQUIRE(config1.serving.sessions[0].output_device == "hw:1,0");
+    
+    // Unnamed sessions are numbered
+    REQUIRE(config1.serving.sessions[1].name == "session2");
+    REQUIRE(config1.serving.sessions[1].input_device == "tcp://:5001");
+    REQUIRE(config1.serving.sessions[1].output_device == "default");
+    
+    config1.save(temp_file);
+    Config config2;
+    config2.load(temp_file);
+    REQUIRE(config2.serving.sessions.size() == 2);
+    REQUIRE(config2.serving.sessions[1].name == "session2");
+    REQUIRE(config2.serving.llm_slots == 3);
+    
+    // Clean up
+    std::remove(temp_file.c_str());
+}
@@ -0,0 +1,130 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+#include "conversation_history.h"
+
+TEST_CASE("ConversationHistory keeps turns oldest first", "[history]") {
+    ConversationHistory history(4, 0);
+    REQUIRE(history.empty());
+    REQUIRE(history.format().empty());
+    
+    history.push("Hi", "Hello there.");
+    history.push("How are you?", "Fine, thanks.");
+    REQUIRE(history.size() == 2);
+    REQUIRE(history[0].user == "Hi");
+    REQUIRE(history[1].assistant == "Fine, thanks.");
+    REQUIRE(history.format() ==
+            "\n\nConversation history:\n"
+            "User: Hi\nAssistant: Hello there.\n\n"
+            "User: How are you?\nAssistant: Fine, thanks.\n\n");
+    
+    history.pop_back();
+    REQUIRE(history.size() == 1);
+    REQUIRE(history.token_count() == ConversationHistory::estimate_tokens("Hi") +
+                                     ConversationHistory::estimate_tokens("Hello there."));
+    
+    history.clear();
+    REQUIRE(history.empty());
+    REQUIRE(history.token_count() == 0);
+}
+
+TEST_CASE("ConversationHistory drops old turns in batches when full", "[history]") {
+    ConversationHistory history(8, 0);
+    for (int i = 0; i < 8; i++) {
+        history.push("question " + std::to_string(i), "answer");
+    }
+    REQUIRE(history.size() == 8);
+    
+    // A quarter of the slots is freed at once, so the next turns fit as well
+    history.push("question 8", "answer");
+    REQUIRE(history.size() == 7);
+    REQUIRE(history[0].user == "question 2");
+    REQUIRE(history[6].user == "question 8");
+    
+    history.push("question 9", "answer");
+    REQUIRE(history.size() == 8);
+    REQUIRE(history[0].user == "question 2");
+    
+    // The ring wraps around over many turns and never grows
+    for (int i = 10; i < 1000; i++) {
+        history.push("question " + std::to_string(i), "answer");
+    }
+    REQUIRE(history.size() <= 8);
+    REQUIRE(history.capacity() == 8);
+    REQUIRE(history[history.size() - 1].user == "question 999");
+}
+
+TEST_CASE("ConversationHistory stays within its token budget", "[history]") {
+    const std::string forty_chars(40, 'x'); // Ten tokens
+    ConversationHistory history(100, 100);
+    
+    for (int i = 0; i < 5; i++) {
+        history.push(forty_chars, forty_chars);
+    }
+    REQUIRE(history.token_count() == 100);
+    
+    // Over budget, old turns go until the new one fits in three quarters
+    history.push(forty_chars, forty_chars);
+    REQUIRE(history.token_count() <= 75);
+    REQUIRE(history.size() == 3);
+    
+    // A turn larger than the whole budget is still kept
+    history.push(std::string(800, 'y'), "ok");
+    REQUIRE(history.size() == 1);
+    REQUIRE(history[0].user.size() == 800);
+}
+
+TEST_CASE("ConversationHistory forgets a turn by its id", "[history]") {
+    ConversationHistory history(4, 0);
+    for (int i = 0; i < 4; i++) {
+        history.push("question " + std::to_string(i), "answer");
+    }
+    
+    // The push frees a slot first, so the size does not grow
+    const uint64_t id = history.push("question 4", "answer");
+    REQUIRE(history.size() == 4);
+    REQUIRE(history.forget(id));
+    REQUIRE(history.size() == 3);
+    REQUIRE(history[2].user == "question 3");
+    
+    // Only the newest turn can be forgotten, and only once
+    const uint64_t older = history.push("question 5", "answer");
+    history.push("question 6", "answer");
+    REQUIRE_FALSE(history.forget(older));
+    REQUIRE_FALSE(history.forget(id));
+    REQUIRE_FALSE(history.forget(0));
+    REQUIRE(history.size() == 4);
+}
+
+TEST_CASE("ConversationHistory keeps the turns it drops for the summary", "[history]") {
+    ConversationHistory history(4, 0);
+    for (int i = 0; i < 5; i++) {
+        history.push("turn " + std::to_string(i), "ok");
+    }
+    REQUIRE_FALSE(history.has_dropped());
+    
+    history.set_keep_dropped(true);
+    for (int i = 5; i < 10; i++) {
+        history.push("turn " + std::to_string(i), "ok");
+    }
+    REQUIRE(history.has_dropped());
+    std::string expected;
+    for (int i = 1; i < 6; i++) {
+        expected += "User: turn " + std::to_string(i) + "\nAssistant: ok\n\n";
+    }
+    REQUIRE(history.take_dropped() == expected);
+    REQUIRE(history.take_dropped().empty());
+    
+    history.set_summary("The user counted turns.");
+    REQUIRE(history.format().find("Summary of the earlier conversation: The user counted turns.\n\n") != std::string::npos);
+    
+    // The summary and what dropped out go with the rest
+    history.push("turn 10", "ok");
+    history.push("turn 11", "ok");
+    REQUIRE(history.has_dropped());
+    history.clear();
+    REQUIRE_FALSE(history.has_dropped());
+    REQUIRE(history.get_summary().empty());
+}
@@ -0,0 +1,113 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#include "conversation_logger.h"
+
+static std::vector<std::string> read_lines(const std::string& path) {
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+static void remove_logs(const std::string& path) {
+    std::remove(path.c_str());
+    for (int i = 1; i <= 5; i++) {
+        std::remove((path + "." + std::to_string(i)).c_str());
+    }
+}
+
+TEST_CASE("ConversationLogger writes text lines in the background", "[logger]") {
+    const std::string path = "test_conversation.log";
+    remove_logs(path);
+    
+    LoggingConfig config;
+    ConversationLogger logger(path, config);
+    REQUIRE(logger.open());
+    logger.log_event("Conversation started");
+    logger.log("User", "What can you do?");
+    logger.log("Vibe", "Lots of things.");
+    logger.close();
+    
+    std::vector<std::string> lines = read_lines(path);
+    REQUIRE(lines.size() == 4);
+    REQUIRE(lines[0].rfind("=== Conversation started at ", 0) == 0);
+    REQUIRE(lines[1] == "===");
+    REQUIRE(lines[2].find("] User: What can you do?") != std::string::npos);
+    REQUIRE(lines[3].find("] Vibe: Lots of things.") != std::string::npos);
+    
+    // Nothing is written once closed
+    logger.log("User", "Too late");
+    REQUIRE(read_lines(path).size() == 4);
+    remove_logs(path);
+}
+
+TEST_CASE("ConversationLogger writes JSON lines with turn timings", "[logger]") {
+    const std::string path = "test_conversation.jsonl";
+    remove_logs(path);
+    
+    LoggingConfig config;
+    config.format = "jsonl";
+    ConversationLogger logger(path, config);
+    REQUIRE(logger.open());
+    logger.log("User", "Say \"hi\"");
+    
+    LatencyMetrics metrics;
+    metrics.enable();
+    auto start = LatencyMetrics::Clock::now();
+    metrics.begin_turn(start);
+    metrics.mark(TurnEvent::SttStart, start + std::chrono::milliseconds(10));
+    metrics.mark(TurnEvent::SttEnd, start + std::chrono::milliseconds(250));
+    logger.log_timings(metrics.end_turn());
+    logger.log_timings(LatencyMetrics::Turn()); // Nothing measured, nothing logged
+    logger.close();
+    
+    std::vector<std::string> lines = read_lines(path);
+    REQUIRE(lines.size() == 2);
+    nlohmann::json message = nlohmann::json::parse(lines[0]);
+    REQUIRE(message["speaker"] == "User");
+    REQUIRE(message["text"] == "Say \"hi\"");
+    REQUIRE(message.contains("time"));
+    
+    nlohmann::json timings = nlohmann::json::parse(lines[1]);
+    REQUIRE(timings["latency_ms"]["capture_to_stt"] == 10);
+    REQUIRE(timings["latency_ms"]["stt"] == 240);
+    remove_logs(path);
+}
+
+TEST_CASE("ConversationLogger rotates files by size", "[logger]") {
+    const std::string path = "test_rotated.log";
+    remove_logs(path);
+    
+    LoggingConfig config;
+    config.rotate_kb = 1;
+    config.keep_files = 2;
+    ConversationLogger logger(path, config);
+    REQUIRE(logger.open());
+    const std::string message(200, 'x');
+    for (int i = 0; i < 20; i++) {
+        logger.log("User", message);
+    }
+    logger.close();
+    
+    // About five messages fit in a kilobyte; only two old files are kept
+    std::ifstream current(path), first(path + ".1"), second(path + ".2"), third(path + ".3");
+    REQUIRE(current.good());
+    REQUIRE(first.good());
+    REQUIRE(second.good());
+    REQUIRE_FALSE(third.good());
+    for (const std::string& file : {path, path + ".1", path + ".2"}) {
+        std::ifstream in(file, std::ios::ate);
+        REQUIRE(static_cast<size_t>(in.tellg()) <= 1024);
+    }
+    REQUIRE(read_lines(path + ".1").size() == 4);
+    remove_logs(path);
+}
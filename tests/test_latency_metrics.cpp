@@ -0,0 +1,147 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <atomic>
+#include <unistd.h>
+
+#include "latency_metrics.h"
+
+using Clock = LatencyMetrics::Clock;
+
+static std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+TEST_CASE("Disabled metrics record nothing", "[metrics]") {
+    LatencyMetrics metrics;
+    REQUIRE_FALSE(metrics.is_enabled());
+    
+    metrics.begin_turn();
+    metrics.mark(TurnEvent::SttStart);
+    LatencyMetrics::Turn turn = metrics.end_turn();
+    REQUIRE_FALSE(turn.has(TurnEvent::SpeechEnd));
+    REQUIRE_FALSE(turn.has(TurnEvent::SttStart));
+    REQUIRE(metrics.histogram(0).count == 0);
+}
+
+TEST_CASE("Only the first mark of an event in a turn counts", "[metrics]") {
+    LatencyMetrics metrics;
+    metrics.enable();
+    
+    Clock::time_point speech_end = Clock::now() - std::chrono::milliseconds(100);
+    metrics.begin_turn(speech_end);
+    metrics.mark(TurnEvent::SttStart);
+    LatencyMetrics::Turn partial = metrics.end_turn();
+    double first = partial.elapsed_ms(TurnEvent::SpeechEnd, TurnEvent::SttStart);
+    REQUIRE(first >= 100.0);
+    
+    // Marks outside a turn are ignored
+    metrics.mark(TurnEvent::SttEnd);
+    
+    metrics.begin_turn(speech_end);
+    metrics.mark(TurnEvent::TtsStart);
+    usleep(2000);
+    metrics.mark(TurnEvent::TtsStart);
+    metrics.mark(TurnEvent::FirstAudio);
+    LatencyMetrics::Turn turn = metrics.end_turn();
+    REQUIRE_FALSE(turn.has(TurnEvent::SttEnd));
+    REQUIRE(turn.elapsed_ms(TurnEvent::TtsStart, TurnEvent::FirstAudio) >= 2.0);
+    REQUIRE(turn.elapsed_ms(TurnEvent::SttStart, TurnEvent::SttEnd) == -1.0);
+}
+
+TEST_CASE("Events can be marked with the time they happened", "[metrics]") {
+    LatencyMetrics metrics;
+    metrics.enable();
+    
+    // A pipeline stage timed transcription before the turn was started
+    Clock::time_point speech_end = Clock::now() - std::chrono::milliseconds(300);
+    Clock::time_point stt_start = speech_end + std::chrono::milliseconds(20);
+    Clock::time_point stt_end = stt_start + std::chrono::milliseconds(150);
+    metrics.begin_turn(speech_end);
+    metrics.mark(TurnEvent::SttStart, stt_start);
+    metrics.mark(TurnEvent::SttEnd, stt_end);
+    metrics.mark(TurnEvent::SttEnd, Clock::now());
+    
+    LatencyMetrics::Turn turn = metrics.end_turn();
+    REQUIRE(turn.elapsed_ms(TurnEvent::SpeechEnd, TurnEvent::SttStart) == Approx(20.0));
+    REQUIRE(turn.elapsed_ms(TurnEvent::SttStart, TurnEvent::SttEnd) == Approx(150.0));
+}
+
+TEST_CASE("Histograms bucket turn intervals", "[metrics]") {
+    LatencyMetrics::Histogram histogram;
+    for (double ms : {10.0, 40.0, 40.0, 400.0, 20000.0}) {
+        histogram.add(ms);
+    }
+    REQUIRE(histogram.count == 5);
+    REQUIRE(histogram.sum_ms == Approx(20490.0));
+    REQUIRE(histogram.buckets[0] == 1);                 // <= 25 ms
+    REQUIRE(histogram.buckets[1] == 2);                 // <= 50 ms
+    REQUIRE(histogram.buckets.back() == 1);             // Above every bound
+    REQUIRE(histogram.quantile_ms(0.5) == 50.0);
+    REQUIRE(histogram.quantile_ms(0.0) == 25.0);
+}
+
+TEST_CASE("Finished turns are exported as JSON lines and Prometheus text", "[metrics]") {
+    std::string jsonl = "/tmp/test_latency_" + std::to_string(getpid()) + ".jsonl";
+    std::string prom = "/tmp/test_latency_" + std::to_string(getpid()) + ".prom";
+    std::remove(jsonl.c_str());
+    
+    LatencyMetrics metrics;
+    metrics.enable(jsonl, prom);
+    
+    metrics.begin_turn(Clock::now() - std::chrono::milliseconds(30));
+    metrics.mark(TurnEvent::SttStart);
+    metrics.mark(TurnEvent::SttEnd);
+    metrics.end_turn(true);
+    
+    metrics.begin_turn(Clock::now() - std::chrono::milliseconds(30));
+    for (TurnEvent event : {TurnEvent::SttStart, TurnEvent::SttEnd, TurnEvent::LlmFirstByte,
+                            TurnEvent::LlmLastByte, TurnEvent::TtsStart, TurnEvent::FirstAudio}) {
+        metrics.mark(event);
+    }
+    LatencyMetrics::Turn turn = metrics.end_turn();
+    REQUIRE(LatencyMetrics::describe(turn).find("end_to_end") != std::string::npos);
+    
+    std::istringstream lines(read_file(jsonl));
+    std::string rejected_line, full_line, extra;
+    REQUIRE(std::getline(lines, rejected_line));
+    REQUIRE(std::getline(lines, full_line));
+    REQUIRE_FALSE(std::getline(lines, extra));
+    REQUIRE(rejected_line.find("\"rejected\":true") != std::string::npos);
+    REQUIRE(rejected_line.find("\"stt_ms\":") != std::string::npos);
+    REQUIRE(rejected_line.find("end_to_end") == std::string::npos);
+    REQUIRE(full_line.find("\"turn\":2") != std::string::npos);
+    REQUIRE(full_line.find("\"end_to_end_ms\":") != std::string::npos);
+    
+    std::string text = read_file(prom);
+    REQUIRE(text == metrics.prometheus_text());
+    REQUIRE(text.find("# TYPE voice_assistant_stt_seconds histogram") != std::string::npos);
+    REQUIRE(text.find("voice_assistant_stt_seconds_count 2") != std::string::npos);
+    REQUIRE(text.find("voice_assistant_end_to_end_seconds_bucket{le=\"+Inf\"} 1") != std::string::npos);
+    REQUIRE(text.find("voice_assistant_end_to_end_seconds_bucket{le=\"0.025\"} 0") != std::string::npos);
+    REQUIRE(text.find("voice_assistant_turns_total 2") != std::string::npos);
+    REQUIRE(text.find("voice_assistant_rejected_utterances_total 1") != std::string::npos);
+    
+    std::remove(jsonl.c_str());
+    std::remove(prom.c_str());
+}
+
+TEST_CASE("Counters kept elsewhere are exported with the histograms", "[metrics]") {
+    LatencyMetrics metrics;
+    metrics.enable();
+    std::atomic<uint64_t> overruns{0};
+    metrics.add_counter("capture_overruns", [&overruns] { return overruns.load(); });
+    
+    REQUIRE(metrics.prometheus_text().find("voice_assistant_capture_overruns_total 0\n") != std::string::npos);
+    overruns.store(3);
+    std::string text = metrics.prometheus_text();
+    REQUIRE(text.find("# TYPE voice_assistant_capture_overruns_total counter\n") != std::string::npos);
+    REQUIRE(text.find("voice_assistant_capture_overruns_total 3\n") != std::string::npos);
+    REQUIRE(metrics.summary().find("capture_overruns") != std::string::npos);
+}
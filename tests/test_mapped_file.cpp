@@ -0,0 +1,60 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+
+#include "mapped_file.h"
+
+TEST_CASE("MappedFile reads a file front to back", "[mapped_file]") {
+    const char* path = "test_mapped_file.bin";
+    std::string contents;
+    for (int i = 0; i < 10000; i++) {
+        contents += static_cast<char>(i % 251);
+    }
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    }
+    
+    MappedFile mapped;
+    REQUIRE(mapped.open(path));
+    REQUIRE(mapped.is_open());
+    REQUIRE(mapped.size() == contents.size());
+    
+    SECTION("Reads continue where the last one stopped") {
+        std::vector<char> buffer(4096);
+        std::string read_back;
+        while (!mapped.eof()) {
+            size_t n = mapped.read(buffer.data(), buffer.size());
+            REQUIRE(n > 0);
+            read_back.append(buffer.data(), n);
+        }
+        REQUIRE(read_back == contents);
+        
+        // The last read came up short and nothing is left
+        REQUIRE(mapped.read(buffer.data(), buffer.size()) == 0);
+    }
+    
+    SECTION("Closing releases the mapping") {
+        mapped.close();
+        REQUIRE_FALSE(mapped.is_open());
+        REQUIRE(mapped.eof());
+        char byte;
+        REQUIRE(mapped.read(&byte, 1) == 0);
+    }
+    
+    std::remove(path);
+}
+
+TEST_CASE("MappedFile refuses missing and empty files", "[mapped_file]") {
+    MappedFile mapped;
+    REQUIRE_FALSE(mapped.open("does_not_exist.bin"));
+    
+    const char* path = "test_mapped_file_empty.bin";
+    { std::ofstream file(path); }
+    REQUIRE_FALSE(mapped.open(path));
+    REQUIRE_FALSE(mapped.is_open());
+    std::remove(path);
+}
@@ -1,6 +1,13 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 #include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 
 #include "ollama_client.h"
 
@@ -30,4 +37,281 @@ TEST_CASE("OllamaClient handles error conditions", "[ollama]") {
     std::string result = ollama.process("Test query");
     REQUIRE(!result.empty());
     REQUIRE(result.find("Sorry") != std::string::npos);
-}
\ No newline at end of file
+}
+
+TEST_CASE("OllamaClient streaming reports errors through the sentence callback", "[ollama]") {
+    OllamaConfig config;
+    config.model = "llama3";
+    config.host = "http://nonexistent.host:11434";
+    config.stream = true;
+    
+    OllamaClient ollama(config);
+    REQUIRE(ollama.is_streaming());
+    
+    std::vector<std::string> spoken;
+    std::string result = ollama.process_streaming("Test query", [&spoken](const std::string& sentence) {
+        spoken.push_back(sentence);
+    });
+    
+    REQUIRE(result.find("Sorry") != std::string::npos);
+    REQUIRE(spoken.size() == 1);
+    REQUIRE(spoken[0] == result);
+}
+
+TEST_CASE("OllamaClient cancel aborts a request in flight", "[ollama]") {
+    // A local server that accepts the connection but never replies
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(server >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    REQUIRE(bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    REQUIRE(listen(server, 1) == 0);
+    socklen_t addr_len = sizeof(addr);
+    getsockname(server, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    
+    OllamaConfig config;
+    config.host = "http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+    config.stream = true;
+    OllamaClient ollama(config);
+    
+    std::thread canceller([&ollama] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        ollama.cancel();
+    });
+    
+    std::vector<std::string> spoken;
+    auto start = std::chrono::steady_clock::now();
+    ollama.process_streaming("Test query", [&spoken](const std::string& sentence) {
+        spoken.push_back(sentence);
+    });
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    canceller.join();
+    close(server);
+    
+    // Nothing is spoken for a cancelled request, and it stops well before the 30 s timeout
+    REQUIRE(ollama.was_cancelled());
+    REQUIRE(spoken.empty());
+    REQUIRE(elapsed < std::chrono::seconds(3));
+    REQUIRE(ollama.history_size() == 0);
+}
+
+TEST_CASE("OllamaClient cancel applies to requests whose token was taken", "[ollama]") {
+    // Nothing listens on the port once it is closed, so requests fail fast
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(server >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    REQUIRE(bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    socklen_t addr_len = sizeof(addr);
+    getsockname(server, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    close(server);
+    
+    OllamaConfig config;
+    config.host = "http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+    config.stream = true;
+    OllamaClient ollama(config);
+    std::vector<std::string> spoken;
+    auto speak = [&spoken](const std::string& sentence) { spoken.push_back(sentence); };
+    
+    // Cancelled before the request starts, it is not sent at all
+    uint64_t token = ollama.request_token();
+    ollama.cancel();
+    REQUIRE(ollama.process_streaming("Test query", speak, token).empty());
+    REQUIRE(ollama.was_cancelled());
+    REQUIRE(spoken.empty());
+    
+    // Cancelling an older request leaves a newer one alone
+    uint64_t older = ollama.request_token();
+    token = ollama.request_token();
+    ollama.cancel(older);
+    REQUIRE_FALSE(ollama.process_streaming("Test query", speak, token).empty());
+    REQUIRE_FALSE(ollama.was_cancelled());
+    REQUIRE(spoken.size() == 1);
+    
+    // A cancel with no request asked for does not reach the next one
+    ollama.cancel();
+    spoken.clear();
+    ollama.process_streaming("Test query", speak);
+    REQUIRE_FALSE(ollama.was_cancelled());
+    REQUIRE(spoken.size() == 1);
+}
+
+// Accept one HTTP request on a local port and answer it with a JSON body.
+// The raw request is stored in received.
+class OneShotServer {
+private:
+    int server = -1;
+    std::thread worker;
+    
+public:
+    int port = 0;
+    std::string received;
+    
+    explicit OneShotServer(const std::string& body) {
+        server = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        listen(server, 1);
+        socklen_t addr_len = sizeof(addr);
+        getsockname(server, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+        port = ntohs(addr.sin_port);
+        
+        worker = std::thread([this, body] {
+            int client = accept(server, nullptr, nullptr);
+            if (client < 0) return;
+            
+            // Read until the whole body announced by Content-Length has arrived
+            char buffer[4096];
+            ssize_t n;
+            while ((n = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+                received.append(buffer, n);
+                size_t header_end = received.find("\r\n\r\n");
+                size_t length_pos = received.find("Content-Length: ");
+                if (header_end != std::string::npos && length_pos != std::string::npos &&
+                    received.size() >= header_end + 4 + std::stoul(received.substr(length_pos + 16))) {
+                    break;
+                }
+            }
+            
+            std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+            send(client, response.data(), response.size(), 0);
+            close(client);
+        });
+    }
+    
+    ~OneShotServer() {
+        if (worker.joinable()) worker.join();
+        close(server);
+    }
+    
+    void wait() {
+        if (worker.joinable()) worker.join();
+    }
+};
+
+TEST_CASE("OllamaClient chat mode sends messages and reads the chat reply", "[ollama]") {
+    OneShotServer server(R"({"message": {"role": "assistant", "content": "Hello there."}, "done": true})");
+    
+    OllamaConfig config;
+    config.host = "http://127.0.0.1:" + std::to_string(server.port);
+    config.api = "chat";
+    config.system_prompt = "Be brief.";
+    OllamaClient ollama(config);
+    
+    std::string result = ollama.process("Hi");
+    server.wait();
+    
+    REQUIRE(result == "Hello there.");
+    REQUIRE(ollama.history_size() == 1);
+    REQUIRE(server.received.find("POST /api/chat") != std::string::npos);
+    REQUIRE(server.received.find("\"messages\"") != std::string::npos);
+    REQUIRE(server.received.find("\"system\"") != std::string::npos);
+    
+    // The turn the reply added can be taken back while it is the newest
+    const uint64_t turn = ollama.last_turn_id();
+    REQUIRE(turn != 0);
+    REQUIRE(ollama.forget_turn(turn));
+    REQUIRE(ollama.history_size() == 0);
+}
+
+TEST_CASE("OllamaClient summarizes dropped turns in the background", "[ollama]") {
+    OneShotServer server(R"({"response": "The user asked about the weather.", "done": true})");
+    
+    OllamaConfig config;
+    config.host = "http://127.0.0.1:" + std::to_string(server.port);
+    config.history_turns = 1;
+    config.history_summary = true;
+    OllamaClient ollama(config);
+    
+    // Adding turns only sets the dropped ones aside
+    ollama.add_turn("Will it rain?", "Probably not.");
+    ollama.add_turn("Thanks", "You're welcome.");
+    REQUIRE(ollama.history_size() == 1);
+    REQUIRE(ollama.get_history_summary().empty());
+    
+    ollama.update_summary();
+    ollama.wait_for_summary();
+    server.wait();
+    REQUIRE(server.received.find("User: Will it rain?") != std::string::npos);
+    REQUIRE(ollama.get_history_summary() == "The user asked about the weather.");
+    
+    // Nothing new has dropped out, so there is nothing more to ask
+    ollama.update_summary();
+    ollama.wait_for_summary();
+    REQUIRE(ollama.get_history_summary() == "The user asked about the weather.");
+}
+
+TEST_CASE("OllamaClient warm_up loads the model without a prompt", "[ollama]") {
+    OneShotServer server(R"({"model": "llama3", "response": "", "done": true, "done_reason": "load"})");
+    
+    OllamaConfig config;
+    config.host = "http://127.0.0.1:" + std::to_string(server.port);
+    config.model = "llama3";
+    config.keep_alive = "30m";
+    OllamaClient ollama(config);
+    
+    REQUIRE(ollama.warm_up());
+    server.wait();
+    
+    REQUIRE(server.received.find("POST /api/generate") != std::string::npos);
+    REQUIRE(server.received.find("\"keep_alive\":\"30m\"") != std::string::npos);
+    REQUIRE(server.received.find("\"prompt\"") == std::string::npos);
+    REQUIRE(ollama.history_size() == 0);
+    
+    // Without a server there is nothing to warm up
+    config.host = "http://127.0.0.1:1";
+    OllamaClient unreachable(config);
+    REQUIRE_FALSE(unreachable.warm_up());
+    REQUIRE(unreachable.server_version().empty());
+}
+
+TEST_CASE("SentenceSplitter emits complete sentences from streamed chunks", "[ollama][stream]") {
+    SentenceSplitter splitter;
+    std::vector<std::string> sentences;
+    auto emit = [&sentences](const std::string& sentence) { sentences.push_back(sentence); };
+    
+    SECTION("Sentences split across chunks") {
+        splitter.feed("Hello the", emit);
+        splitter.feed("re. How are", emit);
+        REQUIRE(sentences.size() == 1);
+        REQUIRE(sentences[0] == "Hello there.");
+        
+        splitter.feed(" you?! I am fine", emit);
+        REQUIRE(sentences.size() == 2);
+        REQUIRE(sentences[1] == "How are you?!");
+        
+        splitter.flush(emit);
+        REQUIRE(sentences.size() == 3);
+        REQUIRE(sentences[2] == "I am fine");
+    }
+    
+    SECTION("Waits for the character after the punctuation") {
+        splitter.feed("Version 3.", emit);
+        REQUIRE(sentences.empty());
+        splitter.feed("5 is out. ", emit);
+        REQUIRE(sentences.size() == 1);
+        REQUIRE(sentences[0] == "Version 3.5 is out.");
+    }
+    
+    SECTION("Abbreviations do not end a sentence") {
+        splitter.feed("Try fruit, e.g. apples. Done", emit);
+        REQUIRE(sentences.size() == 1);
+        REQUIRE(sentences[0] == "Try fruit, e.g. apples.");
+    }
+    
+    SECTION("Code blocks are kept whole") {
+        splitter.feed("Here:\n```\nx = 1. y = 2.\n", emit);
+        REQUIRE(sentences.size() == 1);
+        splitter.feed("```\nThat is all. ", emit);
+        REQUIRE(sentences.size() == 3);
+        REQUIRE(sentences[1] == "```\nx = 1. y = 2.\n```");
+        REQUIRE(sentences[2] == "That is all.");
+    }
+}
@@ -0,0 +1,118 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <cmath>
+
+#include "resampler.h"
+
+static std::vector<float> make_tone(float frequency, int sample_rate, size_t count, float amplitude = 0.5f) {
+    std::vector<float> audio(count);
+    for (size_t i = 0; i < count; i++) {
+        audio[i] = amplitude * std::sin(2.0f * static_cast<float>(M_PI) * frequency * i / sample_rate);
+    }
+    return audio;
+}
+
+// RMS of a buffer, skipping the edges where the filter is settling
+static float steady_rms(const std::vector<float>& audio, size_t skip) {
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t i = skip; i + skip < audio.size(); i++) {
+        sum += audio[i] * audio[i];
+        count++;
+    }
+    return count ? static_cast<float>(std::sqrt(sum / count)) : 0.0f;
+}
+
+TEST_CASE("Equal rates pass audio through unchanged", "[resampler]") {
+    PolyphaseResampler resampler(16000, 16000);
+    REQUIRE(resampler.is_passthrough());
+    
+    std::vector<float> input = make_tone(440.0f, 16000, 100);
+    std::vector<float> output;
+    resampler.process(input.data(), input.size(), output);
+    REQUIRE(output == input);
+}
+
+TEST_CASE("Common capture rates are converted to 16kHz at the right length", "[resampler]") {
+    for (int rate : {48000, 44100, 32000, 22050, 8000}) {
+        INFO("Input rate " << rate);
+        std::vector<float> input(rate); // One second
+        std::vector<float> output;
+        PolyphaseResampler::resample(input.data(), input.size(), rate, 16000, output);
+        REQUIRE(output.size() == 16000);
+        
+        // Streaming holds back only the filter latency
+        PolyphaseResampler resampler(rate, 16000);
+        std::vector<float> streamed;
+        resampler.process(input.data(), input.size(), streamed);
+        REQUIRE(streamed.size() + resampler.latency() >= 15999);
+        REQUIRE(streamed.size() + resampler.latency() <= 16001);
+        REQUIRE(streamed.size() <= resampler.max_output(input.size()));
+    }
+}
+
+TEST_CASE("Speech-band tones keep their level and aliases are removed", "[resampler]") {
+    for (int rate : {48000, 44100}) {
+        INFO("Input rate " << rate);
+        std::vector<float> output;
+        
+        // A 1 kHz tone passes at unity gain, and stays a 1 kHz tone
+        std::vector<float> tone = make_tone(1000.0f, rate, rate / 2);
+        PolyphaseResampler::resample(tone.data(), tone.size(), rate, 16000, output);
+        REQUIRE(steady_rms(output, 200) == Approx(0.5f / std::sqrt(2.0f)).epsilon(0.01));
+        
+        std::vector<float> expected = make_tone(1000.0f, 16000, output.size());
+        float max_error = 0.0f;
+        for (size_t i = 200; i + 200 < output.size(); i++) {
+            max_error = std::max(max_error, std::fabs(output[i] - expected[i]));
+        }
+        REQUIRE(max_error < 0.01f);
+        
+        // A 12 kHz tone is above the 8 kHz Nyquist frequency and must not fold back
+        std::vector<float> high = make_tone(12000.0f, rate, rate / 2);
+        PolyphaseResampler::resample(high.data(), high.size(), rate, 16000, output);
+        REQUIRE(steady_rms(output, 200) < 0.001f);
+    }
+}
+
+TEST_CASE("Streaming output does not depend on chunk size", "[resampler]") {
+    std::vector<float> input = make_tone(700.0f, 44100, 4410);
+    for (size_t i = 0; i < input.size(); i += 7) {
+        input[i] += 0.1f; // Some broadband content
+    }
+    
+    PolyphaseResampler whole(44100, 16000);
+    std::vector<float> expected;
+    whole.process(input.data(), input.size(), expected);
+    
+    for (size_t chunk : {1, 3, 64, 441, 1000}) {
+        INFO("Chunk size " << chunk);
+        PolyphaseResampler resampler(44100, 16000);
+        std::vector<float> output;
+        for (size_t i = 0; i < input.size(); i += chunk) {
+            resampler.process(input.data() + i, std::min(chunk, input.size() - i), output);
+        }
+        
+        REQUIRE(output.size() == expected.size());
+        for (size_t i = 0; i < output.size(); i++) {
+            REQUIRE(output[i] == expected[i]);
+        }
+    }
+}
+
+TEST_CASE("Reset forgets earlier input", "[resampler]") {
+    std::vector<float> loud = make_tone(1000.0f, 48000, 480);
+    std::vector<float> silence(480, 0.0f);
+    
+    PolyphaseResampler resampler(48000, 16000);
+    std::vector<float> output;
+    resampler.process(loud.data(), loud.size(), output);
+    resampler.reset();
+    output.clear();
+    resampler.process(silence.data(), silence.size(), output);
+    
+    for (float sample : output) {
+        REQUIRE(sample == 0.0f);
+    }
+}
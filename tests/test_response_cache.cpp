@@ -0,0 +1,126 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <chrono>
+#include <ctime>
+
+#include "response_cache.h"
+
+TEST_CASE("ResponseCache ignores case, punctuation and filler words", "[response_cache]") {
+    REQUIRE(ResponseCache::normalize("What can you do?") == "what can you do");
+    REQUIRE(ResponseCache::normalize("  Um, what CAN you   do, please.") == "what can you do");
+    REQUIRE(ResponseCache::normalize("What's the time?") == "what's the time");
+    
+    REQUIRE(ResponseCache::make_key("What can you do?", "llama3", "Be brief.") ==
+            ResponseCache::make_key("what can you do", "llama3", "Be brief."));
+    REQUIRE(ResponseCache::make_key("What can you do?", "llama3", "Be brief.") !=
+            ResponseCache::make_key("What can you do?", "gemma3:1b", "Be brief."));
+    REQUIRE(ResponseCache::make_key("What can you do?", "llama3", "Be brief.") !=
+            ResponseCache::make_key("What can you do?", "llama3", "Be a pirate."));
+}
+
+TEST_CASE("ResponseCache expires entries and drops the least recently used", "[response_cache]") {
+    using namespace std::chrono;
+    ResponseCache cache(2, seconds(60));
+    const auto start = ResponseCache::Clock::now();
+    std::string reply;
+    
+    SECTION("Entries expire after the TTL") {
+        cache.store("a", "reply a", start);
+        REQUIRE(cache.find("a", reply, start + seconds(59)));
+        REQUIRE(reply == "reply a");
+        REQUIRE_FALSE(cache.find("a", reply, start + seconds(60)));
+        REQUIRE(cache.size() == 0);
+    }
+    
+    SECTION("A full cache drops the entry used longest ago") {
+        cache.store("a", "reply a", start);
+        cache.store("b", "reply b", start);
+        REQUIRE(cache.find("a", reply, start)); // b is now the oldest
+        cache.store("c", "reply c", start);
+        
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.find("a", reply, start));
+        REQUIRE(cache.find("c", reply, start));
+        REQUIRE_FALSE(cache.find("b", reply, start));
+    }
+    
+    SECTION("Storing a key again replaces its reply") {
+        cache.store("a", "old", start);
+        cache.store("a", "new", start);
+        REQUIRE(cache.size() == 1);
+        REQUIRE(cache.find("a", reply, start));
+        REQUIRE(reply == "new");
+    }
+    
+    SECTION("Empty replies are not cached") {
+        cache.store("a", "", start);
+        REQUIRE(cache.size() == 0);
+    }
+}
+
+TEST_CASE("Quick intents answer time and date questions", "[response_cache]") {
+    REQUIRE(match_quick_intent("What time is it?") == QuickIntent::Time);
+    REQUIRE(match_quick_intent("Hey, what's the time now?") == QuickIntent::Time);
+    REQUIRE(match_quick_intent("What's today's date?") == QuickIntent::Date);
+    REQUIRE(match_quick_intent("What day is it today?") == QuickIntent::Date);
+    REQUIRE(match_quick_intent("What are you running on?") == QuickIntent::System);
+    REQUIRE(match_quick_intent("What time is it in Tokyo?") == QuickIntent::None);
+    REQUIRE(match_quick_intent("Tell me a story") == QuickIntent::None);
+    
+    std::tm local{};
+    local.tm_year = 2026 - 1900;
+    local.tm_mon = 9;
+    local.tm_mday = 14;
+    local.tm_hour = 15;
+    local.tm_min = 7;
+    local.tm_isdst = -1;
+    const std::time_t now = std::mktime(&local);
+    
+    SystemInfo info;
+    REQUIRE(answer_quick_intent(QuickIntent::Time, info, now) == "It's 3:07 PM.");
+    REQUIRE(answer_quick_intent(QuickIntent::Date, info, now) == "Today is Wednesday, October 14, 2026.");
+    
+    // Without system information the question is left to the model
+    REQUIRE(answer_quick_intent(QuickIntent::System, info, now).empty());
+    info.os_info = "Ubuntu 24.04";
+    info.cpu_info = "Intel Core i7 with 8 cores";
+    info.memory_info = "15Gi of RAM";
+    REQUIRE(answer_quick_intent(QuickIntent::System, info, now) ==
+            "I'm running on Ubuntu 24.04 with Intel Core i7 with 8 cores and 15Gi of RAM.");
+}
+
+TEST_CASE("QuickReplies tries intents before the cache", "[response_cache]") {
+    ResponseCacheConfig config;
+    OllamaConfig ollama;
+    SystemInfo info;
+    std::string reply;
+    bool from_cache = true;
+    
+    SECTION("The cache is off by default") {
+        QuickReplies replies(config, ollama, info);
+        replies.remember("What can you do?", "Lots of things.");
+        REQUIRE_FALSE(replies.find("What can you do?", reply));
+        REQUIRE(replies.find("What time is it?", reply, &from_cache));
+        REQUIRE_FALSE(from_cache);
+        REQUIRE(replies.kept_audio_limit() == 0);
+    }
+    
+    SECTION("Cached replies are found again") {
+        config.enabled = true;
+        config.max_entries = 8;
+        QuickReplies replies(config, ollama, info);
+        replies.remember("What can you do?", "Lots of things.");
+        REQUIRE(replies.find("what can you do", reply, &from_cache));
+        REQUIRE(reply == "Lots of things.");
+        REQUIRE(from_cache);
+        REQUIRE(replies.kept_audio_limit() == 8);
+    }
+    
+    SECTION("Intents can be turned off") {
+        config.quick_intents = false;
+        QuickReplies replies(config, ollama, info);
+        REQUIRE_FALSE(replies.is_enabled());
+        REQUIRE_FALSE(replies.find("What time is it?", reply));
+    }
+}
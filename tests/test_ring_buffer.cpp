@@ -0,0 +1,161 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "ring_buffer.h"
+
+TEST_CASE("SpscRingBuffer keeps the newest samples", "[ring_buffer]") {
+    SpscRingBuffer<float> ring(4);
+    
+    std::vector<float> first = {1, 2, 3};
+    ring.write(first.data(), first.size());
+    REQUIRE(ring.size() == 3);
+    REQUIRE(ring.oldest_position() == 0);
+    
+    std::vector<float> second = {4, 5, 6};
+    ring.write(second.data(), second.size());
+    REQUIRE(ring.write_position() == 6);
+    REQUIRE(ring.oldest_position() == 2);
+    REQUIRE(ring.size() == 4);
+    
+    std::vector<float> out;
+    REQUIRE(ring.copy(2, 6, out));
+    REQUIRE(out == std::vector<float>{3, 4, 5, 6});
+    
+    // Samples that have been overwritten can no longer be copied
+    REQUIRE_FALSE(ring.copy(1, 6, out));
+}
+
+TEST_CASE("SpscRingBuffer spans wrap around the end of the storage", "[ring_buffer]") {
+    SpscRingBuffer<float> ring(4);
+    std::vector<float> samples = {1, 2, 3, 4, 5, 6};
+    ring.write(samples.data(), samples.size());
+    
+    SpscRingBuffer<float>::Span view = ring.span(3, 6);
+    REQUIRE(view.size() == 3);
+    REQUIRE(view.first_size == 1);
+    REQUIRE(view.second_size == 2);
+    
+    std::vector<float> out(view.size());
+    view.copy_to(out.data());
+    REQUIRE(out == std::vector<float>{4, 5, 6});
+}
+
+TEST_CASE("SpscRingBuffer handles writes larger than its capacity", "[ring_buffer]") {
+    SpscRingBuffer<float> ring(3);
+    std::vector<float> samples = {1, 2, 3, 4, 5};
+    ring.write(samples.data(), samples.size());
+    
+    REQUIRE(ring.write_position() == 5);
+    std::vector<float> out;
+    REQUIRE(ring.copy(ring.oldest_position(), ring.write_position(), out));
+    REQUIRE(out == std::vector<float>{3, 4, 5});
+}
+
+// A sample that holds the producer up right after it overwrites the sample
+// for position `pause_at`, as if the copy ran in the middle of a write
+struct PausingSample {
+    static std::atomic<uint64_t> pause_at;
+    static std::atomic<bool> paused;
+    static std::atomic<bool> resume;
+    static thread_local bool is_producer;
+    
+    uint64_t value = 0;
+    
+    PausingSample() = default;
+    explicit PausingSample(uint64_t v) : value(v) {}
+    PausingSample(const PausingSample&) = default;
+    
+    PausingSample& operator=(const PausingSample& other) {
+        value = other.value;
+        if (is_producer && value == pause_at.load()) {
+            paused = true;
+            while (!resume.load()) {
+                std::this_thread::yield();
+            }
+        }
+        return *this;
+    }
+};
+
+std::atomic<uint64_t> PausingSample::pause_at{0};
+std::atomic<bool> PausingSample::paused{false};
+std::atomic<bool> PausingSample::resume{false};
+thread_local bool PausingSample::is_producer = false;
+
+TEST_CASE("SpscRingBuffer copies fail while a write overwrites them", "[ring_buffer]") {
+    SpscRingBuffer<PausingSample> ring(8);
+    std::vector<PausingSample> samples;
+    for (uint64_t i = 0; i < 12; i++) {
+        samples.emplace_back(i);
+    }
+    PausingSample::pause_at = 100; // Not reached while filling
+    ring.write(samples.data(), 8);
+    
+    // The producer stops having overwritten position 0 with 8, before the
+    // write is finished
+    PausingSample::pause_at = 8;
+    std::thread producer([&] {
+        PausingSample::is_producer = true;
+        ring.write(samples.data() + 8, 4);
+    });
+    while (!PausingSample::paused.load()) {
+        std::this_thread::yield();
+    }
+    
+    // CHECK rather than REQUIRE, so the producer is always let go
+    std::vector<PausingSample> out;
+    CHECK(ring.write_position() == 8);
+    CHECK_FALSE(ring.copy(0, 4, out));
+    
+    // Past the part being written, the copy is fine
+    CHECK(ring.copy(4, 8, out));
+    CHECK(out.size() == 4);
+    CHECK(out.front().value == 4);
+    CHECK(out.back().value == 7);
+    
+    PausingSample::resume = true;
+    producer.join();
+    REQUIRE(ring.write_position() == 12);
+}
+
+TEST_CASE("SpscQueue passes items between threads in order", "[ring_buffer]") {
+    SpscQueue<int> queue(8);
+    const int count = 10000;
+    
+    std::thread producer([&queue] {
+        for (int i = 0; i < count; i++) {
+            while (!queue.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    
+    int expected = 0;
+    while (expected < count) {
+        int value;
+        if (queue.pop(value)) {
+            REQUIRE(value == expected);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("SpscQueue rejects items when full", "[ring_buffer]") {
+    SpscQueue<int> queue(2);
+    REQUIRE(queue.push(1));
+    REQUIRE(queue.push(2));
+    REQUIRE_FALSE(queue.push(3));
+    
+    int value;
+    REQUIRE(queue.pop(value));
+    REQUIRE(value == 1);
+    REQUIRE(queue.push(3));
+}
@@ -0,0 +1,153 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <csignal>
+
+#include "job_slots.h"
+#include "session_manager.h"
+
+TEST_CASE("JobSlots serve waiting callers in arrival order", "[serving]") {
+    JobSlots slots(1);
+    REQUIRE(slots.size() == 1);
+    
+    JobSlots::Lease held = slots.acquire();
+    REQUIRE(held);
+    REQUIRE(slots.in_use() == 1);
+    
+    std::mutex order_mutex;
+    std::vector<int> order;
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 3; i++) {
+        waiters.emplace_back([&, i] {
+            JobSlots::Lease lease = slots.acquire();
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(i);
+        });
+        // Let each waiter queue up before the next one
+        while (slots.wait_count() < static_cast<uint64_t>(i + 1)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    
+    held.release();
+    for (auto& waiter : waiters) {
+        waiter.join();
+    }
+    REQUIRE(order == std::vector<int>{0, 1, 2});
+    REQUIRE(slots.in_use() == 0);
+    REQUIRE(slots.wait_count() == 3);
+}
+
+TEST_CASE("JobSlots give up waiting once cancelled", "[serving]") {
+    JobSlots slots(1);
+    JobSlots::Lease held = slots.acquire();
+    
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> got_slot{true};
+    std::thread waiter([&] {
+        got_slot.store(static_cast<bool>(slots.acquire([&] { return cancelled.load(); })));
+    });
+    while (slots.wait_count() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    cancelled.store(true);
+    waiter.join();
+    REQUIRE_FALSE(got_slot.load());
+    
+    // The cancelled caller left the queue, so the slot comes back free
+    held.release();
+    REQUIRE(slots.in_use() == 0);
+    REQUIRE(slots.acquire());
+    
+    // Cancelled before asking, it gets nothing even with a slot free
+    REQUIRE_FALSE(slots.acquire([] { return true; }));
+    REQUIRE(slots.in_use() == 0);
+}
+
+TEST_CASE("SessionManager runs every session until the running flag clears", "[serving]") {
+    volatile sig_atomic_t running = 1;
+    std::atomic<int> kitchen_runs{0};
+    std::atomic<int> office_runs{0};
+    
+    SessionManager manager(&running, 1, 1);
+    manager.add("kitchen", [&] {
+        kitchen_runs++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return SessionManager::Outcome::Ended;
+    }, [&] { return static_cast<uint64_t>(kitchen_runs.load()); });
+    manager.add("office", [&] {
+        office_runs++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return SessionManager::Outcome::Ended;
+    });
+    REQUIRE(manager.size() == 2);
+    
+    manager.start();
+    while (kitchen_runs.load() < 3 || office_runs.load() < 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    running = 0;
+    manager.join();
+    
+    REQUIRE(manager.conversation_count(0) == static_cast<uint64_t>(kitchen_runs.load()));
+    REQUIRE(manager.conversation_count(1) == static_cast<uint64_t>(office_runs.load()));
+    REQUIRE(manager.turn_count() == static_cast<uint64_t>(kitchen_runs.load()));
+    
+    std::string summary = manager.summary(4);
+    REQUIRE(summary.find("kitchen") != std::string::npos);
+    REQUIRE(summary.find("turns per CPU-hour on 4 CPU(s)") != std::string::npos);
+}
+
+TEST_CASE("SessionManager stops a session that cannot go on", "[serving]") {
+    volatile sig_atomic_t running = 1;
+    std::atomic<int> runs{0};
+    
+    SessionManager manager(&running, 1, 1);
+    manager.add("recording", [&] {
+        runs++;
+        return SessionManager::Outcome::Stopped;
+    });
+    manager.start();
+    manager.join();
+    
+    REQUIRE(runs.load() == 1);
+    REQUIRE(manager.conversation_count(0) == 1);
+}
+
+TEST_CASE("SessionManager only waits before retrying a failed conversation", "[serving]") {
+    volatile sig_atomic_t running = 1;
+    std::atomic<int> quick_goodbyes{0};
+    std::atomic<int> failures{0};
+    
+    // Both end at once, but only the failed one waits the restart delay
+    SessionManager manager(&running, 10000, 30000);
+    manager.add("kitchen", [&] {
+        quick_goodbyes++;
+        return SessionManager::Outcome::Ended;
+    });
+    manager.add("garage", [&] {
+        failures++;
+        return SessionManager::Outcome::Failed;
+    });
+    manager.start();
+    while (quick_goodbyes.load() < 10) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    running = 0;
+    manager.join();
+    
+    REQUIRE(failures.load() == 1);
+}
+
+TEST_CASE("session_file_path puts the session name before the extension", "[serving]") {
+    REQUIRE(session_file_path("metrics.jsonl", "kitchen") == "metrics.kitchen.jsonl");
+    REQUIRE(session_file_path("logs/conversation.log", "office") == "logs/conversation.office.log");
+    REQUIRE(session_file_path("logs.d/conversation", "office") == "logs.d/conversation.office");
+    REQUIRE(session_file_path(".hidden", "a") == ".hidden.a");
+    REQUIRE(session_file_path("", "kitchen") == "");
+}
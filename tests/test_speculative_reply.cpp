@@ -0,0 +1,161 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "speculative_reply.h"
+
+// Stands in for the Ollama client: speaks two sentences, then waits until
+// released or cancelled, like a reply that is still being generated.
+// Requests are cancelled by token, as in the client, so a cancel that comes
+// before the worker gets going is not lost.
+struct FakeModel {
+    std::atomic<uint64_t> issued{0};
+    std::atomic<uint64_t> cancelled_through{0};
+    std::atomic<bool> cancelled{false}; // Set by any cancel, never reset
+    std::atomic<bool> release{false};
+    std::atomic<int> forgotten{0};
+    std::atomic<bool> remembered{false};
+    
+    std::mutex request_mutex;
+    std::condition_variable request_entered;
+    int requests = 0;
+    
+    // Wait until count requests have reached generate
+    void wait_for_requests(int count) {
+        std::unique_lock<std::mutex> lock(request_mutex);
+        request_entered.wait(lock, [&] { return requests >= count; });
+    }
+    
+    int request_count() {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        return requests;
+    }
+    
+    SpeculativeReply make() {
+        return SpeculativeReply(
+            [this](const std::string& prompt, const SpeculativeReply::SentenceCallback& on_sentence, uint64_t token) {
+                {
+                    std::lock_guard<std::mutex> lock(request_mutex);
+                    requests++;
+                }
+                request_entered.notify_all();
+                auto is_cancelled = [this, token] { return token <= cancelled_through.load(); };
+                on_sentence("You asked: " + prompt + ".");
+                on_sentence("Here is more.");
+                while (!release.load() && !is_cancelled()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                if (is_cancelled()) {
+                    return std::string();
+                }
+                on_sentence("Done.");
+                remembered = true;
+                return "You asked: " + prompt + ". Here is more. Done.";
+            },
+            [this] { return ++issued; },
+            [this](uint64_t token) {
+                cancelled = true;
+                uint64_t through = cancelled_through.load();
+                while (through < token && !cancelled_through.compare_exchange_weak(through, token)) {
+                }
+            },
+            [this] {
+                if (remembered.exchange(false)) forgotten++;
+            });
+    }
+};
+
+TEST_CASE("match_key ignores case, punctuation and spacing", "[speculative]") {
+    REQUIRE(SpeculativeReply::match_key("What's the time?") == "what's the time");
+    REQUIRE(SpeculativeReply::match_key("  what's   the TIME") == "what's the time");
+    REQUIRE(SpeculativeReply::match_key("...") == "");
+    REQUIRE(SpeculativeReply::match_key("Turn it on") != SpeculativeReply::match_key("Turn it off"));
+}
+
+TEST_CASE("A matching final transcript adopts the reply", "[speculative]") {
+    FakeModel model;
+    SpeculativeReply speculation = model.make();
+    
+    REQUIRE(speculation.start("what time is it"));
+    REQUIRE(speculation.is_active());
+    
+    // The same prompt again does not start a second request
+    REQUIRE_FALSE(speculation.start("What time is it?"));
+    
+    // Let the held sentences arrive before adopting
+    model.wait_for_requests(1);
+    
+    speculation.pause();
+    std::vector<std::string> spoken;
+    std::mutex spoken_mutex;
+    std::thread releaser([&model] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        model.release = true;
+    });
+    std::string reply;
+    bool adopted = speculation.adopt("What time is it?", [&](const std::string& sentence) {
+        std::lock_guard<std::mutex> lock(spoken_mutex);
+        spoken.push_back(sentence);
+    }, reply);
+    releaser.join();
+    
+    REQUIRE(adopted);
+    REQUIRE(spoken == std::vector<std::string>{"You asked: what time is it.", "Here is more.", "Done."});
+    REQUIRE(reply == "You asked: what time is it. Here is more. Done.");
+    REQUIRE(model.request_count() == 1);
+    REQUIRE(model.forgotten == 0);
+    REQUIRE_FALSE(speculation.is_active());
+    
+    // Nothing starts while paused
+    REQUIRE_FALSE(speculation.start("and the date"));
+    speculation.resume();
+}
+
+TEST_CASE("A different final transcript discards the reply", "[speculative]") {
+    FakeModel model;
+    SpeculativeReply speculation = model.make();
+    
+    SECTION("Still generating: the request is cancelled") {
+        REQUIRE(speculation.start("turn on the"));
+        speculation.pause();
+        std::vector<std::string> spoken;
+        std::string reply;
+        REQUIRE_FALSE(speculation.adopt("turn on the lights", [&](const std::string& s) { spoken.push_back(s); }, reply));
+        REQUIRE(model.cancelled);
+        REQUIRE(spoken.empty());
+        REQUIRE(reply.empty());
+        REQUIRE_FALSE(speculation.is_active());
+    }
+    
+    SECTION("Already finished: the reply is forgotten") {
+        model.release = true;
+        REQUIRE(speculation.start("turn on the"));
+        while (!model.remembered.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        speculation.discard();
+        REQUIRE(model.forgotten == 1);
+    }
+    
+    SECTION("A new partial replaces the old reply") {
+        REQUIRE(speculation.start("turn on the"));
+        REQUIRE(speculation.start("turn on the lights"));
+        model.wait_for_requests(2);
+        REQUIRE(model.request_count() == 2);
+        REQUIRE(model.cancelled);
+        
+        // Changes while a turn is being answered leave the reply alone
+        speculation.pause();
+        speculation.invalidate();
+        REQUIRE(speculation.is_active());
+        speculation.resume();
+        speculation.invalidate();
+        REQUIRE_FALSE(speculation.is_active());
+    }
+}
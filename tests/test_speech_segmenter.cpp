@@ -0,0 +1,215 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <cmath>
+
+#include "speech_segmenter.h"
+
+static const int kRate = 16000;
+
+struct RecordedEvent {
+    SpeechSegmenter::Event event;
+    uint64_t start;
+    uint64_t end;
+};
+
+static std::vector<float> make_tone(size_t count, float amplitude = 0.3f) {
+    std::vector<float> audio(count);
+    for (size_t i = 0; i < count; i++) {
+        audio[i] = amplitude * std::sin(2.0f * 3.14159265f * 220.0f * i / kRate);
+    }
+    return audio;
+}
+
+static VADParams test_params() {
+    VADParams params;
+    params.threshold = 0.001f;
+    params.freq_threshold = 30.0f;
+    return params;
+}
+
+// Feed audio in capture-sized chunks, advancing the stream position. Like
+// the capture thread, barge-in opens the gate for the following chunks.
+static void feed(SpeechSegmenter& segmenter, const std::vector<float>& audio, uint64_t& position,
+                 std::vector<RecordedEvent>& events, SpeechSegmenter::EchoGate gate = {}) {
+    for (size_t i = 0; i < audio.size(); i += 1600) {
+        size_t count = std::min<size_t>(1600, audio.size() - i);
+        segmenter.process(audio.data() + i, count, position, gate,
+                          [&](SpeechSegmenter::Event event, uint64_t start, uint64_t end) {
+                              events.push_back({event, start, end});
+                              if (event == SpeechSegmenter::Event::BargeIn) {
+                                  gate.closed = false;
+                              }
+                          });
+        position += count;
+    }
+}
+
+TEST_CASE("SpeechSegmenter finds an utterance between silences", "[segmenter]") {
+    SpeechSegmenter segmenter(test_params(), kRate, 10 * kRate);
+    std::vector<RecordedEvent> events;
+    uint64_t position = 0;
+    
+    feed(segmenter, std::vector<float>(2 * kRate, 0.0f), position, events);
+    REQUIRE(events.empty());
+    
+    feed(segmenter, make_tone(2 * kRate), position, events);
+    REQUIRE(events.size() == 1);
+    REQUIRE(events[0].event == SpeechSegmenter::Event::Started);
+    REQUIRE(segmenter.is_speaking());
+    
+    feed(segmenter, std::vector<float>(2 * kRate, 0.0f), position, events);
+    REQUIRE(events.size() == 2);
+    REQUIRE(events[1].event == SpeechSegmenter::Event::Ended);
+    REQUIRE_FALSE(segmenter.is_speaking());
+    
+    // The utterance covers the tone plus some context on either side
+    REQUIRE(events[1].start == events[0].start);
+    REQUIRE(events[1].start < 2 * kRate);
+    REQUIRE(events[1].end > 4 * kRate);
+    REQUIRE(events[1].end <= position);
+}
+
+TEST_CASE("SpeechSegmenter drops speech behind the echo gate", "[segmenter]") {
+    SpeechSegmenter segmenter(test_params(), kRate, 10 * kRate);
+    std::vector<RecordedEvent> events;
+    uint64_t position = 0;
+    
+    SECTION("Nothing is detected while the gate is closed") {
+        SpeechSegmenter::EchoGate gate;
+        gate.closed = true;
+        feed(segmenter, make_tone(2 * kRate), position, events, gate);
+        REQUIRE(events.empty());
+    }
+    
+    SECTION("Speech in progress is dropped when the gate closes") {
+        feed(segmenter, make_tone(kRate), position, events);
+        REQUIRE(events.size() == 1);
+        
+        SpeechSegmenter::EchoGate gate;
+        gate.closed = true;
+        feed(segmenter, make_tone(kRate), position, events, gate);
+        REQUIRE(events.size() == 2);
+        REQUIRE(events[1].event == SpeechSegmenter::Event::Dropped);
+        REQUIRE_FALSE(segmenter.is_speaking());
+    }
+    
+    SECTION("Utterances after the gate opens start after the echo tail") {
+        SpeechSegmenter::EchoGate gate;
+        gate.release_pos = kRate;
+        feed(segmenter, make_tone(3 * kRate), position, events, gate);
+        REQUIRE(events.size() == 1);
+        REQUIRE(events[0].event == SpeechSegmenter::Event::Started);
+        REQUIRE(events[0].start >= static_cast<uint64_t>(kRate + kRate * 300 / 1000));
+    }
+}
+
+TEST_CASE("SpeechSegmenter reports loud speech over the gate as barge-in", "[segmenter]") {
+    SpeechSegmenter segmenter(test_params(), kRate, 10 * kRate);
+    segmenter.set_barge_in_enabled(true);
+    std::vector<RecordedEvent> events;
+    uint64_t position = 0;
+    
+    SpeechSegmenter::EchoGate gate;
+    gate.closed = true;
+    feed(segmenter, make_tone(kRate), position, events, gate);
+    REQUIRE(events.size() == 1);
+    REQUIRE(events[0].event == SpeechSegmenter::Event::BargeIn);
+    REQUIRE(segmenter.is_speaking());
+    
+    // The utterance ends normally once the caller opens the gate
+    feed(segmenter, std::vector<float>(2 * kRate, 0.0f), position, events);
+    REQUIRE(events.back().event == SpeechSegmenter::Event::Ended);
+    REQUIRE(events.back().start == events[0].start);
+}
+
+TEST_CASE("SharedEchoGate only lets barge-in through while it is closed", "[segmenter]") {
+    SharedEchoGate gate;
+    int interruptions = 0;
+    auto interrupt = [&interruptions] { interruptions++; };
+    
+    // Talking over a reply opens the gate and is reported once
+    gate.close();
+    REQUIRE(gate.snapshot().closed);
+    REQUIRE(gate.barge_in(interrupt));
+    REQUIRE(interruptions == 1);
+    REQUIRE_FALSE(gate.snapshot().closed);
+    REQUIRE_FALSE(gate.open(1000)); // Already open; the user is speaking
+    REQUIRE(gate.snapshot().release_pos == 0);
+    REQUIRE(gate.take_barge_in());
+    REQUIRE_FALSE(gate.take_barge_in());
+    
+    // The chunk was segmented with the gate closed, but the reply finished
+    // before the barge-in was reported: nothing is interrupted
+    gate.close();
+    SpeechSegmenter::EchoGate snapshot = gate.snapshot();
+    REQUIRE(snapshot.closed);
+    REQUIRE(gate.open(2000));
+    REQUIRE_FALSE(gate.barge_in(interrupt));
+    REQUIRE(interruptions == 1);
+    REQUIRE_FALSE(gate.take_barge_in());
+    REQUIRE(gate.snapshot().release_pos == 2000);
+    
+    gate.reset();
+    REQUIRE(gate.snapshot().release_pos == 0);
+}
+
+TEST_CASE("SpeechSegmenter splits utterances longer than max_speech_ms", "[segmenter]") {
+    VADParams params = test_params();
+    params.max_speech_ms = 2000;
+    SpeechSegmenter segmenter(params, kRate, 10 * kRate);
+    std::vector<RecordedEvent> events;
+    uint64_t position = 0;
+    
+    feed(segmenter, make_tone(5 * kRate), position, events);
+    REQUIRE(events.size() >= 3);
+    REQUIRE(events[0].event == SpeechSegmenter::Event::Started);
+    for (size_t i = 1; i < events.size(); i++) {
+        REQUIRE(events[i].event == SpeechSegmenter::Event::Split);
+        REQUIRE(events[i].end - events[i].start >= 2 * static_cast<uint64_t>(kRate));
+    }
+    
+    // Each piece starts where the previous one ended
+    for (size_t i = 2; i < events.size(); i++) {
+        REQUIRE(events[i].start == events[i - 1].end);
+    }
+}
+
+TEST_CASE("SpeechSegmenter ends an utterance cut off by the end of the stream", "[segmenter]") {
+    SpeechSegmenter segmenter(test_params(), kRate, 10 * kRate);
+    std::vector<RecordedEvent> events;
+    uint64_t position = 0;
+    auto record = [&](SpeechSegmenter::Event event, uint64_t start, uint64_t end) {
+        events.push_back({event, start, end});
+    };
+    
+    // Nothing to end while silent
+    feed(segmenter, std::vector<float>(kRate, 0.0f), position, events);
+    segmenter.finish(position, record);
+    REQUIRE(events.empty());
+    
+    feed(segmenter, make_tone(2 * kRate), position, events);
+    REQUIRE(segmenter.is_speaking());
+    segmenter.finish(position, record);
+    REQUIRE(events.size() == 2);
+    REQUIRE(events[1].event == SpeechSegmenter::Event::Ended);
+    REQUIRE(events[1].start == events[0].start);
+    REQUIRE(events[1].end == position);
+    REQUIRE_FALSE(segmenter.is_speaking());
+}
+
+TEST_CASE("make_vad_params copies the streaming settings", "[segmenter]") {
+    StreamingConfig streaming;
+    streaming.vad_threshold = 0.02f;
+    streaming.vad_window_ms = 400;
+    streaming.vad_hop_ms = 50;
+    streaming.max_speech_ms = 12000;
+    streaming.vad_speech_threshold = 0.7f;
+    
+    VADParams params = make_vad_params(streaming);
+    REQUIRE(params.threshold == Approx(0.02f));
+    REQUIRE(params.window_ms == 400);
+    REQUIRE(params.hop_ms == 50);
+    REQUIRE(params.max_speech_ms == 12000);
+    REQUIRE(params.speech_probability == Approx(0.7f));
+}
@@ -0,0 +1,76 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+#include "system_probe.h"
+
+TEST_CASE("describe_os reads os-release without shelling out", "[system]") {
+    std::string os_release =
+        "PRETTY_NAME=\"Ubuntu 22.04.4 LTS\"\n"
+        "NAME=\"Ubuntu\"\n"
+        "VERSION_ID=\"22.04\"\n"
+        "VERSION=\"22.04.4 LTS (Jammy Jellyfish)\"\n";
+    REQUIRE(os_release_value(os_release, "NAME") == "Ubuntu");
+    REQUIRE(os_release_value(os_release, "VERSION_ID") == "22.04");
+    REQUIRE(describe_os(os_release, "Linux") == "Ubuntu 22.04.4 LTS (Jammy Jellyfish)");
+    
+    // Rolling releases have no VERSION, and the kernel name is the last resort
+    REQUIRE(describe_os("NAME=Arch Linux\n", "Linux") == "Arch Linux");
+    REQUIRE(describe_os("", "Linux") == "Linux Operating System");
+    REQUIRE(describe_os("", "") == "Unknown Operating System");
+}
+
+TEST_CASE("describe_cpu simplifies /proc/cpuinfo", "[system]") {
+    std::string intel =
+        "processor\t: 0\n"
+        "model name\t: Intel(R) Core(TM) i7-8550U CPU @ 1.80GHz\n"
+        "cpu MHz\t\t: 2803.212\n";
+    REQUIRE(describe_cpu(intel, 8) == "Intel Core i7 running at 2.8 GHz with 8 cores");
+    
+    std::string amd = "model name\t: AMD Ryzen 7 5800X 8-Core Processor\ncpu MHz\t\t: 3800.000\n";
+    REQUIRE(describe_cpu(amd, 16) == "AMD Ryzen processor running at 3.8 GHz with 16 cores");
+    
+    // Many ARM kernels list neither a model name nor a clock
+    REQUIRE(describe_cpu("processor\t: 0\nBogoMIPS\t: 108.00\n", 4) == "Generic processor with 4 cores");
+}
+
+TEST_CASE("Sizes are printed like free -h and df -h", "[system]") {
+    REQUIRE(format_size(512, false) == "512B");
+    REQUIRE(format_size(8160436ull * 1024, true) == "7.8Gi");
+    REQUIRE(format_size(16ull << 30, true) == "16Gi");
+    REQUIRE(format_size(250ull << 30, false) == "250G");
+    REQUIRE(format_size(1536ull << 20, false) == "1.5G");
+    
+    REQUIRE(describe_memory("MemTotal:       16314272 kB\nMemFree:         1234 kB\n") == "16Gi of RAM");
+    REQUIRE(describe_memory("") == "");
+    REQUIRE(describe_disk("/").find("disk space") != std::string::npos);
+}
+
+TEST_CASE("describe_gpu prefers a discrete card", "[system]") {
+    REQUIRE(describe_gpu({}) == "");
+    REQUIRE(describe_gpu({"0x8086"}) == "Intel");
+    REQUIRE(describe_gpu({"0x8086", "0x10de"}) == "NVIDIA");
+    REQUIRE(describe_gpu({"0x1002"}) == "AMD Radeon");
+    REQUIRE(describe_gpu({"0x1af4"}) == "Graphics card");
+}
+
+TEST_CASE("has_default_route reads /proc/net/route", "[system]") {
+    const std::string header = "Iface\tDestination\tGateway \tFlags\tRefCnt\tUse\tMetric\tMask\n";
+    REQUIRE(has_default_route(header + "eth0\t00000000\t0102A8C0\t0003\t0\t0\t100\t00000000\n"));
+    REQUIRE_FALSE(has_default_route(header + "eth0\t0002A8C0\t00000000\t0001\t0\t0\t100\t00FFFFFF\n"));
+    REQUIRE_FALSE(has_default_route(header));
+}
+
+TEST_CASE("whisper_source_version reads the project() version", "[system]") {
+    REQUIRE(whisper_source_version("cmake_minimum_required(VERSION 3.5)\n"
+                                   "project(\"whisper.cpp\" C CXX VERSION 1.7.4)\n") == "whisper.cpp 1.7.4");
+    REQUIRE(whisper_source_version("project(\"whisper.cpp\" C CXX)\nset(VERSION 2)\n") == "");
+    REQUIRE(whisper_source_version("") == "");
+}
+
+TEST_CASE("find_in_path looks for executables like which", "[system]") {
+    REQUIRE(find_in_path("sh", "/nonexistent:/bin:/usr/bin") == "/bin/sh");
+    REQUIRE(find_in_path("no-such-tool-here", "/bin:/usr/bin").empty());
+    REQUIRE(find_in_path("sh", "").empty());
+}
@@ -0,0 +1,87 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "thread_scheduling.h"
+
+TEST_CASE("parse_cpu_list reads taskset style lists", "[scheduling]") {
+    std::vector<int> cpus;
+    REQUIRE(parse_cpu_list("", cpus));
+    REQUIRE(cpus.empty());
+    
+    REQUIRE(parse_cpu_list("3", cpus));
+    REQUIRE(cpus == std::vector<int>{3});
+    
+    REQUIRE(parse_cpu_list("0,2-4", cpus));
+    REQUIRE(cpus == std::vector<int>{0, 2, 3, 4});
+    REQUIRE(format_cpu_list(cpus) == "0,2,3,4");
+    
+    // Repeats are only listed once
+    REQUIRE(parse_cpu_list("1,0-1", cpus));
+    REQUIRE(cpus == std::vector<int>{1, 0});
+    
+    REQUIRE_FALSE(parse_cpu_list("a", cpus));
+    REQUIRE_FALSE(parse_cpu_list("1,", cpus));
+    REQUIRE_FALSE(parse_cpu_list("3-1", cpus));
+    REQUIRE_FALSE(parse_cpu_list("-1", cpus));
+    REQUIRE_FALSE(parse_cpu_list("2 3", cpus));
+}
+
+TEST_CASE("Capture and playback policies come from the config", "[scheduling]") {
+    SchedulingConfig config;
+    REQUIRE_FALSE(audio_thread_policy(config, true).is_set());
+    REQUIRE_FALSE(audio_thread_policy(config, false).is_set());
+    
+    config.capture_cpus = "3";
+    config.playback_cpus = "2";
+    config.realtime = true;
+    ThreadPolicy capture = audio_thread_policy(config, true);
+    REQUIRE(capture.cpus == std::vector<int>{3});
+    REQUIRE(capture.priority == config.capture_priority);
+    ThreadPolicy playback = audio_thread_policy(config, false);
+    REQUIRE(playback.cpus == std::vector<int>{2});
+    REQUIRE(playback.priority == config.playback_priority);
+    
+    // A malformed list only loses the pinning
+    config.capture_cpus = "three";
+    capture = audio_thread_policy(config, true);
+    REQUIRE(capture.cpus.empty());
+    REQUIRE(capture.priority == config.capture_priority);
+}
+
+TEST_CASE("Worker threads get the cores the audio threads leave", "[scheduling]") {
+    const std::vector<int> all = {0, 1, 2, 3};
+    SchedulingConfig config;
+    REQUIRE(worker_cpus(config, all).empty());
+    
+    config.capture_cpus = "3";
+    config.playback_cpus = "2";
+    REQUIRE(worker_cpus(config, all) == std::vector<int>{0, 1});
+    
+    config.worker_cpus = "1";
+    REQUIRE(worker_cpus(config, all) == std::vector<int>{1});
+    
+    config.worker_cpus = "";
+    config.capture_cpus = "0-3";
+    REQUIRE(worker_cpus(config, all).empty());
+}
+
+TEST_CASE("apply_thread_policy pins the calling thread", "[scheduling]") {
+    std::vector<int> cpus = allowed_cpus();
+    REQUIRE_FALSE(cpus.empty());
+    
+    // In a thread of its own, so the test runner keeps its affinity
+    ThreadPolicy policy;
+    policy.cpus = {cpus.front()};
+    bool applied = false;
+    std::vector<int> seen;
+    std::thread worker([&] {
+        applied = apply_thread_policy(policy, "test");
+        seen = allowed_cpus();
+    });
+    worker.join();
+    REQUIRE(applied);
+    REQUIRE(seen == policy.cpus);
+}
@@ -2,6 +2,8 @@
 #include <catch2/catch.hpp>
 #include <string>
 #include <filesystem>
+#include <vector>
+#include <memory>
 namespace fs = std::filesystem;
 
 #include "tts_engine.h"
@@ -39,4 +41,251 @@ TEST_CASE("TTSEngine can handle special characters", "[tts]") {
     
     // Should not crash with special characters
     REQUIRE_NOTHROW(tts.speak("Special characters: !@#$%^&*()_+{}|:<>?"));
-}
\ No newline at end of file
+}
+TEST_CASE("TTSEngine cancel makes speak return immediately", "[tts]") {
+    TTSConfig config;
+    config.engine = "espeak";
+    config.voice = "en";
+    config.speed = 150;
+    
+    TTSEngine tts(config);
+    tts.cancel();
+    REQUIRE(tts.is_cancelled());
+    REQUIRE_NOTHROW(tts.speak("This should not be spoken"));
+    
+    tts.reset_cancel();
+    REQUIRE_FALSE(tts.is_cancelled());
+}
+
+TEST_CASE("TTSSpeechQueue cancel drops queued sentences", "[tts]") {
+    TTSConfig config;
+    config.engine = "espeak";
+    config.voice = "en";
+    config.speed = 150;
+    
+    TTSEngine tts(config);
+    TTSSpeechQueue queue(tts);
+    queue.enqueue("First sentence.");
+    queue.enqueue("Second sentence.");
+    queue.enqueue("Third sentence.");
+    
+    queue.cancel();
+    REQUIRE_FALSE(queue.is_active());
+    REQUIRE_FALSE(tts.is_cancelled());
+}
+
+// Synthesizer that produces a fixed number of blocks for any text
+class FakeSynthesizer : public SpeechSynthesizer {
+public:
+    int blocks = 4;
+    bool cancel_after_first = false;
+    TTSEngine* engine = nullptr;
+    
+    bool synthesize(const std::string& text, PcmSink& sink, const std::atomic<bool>& cancelled) override {
+        std::vector<int16_t> block(text.size(), 1000);
+        for (int i = 0; i < blocks; i++) {
+            if (cancelled.load()) {
+                return false;
+            }
+            if (!sink.write(block.data(), block.size())) {
+                return false;
+            }
+            if (cancel_after_first && engine) {
+                engine->cancel();
+            }
+        }
+        return true;
+    }
+    
+    int sample_rate() const override { return 22050; }
+};
+
+// Sink that records what it was asked to do
+class RecordingSink : public PcmSink {
+public:
+    int begin_rate = 0;
+    size_t samples_written = 0;
+    int drains = 0;
+    int drops = 0;
+    
+    bool begin(int sample_rate) override { begin_rate = sample_rate; return true; }
+    bool write(const int16_t*, size_t count) override { samples_written += count; return true; }
+    void drain() override { drains++; }
+    void drop() override { drops++; }
+};
+
+TEST_CASE("TTSEngine streams native synthesis into the sink", "[tts]") {
+    TTSConfig config;
+    TTSEngine tts(config);
+    REQUIRE_FALSE(tts.has_native_backend());
+    
+    auto synthesizer = std::make_unique<FakeSynthesizer>();
+    auto sink = std::make_unique<RecordingSink>();
+    RecordingSink* recorded = sink.get();
+    tts.set_native_backend(std::move(synthesizer), std::move(sink));
+    REQUIRE(tts.has_native_backend());
+    
+    tts.speak("Hello");
+    REQUIRE(recorded->begin_rate == 22050);
+    REQUIRE(recorded->samples_written == 4 * 5);
+    REQUIRE(recorded->drains == 1);
+    REQUIRE(recorded->drops == 0);
+}
+
+TEST_CASE("TTSEngine reports when speech starts and first plays", "[tts][metrics]") {
+    TTSConfig config;
+    TTSEngine tts(config);
+    tts.set_native_backend(std::make_unique<FakeSynthesizer>(), std::make_unique<RecordingSink>());
+    
+    LatencyMetrics metrics;
+    metrics.enable();
+    tts.set_metrics(&metrics);
+    
+    metrics.begin_turn();
+    tts.speak("Hello");
+    LatencyMetrics::Turn turn = metrics.end_turn();
+    REQUIRE(turn.has(TurnEvent::TtsStart));
+    REQUIRE(turn.has(TurnEvent::FirstAudio));
+    REQUIRE(turn.elapsed_ms(TurnEvent::TtsStart, TurnEvent::FirstAudio) >= 0.0);
+}
+
+TEST_CASE("TTSEngine cancel cuts native playback off", "[tts]") {
+    TTSConfig config;
+    TTSEngine tts(config);
+    
+    auto synthesizer = std::make_unique<FakeSynthesizer>();
+    synthesizer->cancel_after_first = true;
+    synthesizer->engine = &tts;
+    auto sink = std::make_unique<RecordingSink>();
+    RecordingSink* recorded = sink.get();
+    tts.set_native_backend(std::move(synthesizer), std::move(sink));
+    
+    tts.speak("Hello");
+    REQUIRE(recorded->samples_written == 5);
+    REQUIRE(recorded->drops == 1);
+    REQUIRE(recorded->drains == 0);
+}
+
+TEST_CASE("TTSEngine recognises ALSA output devices", "[tts]") {
+    REQUIRE(TTSEngine::is_alsa_device("default"));
+    REQUIRE(TTSEngine::is_alsa_device("hw:0,0"));
+    REQUIRE(TTSEngine::is_alsa_device("plughw:1,0"));
+    REQUIRE_FALSE(TTSEngine::is_alsa_device("alsa_output.pci-0000_00_1f.3.analog-stereo"));
+}
+
+TEST_CASE("PhraseCache saves and maps entries back", "[tts][cache]") {
+    std::string path = (fs::temp_directory_path() / "test_phrase_cache.bin").string();
+    std::string key = PhraseCache::make_key("Goodbye.", "en", 150);
+    
+    {
+        PhraseCache cache;
+        cache.store(key, std::vector<int16_t>{1, -2, 3}, 22050);
+        cache.store(PhraseCache::make_key("Hi", "en", 150), std::vector<int16_t>(101, 7), 16000);
+        REQUIRE(cache.save(path));
+    }
+    
+    PhraseCache loaded;
+    REQUIRE(loaded.load(path));
+    REQUIRE(loaded.size() == 2);
+    
+    const PhraseCache::Entry* entry = loaded.find(key);
+    REQUIRE(entry != nullptr);
+    REQUIRE(entry->sample_rate == 22050);
+    REQUIRE(entry->count == 3);
+    REQUIRE(entry->samples()[1] == -2);
+    
+    // A different voice or speed is a different phrase
+    REQUIRE(loaded.find(PhraseCache::make_key("Goodbye.", "en", 175)) == nullptr);
+    
+    std::remove(path.c_str());
+    REQUIRE_FALSE(loaded.load(path));
+}
+
+TEST_CASE("TTSEngine plays warmed phrases without synthesizing", "[tts][cache]") {
+    TTSConfig config;
+    TTSEngine tts(config);
+    
+    auto synthesizer = std::make_unique<FakeSynthesizer>();
+    FakeSynthesizer* synth = synthesizer.get();
+    auto sink = std::make_unique<RecordingSink>();
+    RecordingSink* recorded = sink.get();
+    tts.set_native_backend(std::move(synthesizer), std::move(sink));
+    
+    REQUIRE(tts.warm_phrase_cache({"Goodbye."}) == 1);
+    REQUIRE(tts.warm_phrase_cache({"Goodbye."}) == 0);
+    REQUIRE(tts.cached_phrase_count() == 1);
+    
+    // The cached audio is played even once the synthesizer produces nothing
+    synth->blocks = 0;
+    tts.speak("Goodbye.");
+    REQUIRE(recorded->samples_written == 4 * 8);
+    REQUIRE(recorded->drains == 1);
+    
+    tts.speak("Not cached");
+    REQUIRE(recorded->samples_written == 4 * 8);
+}
+
+TEST_CASE("TTSEngine keeps the audio of texts it was asked to", "[tts][cache]") {
+    TTSConfig config;
+    TTSEngine tts(config);
+    
+    auto synthesizer = std::make_unique<FakeSynthesizer>();
+    FakeSynthesizer* synth = synthesizer.get();
+    auto sink = std::make_unique<RecordingSink>();
+    RecordingSink* recorded = sink.get();
+    tts.set_native_backend(std::move(synthesizer), std::move(sink));
+    
+    tts.keep_audio("Cached reply.", 1);
+    tts.keep_audio("Over the limit.", 1);
+    tts.speak("Cached reply.");
+    REQUIRE(recorded->samples_written == 4 * 13);
+    REQUIRE(tts.cached_phrase_count() == 1);
+    
+    // Played again from memory, without the synthesizer
+    synth->blocks = 0;
+    tts.speak("Cached reply.");
+    REQUIRE(recorded->samples_written == 2 * 4 * 13);
+    
+    tts.speak("Over the limit.");
+    REQUIRE(recorded->samples_written == 2 * 4 * 13);
+    REQUIRE(tts.cached_phrase_count() == 1);
+}
+
+TEST_CASE("TTSEngines of several sessions share one synthesizer and phrase cache", "[tts][cache]") {
+    TTSConfig config;
+    TTSEngine first(config);
+    TTSEngine second(config);
+    
+    SharedSynthesizer shared(std::make_unique<FakeSynthesizer>());
+    auto first_sink = std::make_unique<RecordingSink>();
+    auto second_sink = std::make_unique<RecordingSink>();
+    RecordingSink* first_recorded = first_sink.get();
+    RecordingSink* second_recorded = second_sink.get();
+    first.set_native_backend(shared.share(), std::move(first_sink));
+    second.set_native_backend(shared.share(), std::move(second_sink));
+    
+    REQUIRE(first.warm_phrase_cache({"Goodbye."}) == 1);
+    second.set_phrase_cache(first.get_phrase_cache());
+    REQUIRE(second.cached_phrase_count() == 1);
+    
+    // Synthesized text reaches the sink of the engine that spoke it
+    second.speak("Hello");
+    REQUIRE(second_recorded->begin_rate == 22050);
+    REQUIRE(second_recorded->samples_written == 4 * 5);
+    REQUIRE(first_recorded->samples_written == 0);
+    
+    second.speak("Goodbye.");
+    REQUIRE(second_recorded->samples_written == 4 * 5 + 4 * 8);
+}
+
+TEST_CASE("PhraseCache keeps the first audio stored for a key", "[tts][cache]") {
+    PhraseCache cache;
+    std::string key = PhraseCache::make_key("Hi", "en", 150);
+    cache.store(key, std::vector<int16_t>{1, 2}, 16000);
+    const PhraseCache::Entry* entry = cache.find(key);
+    
+    cache.store(key, std::vector<int16_t>{3, 4, 5}, 22050);
+    REQUIRE(cache.find(key) == entry);
+    REQUIRE(entry->count == 2);
+    REQUIRE(entry->sample_rate == 16000);
+}
@@ -0,0 +1,82 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+#include "tts_normalizer.h"
+
+// Normalize text fed in chunks of the given size
+static std::string normalize_in_chunks(const std::string& text, size_t chunk_size) {
+    TTSNormalizer normalizer;
+    std::string out;
+    for (size_t i = 0; i < text.size(); i += chunk_size) {
+        normalizer.feed(text.substr(i, chunk_size), out);
+    }
+    normalizer.flush(out);
+    return out;
+}
+
+TEST_CASE("TTSNormalizer strips markdown formatting", "[tts][normalizer]") {
+    REQUIRE(TTSNormalizer::normalize("This is **bold** and _italic_.") == "This is bold and italic.");
+    REQUIRE(TTSNormalizer::normalize("Run `make` first.") == "Run make first.");
+    REQUIRE(TTSNormalizer::normalize("See [the docs](https://example.com/docs) now.") == "See the docs now.");
+    REQUIRE(TTSNormalizer::normalize("Visit https://example.com/a?b=c.") == "Visit website link.");
+}
+
+TEST_CASE("TTSNormalizer reads code blocks as a single sentence", "[tts][normalizer]") {
+    std::string text = "Here you go:\n```cpp\nint x = 1;\n```\nThat is all.";
+    REQUIRE(TTSNormalizer::normalize(text) ==
+            "Here you go is I've prepared some code for you, but I won't read it aloud. That is all.");
+}
+
+TEST_CASE("TTSNormalizer turns headings and bullets into sentences", "[tts][normalizer]") {
+    std::string text = "# Plan\n- Buy milk\n- Call Bob\n\nDone";
+    REQUIRE(TTSNormalizer::normalize(text) ==
+            "Main topic: Plan. Point: Buy milk. Point: Call Bob. Done");
+    REQUIRE(TTSNormalizer::normalize("## Notes\n### Details") == "Subtopic: Notes. Section: Details.");
+}
+
+TEST_CASE("TTSNormalizer speaks symbols, ordinals and abbreviations", "[tts][normalizer]") {
+    REQUIRE(TTSNormalizer::normalize("5 + 3 = 8") == "5 plus 3 equals 8");
+    REQUIRE(TTSNormalizer::normalize("50% of $10") == "50 percent of dollars 10");
+    REQUIRE(TTSNormalizer::normalize("the 1st and 2nd, not 21st") == "the first and second, not 21st");
+    REQUIRE(TTSNormalizer::normalize("fruit, e.g. apples") == "fruit, for example apples");
+    REQUIRE(TTSNormalizer::normalize("a well-known result") == "a well-known result");
+    REQUIRE(TTSNormalizer::normalize("Meet at 10:30 today") == "Meet at 10:30 today");
+    REQUIRE(TTSNormalizer::normalize("Great job 👍") == "Great job thumbs up");
+}
+
+TEST_CASE("TTSNormalizer collapses whitespace and repeated periods", "[tts][normalizer]") {
+    REQUIRE(TTSNormalizer::normalize("  Hello   world \t again  ") == "Hello world again");
+    REQUIRE(TTSNormalizer::normalize("Wait... what") == "Wait. what");
+    REQUIRE(TTSNormalizer::normalize("Line one\nline two") == "Line one line two");
+}
+
+TEST_CASE("TTSNormalizer gives the same result however the text is chunked", "[tts][normalizer]") {
+    std::vector<std::string> texts = {
+        "# Title\n* First point\n* Second point\n\nSee [link](http://x.y/z) or https://a.b/c.",
+        "Code: ```\nfoo();\n``` and `bar` with **bold**, e.g. this 3rd case... 50% done 🚀!",
+        "Ratio 3:2 - roughly - is 2nd best, i.e. fine & well-known.",
+    };
+    
+    for (const auto& text : texts) {
+        std::string whole = TTSNormalizer::normalize(text);
+        for (size_t chunk_size = 1; chunk_size <= 8; chunk_size++) {
+            INFO("chunk size " << chunk_size << ": " << text);
+            REQUIRE(normalize_in_chunks(text, chunk_size) == whole);
+        }
+    }
+}
+
+TEST_CASE("TTSNormalizer holds back incomplete constructs", "[tts][normalizer]") {
+    TTSNormalizer normalizer;
+    std::string out;
+    
+    normalizer.feed("Look at ``", out);
+    REQUIRE(out == "Look at");
+    normalizer.feed("`\nsecret\n", out);
+    REQUIRE(out.find("secret") == std::string::npos);
+    normalizer.feed("```\nDone", out);
+    normalizer.flush(out);
+    REQUIRE(out == "Look at I've prepared some code for you, but I won't read it aloud. Done");
+}
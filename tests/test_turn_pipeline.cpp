@@ -0,0 +1,127 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "turn_pipeline.h"
+
+TEST_CASE("BoundedQueue hands items over in order", "[pipeline]") {
+    BoundedQueue<int> queue(4);
+    std::vector<int> received;
+    
+    std::thread consumer([&] {
+        int item;
+        while (queue.pop(item)) {
+            received.push_back(item);
+        }
+    });
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(queue.push(i));
+    }
+    queue.close();
+    consumer.join();
+    
+    REQUIRE(received.size() == 100);
+    for (int i = 0; i < 100; i++) {
+        REQUIRE(received[i] == i);
+    }
+}
+
+TEST_CASE("BoundedQueue holds producers back when full", "[pipeline]") {
+    BoundedQueue<int> queue(2);
+    REQUIRE(queue.push(1));
+    REQUIRE(queue.push(2));
+    
+    std::atomic<bool> pushed{false};
+    std::thread producer([&] {
+        queue.push(3);
+        pushed.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE_FALSE(pushed.load());
+    
+    int item = 0;
+    REQUIRE(queue.pop(item));
+    REQUIRE(item == 1);
+    producer.join();
+    REQUIRE(pushed.load());
+    REQUIRE(queue.size() == 2);
+}
+
+TEST_CASE("Closing a BoundedQueue wakes waiters", "[pipeline]") {
+    BoundedQueue<int> queue(1);
+    
+    SECTION("A waiting consumer gets nothing") {
+        std::thread consumer([&] {
+            int item;
+            REQUIRE_FALSE(queue.pop(item));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.close();
+        consumer.join();
+    }
+    
+    SECTION("A waiting producer's item is refused") {
+        REQUIRE(queue.push(1));
+        std::thread producer([&] {
+            REQUIRE_FALSE(queue.push(2));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.close();
+        producer.join();
+        
+        // What was queued before closing can still be taken
+        int item = 0;
+        REQUIRE(queue.pop(item));
+        REQUIRE(item == 1);
+        REQUIRE_FALSE(queue.pop(item));
+    }
+    
+    SECTION("Nothing is accepted after closing") {
+        queue.close();
+        REQUIRE_FALSE(queue.push(1));
+    }
+}
+
+TEST_CASE("PipelineStage chains stages and finishes in order", "[pipeline]") {
+    std::vector<int> results;
+    PipelineStage<int> last(2, [&](int& item) { results.push_back(item); });
+    PipelineStage<int> first(2, [&](int& item) { last.submit(item * 10); });
+    
+    for (int i = 1; i <= 5; i++) {
+        REQUIRE(first.submit(i));
+    }
+    first.finish();
+    last.finish();
+    
+    REQUIRE(results == std::vector<int>{10, 20, 30, 40, 50});
+    REQUIRE_FALSE(first.submit(6));
+}
+
+TEST_CASE("Cancelling a PipelineStage drops queued work", "[pipeline]") {
+    std::atomic<bool> release{false};
+    std::atomic<int> handled{0};
+    PipelineStage<int> stage(4, [&](int&) {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        handled++;
+    });
+    
+    // The first item is being handled, the rest wait in the queue
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(stage.submit(i));
+    }
+    while (stage.pending() > 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stage.cancel();
+    REQUIRE(stage.pending() == 0);
+    REQUIRE_FALSE(stage.submit(5));
+    
+    release.store(true);
+    stage.finish();
+    REQUIRE(handled.load() == 1);
+}
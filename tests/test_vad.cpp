@@ -0,0 +1,164 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <cmath>
+
+#include "vad.h"
+
+// A tone with a little noise-free silence after it
+static std::vector<float> make_test_signal(int sample_rate) {
+    std::vector<float> audio;
+    for (int i = 0; i < sample_rate; i++) {
+        audio.push_back(0.3f * std::sin(2.0f * 3.14159265f * 220.0f * i / sample_rate));
+    }
+    audio.resize(audio.size() + sample_rate, 0.0f);
+    return audio;
+}
+
+TEST_CASE("detect_voice_activity spots a tone and ignores silence", "[vad]") {
+    const int rate = 16000;
+    std::vector<float> tone(rate / 2);
+    for (size_t i = 0; i < tone.size(); i++) {
+        tone[i] = 0.3f * std::sin(2.0f * 3.14159265f * 220.0f * i / rate);
+    }
+    std::vector<float> silence(rate / 2, 0.0f);
+    
+    REQUIRE(detect_voice_activity(tone, rate, 0.001f, 30.0f));
+    REQUIRE_FALSE(detect_voice_activity(silence, rate, 0.001f, 30.0f));
+}
+
+TEST_CASE("VoiceActivityDetector matches detect_voice_activity on each window", "[vad]") {
+    const int rate = 16000;
+    const float threshold = 0.001f;
+    const float freq_threshold = 30.0f;
+    std::vector<float> audio = make_test_signal(rate);
+    
+    VoiceActivityDetector vad(rate, 500, 100, threshold, freq_threshold);
+    REQUIRE(vad.get_window_size() == 8000);
+    REQUIRE(vad.get_hop_size() == 1600);
+    
+    // Feed in odd-sized chunks so hops straddle chunk boundaries
+    std::vector<bool> incremental;
+    std::vector<size_t> decision_ends;
+    size_t pos = 0;
+    while (pos < audio.size()) {
+        size_t count = std::min<size_t>(1234, audio.size() - pos);
+        vad.process(audio.data() + pos, count, [&](bool is_speech, size_t offset) {
+            incremental.push_back(is_speech);
+            decision_ends.push_back(pos + offset);
+            
+            // The running statistics agree with a fresh pass over the window
+            std::vector<float> window(audio.begin() + (pos + offset - 8000), audio.begin() + (pos + offset));
+            float energy = 0.0f;
+            for (float s : window) energy += s * s;
+            REQUIRE(vad.get_stats().energy == Approx(energy / window.size()).epsilon(1e-4));
+        });
+        pos += count;
+    }
+    
+    REQUIRE(incremental.size() == (audio.size() - 8000) / 1600 + 1);
+    for (size_t i = 0; i < incremental.size(); i++) {
+        std::vector<float> window(audio.begin() + (decision_ends[i] - 8000), audio.begin() + decision_ends[i]);
+        REQUIRE(incremental[i] == detect_voice_activity(window, rate, threshold, freq_threshold));
+    }
+    
+    // The tone is detected first and the trailing silence ends it
+    REQUIRE(incremental.front());
+    REQUIRE_FALSE(incremental.back());
+}
+
+TEST_CASE("VoiceActivityDetector tracks the window peak", "[vad]") {
+    VoiceActivityDetector vad(1000, 10, 1, 0.001f, 30.0f);
+    std::vector<float> audio(30, 0.01f);
+    audio[5] = 0.9f;
+    
+    std::vector<float> peaks;
+    vad.process(audio.data(), audio.size(), [&](bool, size_t) {
+        peaks.push_back(vad.get_stats().peak_energy);
+    });
+    
+    // The spike is in the first windows, then drops out
+    REQUIRE(peaks.front() == Approx(0.81f));
+    REQUIRE(peaks.back() == Approx(0.0001f));
+    
+    vad.reset();
+    REQUIRE_FALSE(vad.is_speech());
+}
+
+// Classifier that calls everything speech and records what it was given
+class RecordingClassifier : public SpeechClassifier {
+public:
+    float probability = 0.9f;
+    std::vector<std::vector<float>> windows;
+    
+    float speech_probability(const float* samples, size_t count) override {
+        windows.emplace_back(samples, samples + count);
+        return probability;
+    }
+    
+    const char* name() const override { return "recording"; }
+};
+
+TEST_CASE("A speech classifier only runs on windows past the energy gate", "[vad]") {
+    const int rate = 16000;
+    std::vector<float> audio = make_test_signal(rate);
+    
+    RecordingClassifier classifier;
+    VoiceActivityDetector vad(rate, 500, 100, 0.001f, 30.0f);
+    vad.set_classifier(&classifier, 0.5f);
+    
+    std::vector<bool> decisions;
+    std::vector<size_t> decision_ends;
+    size_t pos = 0;
+    while (pos < audio.size()) {
+        size_t count = std::min<size_t>(1000, audio.size() - pos);
+        vad.process(audio.data() + pos, count, [&](bool is_speech, size_t offset) {
+            decisions.push_back(is_speech);
+            decision_ends.push_back(pos + offset);
+            
+            // Quiet windows never reach the classifier
+            bool gated = passes_energy_gate(vad.get_stats(), 0.001f);
+            REQUIRE(is_speech == gated);
+            REQUIRE((vad.get_speech_probability() >= 0.0f) == gated);
+        });
+        pos += count;
+    }
+    
+    REQUIRE(vad.get_classifier_runs() == classifier.windows.size());
+    REQUIRE(classifier.windows.size() > 0);
+    REQUIRE(classifier.windows.size() < decisions.size());
+    
+    // The classifier sees the whole window in time order, across the wrap
+    size_t run = 0;
+    for (size_t i = 0; i < decisions.size() && run < classifier.windows.size(); i++) {
+        if (!decisions[i]) continue;
+        std::vector<float> expected(audio.begin() + (decision_ends[i] - 8000), audio.begin() + decision_ends[i]);
+        REQUIRE(classifier.windows[run] == expected);
+        run++;
+    }
+}
+
+TEST_CASE("The classifier's probability decides, and can be removed again", "[vad]") {
+    const int rate = 16000;
+    std::vector<float> audio = make_test_signal(rate);
+    
+    RecordingClassifier classifier;
+    classifier.probability = 0.2f; // Loud, but not speech (like a fan)
+    VoiceActivityDetector vad(rate, 500, 100, 0.001f, 30.0f);
+    vad.set_classifier(&classifier, 0.5f);
+    
+    bool any_speech = false;
+    vad.process(audio.data(), audio.size(), [&](bool is_speech, size_t) {
+        any_speech = any_speech || is_speech;
+    });
+    REQUIRE_FALSE(any_speech);
+    REQUIRE(classifier.windows.size() > 0);
+    
+    // Without a classifier the heuristics find the tone again
+    vad.set_classifier(nullptr);
+    vad.reset();
+    vad.process(audio.data(), audio.size(), [&](bool is_speech, size_t) {
+        any_speech = any_speech || is_speech;
+    });
+    REQUIRE(any_speech);
+}
@@ -0,0 +1,87 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+
+#include "wav_file.h"
+
+TEST_CASE("WAV files round-trip as 16-bit mono", "[wav]") {
+    std::vector<float> audio(1600);
+    for (size_t i = 0; i < audio.size(); i++) {
+        audio[i] = 0.5f * std::sin(2.0f * 3.14159265f * 440.0f * i / 16000);
+    }
+    audio[10] = 2.0f; // Clipped on write
+    
+    const std::string path = "test_wav_file_roundtrip.wav";
+    REQUIRE(wav_file::write(path, audio, 16000));
+    
+    std::vector<float> loaded;
+    int rate = 0;
+    REQUIRE(wav_file::read(path, loaded, rate));
+    std::remove(path.c_str());
+    
+    REQUIRE(rate == 16000);
+    REQUIRE(loaded.size() == audio.size());
+    REQUIRE(loaded[10] == Approx(1.0f).margin(1e-4));
+    for (size_t i = 0; i < audio.size(); i++) {
+        if (i == 10) continue;
+        REQUIRE(loaded[i] == Approx(audio[i]).margin(1e-4));
+    }
+}
+
+// Write a stereo 32-bit float file with an extra chunk before the data
+static void write_stereo_float(const std::string& path, const std::vector<float>& left, const std::vector<float>& right) {
+    std::ofstream file(path, std::ios::binary);
+    const uint32_t data_bytes = static_cast<uint32_t>(left.size() * 8);
+    file.write("RIFF", 4);
+    wav_file::write_le32(file, 4 + 24 + 14 + 8 + data_bytes);
+    file.write("WAVEfmt ", 8);
+    wav_file::write_le32(file, 16);
+    wav_file::write_le16(file, 3); // IEEE float
+    wav_file::write_le16(file, 2);
+    wav_file::write_le32(file, 48000);
+    wav_file::write_le32(file, 48000 * 8);
+    wav_file::write_le16(file, 8);
+    wav_file::write_le16(file, 32);
+    file.write("LIST", 4);
+    wav_file::write_le32(file, 5); // Odd size, padded to 6
+    file.write("abcde\0", 6);
+    file.write("data", 4);
+    wav_file::write_le32(file, data_bytes);
+    for (size_t i = 0; i < left.size(); i++) {
+        file.write(reinterpret_cast<const char*>(&left[i]), 4);
+        file.write(reinterpret_cast<const char*>(&right[i]), 4);
+    }
+}
+
+TEST_CASE("Float and multi-channel WAV files are mixed down to mono", "[wav]") {
+    const std::string path = "test_wav_file_stereo.wav";
+    write_stereo_float(path, {0.5f, -1.0f, 0.25f}, {0.1f, 1.0f, 0.25f});
+    
+    std::vector<float> loaded;
+    int rate = 0;
+    REQUIRE(wav_file::read(path, loaded, rate));
+    std::remove(path.c_str());
+    
+    REQUIRE(rate == 48000);
+    REQUIRE(loaded.size() == 3);
+    REQUIRE(loaded[0] == Approx(0.3f));
+    REQUIRE(loaded[1] == Approx(0.0f));
+    REQUIRE(loaded[2] == Approx(0.25f));
+}
+
+TEST_CASE("Files that are not WAV audio are rejected", "[wav]") {
+    const std::string path = "test_wav_file_invalid.wav";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "This is not audio at all";
+    }
+    
+    std::vector<float> loaded;
+    int rate = 0;
+    REQUIRE_FALSE(wav_file::read(path, loaded, rate));
+    REQUIRE_FALSE(wav_file::read("does_not_exist.wav", loaded, rate));
+    std::remove(path.c_str());
+}
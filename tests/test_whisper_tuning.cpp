@@ -0,0 +1,78 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+#include "whisper_tuning.h"
+
+TEST_CASE("count_physical_cores ignores SMT siblings", "[whisper][tuning]") {
+    // Two cores with two hardware threads each
+    std::string cpuinfo =
+        "processor\t: 0\nphysical id\t: 0\ncore id\t\t: 0\n\n"
+        "processor\t: 1\nphysical id\t: 0\ncore id\t\t: 1\n\n"
+        "processor\t: 2\nphysical id\t: 0\ncore id\t\t: 0\n\n"
+        "processor\t: 3\nphysical id\t: 0\ncore id\t\t: 1\n\n";
+    REQUIRE(count_physical_cores(cpuinfo) == 2);
+    
+    // Same core ids on a second socket are different cores
+    std::string two_sockets =
+        "processor\t: 0\nphysical id\t: 0\ncore id\t\t: 0\n\n"
+        "processor\t: 1\nphysical id\t: 1\ncore id\t\t: 0\n\n";
+    REQUIRE(count_physical_cores(two_sockets) == 2);
+    
+    // Without core ids (e.g. many ARM kernels) the caller falls back
+    REQUIRE(count_physical_cores("processor\t: 0\nBogoMIPS\t: 48.00\n") == 0);
+    REQUIRE(detect_physical_cores() >= 1);
+}
+
+TEST_CASE("system_info_has_gpu spots compiled-in GPU backends", "[whisper][tuning]") {
+    REQUIRE(system_info_has_gpu("AVX = 1 | CUDA = 1 | METAL = 0"));
+    REQUIRE_FALSE(system_info_has_gpu("AVX = 1 | CUDA = 0 | METAL = 0 | BLAS = 1"));
+    REQUIRE(system_info_has_gpu("WHISPER : COREML = 0 | OPENVINO = 0 | CUDA : ARCHS = 890 | CPU : SSE3 = 1"));
+    REQUIRE_FALSE(system_info_has_gpu("CPU : SSE3 = 1 | AVX2 = 1 |"));
+}
+
+TEST_CASE("choose_whisper_tuning leaves cores for capture and TTS", "[whisper][tuning]") {
+    WhisperConfig config;
+    
+    WhisperTuning tuning = choose_whisper_tuning(config, 8, false);
+    REQUIRE(tuning.threads == 6);
+    REQUIRE_FALSE(tuning.use_gpu);
+    REQUIRE_FALSE(tuning.flash_attn);
+    
+    // Small machines still get one thread
+    REQUIRE(choose_whisper_tuning(config, 2, false).threads == 1);
+    
+    // Explicit settings win
+    config.threads = 3;
+    REQUIRE(choose_whisper_tuning(config, 8, false).threads == 3);
+    config.threads = 0;
+    config.reserved_cores = 0;
+    REQUIRE(choose_whisper_tuning(config, 8, false).threads == 8);
+    
+    // Flash attention only applies with a GPU
+    config.flash_attn = true;
+    REQUIRE_FALSE(choose_whisper_tuning(config, 8, false).flash_attn);
+    tuning = choose_whisper_tuning(config, 16, true);
+    REQUIRE(tuning.use_gpu);
+    REQUIRE(tuning.flash_attn);
+    REQUIRE(tuning.threads == 4);
+    
+    config.use_gpu = false;
+    REQUIRE_FALSE(choose_whisper_tuning(config, 16, true).use_gpu);
+    
+    // The model is mapped by default, and weight sharing is opt-in
+    REQUIRE(tuning.use_mmap);
+    REQUIRE_FALSE(tuning.share_weights);
+    config.mmap = false;
+    config.share_weights = true;
+    tuning = choose_whisper_tuning(config, 8, false);
+    REQUIRE_FALSE(tuning.use_mmap);
+    REQUIRE(tuning.share_weights);
+}
+
+TEST_CASE("calibration_candidates starts from the chosen count", "[whisper][tuning]") {
+    REQUIRE(calibration_candidates(8) == std::vector<int>{8, 6, 4, 3});
+    REQUIRE(calibration_candidates(2) == std::vector<int>{2, 1});
+    REQUIRE(calibration_candidates(1) == std::vector<int>{1});
+}